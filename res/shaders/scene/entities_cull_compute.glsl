@@ -0,0 +1,96 @@
+#version 450
+
+#define GROUP_SIZE_X 64
+
+layout (local_size_x = GROUP_SIZE_X) in;
+layout (local_size_y = 1) in;
+layout (local_size_z = 1) in;
+
+struct ObjectBounds {
+    vec4 center;
+    vec4 halfExtent;
+};
+
+struct MeshBatch {
+    uint firstObject;
+    uint objectCount;
+    uint _pad0;
+    uint _pad1;
+};
+
+// Matches VkDrawIndexedIndirectCommand. instanceCount is at the same offset in VkDrawIndirectCommand.
+struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(push_constant) uniform PC1 {
+    vec4 frustumPlanes[6];
+    uint objectCount;
+    uint batchCount;
+    uint firstCommand;
+    uint firstInstance;
+};
+
+layout(set = 0, binding = 0, std430) readonly buffer ObjectBoundsBuffer {
+    ObjectBounds objectBounds[];
+};
+
+layout(set = 0, binding = 1, std430) readonly buffer MeshBatchBuffer {
+    MeshBatch meshBatches[];
+};
+
+layout(set = 0, binding = 2, std430) buffer DrawCommandBuffer {
+    DrawCommand drawCommands[];
+};
+
+layout(set = 0, binding = 3, std430) writeonly buffer ObjectIndexBuffer {
+    uint objectIndices[];
+};
+
+bool isVisible(vec3 center, vec3 halfExtent) {
+    for (int i = 0; i < 6; ++i) {
+        vec4 plane = frustumPlanes[i];
+        float distance = dot(plane.xyz, center) + plane.w;
+        float radius = dot(abs(plane.xyz), halfExtent);
+        if (distance + radius < 0.0)
+            return false;
+    }
+    return true;
+}
+
+uint findMeshBatch(uint objectIndex) {
+    // Batches are sorted by firstObject. Find the last batch which starts at or before this object.
+    uint lo = 0;
+    uint hi = batchCount;
+    while (hi - lo > 1) {
+        uint mid = (lo + hi) / 2;
+        if (meshBatches[mid].firstObject <= objectIndex) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+void main() {
+    const uint objectIndex = gl_GlobalInvocationID.x;
+
+    if (objectIndex >= objectCount || batchCount == 0)
+        return;
+
+    ObjectBounds bounds = objectBounds[objectIndex];
+
+    if (!isVisible(bounds.center.xyz, bounds.halfExtent.xyz))
+        return;
+
+    uint batchIndex = findMeshBatch(objectIndex);
+    MeshBatch batch = meshBatches[batchIndex];
+
+    uint slot = atomicAdd(drawCommands[firstCommand + batchIndex].instanceCount, 1);
+    objectIndices[firstInstance + batch.firstObject + slot] = objectIndex;
+}
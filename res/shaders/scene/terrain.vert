@@ -48,7 +48,8 @@ void main() {
     int vertexIndex = int(gl_VertexIndex); // gl_VertexID for OpenGL
 
     ivec2 gridPos = calculateTerrainTileGridPos(vertexIndex, tileGridSize);
-    vec2 normPos = calculateTerrainTileNormalizedPos(gridPos, tileGridSize);
+    vec2 morphedGridPos = calculateTerrainTileMorphedGridPos(gridPos, tileGridSize, tileData);
+    vec2 normPos = calculateTerrainTileNormalizedPos(morphedGridPos, tileGridSize);
 
     vec4 localPos = calculateTerrainTileLocalPos(normPos, tileData.tilePosition, tileData.tileSize);
     vec2 localTex = calculateTerrainTileTexturePos(normPos, tileData.textureOffset, tileData.textureSize);
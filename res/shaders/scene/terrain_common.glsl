@@ -7,6 +7,9 @@ struct TerrainTileData {
     vec2 tileSize;
     vec2 textureOffset;
     vec2 textureSize;
+    uint packedMorphFactors; // unorm8 at each corner, ordered (0,0), (1,0), (0,1), (1,1)
+    uint packedNeighbourDepthDeltas; // uint8 for each edge, ordered -X, -Y, +X, +Y
+    uvec2 packedNeighbourMorphFactors; // unorm8 at both ends of each edge's coarser neighbour
 };
 
 ivec2 calculateTerrainTileGridPos(int vertexIndex, int tileGridSize) {
@@ -29,8 +32,42 @@ ivec2 calculateTerrainTileGridPos(int vertexIndex, int tileGridSize) {
     return gridPos;
 }
 
-vec2 calculateTerrainTileNormalizedPos(ivec2 tilleGridPos, int tileGridSize) {
-    return vec2(tilleGridPos) / float(tileGridSize);
+// Moves the odd vertices of the grid onto the even ones as the tile approaches the distance where it merges with its
+// siblings, so at a morph factor of 1 the tile matches its parent. Edges bordering a coarser tile are collapsed onto
+// that tile's vertices, and morphed the same way it morphs them, so there are no cracks between levels of detail.
+vec2 calculateTerrainTileMorphedGridPos(ivec2 gridPos, int tileGridSize, TerrainTileData tileData) {
+    vec2 pos = vec2(gridPos);
+
+    // Coarser neighbours more than this many levels up would need a vertex spacing larger than half the tile.
+    int maxDepthDelta = findMSB(tileGridSize) - 1;
+
+    for (int i = 0; i < 4; ++i) {
+        int depthDelta = min(int((tileData.packedNeighbourDepthDeltas >> (i * 8)) & 0xFF), maxDepthDelta);
+        int edgeAxis = 1 - i % 2; // Axis along the edge
+        if (depthDelta == 0 || gridPos[1 - edgeAxis] != (i < 2 ? 0 : tileGridSize))
+            continue;
+
+        float coarseScale = float(1 << depthDelta);
+        float coarsePos = floor(pos[edgeAxis] / coarseScale) * coarseScale;
+
+        // Where along the coarser tile's edge this vertex is, to interpolate its morph factor the same way it does.
+        vec4 neighbourMorphFactors = unpackUnorm4x8(tileData.packedNeighbourMorphFactors[i / 2]);
+        vec2 edgeMorphFactors = i % 2 == 0 ? neighbourMorphFactors.xy : neighbourMorphFactors.zw;
+        float tileOffset = mod(tileData.textureOffset[edgeAxis] / tileData.textureSize[edgeAxis], coarseScale);
+        float morphFactor = mix(edgeMorphFactors.x, edgeMorphFactors.y, (tileOffset + coarsePos / float(tileGridSize)) / coarseScale);
+
+        pos[edgeAxis] = coarsePos - mod(coarsePos, 2.0 * coarseScale) * morphFactor;
+        return pos;
+    }
+
+    vec4 morphFactors = unpackUnorm4x8(tileData.packedMorphFactors);
+    vec2 normPos = pos / float(tileGridSize);
+    float morphFactor = mix(mix(morphFactors.x, morphFactors.y, normPos.x), mix(morphFactors.z, morphFactors.w, normPos.x), normPos.y);
+    return pos - mod(pos, 2.0) * morphFactor;
+}
+
+vec2 calculateTerrainTileNormalizedPos(vec2 tilleGridPos, int tileGridSize) {
+    return tilleGridPos / float(tileGridSize);
 }
 
 vec4 calculateTerrainTileLocalPos(vec2 normalizedTilePos , vec2 tileOffset, vec2 tileSize) {
@@ -0,0 +1,111 @@
+#include "benchmark/FrustumCullingBenchmark.h"
+#include "core/engine/scene/bound/Frustum.h"
+#include "core/engine/scene/bound/BoundingVolume.h"
+#include "core/engine/scene/bound/Visibility.h"
+#include "core/util/Time.h"
+#include "core/util/Logger.h"
+#include <cstring>
+#include <random>
+
+void FrustumCullingBenchmark::run(const Frustum& frustum, size_t count, size_t iterations) {
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<float> randPosition(-100.0F, 100.0F);
+    std::uniform_real_distribution<float> randSize(0.1F, 2.0F);
+
+    std::vector<float> centerX(count), centerY(count), centerZ(count);
+    std::vector<float> halfExtentX(count), halfExtentY(count), halfExtentZ(count);
+    std::vector<BoundingSphere> spheres;
+    std::vector<AxisAlignedBoundingBox> boxes;
+    spheres.reserve(count);
+    boxes.reserve(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        centerX[i] = randPosition(gen);
+        centerY[i] = randPosition(gen);
+        centerZ[i] = randPosition(gen);
+        halfExtentX[i] = randSize(gen);
+        halfExtentY[i] = randSize(gen);
+        halfExtentZ[i] = randSize(gen);
+        spheres.emplace_back(glm::dvec3(centerX[i], centerY[i], centerZ[i]), halfExtentX[i]);
+        boxes.emplace_back(glm::dvec3(centerX[i], centerY[i], centerZ[i]), glm::dvec3(halfExtentX[i], halfExtentY[i], halfExtentZ[i]));
+    }
+
+    std::vector<uint8_t> scalarVisibility(count);
+    std::vector<uint8_t> batchVisibility(count);
+
+    auto testScalar = [&](const BoundingVolume& boundingVolume) {
+        if (!frustum.intersects(boundingVolume))
+            return (uint8_t)Visibility_NotVisible;
+        return (uint8_t)(frustum.contains(boundingVolume) ? Visibility_FullyVisible : Visibility_PartiallyVisible);
+    };
+
+    auto countMismatches = [&]() {
+        size_t mismatches = 0;
+        for (size_t i = 0; i < count; ++i)
+            if (scalarVisibility[i] != batchVisibility[i])
+                ++mismatches;
+        return mismatches;
+    };
+
+    Time::moment_t startTime = Time::now();
+    for (size_t n = 0; n < iterations; ++n)
+        for (size_t i = 0; i < count; ++i)
+            scalarVisibility[i] = testScalar(spheres[i]);
+    double scalarSphereTime = Time::milliseconds(startTime) / iterations;
+
+    startTime = Time::now();
+    for (size_t n = 0; n < iterations; ++n)
+        frustum.testSpheres(centerX.data(), centerY.data(), centerZ.data(), halfExtentX.data(), count, batchVisibility.data());
+    double batchSphereTime = Time::milliseconds(startTime) / iterations;
+
+    size_t sphereMismatches = countMismatches();
+
+    startTime = Time::now();
+    for (size_t n = 0; n < iterations; ++n)
+        for (size_t i = 0; i < count; ++i)
+            scalarVisibility[i] = testScalar(boxes[i]);
+    double scalarAABBTime = Time::milliseconds(startTime) / iterations;
+
+    startTime = Time::now();
+    for (size_t n = 0; n < iterations; ++n)
+        frustum.testAABBs(centerX.data(), centerY.data(), centerZ.data(), halfExtentX.data(), halfExtentY.data(), halfExtentZ.data(), count, batchVisibility.data());
+    double batchAABBTime = Time::milliseconds(startTime) / iterations;
+
+    size_t aabbMismatches = countMismatches();
+
+    // Small numbers of mismatches are expected for volumes touching a plane, since the batched tests are single precision.
+    LOG_INFO("Frustum culling benchmark (%zu volumes): Spheres: scalar %.3f msec, batched %.3f msec (%zu mismatches) - AABBs: scalar %.3f msec, batched %.3f msec (%zu mismatches)",
+             count, scalarSphereTime, batchSphereTime, sphereMismatches, scalarAABBTime, batchAABBTime, aabbMismatches);
+}
+
+int FrustumCullingBenchmark::main(int argc, char* argv[]) {
+    size_t count = 100000;
+    size_t iterations = 20;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--benchmark-frustum") == 0) {
+            continue;
+        } else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            count = (size_t)strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = (size_t)strtoull(argv[++i], nullptr, 10);
+        } else {
+            LOG_ERROR("Usage: %s --benchmark-frustum [--count <volumes>] [--iterations <count>]", argv[0]);
+            return 1;
+        }
+    }
+
+    if (count == 0 || iterations == 0) {
+        LOG_ERROR("Unable to run frustum culling benchmark: The volume and iteration counts must not be zero");
+        return 1;
+    }
+
+    // A camera inside the volumes, so that some are fully visible, some partially, and most are outside.
+    glm::dvec3 origin(0.0, 0.0, 0.0);
+    glm::dmat4 projection = glm::perspective(glm::radians(90.0), 16.0 / 9.0, 0.1, 150.0);
+    glm::dmat4 view = glm::lookAt(origin, glm::dvec3(0.0, 0.0, -1.0), glm::dvec3(0.0, 1.0, 0.0));
+    Frustum frustum(origin, projection * view);
+
+    run(frustum, count, iterations);
+    return 0;
+}
@@ -0,0 +1,20 @@
+#ifndef WORLDENGINE_FRUSTUMCULLINGBENCHMARK_H
+#define WORLDENGINE_FRUSTUMCULLINGBENCHMARK_H
+
+#include "core/core.h"
+
+class Frustum;
+
+// Compares Frustum's batched visibility tests against testing each volume individually through its BoundingVolume,
+// on the CPU only.
+namespace FrustumCullingBenchmark {
+    // Times both paths for count random spheres and AABBs around the origin, and logs the results.
+    void run(const Frustum& frustum, size_t count = 100000, size_t iterations = 20);
+
+    // Runs the benchmark against a fixed camera, without creating an application, so it can run unattended.
+    // Usage: WorldEngine --benchmark-frustum [--count <volumes>] [--iterations <count>]
+    int main(int argc, char* argv[]);
+}
+
+
+#endif //WORLDENGINE_FRUSTUMCULLINGBENCHMARK_H
@@ -0,0 +1,212 @@
+// Replays allocation traces against OffsetAllocator on the CPU, to measure the cost of allocating and freeing, and the
+// fragmentation left behind, without a GPU.
+//
+// Usage: OffsetAllocatorBenchmark [--trace <file>] [--write-trace <file>] [--heap-size <bytes>] [--ops <count>] [--seed <seed>]
+//
+// A trace file has one operation per line. "a <id> <size> <alignment>" allocates, and "f <id>" frees the allocation
+// with that id. Without a trace file, a synthetic streaming trace is generated, where buffers and images of mixed sizes
+// are created and freed around a steady working set.
+
+#include "core/util/OffsetAllocator.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct TraceOp {
+    bool allocate;
+    uint32_t id;
+    uint64_t size;
+    uint64_t alignment;
+};
+
+static bool readTrace(const char* filePath, std::vector<TraceOp>& outOps) {
+    std::ifstream file(filePath);
+    if (!file.is_open()) {
+        printf("Unable to open trace file \"%s\"\n", filePath);
+        return false;
+    }
+
+    std::string type;
+    while (file >> type) {
+        TraceOp op{};
+        if (type == "a") {
+            op.allocate = true;
+            file >> op.id >> op.size >> op.alignment;
+        } else if (type == "f") {
+            op.allocate = false;
+            file >> op.id;
+        } else {
+            printf("Invalid operation \"%s\" in trace file \"%s\"\n", type.c_str(), filePath);
+            return false;
+        }
+        outOps.emplace_back(op);
+    }
+    return true;
+}
+
+static bool writeTrace(const char* filePath, const std::vector<TraceOp>& ops) {
+    std::ofstream file(filePath);
+    if (!file.is_open()) {
+        printf("Unable to open trace file \"%s\" for writing\n", filePath);
+        return false;
+    }
+
+    for (const TraceOp& op : ops) {
+        if (op.allocate)
+            file << "a " << op.id << " " << op.size << " " << op.alignment << "\n";
+        else
+            file << "f " << op.id << "\n";
+    }
+    return true;
+}
+
+static void generateTrace(size_t opCount, uint64_t heapSize, uint64_t seed, std::vector<TraceOp>& outOps) {
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    // Mostly small buffers, with fewer but much larger images, similar to streamed meshes and textures.
+    auto randomSize = [&](uint64_t minSize, uint64_t maxSize) {
+        double t = unit(rng);
+        return (uint64_t)((double)minSize * std::pow((double)maxSize / (double)minSize, t * t));
+    };
+
+    // Keep the live set around half of the heap, so allocations churn without running out of space.
+    const uint64_t targetLiveBytes = heapSize / 2;
+
+    std::vector<std::pair<uint32_t, uint64_t>> live;
+    uint64_t liveBytes = 0;
+    uint32_t nextId = 0;
+
+    outOps.reserve(opCount);
+    while (outOps.size() < opCount) {
+        bool allocate = live.empty() || (liveBytes < targetLiveBytes ? unit(rng) < 0.6 : unit(rng) < 0.4);
+
+        if (allocate) {
+            TraceOp op{};
+            op.allocate = true;
+            op.id = nextId++;
+            if (unit(rng) < 0.8) {
+                op.size = randomSize(256, 4 * 1024 * 1024);
+                op.alignment = 256;
+            } else {
+                op.size = randomSize(64 * 1024, 16 * 1024 * 1024);
+                op.alignment = 64 * 1024;
+            }
+            live.emplace_back(op.id, op.size);
+            liveBytes += op.size;
+            outOps.emplace_back(op);
+        } else {
+            size_t index = (size_t)(rng() % live.size());
+            TraceOp op{};
+            op.allocate = false;
+            op.id = live[index].first;
+            liveBytes -= live[index].second;
+            live[index] = live.back();
+            live.pop_back();
+            outOps.emplace_back(op);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* traceFilePath = nullptr;
+    const char* writeTraceFilePath = nullptr;
+    uint64_t heapSize = 128ull * 1024 * 1024;
+    size_t opCount = 1000000;
+    uint64_t seed = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            traceFilePath = argv[++i];
+        } else if (strcmp(argv[i], "--write-trace") == 0 && i + 1 < argc) {
+            writeTraceFilePath = argv[++i];
+        } else if (strcmp(argv[i], "--heap-size") == 0 && i + 1 < argc) {
+            heapSize = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--ops") == 0 && i + 1 < argc) {
+            opCount = (size_t)strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else {
+            printf("Usage: %s [--trace <file>] [--write-trace <file>] [--heap-size <bytes>] [--ops <count>] [--seed <seed>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<TraceOp> ops;
+    if (traceFilePath != nullptr) {
+        if (!readTrace(traceFilePath, ops))
+            return 1;
+    } else {
+        generateTrace(opCount, heapSize, seed, ops);
+    }
+
+    if (writeTraceFilePath != nullptr && !writeTrace(writeTraceFilePath, ops))
+        return 1;
+
+    OffsetAllocator allocator(heapSize);
+    std::unordered_map<uint32_t, uint32_t> allocationIndices;
+    allocationIndices.reserve(ops.size());
+
+    size_t allocateCount = 0;
+    size_t freeCount = 0;
+    size_t failedCount = 0;
+    double allocateSeconds = 0.0;
+    double freeSeconds = 0.0;
+    double maxFragmentation = 0.0;
+    uint32_t maxAllocationCount = 0;
+
+    for (size_t i = 0; i < ops.size(); ++i) {
+        const TraceOp& op = ops[i];
+
+        if (op.allocate) {
+            auto t0 = std::chrono::high_resolution_clock::now();
+            OffsetAllocator::Allocation allocation = allocator.allocate(op.size, op.alignment);
+            allocateSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t0).count();
+            ++allocateCount;
+
+            if (!allocation.valid()) {
+                ++failedCount;
+                continue;
+            }
+            allocationIndices[op.id] = allocation.index;
+            maxAllocationCount = std::max(maxAllocationCount, allocator.getAllocationCount());
+
+        } else {
+            auto it = allocationIndices.find(op.id);
+            if (it == allocationIndices.end())
+                continue; // The allocation failed, or the trace frees an unknown id.
+
+            auto t0 = std::chrono::high_resolution_clock::now();
+            allocator.free(it->second);
+            freeSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t0).count();
+            ++freeCount;
+
+            allocationIndices.erase(it);
+        }
+
+        // Stats scan the largest size class, so they are sampled rather than taken after every operation.
+        if (i % 1024 == 0)
+            maxFragmentation = std::max(maxFragmentation, allocator.getStats().getFragmentation());
+    }
+
+    OffsetAllocator::Stats stats = allocator.getStats();
+
+    printf("Replayed %zu operations on a %.2f MiB heap\n", ops.size(), (double)heapSize / (1024.0 * 1024.0));
+    printf("  allocate: %zu calls, %.1f ns/call, %zu failed\n", allocateCount, allocateCount > 0 ? allocateSeconds * 1e9 / (double)allocateCount : 0.0, failedCount);
+    printf("  free:     %zu calls, %.1f ns/call\n", freeCount, freeCount > 0 ? freeSeconds * 1e9 / (double)freeCount : 0.0);
+    printf("  peak allocations: %u\n", maxAllocationCount);
+    printf("  peak fragmentation (sampled): %.3f\n", maxFragmentation);
+    printf("  final: %u allocations, %.2f MiB allocated, %u free regions, largest free region %.2f MiB, fragmentation %.3f\n",
+           stats.allocationCount, (double)stats.allocatedBytes / (1024.0 * 1024.0), stats.freeRegionCount,
+           (double)stats.largestFreeRegion / (1024.0 * 1024.0), stats.getFragmentation());
+
+    return 0;
+}
@@ -335,6 +335,7 @@ void Application::start() {
 
                 auto beginFrame = now;
 
+                ThreadUtils::flushFrame();
                 ThreadUtils::wakeThreads();
 
                 processEventsInternal();
@@ -15,6 +15,8 @@
 #include "core/engine/renderer/EnvironmentMap.h"
 #include "core/engine/event/EventDispatcher.h"
 #include "core/graphics/GraphicsManager.h"
+#include "core/graphics/DescriptorAllocator.h"
+#include "core/thread/TaskGraph.h"
 #include "core/util/Profiler.h"
 #include "core/util/Logger.h"
 #include <SDL2/SDL.h>
@@ -43,7 +45,11 @@ Engine::Engine():
     m_renderWireframeEnabled(false),
     m_debugCompositeEnabled(true),
     m_renderCamera(new RenderCamera()),
-    m_viewFrustum(nullptr) {
+    m_viewFrustum(nullptr),
+    m_visibilityGraph(new TaskGraph()),
+    m_visibilityDeltaTime(0.0),
+    m_terrainVisibility(0),
+    m_sceneVisibility(0) {
 }
 
 Engine::~Engine() {
@@ -64,6 +70,7 @@ Engine::~Engine() {
 
     delete m_renderCamera;
     delete m_viewFrustum;
+    delete m_visibilityGraph;
 }
 
 void Engine::processEvent(const SDL_Event* event) {
@@ -265,6 +272,8 @@ bool Engine::init(SDL_Window* windowHandle) {
         return false;
     }
 
+    initVisibilityGraph();
+
     m_runTime = 0.0;
     m_accumulatedTime = 0.0;
     m_currentFrameCount = 0;
@@ -275,6 +284,26 @@ bool Engine::init(SDL_Window* windowHandle) {
     return true;
 }
 
+void Engine::initVisibilityGraph() {
+    m_visibilityGraph->clear();
+
+    TaskGraph::NodeId terrainVisibility = m_visibilityGraph->addNode("TerrainRenderer::updateVisibility", [this]() {
+        m_terrainVisibility = m_terrainRenderer->updateVisibility(m_visibilityDeltaTime, m_renderCamera, m_viewFrustum);
+    });
+
+    TaskGraph::NodeId sceneVisibility = m_visibilityGraph->addNode("SceneRenderer::updateVisibility", [this]() {
+        m_sceneVisibility = m_sceneRenderer->updateVisibility(m_visibilityDeltaTime, m_renderCamera, m_viewFrustum);
+    });
+
+    TaskGraph::NodeId shadowMapVisibility = m_visibilityGraph->addNode("LightRenderer::updateShadowMapVisibility", [this]() {
+        m_lightRenderer->updateShadowMapVisibility(m_visibilityDeltaTime);
+    });
+
+    // Shadow cascades append their visible terrain tiles to the TerrainRenderer after the main view, so they must
+    // not run at the same time. The SceneRenderer shares no state with either, and runs alongside them.
+    m_visibilityGraph->addDependency(shadowMapVisibility, terrainVisibility);
+}
+
 void Engine::preRender(double dt) {
     PROFILE_SCOPE("Engine::preRender");
 
@@ -319,18 +348,28 @@ void Engine::render(double dt) {
         EnvironmentMap::getEmptyEnvironmentMap();
     }
 
+    // The visibility graph nodes only cull. Everything which reads the registry or creates resources happens here on
+    // the render thread, before or after the graph runs.
     m_terrainRenderer->resetVisibility();
     m_sceneRenderer->resetVisibility();
-
-    uint32_t terrainVisibility = m_terrainRenderer->updateVisibility(dt, m_renderCamera, m_viewFrustum);
-    m_sceneRenderer->updateVisibility(dt, m_renderCamera, m_viewFrustum);
     m_lightRenderer->updateVisibleShadowMaps(dt, m_renderCamera);
 
-    uint32_t sceneVisibility = m_sceneRenderer->updateVisibility(dt, m_renderCamera, m_viewFrustum);
+    m_visibilityDeltaTime = dt;
+    m_visibilityGraph->run();
+
+    m_terrainRenderer->updateTileSuppliers();
+
+    uint32_t terrainVisibility = m_terrainVisibility;
+    uint32_t sceneVisibility = m_sceneVisibility;
 
     m_terrainRenderer->applyVisibility();
     m_sceneRenderer->applyVisibility();
 
+    // Descriptor writes enqueued so far this frame are applied together, before anything binds the written sets.
+    graphics()->descriptorAllocator().flushWrites();
+
+    m_sceneRenderer->dispatchCulling(commandBuffer);
+
     m_lightRenderer->renderShadowMaps(dt, commandBuffer, m_renderCamera);
 
     m_deferredRenderer->updateCamera(dt, m_renderCamera);
@@ -20,6 +20,7 @@ class PostProcessRenderer;
 class EventDispatcher;
 class RenderCamera;
 class Frustum;
+class TaskGraph;
 
 class Engine {
     friend class Application;
@@ -94,6 +95,8 @@ public:
 private:
     bool init(SDL_Window* windowHandle);
 
+    void initVisibilityGraph();
+
     void preRender(double dt);
 
     void render(double dt);
@@ -131,6 +134,12 @@ private:
 
     RenderCamera* m_renderCamera;
     Frustum* m_viewFrustum;
+
+    // Per-frame visibility updates for independent renderers run concurrently through this graph.
+    TaskGraph* m_visibilityGraph;
+    double m_visibilityDeltaTime;
+    uint32_t m_terrainVisibility;
+    uint32_t m_sceneVisibility;
 };
 
 
@@ -6,6 +6,7 @@
 #include "core/application/Application.h"
 #include "core/application/Engine.h"
 #include "core/graphics/GraphicsManager.h"
+#include "core/graphics/UploadManager.h"
 #include "core/graphics/ImageCube.h"
 #include "core/graphics/ImageView.h"
 #include "core/graphics/Texture.h"
@@ -157,6 +158,8 @@ void EnvironmentMap::update() {
 
         commandBuffer.end();
 
+        Engine::graphics()->uploads().synchronize(); // The environment image may still be uploading
+
         vk::SubmitInfo queueSubmitInfo;
         queueSubmitInfo.setCommandBufferCount(1);
         queueSubmitInfo.setPCommandBuffers(&commandBuffer);
@@ -133,6 +133,8 @@ bool ImmediateRenderer::init() {
         LOG_ERROR("Failed to create ImmediateRenderer RenderPass");
         return false;
     }
+
+    prewarmGraphicsPipelines();
     return true;
 }
 
@@ -677,74 +679,106 @@ GraphicsPipeline* ImmediateRenderer::getGraphicsPipeline(const RenderCommand& re
         default: return nullptr;
     }
 
-    size_t key = 0;
-    std::hash_combine(key, (uint32_t)primitiveTopology);
-    std::hash_combine(key, renderCommand.state.blendEnabled);
-    std::hash_combine(key, renderCommand.state.blendEnabled ? renderCommand.state.colourBlendMode : BlendMode{});
-    std::hash_combine(key, renderCommand.state.blendEnabled ? renderCommand.state.alphaBlendMode : BlendMode{});
+    size_t key = getGraphicsPipelineKey(primitiveTopology, renderCommand.state);
 
     auto it = m_graphicsPipelines.find(key);
 
     if (it == m_graphicsPipelines.end() || it->second == nullptr) {
         PROFILE_REGION("Initialize pipeline");
 
-        GraphicsPipelineConfiguration pipelineConfiguration{};
-        pipelineConfiguration.device = Engine::graphics()->getDevice();
-        pipelineConfiguration.renderPass = m_renderPass;
-        pipelineConfiguration.setViewport(0, 0); // Default to full window resolution
+        GraphicsPipelineConfiguration pipelineConfiguration = getGraphicsPipelineConfiguration(primitiveTopology, renderCommand.state);
 
-        pipelineConfiguration.primitiveTopology = primitiveTopology;
+        GraphicsPipeline* pipeline = GraphicsPipeline::create(pipelineConfiguration, "ImmediateRenderer-GraphicsPipeline");
+        m_graphicsPipelines.insert(std::make_pair(key, pipeline));
 
-        pipelineConfiguration.setDynamicState(vk::DynamicState::eDepthTestEnableEXT, true);
-        pipelineConfiguration.setDynamicState(vk::DynamicState::eCullModeEXT, true);
-        pipelineConfiguration.setDynamicState(vk::DynamicState::eLineWidth, true);
+        return pipeline;
+    }
 
-//        pipelineConfiguration.polygonMode = vk::PolygonMode::eLine;
+    return it->second;
+}
 
-        AttachmentBlendState attachmentBlendState;
-        attachmentBlendState.blendEnable = renderCommand.state.blendEnabled;
-        if (renderCommand.state.blendEnabled) {
-            attachmentBlendState.setColourBlendMode(renderCommand.state.colourBlendMode);
-            attachmentBlendState.setAlphaBlendMode(renderCommand.state.alphaBlendMode);
-        }
+GraphicsPipelineConfiguration ImmediateRenderer::getGraphicsPipelineConfiguration(vk::PrimitiveTopology primitiveTopology, const RenderState& renderState) const {
+    GraphicsPipelineConfiguration pipelineConfiguration{};
+    pipelineConfiguration.device = Engine::graphics()->getDevice();
+    pipelineConfiguration.renderPass = m_renderPass;
+    pipelineConfiguration.setViewport(0, 0); // Default to full window resolution
 
-        pipelineConfiguration.setAttachmentBlendState(0, attachmentBlendState);
-
-        pipelineConfiguration.vertexShader = "shaders/debug/debug_lines.vert";
-        pipelineConfiguration.fragmentShader = "shaders/debug/debug_lines.frag";
-
-        pipelineConfiguration.vertexInputBindings.resize(1);
-        pipelineConfiguration.vertexInputBindings[0].setBinding(0);
-        pipelineConfiguration.vertexInputBindings[0].setStride(sizeof(ColouredVertex));
-        pipelineConfiguration.vertexInputBindings[0].setInputRate(vk::VertexInputRate::eVertex);
-
-        pipelineConfiguration.vertexInputAttributes.resize(4);
-        pipelineConfiguration.vertexInputAttributes[0].setBinding(0);
-        pipelineConfiguration.vertexInputAttributes[0].setLocation(0);
-        pipelineConfiguration.vertexInputAttributes[0].setFormat(vk::Format::eR32G32B32Sfloat); // vec3
-        pipelineConfiguration.vertexInputAttributes[0].setOffset(offsetof(ColouredVertex, position));
-        pipelineConfiguration.vertexInputAttributes[1].setBinding(0);
-        pipelineConfiguration.vertexInputAttributes[1].setLocation(1);
-        pipelineConfiguration.vertexInputAttributes[1].setFormat(vk::Format::eR32G32B32Sfloat); // vec3
-        pipelineConfiguration.vertexInputAttributes[1].setOffset(offsetof(ColouredVertex, normal));
-        pipelineConfiguration.vertexInputAttributes[2].setBinding(0);
-        pipelineConfiguration.vertexInputAttributes[2].setLocation(2);
-        pipelineConfiguration.vertexInputAttributes[2].setFormat(vk::Format::eR32G32Sfloat); // vec2
-        pipelineConfiguration.vertexInputAttributes[2].setOffset(offsetof(ColouredVertex, texture));
-        pipelineConfiguration.vertexInputAttributes[3].setBinding(0);
-        pipelineConfiguration.vertexInputAttributes[3].setLocation(3);
-        pipelineConfiguration.vertexInputAttributes[3].setFormat(vk::Format::eR8G8B8A8Unorm); // u8vec4
-        pipelineConfiguration.vertexInputAttributes[3].setOffset(offsetof(ColouredVertex, colour));
-
-        pipelineConfiguration.descriptorSetLayouts.emplace_back(m_descriptorSetLayout->getDescriptorSetLayout());
+    pipelineConfiguration.primitiveTopology = primitiveTopology;
 
-        GraphicsPipeline* pipeline = GraphicsPipeline::create(pipelineConfiguration, "ImmediateRenderer-GraphicsPipeline");
-        m_graphicsPipelines.insert(std::make_pair(key, pipeline));
+    pipelineConfiguration.setDynamicState(vk::DynamicState::eDepthTestEnableEXT, true);
+    pipelineConfiguration.setDynamicState(vk::DynamicState::eCullModeEXT, true);
+    pipelineConfiguration.setDynamicState(vk::DynamicState::eLineWidth, true);
 
-        return pipeline;
+//    pipelineConfiguration.polygonMode = vk::PolygonMode::eLine;
+
+    AttachmentBlendState attachmentBlendState;
+    attachmentBlendState.blendEnable = renderState.blendEnabled;
+    if (renderState.blendEnabled) {
+        attachmentBlendState.setColourBlendMode(renderState.colourBlendMode);
+        attachmentBlendState.setAlphaBlendMode(renderState.alphaBlendMode);
     }
 
-    return it->second;
+    pipelineConfiguration.setAttachmentBlendState(0, attachmentBlendState);
+
+    pipelineConfiguration.vertexShader = "shaders/debug/debug_lines.vert";
+    pipelineConfiguration.fragmentShader = "shaders/debug/debug_lines.frag";
+
+    pipelineConfiguration.vertexInputBindings.resize(1);
+    pipelineConfiguration.vertexInputBindings[0].setBinding(0);
+    pipelineConfiguration.vertexInputBindings[0].setStride(sizeof(ColouredVertex));
+    pipelineConfiguration.vertexInputBindings[0].setInputRate(vk::VertexInputRate::eVertex);
+
+    pipelineConfiguration.vertexInputAttributes.resize(4);
+    pipelineConfiguration.vertexInputAttributes[0].setBinding(0);
+    pipelineConfiguration.vertexInputAttributes[0].setLocation(0);
+    pipelineConfiguration.vertexInputAttributes[0].setFormat(vk::Format::eR32G32B32Sfloat); // vec3
+    pipelineConfiguration.vertexInputAttributes[0].setOffset(offsetof(ColouredVertex, position));
+    pipelineConfiguration.vertexInputAttributes[1].setBinding(0);
+    pipelineConfiguration.vertexInputAttributes[1].setLocation(1);
+    pipelineConfiguration.vertexInputAttributes[1].setFormat(vk::Format::eR32G32B32Sfloat); // vec3
+    pipelineConfiguration.vertexInputAttributes[1].setOffset(offsetof(ColouredVertex, normal));
+    pipelineConfiguration.vertexInputAttributes[2].setBinding(0);
+    pipelineConfiguration.vertexInputAttributes[2].setLocation(2);
+    pipelineConfiguration.vertexInputAttributes[2].setFormat(vk::Format::eR32G32Sfloat); // vec2
+    pipelineConfiguration.vertexInputAttributes[2].setOffset(offsetof(ColouredVertex, texture));
+    pipelineConfiguration.vertexInputAttributes[3].setBinding(0);
+    pipelineConfiguration.vertexInputAttributes[3].setLocation(3);
+    pipelineConfiguration.vertexInputAttributes[3].setFormat(vk::Format::eR8G8B8A8Unorm); // u8vec4
+    pipelineConfiguration.vertexInputAttributes[3].setOffset(offsetof(ColouredVertex, colour));
+
+    pipelineConfiguration.descriptorSetLayouts.emplace_back(m_descriptorSetLayout->getDescriptorSetLayout());
+
+    return pipelineConfiguration;
+}
+
+size_t ImmediateRenderer::getGraphicsPipelineKey(vk::PrimitiveTopology primitiveTopology, const RenderState& renderState) {
+    size_t key = 0;
+    std::hash_combine(key, (uint32_t)primitiveTopology);
+    std::hash_combine(key, renderState.blendEnabled);
+    std::hash_combine(key, renderState.blendEnabled ? renderState.colourBlendMode : BlendMode{});
+    std::hash_combine(key, renderState.blendEnabled ? renderState.alphaBlendMode : BlendMode{});
+    return key;
+}
+
+void ImmediateRenderer::prewarmGraphicsPipelines() {
+    PROFILE_SCOPE("ImmediateRenderer::prewarmGraphicsPipelines");
+
+    const vk::PrimitiveTopology primitiveTopologies[] = {
+            vk::PrimitiveTopology::eTriangleList,
+            vk::PrimitiveTopology::eTriangleStrip,
+            vk::PrimitiveTopology::eLineList,
+            vk::PrimitiveTopology::eLineStrip,
+            vk::PrimitiveTopology::ePointList
+    };
+
+    // Opaque, and the standard alpha blending used by the debug overlays.
+    RenderState renderStates[2];
+    renderStates[1].blendEnabled = true;
+    renderStates[1].colourBlendMode = BlendMode{vk::BlendFactor::eSrcAlpha, vk::BlendFactor::eOneMinusSrcAlpha, vk::BlendOp::eAdd};
+
+    for (const vk::PrimitiveTopology& primitiveTopology : primitiveTopologies)
+        for (const RenderState& renderState : renderStates)
+            GraphicsPipeline::prewarm(getGraphicsPipelineConfiguration(primitiveTopology, renderState), "ImmediateRenderer-GraphicsPipeline");
 }
 
 bool ImmediateRenderer::createRenderPass() {
@@ -201,6 +201,13 @@ private:
 
     GraphicsPipeline* getGraphicsPipeline(const RenderCommand& renderCommand);
 
+    GraphicsPipelineConfiguration getGraphicsPipelineConfiguration(vk::PrimitiveTopology primitiveTopology, const RenderState& renderState) const;
+
+    static size_t getGraphicsPipelineKey(vk::PrimitiveTopology primitiveTopology, const RenderState& renderState);
+
+    // Fills the pipeline cache with the common permutations in the background, so the first draw with each is not stalled.
+    void prewarmGraphicsPipelines();
+
     bool createRenderPass();
 
     void recreateSwapchain(RecreateSwapchainEvent* event);
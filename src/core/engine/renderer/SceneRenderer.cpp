@@ -5,6 +5,7 @@
 #include "core/engine/renderer/renderPasses/DeferredRenderer.h"
 #include "core/graphics/GraphicsManager.h"
 #include "core/graphics/GraphicsPipeline.h"
+#include "core/graphics/ComputePipeline.h"
 #include "core/graphics/ImageData.h"
 #include "core/graphics/Image2D.h"
 #include "core/graphics/ImageView.h"
@@ -13,7 +14,10 @@
 #include "core/graphics/Mesh.h"
 #include "core/graphics/DescriptorSet.h"
 #include "core/engine/scene/bound/Frustum.h"
+#include "core/engine/scene/bound/BoundingVolume.h"
 #include "core/engine/scene/Scene.h"
+#include "core/engine/scene/TransformHierarchy.h"
+#include "core/thread/ThreadUtils.h"
 #include "core/util/Logger.h"
 
 
@@ -28,7 +32,11 @@ struct AlwaysUpdateFlag { uint8_t _v; };
 
 SceneRenderer::SceneRenderer():
     m_scene(nullptr),
+    m_cullingComputePipeline(nullptr),
     m_numRenderEntities(0),
+    m_drawMode(DrawMode_Indirect),
+    m_culledObjectIndexCount(0),
+    m_meshBatchesChanged(true),
     m_previousPartialTicks(1.0),
     m_numAddedRenderEntities(0) {
 }
@@ -41,10 +49,18 @@ SceneRenderer::~SceneRenderer() {
             delete m_resources[i]->objectIndicesBuffer;
             delete m_resources[i]->worldTransformBuffer;
             delete m_resources[i]->materialDataBuffer;
+            delete m_resources[i]->drawCommandBuffer;
+            delete m_resources[i]->objectBoundsBuffer;
+            delete m_resources[i]->meshBatchBuffer;
+            delete m_resources[i]->culledObjectIndicesBuffer;
             delete m_resources[i]->objectDescriptorSet;
+            delete m_resources[i]->culledObjectDescriptorSet;
             delete m_resources[i]->materialDescriptorSet;
+            delete m_resources[i]->cullingDescriptorSet;
         }
     }
+
+    delete m_cullingComputePipeline;
 }
 
 bool SceneRenderer::init() {
@@ -56,6 +72,8 @@ bool SceneRenderer::init() {
 
     constexpr size_t maxTextures = 0xFFFF;
 
+    setDrawMode(m_drawMode); // Falls back to direct drawing if the device cannot draw indirectly.
+
     initMissingTextureMaterial();
     std::vector<Texture*> initialTextures;
     initialTextures.resize(maxTextures, m_missingTextureMaterial->getAlbedoMap().get());
@@ -73,17 +91,41 @@ bool SceneRenderer::init() {
             .addStorageBuffer(1, vk::ShaderStageFlagBits::eFragment) // material data buffer (material properties & texture indices)
             .build("SceneRenderer-MaterialDescriptorSetLayout");
 
+    m_cullingDescriptorSetLayout = builder
+            .addStorageBuffer(0, vk::ShaderStageFlagBits::eCompute) // object bounds buffer
+            .addStorageBuffer(1, vk::ShaderStageFlagBits::eCompute) // mesh batch buffer
+            .addStorageBuffer(2, vk::ShaderStageFlagBits::eCompute) // draw command buffer
+            .addStorageBuffer(3, vk::ShaderStageFlagBits::eCompute) // culled object indices buffer
+            .build("SceneRenderer-CullingDescriptorSetLayout");
+
+    m_cullingComputePipeline = ComputePipeline::create(Engine::graphics()->getDevice(), "SceneRenderer-CullingComputePipeline");
+    if (!createCullingComputePipeline()) {
+        LOG_ERROR("Failed to create SceneRenderer culling compute pipeline");
+        return false;
+    }
+
     for (int i = 0; i < CONCURRENT_FRAMES; ++i) {
         m_resources.set(i, new RenderResources());
         m_resources[i]->objectDescriptorSet = DescriptorSet::create(m_objectDescriptorSetLayout, descriptorPool, "SceneRenderer-ObjectDescriptorSet");
+        m_resources[i]->culledObjectDescriptorSet = DescriptorSet::create(m_objectDescriptorSetLayout, descriptorPool, "SceneRenderer-CulledObjectDescriptorSet");
         m_resources[i]->materialDescriptorSet = DescriptorSet::create(m_materialDescriptorSetLayout, descriptorPool, "SceneRenderer-MaterialDescriptorSet");
+        m_resources[i]->cullingDescriptorSet = DescriptorSet::create(m_cullingDescriptorSetLayout, descriptorPool, "SceneRenderer-CullingDescriptorSet");
 
         m_resources[i]->objectIndicesBuffer = nullptr;
         m_resources[i]->worldTransformBuffer = nullptr;
         m_resources[i]->materialDataBuffer = nullptr;
+        m_resources[i]->drawCommandBuffer = nullptr;
+        m_resources[i]->objectBoundsBuffer = nullptr;
+        m_resources[i]->meshBatchBuffer = nullptr;
+        m_resources[i]->culledObjectIndicesBuffer = nullptr;
 
         m_resources[i]->updateTextureDescriptorStartIndex = UINT32_MAX;
         m_resources[i]->updateTextureDescriptorEndIndex = 0;
+        m_resources[i]->objectDataChanges.markAllDirty();
+        m_resources[i]->materialDataChanges.markAllDirty();
+        m_resources[i]->objectIndicesChanges.markAllDirty();
+        m_resources[i]->objectBoundsChanges.markAllDirty();
+        m_resources[i]->meshBatchesChanged = true;
 
         DescriptorSetWriter(m_resources[i]->materialDescriptorSet)
                 .writeImage(0, initialTextures.data(), initialImageLayouts.data(), 0, maxTextures)
@@ -110,9 +152,13 @@ void SceneRenderer::preRender(double dt) {
     const auto& renderEntities = m_scene->registry()->group<RenderComponent, RenderInfo, Transform>();
     m_numRenderEntities = (uint32_t)renderEntities.size();
 
+    m_previousUploadStats = m_uploadStats;
+    m_uploadStats = UploadStats{};
+
     sortRenderEntities();
+    updateEntityMaterials(); // Marks entities whose mesh or bounds changed, so their world bounds are recalculated below
     updateEntityWorldTransforms();
-    updateEntityMaterials();
+    updateMeshBatches();
     streamEntityRenderData();
 
     m_previousPartialTicks = Engine::instance()->getPartialTicks();
@@ -123,8 +169,12 @@ void SceneRenderer::resetVisibility() {
     PROFILE_SCOPE("SceneRenderer::resetVisibility")
     m_visibilityApplied = false;
 
-
+    m_visibilityIndices.clear();
     m_objectIndicesBuffer.clear();
+    m_indirectDrawCommands.clear();
+    m_indirectDrawCommandMeshes.clear();
+    m_cullingViews.clear();
+    m_culledObjectIndexCount = 0;
 }
 
 void SceneRenderer::applyVisibility() {
@@ -138,8 +188,62 @@ void SceneRenderer::applyVisibility() {
 
     if (!m_objectIndicesBuffer.empty()) {
         uint32_t* mappedObjectIndicesBuffer = static_cast<uint32_t*>(mapObjectIndicesBuffer(m_objectIndicesBuffer.size()));
-        memcpy(&mappedObjectIndicesBuffer[0], &m_objectIndicesBuffer[0], m_objectIndicesBuffer.size() * sizeof(uint32_t));
+        updateObjectIndicesChanges();
+        m_uploadStats.objectIndicesBytes += m_resources->objectIndicesChanges.upload(mappedObjectIndicesBuffer, m_objectIndicesBuffer.data(), m_objectIndicesBuffer.size(), sizeof(uint32_t));
     }
+
+    PROFILE_REGION("Upload indirect draw commands")
+
+    if (!m_indirectDrawCommands.empty()) {
+        // There is at most one command per mesh batch for each viewpoint, so these are always copied in full.
+        GPUDrawCommand* mappedDrawCommandBuffer = static_cast<GPUDrawCommand*>(mapDrawCommandBuffer(m_indirectDrawCommands.size()));
+        memcpy(&mappedDrawCommandBuffer[0], &m_indirectDrawCommands[0], m_indirectDrawCommands.size() * sizeof(GPUDrawCommand));
+    }
+
+    if (!m_cullingViews.empty())
+        updateCulledObjectIndicesBuffer(m_culledObjectIndexCount);
+}
+
+void SceneRenderer::dispatchCulling(const vk::CommandBuffer& commandBuffer) {
+    PROFILE_SCOPE("SceneRenderer::dispatchCulling")
+    assert(m_visibilityApplied);
+
+    if (m_cullingViews.empty())
+        return;
+
+    PROFILE_BEGIN_GPU_CMD("SceneRenderer::dispatchCulling", commandBuffer);
+
+    constexpr uint32_t workgroupSize = 64;
+
+    std::array<vk::DescriptorSet, 1> descriptorSets = {
+            m_resources->cullingDescriptorSet->getDescriptorSet()
+    };
+
+    m_cullingComputePipeline->bind(commandBuffer);
+    const vk::PipelineLayout& pipelineLayout = m_cullingComputePipeline->getPipelineLayout();
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descriptorSets, nullptr);
+
+    CullingPushConstantData pushConstantData{};
+    pushConstantData.objectCount = m_numRenderEntities;
+    pushConstantData.batchCount = (uint32_t)m_meshBatches.size();
+
+    for (const CullingView& view : m_cullingViews) {
+        for (size_t i = 0; i < view.frustumPlanes.size(); ++i)
+            pushConstantData.frustumPlanes[i] = view.frustumPlanes[i];
+        pushConstantData.firstCommand = view.firstCommand;
+        pushConstantData.firstInstance = view.firstInstance;
+
+        commandBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullingPushConstantData), &pushConstantData);
+        m_cullingComputePipeline->dispatch(commandBuffer, INT_DIV_CEIL(m_numRenderEntities, workgroupSize), 1, 1);
+    }
+
+    // The instance counts are consumed by the indirect draws, and the object indices by the vertex shader.
+    vk::MemoryBarrier memoryBarrier{};
+    memoryBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+    memoryBarrier.dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead;
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexShader, {}, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+    PROFILE_END_GPU_CMD("SceneRenderer::dispatchCulling", commandBuffer);
 }
 
 uint32_t SceneRenderer::updateVisibility(double dt, const RenderCamera* renderCamera, const Frustum* frustum) {
@@ -147,6 +251,32 @@ uint32_t SceneRenderer::updateVisibility(double dt, const RenderCamera* renderCa
     assert(!m_visibilityApplied);
 
     uint32_t visibilityIndex = (uint32_t)m_visibilityIndices.size();
+    VisibilityIndices& visibility = m_visibilityIndices.emplace_back();
+    visibility.firstCommand = (uint32_t)m_indirectDrawCommands.size();
+    visibility.indirect = m_drawMode != DrawMode_Direct;
+    visibility.culledOnGPU = m_drawMode == DrawMode_IndirectCompute && frustum != nullptr;
+
+    if (visibility.culledOnGPU) {
+        // Every object is given a slot in the culled index buffer. The compute shader fills the slots of each batch
+        // from the start, and the instance count of its draw command determines how many are drawn.
+        visibility.firstInstance = m_culledObjectIndexCount;
+        visibility.instanceCount = m_numRenderEntities;
+        m_culledObjectIndexCount += m_numRenderEntities;
+
+        for (const MeshBatch& batch : m_meshBatches)
+            addIndirectDrawCommand(batch.mesh, 0, visibility.firstInstance + batch.firstObject);
+
+        addCullingView(frustum, visibility.firstInstance, visibility.firstCommand);
+
+    } else {
+        visibility.firstInstance = applyFrustumCulling(frustum);
+        visibility.instanceCount = (uint32_t)m_objectIndicesBuffer.size() - visibility.firstInstance;
+
+        if (visibility.indirect)
+            buildIndirectDrawCommands(visibility.firstInstance, visibility.instanceCount);
+    }
+
+    visibility.commandCount = (uint32_t)m_indirectDrawCommands.size() - visibility.firstCommand;
     return visibilityIndex;
 }
 
@@ -160,7 +290,7 @@ void SceneRenderer::renderGeometryPass(double dt, const vk::CommandBuffer& comma
     // bindDescriptorSetsForView(...);
     std::array<vk::DescriptorSet, 3> descriptorSets = {
             Engine::instance()->getDeferredRenderer()->getGlobalDescriptorSet()->getDescriptorSet(),
-            Engine::instance()->getSceneRenderer()->getObjectDescriptorSet()->getDescriptorSet(),
+            Engine::instance()->getSceneRenderer()->getObjectDescriptorSet(visibilityIndex)->getDescriptorSet(),
             Engine::instance()->getSceneRenderer()->getMaterialDescriptorSet()->getDescriptorSet(),
     };
 
@@ -169,7 +299,7 @@ void SceneRenderer::renderGeometryPass(double dt, const vk::CommandBuffer& comma
     graphicsPipeline->bind(commandBuffer);
     commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, graphicsPipeline->getPipelineLayout(), 0, descriptorSets, dynamicOffsets);
 
-    Engine::instance()->getSceneRenderer()->drawEntities(dt, commandBuffer, frustum);
+    Engine::instance()->getSceneRenderer()->drawEntities(dt, commandBuffer, visibilityIndex);
     PROFILE_END_GPU_CMD("SceneRenderer::renderGeometryPass", commandBuffer);
 }
 
@@ -195,12 +325,11 @@ void SceneRenderer::drawEntities(double dt, const vk::CommandBuffer& commandBuff
 
     const VisibilityIndices& visibility = m_visibilityIndices[visibilityIndex];
     if (visibility.instanceCount == 0) {
-        // No terrain is visible from this viewpoint.
+        // No entities are visible from this viewpoint.
         return;
     }
 
-//    applyFrustumCulling(frustum);
-    recordRenderCommands(dt, commandBuffer);
+    recordRenderCommands(dt, commandBuffer, visibilityIndex);
 
     PROFILE_END_GPU_CMD("SceneRenderer::drawEntities", commandBuffer);
 }
@@ -225,6 +354,12 @@ DescriptorSet* SceneRenderer::getObjectDescriptorSet() const {
     return m_resources->objectDescriptorSet;
 }
 
+DescriptorSet* SceneRenderer::getObjectDescriptorSet(uint32_t visibilityIndex) const {
+    if (visibilityIndex < m_visibilityIndices.size() && m_visibilityIndices[visibilityIndex].culledOnGPU)
+        return m_resources->culledObjectDescriptorSet;
+    return m_resources->objectDescriptorSet;
+}
+
 DescriptorSet* SceneRenderer::getMaterialDescriptorSet() const {
     return m_resources->materialDescriptorSet;
 }
@@ -280,6 +415,9 @@ uint32_t SceneRenderer::registerMaterial(Material* material) {
         gpuMaterial.metallic = material->getMetallic();
         m_materialDataBuffer.emplace_back(gpuMaterial);
 
+        for (int i = 0; i < CONCURRENT_FRAMES; ++i)
+            m_resources[i]->materialDataChanges.markDirty(materialIndex, 1);
+
         m_materialIndices.insert(std::make_pair(material->getResourceId(), materialIndex));
     } else {
         materialIndex = it->second;
@@ -287,6 +425,27 @@ uint32_t SceneRenderer::registerMaterial(Material* material) {
     return materialIndex;
 }
 
+void SceneRenderer::notifyTransformChanged(EntityChangeTracker::entity_index entityIndex) {
+    m_transformChangeTracker.setChanged(entityIndex, true);
+}
+
+const SceneRenderer::UploadStats& SceneRenderer::getUploadStats() const {
+    return m_previousUploadStats;
+}
+
+SceneRenderer::DrawMode SceneRenderer::getDrawMode() const {
+    return m_drawMode;
+}
+
+void SceneRenderer::setDrawMode(DrawMode drawMode) {
+    // Every indirect command draws from a non-zero firstInstance, which needs the drawIndirectFirstInstance feature.
+    if (drawMode != DrawMode_Direct && !Engine::graphics()->getEnabledDeviceFeatures().drawIndirectFirstInstance) {
+        LOG_WARN("SceneRenderer draw mode %d requires the drawIndirectFirstInstance feature. Falling back to direct drawing", (int)drawMode);
+        drawMode = DrawMode_Direct;
+    }
+    m_drawMode = drawMode;
+}
+
 void SceneRenderer::initMissingTextureMaterial() {
     union {
         glm::u8vec4 pixels[2][2];
@@ -323,11 +482,19 @@ void SceneRenderer::initMissingTextureMaterial() {
     m_missingTextureMaterial = std::shared_ptr<Material>(Material::create(materialConfig, "SceneRenderer-MissingTextureMaterial"));
 }
 
+bool SceneRenderer::createCullingComputePipeline() {
+    ComputePipelineConfiguration pipelineConfig{};
+    pipelineConfig.device = Engine::graphics()->getDevice();
+    pipelineConfig.computeShader = "shaders/scene/entities_cull_compute.glsl";
+    pipelineConfig.addDescriptorSetLayout(m_cullingDescriptorSetLayout.get());
+    pipelineConfig.addPushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullingPushConstantData));
+    return m_cullingComputePipeline->recreate(pipelineConfig, "SceneRenderer-CullingComputePipeline");
+}
+
 void SceneRenderer::onRenderComponentAdded(ComponentAddedEvent<RenderComponent>* event) {
     assert(event->entity.hasComponent<Transform>());
 
     RenderInfo& renderInfo = event->entity.addComponent<RenderInfo>();
-    WorldRenderBounds& renderBounds = event->entity.addComponent<WorldRenderBounds>();
     Transform& transform = event->entity.getComponent<Transform>();
 
     renderInfo.materialId = 0;
@@ -338,6 +505,8 @@ void SceneRenderer::onRenderComponentAdded(ComponentAddedEvent<RenderComponent>*
     Transform::fillMatrixf(transform, objectData.modelMatrix);
     m_objectDataBuffer.emplace_back(objectData);
 
+    Transform::reindex(transform, renderInfo.objectIndex);
+
     ++m_numAddedRenderEntities;
 }
 
@@ -347,25 +516,32 @@ void SceneRenderer::onRenderComponentRemoved(ComponentRemovedEvent<RenderCompone
         // TODO: add index to removedObjectIndices, then handle this in the next sortRenderEntities call.
     }
 
+    m_meshBatchesChanged = true;
+
     event->entity.removeComponent<RenderInfo>();
-    event->entity.removeComponent<WorldRenderBounds>();
 }
 
-void SceneRenderer::recordRenderCommands(double dt, const vk::CommandBuffer& commandBuffer) {
+void SceneRenderer::recordRenderCommands(double dt, const vk::CommandBuffer& commandBuffer, uint32_t visibilityIndex) {
     PROFILE_SCOPE("SceneRenderer::recordRenderCommands");
 
-    if (m_objectIndicesBuffer.empty()) {
-        return; // Nothing to draw ...??
+    const VisibilityIndices& visibility = m_visibilityIndices[visibilityIndex];
+
+    if (visibility.indirect) {
+        recordIndirectRenderCommands(dt, commandBuffer, visibilityIndex);
+        return;
     }
+
+    assert(visibility.firstInstance + visibility.instanceCount <= m_objectIndicesBuffer.size());
+
     PROFILE_REGION("Gather DrawCommands")
     const auto& renderEntities = m_scene->registry()->group<RenderComponent, RenderInfo, Transform>();
 
     m_drawCommands.clear();
 
     DrawCommand currDrawCommand{};
-    currDrawCommand.firstInstance = 0;
+    currDrawCommand.firstInstance = visibility.firstInstance;
 
-    for (uint32_t i = 0; i < m_objectIndicesBuffer.size(); ++i) {
+    for (uint32_t i = visibility.firstInstance; i < visibility.firstInstance + visibility.instanceCount; ++i) {
         auto it = renderEntities.begin() + m_objectIndicesBuffer[i];
         const RenderComponent& renderComponent = renderEntities.get<RenderComponent>(*it);
 
@@ -393,44 +569,192 @@ void SceneRenderer::recordRenderCommands(double dt, const vk::CommandBuffer& com
     PROFILE_END_REGION()
 }
 
+void SceneRenderer::recordIndirectRenderCommands(double dt, const vk::CommandBuffer& commandBuffer, uint32_t visibilityIndex) {
+    PROFILE_SCOPE("SceneRenderer::recordIndirectRenderCommands");
+
+    const VisibilityIndices& visibility = m_visibilityIndices[visibilityIndex];
+
+    assert(visibility.firstCommand + visibility.commandCount <= m_indirectDrawCommands.size());
+
+    for (uint32_t i = visibility.firstCommand; i < visibility.firstCommand + visibility.commandCount; ++i)
+        m_indirectDrawCommandMeshes[i]->drawIndirect(commandBuffer, m_resources->drawCommandBuffer, i * sizeof(GPUDrawCommand));
+}
+
+void SceneRenderer::addIndirectDrawCommand(Mesh* mesh, uint32_t instanceCount, uint32_t firstInstance) {
+    GPUDrawCommand& command = m_indirectDrawCommands.emplace_back();
+
+    if (mesh->hasIndices()) {
+        command.indexCount = mesh->getIndexCount();
+        command.instanceCount = instanceCount;
+        command.firstIndex = 0;
+        command.vertexOffset = 0;
+        command.firstInstance = firstInstance;
+    } else {
+        command.indexCount = mesh->getVertexCount();
+        command.instanceCount = instanceCount;
+        command.firstIndex = 0; // firstVertex
+        command.vertexOffset = (int32_t)firstInstance; // firstInstance
+        command.firstInstance = 0;
+    }
+
+    m_indirectDrawCommandMeshes.emplace_back(mesh);
+}
+
+void SceneRenderer::buildIndirectDrawCommands(uint32_t firstInstance, uint32_t instanceCount) {
+    PROFILE_SCOPE("SceneRenderer::buildIndirectDrawCommands");
+
+    // Both the visible object indices and the mesh batches are in ascending order, so the visible instances of each
+    // batch are a contiguous run, found with one binary search per batch.
+    const uint32_t* visibleBegin = m_objectIndicesBuffer.data() + firstInstance;
+    const uint32_t* visibleEnd = visibleBegin + instanceCount;
+    const uint32_t* batchBegin = visibleBegin;
+
+    for (const MeshBatch& batch : m_meshBatches) {
+        if (batchBegin == visibleEnd)
+            break;
+
+        const uint32_t* batchEnd = std::lower_bound(batchBegin, visibleEnd, batch.firstObject + batch.objectCount);
+
+        if (batchEnd != batchBegin)
+            addIndirectDrawCommand(batch.mesh, (uint32_t)(batchEnd - batchBegin), firstInstance + (uint32_t)(batchBegin - visibleBegin));
+
+        batchBegin = batchEnd;
+    }
+}
+
+void SceneRenderer::addCullingView(const Frustum* frustum, uint32_t firstInstance, uint32_t firstCommand) {
+    CullingView& view = m_cullingViews.emplace_back();
+
+    for (size_t i = 0; i < Frustum::NumPlanes; ++i) {
+        const Plane& plane = frustum->getPlane(i);
+        view.frustumPlanes[i] = glm::vec4(glm::vec3(plane.getNormal()), (float)plane.getOffset());
+    }
+
+    view.firstInstance = firstInstance;
+    view.firstCommand = firstCommand;
+}
+
 uint32_t SceneRenderer::applyFrustumCulling(const Frustum* frustum) {
     PROFILE_SCOPE("SceneRenderer::applyFrustumCulling");
 
-    uint32_t startIndex = (uint32_t)m_objectIndicesBuffer.size();
+    // Number of entities tested by each culling task. Small enough that idle workers can steal a share of the
+    // work, large enough that the task overhead is negligible.
+    constexpr size_t entitiesPerTask = 4096;
 
-    PROFILE_REGION("Update visible indices")
-    constexpr bool frustumCullingEnabled = false;
+    uint32_t startIndex = (uint32_t)m_objectIndicesBuffer.size();
 
-    if (!frustumCullingEnabled || frustum == nullptr) {
+    if (frustum == nullptr) {
+        PROFILE_REGION("Add all indices")
         // No frustum, we draw everything
-        for (uint32_t i = 0; i < m_numRenderEntities; ++i) {
+        for (uint32_t i = 0; i < m_numRenderEntities; ++i)
             m_objectIndicesBuffer.emplace_back(i);
+        return startIndex;
+    }
+
+    if (m_numRenderEntities == 0)
+        return startIndex;
+
+    assert(m_worldRenderBounds.centerX.size() >= m_numRenderEntities);
+
+    if (m_culledObjectVisibility.size() < m_numRenderEntities)
+        m_culledObjectVisibility.resize(m_numRenderEntities);
+
+    // Each task writes the visible indices of its own chunk, so no synchronization is needed between tasks. The chunks
+    // are then concatenated in order, so that entities sharing a mesh remain adjacent for instancing.
+    auto cullChunk = [this, frustum](size_t rangeStart, size_t rangeEnd) {
+        PROFILE_SCOPE("SceneRenderer::applyFrustumCulling - Cull chunk")
+
+        uint8_t* visibility = &m_culledObjectVisibility[rangeStart];
+
+        frustum->testAABBs(&m_worldRenderBounds.centerX[rangeStart], &m_worldRenderBounds.centerY[rangeStart], &m_worldRenderBounds.centerZ[rangeStart],
+                           &m_worldRenderBounds.halfExtentX[rangeStart], &m_worldRenderBounds.halfExtentY[rangeStart], &m_worldRenderBounds.halfExtentZ[rangeStart],
+                           rangeEnd - rangeStart, visibility);
+
+        std::vector<uint32_t>& visibleIndices = m_culledObjectIndices[rangeStart / entitiesPerTask];
+        visibleIndices.resize(rangeEnd - rangeStart);
+
+        size_t visibleCount = 0;
+
+        for (size_t i = rangeStart; i < rangeEnd; ++i) {
+            visibleIndices[visibleCount] = (uint32_t)i;
+            visibleCount += visibility[i - rangeStart] != Visibility_NotVisible ? 1 : 0;
         }
 
+        visibleIndices.resize(visibleCount);
+    };
+
+    size_t taskCount = INT_DIV_CEIL((size_t)m_numRenderEntities, entitiesPerTask);
+    if (m_culledObjectIndices.size() < taskCount)
+        m_culledObjectIndices.resize(taskCount);
+
+    if (taskCount == 1) {
+        cullChunk(0, m_numRenderEntities);
     } else {
+        // With an alignment equal to the chunk size, every task covers exactly one chunk (except possibly the last),
+        // so rangeStart / entitiesPerTask is the index of the chunk.
+        auto futures = ThreadUtils::parallel_range(m_numRenderEntities, entitiesPerTask, taskCount, cullChunk);
+        ThreadUtils::wait(futures);
+    }
 
-        const auto& renderEntities = m_scene->registry()->group<RenderComponent, RenderInfo, Transform>();
+    PROFILE_REGION("Compact visible indices")
 
-        uint32_t objectIndex = 0;
-        for (auto it = renderEntities.begin(); it != renderEntities.end(); ++it, ++objectIndex) {
-            const RenderComponent& renderComponent = renderEntities.get<RenderComponent>(*it);
-            const Transform& transform = renderEntities.get<Transform>(*it);
-//            if (renderComponent.getBoundingVolume() != nullptr) {
-//                if (frustum->contains(*renderComponent.getBoundingVolume())) {
-//                    m_objectIndicesBuffer.emplace_back(objectIndex);
-//                }
-//            } else {
-                BoundingSphere boundingSphere(transform.getTranslation(), 1.0);
-                if (frustum->intersects(boundingSphere)) {
-                    m_objectIndicesBuffer.emplace_back(objectIndex);
-                }
-//            }
-        }
+    size_t visibleCount = 0;
+    for (size_t i = 0; i < taskCount; ++i)
+        visibleCount += m_culledObjectIndices[i].size();
+
+    m_objectIndicesBuffer.resize(startIndex + visibleCount);
+
+    uint32_t* dst = &m_objectIndicesBuffer[startIndex];
+    for (size_t i = 0; i < taskCount; ++i) {
+        if (m_culledObjectIndices[i].empty())
+            continue;
+        memcpy(dst, m_culledObjectIndices[i].data(), m_culledObjectIndices[i].size() * sizeof(uint32_t));
+        dst += m_culledObjectIndices[i].size();
     }
 
     return startIndex;
 }
 
+void SceneRenderer::updateWorldRenderBounds(size_t index, const BoundingVolume* boundingVolume, const glm::mat4& modelMatrix) {
+    glm::vec3 center;
+    glm::vec3 halfExtents;
+
+    if (boundingVolume == nullptr) {
+        // Entities without bounds are assumed to fit within a unit sphere.
+        center = glm::vec3(modelMatrix[3]);
+        float scale = glm::max(glm::max(glm::length(glm::vec3(modelMatrix[0])), glm::length(glm::vec3(modelMatrix[1]))), glm::length(glm::vec3(modelMatrix[2])));
+        halfExtents = glm::vec3(scale);
+
+    } else if (boundingVolume->getType() == BoundingVolume::Type_Sphere) {
+        const BoundingSphere& sphere = BoundingVolume::cast<const BoundingSphere&>(*boundingVolume);
+        center = glm::vec3(modelMatrix * glm::vec4(glm::vec3(sphere.getCenter()), 1.0F));
+        float scale = glm::max(glm::max(glm::length(glm::vec3(modelMatrix[0])), glm::length(glm::vec3(modelMatrix[1]))), glm::length(glm::vec3(modelMatrix[2])));
+        halfExtents = glm::vec3((float)sphere.getRadius() * scale);
+
+    } else if (boundingVolume->getType() == BoundingVolume::Type_AxisAlignedBoundingBox) {
+        const AxisAlignedBoundingBox& aabb = BoundingVolume::cast<const AxisAlignedBoundingBox&>(*boundingVolume);
+        center = glm::vec3(modelMatrix * glm::vec4(glm::vec3(aabb.getCenter()), 1.0F));
+        // The world space extents of a transformed AABB are the local extents projected onto each world axis.
+        glm::mat3 absMatrix = glm::mat3(glm::abs(glm::vec3(modelMatrix[0])), glm::abs(glm::vec3(modelMatrix[1])), glm::abs(glm::vec3(modelMatrix[2])));
+        halfExtents = absMatrix * glm::vec3(aabb.getHalfExtents());
+
+    } else {
+        // Unsupported bounding volume type, never cull this entity.
+        center = glm::vec3(modelMatrix[3]);
+        halfExtents = glm::vec3(std::numeric_limits<float>::max());
+    }
+
+    m_worldRenderBounds.centerX[index] = center.x;
+    m_worldRenderBounds.centerY[index] = center.y;
+    m_worldRenderBounds.centerZ[index] = center.z;
+    m_worldRenderBounds.halfExtentX[index] = halfExtents.x;
+    m_worldRenderBounds.halfExtentY[index] = halfExtents.y;
+    m_worldRenderBounds.halfExtentZ[index] = halfExtents.z;
+
+    m_objectBoundsBuffer[index].center = glm::vec4(center, 0.0F);
+    m_objectBoundsBuffer[index].halfExtent = glm::vec4(halfExtents, 0.0F);
+}
+
 void SceneRenderer::sortRenderEntities() {
     PROFILE_SCOPE("SceneRenderer::sortRenderEntities")
 
@@ -469,9 +793,15 @@ void SceneRenderer::sortRenderEntities() {
             assert(renderInfo.objectIndex < m_objectDataBuffer.size());
             sortedObjectBuffer[index] = m_objectDataBuffer[renderInfo.objectIndex];
             renderInfo.objectIndex = index;
+            Transform::reindex(renderEntities.get<Transform>(*it), index);
         }
 
         m_objectDataBuffer.swap(sortedObjectBuffer);
+
+        // Every entity may now be at a different index, so all derived data must be recalculated and uploaded.
+        m_transformChangeTracker.setChanged(0, m_objectDataBuffer.size(), true);
+        markObjectDataChanged(0, (uint32_t)m_objectDataBuffer.size());
+        m_meshBatchesChanged = true;
     }
 
 //    LOG_INFO("Sort render entities: %u / %u", numTrue, numFalse);
@@ -483,14 +813,87 @@ void SceneRenderer::updateEntityWorldTransforms() {
 
     assert(m_objectDataBuffer.size() >= renderEntities.size());
 
-    // TODO: not update transforms for entities that never move.
-    // TODO: calculate transforms for entity hierarchy.
+    TransformHierarchy* transformHierarchy = m_scene->getTransformHierarchy();
+    transformHierarchy->update();
 
-    size_t index = 0;
-    for (auto it = renderEntities.begin(); it != renderEntities.end(); ++it, ++index) {
-        Transform& transform = renderEntities.get<Transform>(*it);
+    // Entities beneath a moved parent must be updated even though their own transform did not change.
+    for (entt::entity entity : transformHierarchy->getChangedEntities()) {
+        const Transform* transform = m_scene->registry()->try_get<Transform>(entity);
+        if (transform != nullptr && transform->m_entityIndex != EntityChangeTracker::INVALID_INDEX)
+            m_transformChangeTracker.setChanged(transform->m_entityIndex, true);
+    }
+
+    uint32_t numEntities = (uint32_t)renderEntities.size();
+
+    if (m_worldRenderBounds.centerX.size() < numEntities) {
+        m_worldRenderBounds.centerX.resize(numEntities);
+        m_worldRenderBounds.centerY.resize(numEntities);
+        m_worldRenderBounds.centerZ.resize(numEntities);
+        m_worldRenderBounds.halfExtentX.resize(numEntities);
+        m_worldRenderBounds.halfExtentY.resize(numEntities);
+        m_worldRenderBounds.halfExtentZ.resize(numEntities);
+        m_objectBoundsBuffer.resize(numEntities);
+    }
+
+    // Entities beyond the end of the tracker have never been updated, and are considered changed.
+    m_transformChangeTracker.ensureCapacity(numEntities);
+
+    PROFILE_REGION("Update stopped entities")
+
+    // Entities which moved last frame need their previous model matrix updated once more after they stop moving,
+    // otherwise they would keep producing motion vectors.
+    for (uint32_t index : m_movedObjectIndices) {
+        if (index >= numEntities || m_transformChangeTracker.hasChanged(index))
+            continue;
         m_objectDataBuffer[index].prevModelMatrix = m_objectDataBuffer[index].modelMatrix;
-        Transform::fillMatrixf(transform, m_objectDataBuffer[index].modelMatrix);
+        markObjectDataChanged(index, 1);
+    }
+
+    m_movedObjectIndices.clear();
+
+    PROFILE_REGION("Update changed entities")
+
+    // Only the ranges of entities whose transforms changed are visited. Entities that never move cost nothing here
+    // after their first update.
+    uint32_t firstIndex = m_transformChangeTracker.find(0, true);
+
+    while (firstIndex < numEntities) {
+        uint32_t endIndex = glm::min(m_transformChangeTracker.find(firstIndex, false), numEntities);
+
+        auto it = renderEntities.begin() + firstIndex;
+        for (uint32_t index = firstIndex; index < endIndex; ++index, ++it) {
+            const RenderComponent& renderComponent = renderEntities.get<RenderComponent>(*it);
+            const Transform& transform = renderEntities.get<Transform>(*it);
+
+            GPUObjectData& objectData = m_objectDataBuffer[index];
+            objectData.prevModelMatrix = objectData.modelMatrix;
+
+            const glm::dmat4* worldMatrix = transformHierarchy->getWorldMatrix(*it);
+            if (worldMatrix != nullptr) {
+                objectData.modelMatrix = glm::mat4(*worldMatrix);
+            } else {
+                Transform::fillMatrixf(transform, objectData.modelMatrix);
+            }
+
+            updateWorldRenderBounds(index, renderComponent.getBoundingVolume(), objectData.modelMatrix);
+            m_movedObjectIndices.emplace_back(index);
+        }
+
+        m_transformChangeTracker.setChanged(firstIndex, endIndex - firstIndex, false);
+        markObjectDataChanged(firstIndex, endIndex - firstIndex);
+
+        firstIndex = m_transformChangeTracker.find(endIndex, true);
+    }
+}
+
+void SceneRenderer::markObjectDataChanged(uint32_t firstObject, uint32_t objectCount) {
+    if (objectCount == 0)
+        return;
+
+    // Each frame in flight has its own copy of the object data, so each must receive every change.
+    for (int i = 0; i < CONCURRENT_FRAMES; ++i) {
+        m_resources[i]->objectDataChanges.markDirty(firstObject, objectCount);
+        m_resources[i]->objectBoundsChanges.markDirty(firstObject, objectCount);
     }
 }
 
@@ -504,9 +907,22 @@ void SceneRenderer::updateEntityMaterials() {
         RenderComponent& renderComponent = renderEntities.get<RenderComponent>(*it);
         RenderInfo& renderInfo = renderEntities.get<RenderInfo>(*it);
 
+        if (renderInfo.meshId != renderComponent.getMesh()->getResourceId()) {
+            renderInfo.meshId = renderComponent.getMesh()->getResourceId();
+            m_meshBatchesChanged = true;
+            m_transformChangeTracker.setChanged((uint32_t)index, true);
+        }
+
+        // World bounds are otherwise only recalculated when the transform changes.
+        if (renderInfo.boundingVolume != renderComponent.getBoundingVolume()) {
+            renderInfo.boundingVolume = renderComponent.getBoundingVolume();
+            m_transformChangeTracker.setChanged((uint32_t)index, true);
+        }
+
         if (renderComponent.getMaterial() == nullptr) {
             if (renderInfo.materialIndex != 0) {
                 m_objectDataBuffer[index].materialIndex = 0;
+                markObjectDataChanged((uint32_t)index, 1);
                 renderInfo.materialIndex = 0;
                 renderInfo.materialId = 0;
             }
@@ -514,6 +930,7 @@ void SceneRenderer::updateEntityMaterials() {
             renderInfo.materialIndex = registerMaterial(renderComponent.getMaterial().get());
             renderInfo.materialId = renderComponent.getMaterial()->getResourceId();
             m_objectDataBuffer[index].materialIndex = renderInfo.materialIndex;
+            markObjectDataChanged((uint32_t)index, 1);
         }
     }
 
@@ -527,7 +944,7 @@ void SceneRenderer::updateEntityMaterials() {
         if (arrayCount > 0) {
             DescriptorSetWriter(m_resources->materialDescriptorSet)
                     .writeImage(0, &m_textures[m_resources->updateTextureDescriptorStartIndex], vk::ImageLayout::eShaderReadOnlyOptimal, m_resources->updateTextureDescriptorStartIndex, arrayCount)
-                    .write();
+                    .enqueue();
         }
     }
 
@@ -535,19 +952,99 @@ void SceneRenderer::updateEntityMaterials() {
     m_resources->updateTextureDescriptorEndIndex = 0;
 }
 
+void SceneRenderer::updateMeshBatches() {
+    PROFILE_SCOPE("SceneRenderer::updateMeshBatches")
+
+    if (!m_meshBatchesChanged)
+        return;
+
+    m_meshBatchesChanged = false;
+
+    const auto& renderEntities = m_scene->registry()->group<RenderComponent, RenderInfo, Transform>();
+
+    m_meshBatches.clear();
+
+    uint32_t index = 0;
+    for (auto it = renderEntities.begin(); it != renderEntities.end(); ++it, ++index) {
+        Mesh* mesh = renderEntities.get<RenderComponent>(*it).getMesh().get();
+
+        if (m_meshBatches.empty() || m_meshBatches.back().mesh != mesh) {
+            m_meshBatches.emplace_back(MeshBatch{mesh, index, 0});
+        }
+
+        ++m_meshBatches.back().objectCount;
+    }
+
+    m_meshBatchBuffer.resize(m_meshBatches.size());
+    for (size_t i = 0; i < m_meshBatches.size(); ++i) {
+        m_meshBatchBuffer[i].firstObject = m_meshBatches[i].firstObject;
+        m_meshBatchBuffer[i].objectCount = m_meshBatches[i].objectCount;
+    }
+
+    for (int i = 0; i < CONCURRENT_FRAMES; ++i)
+        m_resources[i]->meshBatchesChanged = true;
+}
+
 void SceneRenderer::streamEntityRenderData() {
     PROFILE_SCOPE("SceneRenderer::streamEntityRenderData")
 
     if (m_numRenderEntities > 0) {
         PROFILE_REGION("Copy object data");
         GPUObjectData* mappedObjectDataBuffer = static_cast<GPUObjectData*>(mapObjectDataBuffer(m_numRenderEntities));
-        memcpy(&mappedObjectDataBuffer[0], &m_objectDataBuffer[0], m_objectDataBuffer.size() * sizeof(GPUObjectData));
+        m_uploadStats.objectDataBytes += m_resources->objectDataChanges.upload(mappedObjectDataBuffer, m_objectDataBuffer.data(), m_numRenderEntities, sizeof(GPUObjectData));
     }
 
     if (!m_materialDataBuffer.empty()) {
         PROFILE_REGION("Copy material data");
         GPUMaterial* mappedMaterialDataBuffer = static_cast<GPUMaterial*>(mapMaterialDataBuffer(m_materialDataBuffer.size()));
-        memcpy(&mappedMaterialDataBuffer[0], &m_materialDataBuffer[0], m_materialDataBuffer.size() * sizeof(GPUMaterial));
+        m_uploadStats.materialDataBytes += m_resources->materialDataChanges.upload(mappedMaterialDataBuffer, m_materialDataBuffer.data(), m_materialDataBuffer.size(), sizeof(GPUMaterial));
+    }
+
+    if (m_drawMode != DrawMode_IndirectCompute) {
+        // The bounds are only read by the culling compute shader. Nothing is uploaded until it is used.
+        m_resources->objectBoundsChanges.markAllDirty();
+        m_resources->meshBatchesChanged = true;
+
+    } else if (m_numRenderEntities > 0) {
+        PROFILE_REGION("Copy culling data");
+        GPUObjectBounds* mappedObjectBoundsBuffer = static_cast<GPUObjectBounds*>(mapObjectBoundsBuffer(m_numRenderEntities));
+        m_resources->objectBoundsChanges.upload(mappedObjectBoundsBuffer, m_objectBoundsBuffer.data(), m_numRenderEntities, sizeof(GPUObjectBounds));
+
+        GPUMeshBatch* mappedMeshBatchBuffer = static_cast<GPUMeshBatch*>(mapMeshBatchBuffer(m_meshBatchBuffer.size()));
+        if (m_resources->meshBatchesChanged) {
+            memcpy(&mappedMeshBatchBuffer[0], &m_meshBatchBuffer[0], m_meshBatchBuffer.size() * sizeof(GPUMeshBatch));
+            m_resources->meshBatchesChanged = false;
+        }
+    }
+}
+
+void SceneRenderer::updateObjectIndicesChanges() {
+    PROFILE_SCOPE("SceneRenderer::updateObjectIndicesChanges")
+
+    // The visible indices are rebuilt every frame, but are mostly the same as the previous frame when the camera and
+    // scene are still. They are compared in blocks against a copy of what was last written to this frame's buffer, which
+    // is far cheaper than writing the whole buffer through to uncached GPU visible memory.
+    constexpr size_t indicesPerBlock = 256;
+
+    std::vector<uint32_t>& uploadedIndices = m_resources->uploadedObjectIndices;
+    DirtyRangeList& changes = m_resources->objectIndicesChanges;
+
+    size_t indexCount = m_objectIndicesBuffer.size();
+    size_t compareCount = changes.isAllDirty() ? 0 : glm::min(uploadedIndices.size(), indexCount);
+
+    uploadedIndices.resize(indexCount);
+
+    for (size_t i = 0; i < compareCount; i += indicesPerBlock) {
+        size_t count = glm::min(indicesPerBlock, compareCount - i);
+        if (memcmp(&uploadedIndices[i], &m_objectIndicesBuffer[i], count * sizeof(uint32_t)) != 0) {
+            memcpy(&uploadedIndices[i], &m_objectIndicesBuffer[i], count * sizeof(uint32_t));
+            changes.markDirty(i, count);
+        }
+    }
+
+    if (compareCount < indexCount) {
+        memcpy(&uploadedIndices[compareCount], &m_objectIndicesBuffer[compareCount], (indexCount - compareCount) * sizeof(uint32_t));
+        changes.markDirty(compareCount, indexCount - compareCount);
     }
 }
 
@@ -567,6 +1064,7 @@ void* SceneRenderer::mapObjectIndicesBuffer(size_t maxObjects) {
 
         delete m_resources->objectIndicesBuffer;
         m_resources->objectIndicesBuffer = Buffer::create(objectIndicesBufferConfig, "SceneRenderer-ObjectIndicesBuffer");
+        m_resources->objectIndicesChanges.markAllDirty();
 
         DescriptorSetWriter(m_resources->objectDescriptorSet)
                 .writeBuffer(1, m_resources->objectIndicesBuffer, 0, newBufferSize)
@@ -591,10 +1089,15 @@ void* SceneRenderer::mapObjectDataBuffer(size_t maxObjects) {
 
         delete m_resources->worldTransformBuffer;
         m_resources->worldTransformBuffer = Buffer::create(worldTransformBufferConfig, "SceneRenderer-WorldTransformBuffer");
+        m_resources->objectDataChanges.markAllDirty();
 
         DescriptorSetWriter(m_resources->objectDescriptorSet)
                 .writeBuffer(0, m_resources->worldTransformBuffer, 0, newBufferSize)
                 .write();
+
+        DescriptorSetWriter(m_resources->culledObjectDescriptorSet)
+                .writeBuffer(0, m_resources->worldTransformBuffer, 0, newBufferSize)
+                .write();
     }
 
     void* mappedBuffer = m_resources->worldTransformBuffer->map();
@@ -615,6 +1118,7 @@ void* SceneRenderer::mapMaterialDataBuffer(size_t maxObjects) {
 
         delete m_resources->materialDataBuffer;
         m_resources->materialDataBuffer = Buffer::create(materialDataBufferConfig, "SceneRenderer-MaterialDataBuffer");
+        m_resources->materialDataChanges.markAllDirty();
 
         DescriptorSetWriter(m_resources->materialDescriptorSet)
                 .writeBuffer(1, m_resources->materialDataBuffer, 0, newBufferSize)
@@ -623,4 +1127,106 @@ void* SceneRenderer::mapMaterialDataBuffer(size_t maxObjects) {
 
     void* mappedBuffer = m_resources->materialDataBuffer->map();
     return mappedBuffer;
-}
\ No newline at end of file
+}
+
+void* SceneRenderer::mapDrawCommandBuffer(size_t maxCommands) {
+
+    vk::DeviceSize newBufferSize = sizeof(GPUDrawCommand) * maxCommands;
+
+    if (m_resources->drawCommandBuffer == nullptr || newBufferSize > m_resources->drawCommandBuffer->getSize()) {
+
+        BufferConfiguration drawCommandBufferConfig{};
+        drawCommandBufferConfig.device = Engine::graphics()->getDevice();
+        drawCommandBufferConfig.size = newBufferSize;
+        drawCommandBufferConfig.memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+        drawCommandBufferConfig.usage = vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eStorageBuffer;
+
+        delete m_resources->drawCommandBuffer;
+        m_resources->drawCommandBuffer = Buffer::create(drawCommandBufferConfig, "SceneRenderer-DrawCommandBuffer");
+
+        DescriptorSetWriter(m_resources->cullingDescriptorSet)
+                .writeBuffer(2, m_resources->drawCommandBuffer, 0, newBufferSize)
+                .write();
+    }
+
+    void* mappedBuffer = m_resources->drawCommandBuffer->map();
+    return mappedBuffer;
+}
+
+void* SceneRenderer::mapObjectBoundsBuffer(size_t maxObjects) {
+
+    vk::DeviceSize newBufferSize = sizeof(GPUObjectBounds) * maxObjects;
+
+    if (m_resources->objectBoundsBuffer == nullptr || newBufferSize > m_resources->objectBoundsBuffer->getSize()) {
+
+        BufferConfiguration objectBoundsBufferConfig{};
+        objectBoundsBufferConfig.device = Engine::graphics()->getDevice();
+        objectBoundsBufferConfig.size = newBufferSize;
+        objectBoundsBufferConfig.memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+        objectBoundsBufferConfig.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+
+        delete m_resources->objectBoundsBuffer;
+        m_resources->objectBoundsBuffer = Buffer::create(objectBoundsBufferConfig, "SceneRenderer-ObjectBoundsBuffer");
+        m_resources->objectBoundsChanges.markAllDirty();
+
+        DescriptorSetWriter(m_resources->cullingDescriptorSet)
+                .writeBuffer(0, m_resources->objectBoundsBuffer, 0, newBufferSize)
+                .write();
+    }
+
+    void* mappedBuffer = m_resources->objectBoundsBuffer->map();
+    return mappedBuffer;
+}
+
+void* SceneRenderer::mapMeshBatchBuffer(size_t maxBatches) {
+
+    vk::DeviceSize newBufferSize = sizeof(GPUMeshBatch) * glm::max(maxBatches, (size_t)1);
+
+    if (m_resources->meshBatchBuffer == nullptr || newBufferSize > m_resources->meshBatchBuffer->getSize()) {
+
+        BufferConfiguration meshBatchBufferConfig{};
+        meshBatchBufferConfig.device = Engine::graphics()->getDevice();
+        meshBatchBufferConfig.size = newBufferSize;
+        meshBatchBufferConfig.memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+        meshBatchBufferConfig.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+
+        delete m_resources->meshBatchBuffer;
+        m_resources->meshBatchBuffer = Buffer::create(meshBatchBufferConfig, "SceneRenderer-MeshBatchBuffer");
+        m_resources->meshBatchesChanged = true;
+
+        DescriptorSetWriter(m_resources->cullingDescriptorSet)
+                .writeBuffer(1, m_resources->meshBatchBuffer, 0, newBufferSize)
+                .write();
+    }
+
+    void* mappedBuffer = m_resources->meshBatchBuffer->map();
+    return mappedBuffer;
+}
+
+void SceneRenderer::updateCulledObjectIndicesBuffer(size_t maxObjects) {
+
+    maxObjects = CEIL_TO_MULTIPLE(maxObjects, 4);
+
+    vk::DeviceSize newBufferSize = sizeof(uint32_t) * maxObjects;
+
+    if (m_resources->culledObjectIndicesBuffer == nullptr || newBufferSize > m_resources->culledObjectIndicesBuffer->getSize()) {
+
+        // Only ever written by the culling compute shader, so this can live in device local memory.
+        BufferConfiguration culledObjectIndicesBufferConfig{};
+        culledObjectIndicesBufferConfig.device = Engine::graphics()->getDevice();
+        culledObjectIndicesBufferConfig.size = newBufferSize;
+        culledObjectIndicesBufferConfig.memoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+        culledObjectIndicesBufferConfig.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+
+        delete m_resources->culledObjectIndicesBuffer;
+        m_resources->culledObjectIndicesBuffer = Buffer::create(culledObjectIndicesBufferConfig, "SceneRenderer-CulledObjectIndicesBuffer");
+
+        DescriptorSetWriter(m_resources->cullingDescriptorSet)
+                .writeBuffer(3, m_resources->culledObjectIndicesBuffer, 0, newBufferSize)
+                .write();
+
+        DescriptorSetWriter(m_resources->culledObjectDescriptorSet)
+                .writeBuffer(1, m_resources->culledObjectIndicesBuffer, 0, newBufferSize)
+                .write();
+    }
+}
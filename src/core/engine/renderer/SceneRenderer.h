@@ -5,6 +5,8 @@
 #include "core/graphics/FrameResource.h"
 #include "core/graphics/GraphicsResource.h"
 #include "core/engine/scene/Scene.h"
+#include "core/util/EntityChangeTracker.h"
+#include "core/util/DirtyRangeList.h"
 
 class Mesh;
 class Buffer;
@@ -16,8 +18,28 @@ class Image2D;
 class Frustum;
 class RenderCamera;
 class RenderComponent;
+class BoundingVolume;
+class ComputePipeline;
 
 class SceneRenderer {
+public:
+    enum DrawMode {
+        // Visible instances are walked on the CPU, and one draw is recorded for each run of instances sharing a mesh.
+        DrawMode_Direct = 0,
+        // Visible instances of each mesh batch are counted on the CPU and written to an indirect command buffer, so
+        // command recording is proportional to the number of meshes rather than the number of visible instances.
+        DrawMode_Indirect = 1,
+        // As DrawMode_Indirect, but frustum culling and instance counting is performed by a compute shader.
+        DrawMode_IndirectCompute = 2,
+    };
+
+    // Bytes written to host visible GPU buffers during one frame.
+    struct UploadStats {
+        size_t objectDataBytes = 0;
+        size_t materialDataBytes = 0;
+        size_t objectIndicesBytes = 0;
+    };
+
 public:
     SceneRenderer();
 
@@ -31,6 +53,10 @@ public:
 
     void applyVisibility();
 
+    // Records the compute culling of any viewpoints using DrawMode_IndirectCompute. Must be called after
+    // applyVisibility, outside of any render pass.
+    void dispatchCulling(const vk::CommandBuffer& commandBuffer);
+
     uint32_t updateVisibility(double dt, const RenderCamera* renderCamera, const Frustum* frustum);
 
     void renderGeometryPass(double dt, const vk::CommandBuffer& commandBuffer, uint32_t visibilityIndex);
@@ -49,36 +75,73 @@ public:
 
     DescriptorSet* getObjectDescriptorSet() const;
 
+    DescriptorSet* getObjectDescriptorSet(uint32_t visibilityIndex) const;
+
     DescriptorSet* getMaterialDescriptorSet() const;
 
     uint32_t registerTexture(Texture* texture);
 
     uint32_t registerMaterial(Material* material);
 
+    void notifyTransformChanged(EntityChangeTracker::entity_index entityIndex);
+
+    // Returns the upload statistics of the last completed frame.
+    const UploadStats& getUploadStats() const;
+
+    DrawMode getDrawMode() const;
+
+    void setDrawMode(DrawMode drawMode);
+
 private:
     void initMissingTextureMaterial();
 
+    bool createCullingComputePipeline();
+
     void onRenderComponentAdded(ComponentAddedEvent<RenderComponent>* event);
 
     void onRenderComponentRemoved(ComponentRemovedEvent<RenderComponent>* event);
 
-    void recordRenderCommands(double dt, const vk::CommandBuffer& commandBuffer);
+    void recordRenderCommands(double dt, const vk::CommandBuffer& commandBuffer, uint32_t visibilityIndex);
+
+    void recordIndirectRenderCommands(double dt, const vk::CommandBuffer& commandBuffer, uint32_t visibilityIndex);
+
+    void addIndirectDrawCommand(Mesh* mesh, uint32_t instanceCount, uint32_t firstInstance);
+
+    void buildIndirectDrawCommands(uint32_t firstInstance, uint32_t instanceCount);
+
+    void addCullingView(const Frustum* frustum, uint32_t firstInstance, uint32_t firstCommand);
 
     uint32_t applyFrustumCulling(const Frustum* frustum);
 
+    void updateWorldRenderBounds(size_t index, const BoundingVolume* boundingVolume, const glm::mat4& modelMatrix);
+
     void sortRenderEntities();
 
     void updateEntityWorldTransforms();
 
+    void markObjectDataChanged(uint32_t firstObject, uint32_t objectCount);
+
     void updateEntityMaterials();
 
+    void updateMeshBatches();
+
     void streamEntityRenderData();
 
+    void updateObjectIndicesChanges();
+
     void* mapObjectIndicesBuffer(size_t maxObjects);
 
     void* mapObjectDataBuffer(size_t maxObjects);
 
     void* mapMaterialDataBuffer(size_t maxObjects);
+
+    void* mapDrawCommandBuffer(size_t maxCommands);
+
+    void* mapObjectBoundsBuffer(size_t maxObjects);
+
+    void* mapMeshBatchBuffer(size_t maxBatches);
+
+    void updateCulledObjectIndicesBuffer(size_t maxObjects);
 private:
     struct GPUObjectData {
         glm::mat4 prevModelMatrix;
@@ -135,14 +198,57 @@ private:
         uint32_t _pad2;
     };
 
+    // Matches the layout of VkDrawIndexedIndirectCommand. For meshes without indices, the first four members hold a
+    // VkDrawIndirectCommand instead (vertexCount, instanceCount, firstVertex, firstInstance). instanceCount is at the
+    // same offset in both, which is the only member written by the culling compute shader.
+    struct GPUDrawCommand {
+        uint32_t indexCount;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        int32_t vertexOffset;
+        uint32_t firstInstance;
+    };
+
+    struct GPUObjectBounds {
+        glm::vec4 center;
+        glm::vec4 halfExtent;
+    };
+
+    struct GPUMeshBatch {
+        uint32_t firstObject;
+        uint32_t objectCount;
+        uint32_t _pad0;
+        uint32_t _pad1;
+    };
+
+    struct CullingPushConstantData {
+        glm::vec4 frustumPlanes[6];
+        uint32_t objectCount;
+        uint32_t batchCount;
+        uint32_t firstCommand;
+        uint32_t firstInstance;
+    };
+
     struct RenderResources {
         Buffer* objectIndicesBuffer;
         Buffer* worldTransformBuffer;
         Buffer* materialDataBuffer;
+        Buffer* drawCommandBuffer;
+        Buffer* objectBoundsBuffer;
+        Buffer* meshBatchBuffer;
+        Buffer* culledObjectIndicesBuffer;
         DescriptorSet* objectDescriptorSet;
+        DescriptorSet* culledObjectDescriptorSet; // Object data, with the object indices written by the culling shader
         DescriptorSet* materialDescriptorSet;
+        DescriptorSet* cullingDescriptorSet;
         uint32_t updateTextureDescriptorStartIndex;
         uint32_t updateTextureDescriptorEndIndex;
+        DirtyRangeList objectDataChanges; // Elements of m_objectDataBuffer not yet copied to this frame's buffer
+        DirtyRangeList materialDataChanges;
+        DirtyRangeList objectIndicesChanges;
+        std::vector<uint32_t> uploadedObjectIndices; // Copy of the object indices last written to this frame's buffer
+        DirtyRangeList objectBoundsChanges;
+        bool meshBatchesChanged;
     };
 
     struct DrawCommand {
@@ -151,20 +257,45 @@ private:
         uint32_t firstInstance = 0;
     };
 
+    // A run of consecutive objects which share a mesh.
+    struct MeshBatch {
+        Mesh* mesh;
+        uint32_t firstObject;
+        uint32_t objectCount;
+    };
+
+    struct CullingView {
+        std::array<glm::vec4, 6> frustumPlanes;
+        uint32_t firstInstance;
+        uint32_t firstCommand;
+    };
+
     struct RenderInfo {
+        ResourceId meshId = 0;
         ResourceId materialId = 0;
         uint32_t materialIndex = UINT32_MAX;
         uint32_t objectIndex = UINT32_MAX;
+        const BoundingVolume* boundingVolume = nullptr;
     };
 
+    // World space AABBs of all render entities, indexed by object index. Each component is stored in its own array so
+    // that ranges of entities can be passed directly to Frustum::testAABBs.
     struct WorldRenderBounds {
-        glm::vec3 aabbMin;
-        glm::vec3 aabbMax;
+        std::vector<float> centerX;
+        std::vector<float> centerY;
+        std::vector<float> centerZ;
+        std::vector<float> halfExtentX;
+        std::vector<float> halfExtentY;
+        std::vector<float> halfExtentZ;
     };
 
     struct VisibilityIndices {
         uint32_t firstInstance;
         uint32_t instanceCount;
+        uint32_t firstCommand;
+        uint32_t commandCount;
+        bool indirect;
+        bool culledOnGPU;
     };
 
 private:
@@ -174,12 +305,16 @@ private:
 
     SharedResource<DescriptorSetLayout> m_objectDescriptorSetLayout;
     SharedResource<DescriptorSetLayout> m_materialDescriptorSetLayout;
+    SharedResource<DescriptorSetLayout> m_cullingDescriptorSetLayout;
+    ComputePipeline* m_cullingComputePipeline;
 
     std::shared_ptr<Image2D> m_missingTextureImage;
     std::shared_ptr<Material> m_missingTextureMaterial;
 
     uint32_t m_numRenderEntities;
 
+    DrawMode m_drawMode;
+
     bool m_visibilityApplied;
     std::vector<VisibilityIndices> m_visibilityIndices;
     std::unordered_map<ResourceId, uint32_t> m_materialIndices;
@@ -190,6 +325,21 @@ private:
     std::vector<GPUObjectData> m_objectDataBuffer;
     std::vector<GPUMaterial> m_materialDataBuffer;
     std::vector<DrawCommand> m_drawCommands;
+    std::vector<GPUDrawCommand> m_indirectDrawCommands;
+    std::vector<Mesh*> m_indirectDrawCommandMeshes;
+    std::vector<MeshBatch> m_meshBatches;
+    std::vector<GPUMeshBatch> m_meshBatchBuffer;
+    std::vector<GPUObjectBounds> m_objectBoundsBuffer;
+    std::vector<CullingView> m_cullingViews;
+    uint32_t m_culledObjectIndexCount;
+    bool m_meshBatchesChanged;
+    WorldRenderBounds m_worldRenderBounds;
+    std::vector<std::vector<uint32_t>> m_culledObjectIndices;
+    std::vector<uint8_t> m_culledObjectVisibility;
+    EntityChangeTracker m_transformChangeTracker;
+    std::vector<uint32_t> m_movedObjectIndices;
+    UploadStats m_uploadStats;
+    UploadStats m_previousUploadStats;
 
     double m_previousPartialTicks;
 
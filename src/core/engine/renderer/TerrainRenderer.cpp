@@ -121,6 +121,7 @@ void TerrainRenderer::resetVisibility() {
     m_terrainUniformData.clear();
     m_globalTerrainInstances.clear();
     m_heightmapImageViews.clear();
+    m_terrainEntities.clear();
     m_visibilityIndices.clear();
     m_visibilityApplied = false;
 
@@ -152,13 +153,24 @@ void TerrainRenderer::resetVisibility() {
         }
 
         m_terrainUniformData.emplace_back(uniformData);
+        m_terrainEntities.emplace_back(TerrainEntity{ &quadtreeTerrain, *transform });
     }
 
     if (!m_heightmapImageViews.empty()) {
         uint32_t maxArrayCount = m_terrainDescriptorSetLayout->getBinding(TERRAIN_HEIGHTMAP_TEXTURES_BINDING).descriptorCount;
         DescriptorSetWriter(m_resources->terrainDescriptorSet)
                 .writeImage(TERRAIN_HEIGHTMAP_TEXTURES_BINDING, m_defaultHeightmapSampler.get(), m_heightmapImageViews.data(), vk::ImageLayout::eShaderReadOnlyOptimal, 0, glm::min((uint32_t)m_heightmapImageViews.size(), maxArrayCount))
-                .write();
+                .enqueue();
+    }
+}
+
+void TerrainRenderer::updateTileSuppliers() {
+    PROFILE_SCOPE("TerrainRenderer::updateTileSuppliers")
+
+    for (const TerrainEntity& terrainEntity : m_terrainEntities) {
+        const std::shared_ptr<TerrainTileSupplier>& tileSupplier = terrainEntity.quadtreeTerrain->getTileQuadtree()->getTileSupplier();
+        if (tileSupplier != nullptr)
+            tileSupplier->update();
     }
 }
 
@@ -179,9 +191,8 @@ void TerrainRenderer::applyVisibility() {
     m_visibilityApplied = true;
 }
 
-uint32_t TerrainRenderer::updateVisibility(double dt, const RenderCamera* renderCamera, const Frustum* frustum) {
+uint32_t TerrainRenderer::updateVisibility(double dt, const RenderCamera* renderCamera, const Frustum* frustum, bool updateSubdivisions) {
     assert(m_visibilityApplied == false);
-    const auto& terrainEntities = m_scene->registry()->view<QuadtreeTerrainComponent>();
 
     // Presumably there will not normally be a large number of terrain entities. It is best to have one entity with the terrain component containing global terrain settings.
     // Multiple terrain entities may be used in situations where the world is enormous, and chunked up, or in the case of planet rendering, each planet might have its own global terrain component.
@@ -190,20 +201,13 @@ uint32_t TerrainRenderer::updateVisibility(double dt, const RenderCamera* render
     VisibilityIndices& visibility = m_visibilityIndices.emplace_back();
     visibility.firstInstance = (uint32_t)m_globalTerrainInstances.size();
 
-    Transform identityTransform = Transform();
-
-    for (auto it = terrainEntities.begin(); it != terrainEntities.end(); ++it) {
-        Entity entity(m_scene, *it);
-
-        const QuadtreeTerrainComponent& quadtreeTerrain = terrainEntities.get<QuadtreeTerrainComponent>(*it);
-        const Transform* transform = entity.tryGetComponent<Transform>();
-        if (transform == nullptr)
-            transform = &identityTransform;
-
+    // This runs on the visibility graph, so it uses the terrain entities collected by resetVisibility rather than the
+    // registry.
+    for (const TerrainEntity& terrainEntity : m_terrainEntities) {
         InstanceInfo instanceInfo{};
         instanceInfo.firstInstance = (uint32_t)m_terrainTileDataBuffer.size();
 
-        updateQuadtreeTerrainTiles(quadtreeTerrain, *transform, dt, frustum);
+        updateQuadtreeTerrainTiles(*terrainEntity.quadtreeTerrain, terrainEntity.transform, dt, frustum, updateSubdivisions);
         instanceInfo.instanceCount = (uint32_t)(m_terrainTileDataBuffer.size() - instanceInfo.firstInstance);
         m_globalTerrainInstances.emplace_back(instanceInfo);
     }
@@ -291,17 +295,21 @@ void TerrainRenderer::recordRenderCommands(double dt, const vk::CommandBuffer& c
 
 }
 
-void TerrainRenderer::updateQuadtreeTerrainTiles(const QuadtreeTerrainComponent& quadtreeTerrain, const Transform& transform, double dt, const Frustum* frustum) {
+void TerrainRenderer::updateQuadtreeTerrainTiles(const QuadtreeTerrainComponent& quadtreeTerrain, const Transform& transform, double dt, const Frustum* frustum, bool updateSubdivisions) {
     PROFILE_SCOPE("TerrainRenderer::updateQuadtreeTerrainTiles")
 
     quadtreeTerrain.getTileQuadtree()->setTransform(transform);
-    quadtreeTerrain.getTileQuadtree()->update(frustum);
+    if (updateSubdivisions)
+        quadtreeTerrain.getTileQuadtree()->update(frustum);
+    else
+        quadtreeTerrain.getTileQuadtree()->updateVisibility(frustum);
 
     glm::dvec3 terrainScale(quadtreeTerrain.getSize().x, quadtreeTerrain.getHeightScale(), quadtreeTerrain.getSize().y);
 
     std::vector<TerrainTileQuadtree::TraversalInfo> traversalStack;
+    TerrainTileQuadtree::NodeLodInfo lodInfo{};
 
-    quadtreeTerrain.getTileQuadtree()->traverseTreeNodes(traversalStack, [this](TerrainTileQuadtree* tileQuadtree, const TerrainTileQuadtree::TraversalInfo& traversalInfo) {
+    quadtreeTerrain.getTileQuadtree()->traverseTreeNodes(traversalStack, [this, &lodInfo](TerrainTileQuadtree* tileQuadtree, const TerrainTileQuadtree::TraversalInfo& traversalInfo) {
         if (!tileQuadtree->isVisible(traversalInfo.nodeIndex)) {
             return true; // Skip whole subtree
         }
@@ -326,6 +334,16 @@ void TerrainRenderer::updateQuadtreeTerrainTiles(const QuadtreeTerrainComponent&
         terrainData.textureOffset = glm::vec2(tileCoord);
         terrainData.textureSize = glm::vec2((float)tileSize);
 
+        // Morph factors and neighbour depths let the vertex shader blend towards the parent tile and stitch edges to
+        // coarser neighbours, so level of detail changes neither pop nor crack.
+        tileQuadtree->calculateNodeLodInfo(traversalInfo, lodInfo);
+        terrainData.packedMorphFactors = glm::packUnorm4x8(glm::vec4(lodInfo.morphFactors[0], lodInfo.morphFactors[1], lodInfo.morphFactors[2], lodInfo.morphFactors[3]));
+        terrainData.packedNeighbourDepthDeltas = 0;
+        for (int i = 0; i < 4; ++i)
+            terrainData.packedNeighbourDepthDeltas |= (uint32_t)lodInfo.neighbourDepthDeltas[i] << (i * 8);
+        terrainData.packedNeighbourMorphFactors.x = glm::packUnorm4x8(glm::vec4(lodInfo.neighbourMorphFactors[0][0], lodInfo.neighbourMorphFactors[0][1], lodInfo.neighbourMorphFactors[1][0], lodInfo.neighbourMorphFactors[1][1]));
+        terrainData.packedNeighbourMorphFactors.y = glm::packUnorm4x8(glm::vec4(lodInfo.neighbourMorphFactors[2][0], lodInfo.neighbourMorphFactors[2][1], lodInfo.neighbourMorphFactors[3][0], lodInfo.neighbourMorphFactors[3][1]));
+
         return false;
     });
 }
@@ -4,10 +4,10 @@
 #include "core/core.h"
 #include "core/graphics/GraphicsResource.h"
 #include "core/graphics/FrameResource.h"
+#include "core/engine/scene/Transform.h"
 
 class Mesh;
 class Frustum;
-class Transform;
 class QuadtreeTerrainComponent;
 class Buffer;
 class Texture;
@@ -25,6 +25,9 @@ private:
         glm::vec2 tileSize;
         glm::vec2 textureOffset;
         glm::vec2 textureSize;
+        uint32_t packedMorphFactors; // Unorm8 at each corner
+        uint32_t packedNeighbourDepthDeltas; // Uint8 for each edge
+        glm::uvec2 packedNeighbourMorphFactors; // Unorm8 at both ends of each edge's coarser neighbour
     };
 
     struct GPUTerrainUniformData {
@@ -46,6 +49,11 @@ private:
         uint32_t instanceCount;
     };
 
+    struct TerrainEntity {
+        const QuadtreeTerrainComponent* quadtreeTerrain;
+        Transform transform;
+    };
+
 public:
     struct InstanceInfo {
         uint32_t firstInstance;
@@ -66,11 +74,18 @@ public:
 
     void renderShadowPass(double dt, const vk::CommandBuffer& commandBuffer, uint32_t visibilityIndex);
 
+    // Collects the terrain entities to be culled this frame. The registry is only read here, on the render thread.
     void resetVisibility();
 
+    // Streams the tiles requested while the visibility was updated. Submits GPU work, so it must run on the render
+    // thread, after the visibility graph.
+    void updateTileSuppliers();
+
     void applyVisibility();
 
-    uint32_t updateVisibility(double dt, const RenderCamera* renderCamera, const Frustum* frustum);
+    // Subdivision is only updated for the main view. Other views, such as shadow cascades, render the same tiles and
+    // only update which of them are visible, so the quadtree stays coherent between frames.
+    uint32_t updateVisibility(double dt, const RenderCamera* renderCamera, const Frustum* frustum, bool updateSubdivisions = true);
 
     void drawTerrain(double dt, const vk::CommandBuffer& commandBuffer, uint32_t visibilityIndex);
 
@@ -89,7 +104,7 @@ public:
     const std::vector<InstanceInfo>& getGlobalTerrainInstances() const;
 
 private:
-    void updateQuadtreeTerrainTiles(const QuadtreeTerrainComponent& quadtreeTerrain, const Transform& transform, double dt, const Frustum* frustum);
+    void updateQuadtreeTerrainTiles(const QuadtreeTerrainComponent& quadtreeTerrain, const Transform& transform, double dt, const Frustum* frustum, bool updateSubdivisions);
 
     void* mapTerrainTileDataBuffer(size_t maxObjects);
 
@@ -109,6 +124,7 @@ private:
     std::vector<GPUTerrainUniformData> m_terrainUniformData;
     std::vector<InstanceInfo> m_globalTerrainInstances;
     std::vector<ImageView*> m_heightmapImageViews;
+    std::vector<TerrainEntity> m_terrainEntities;
 
     std::shared_ptr<Sampler> m_defaultHeightmapSampler;
     std::shared_ptr<Image2D> m_defaultEmptyHeightmapImage;
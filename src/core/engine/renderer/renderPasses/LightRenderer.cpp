@@ -316,8 +316,6 @@ void LightRenderer::updateVisibleShadowMaps(double dt, const RenderCamera* rende
 
     const auto& lightEntities = Engine::scene()->registry()->group<LightComponent>(entt::get<Transform>);
 
-    Frustum frustum;
-
     m_visibleShadowRenderCameras.clear();
     m_visibleShadowMaps.clear();
 
@@ -363,9 +361,6 @@ void LightRenderer::updateVisibleShadowMaps(double dt, const RenderCamera* rende
                 gpuShadowMap.cascadeEndZ = (float)cascadeEndDistance;
 
                 cascadeStartDistance = cascadeEndDistance;
-
-                frustum.set(shadowRenderCamera);
-                Engine::instance()->getTerrainRenderer()->updateVisibility(dt, &shadowRenderCamera, &frustum);
             }
         } else {
             continue;
@@ -387,6 +382,18 @@ void LightRenderer::updateVisibleShadowMaps(double dt, const RenderCamera* rende
     }
 }
 
+void LightRenderer::updateShadowMapVisibility(double dt) {
+    PROFILE_SCOPE("LightRenderer::updateShadowMapVisibility");
+
+    Frustum frustum;
+
+    // Every visible shadow camera is a cascade, in the same order as their shadow maps are rendered.
+    for (const RenderCamera& shadowRenderCamera : m_visibleShadowRenderCameras) {
+        frustum.set(shadowRenderCamera);
+        Engine::instance()->getTerrainRenderer()->updateVisibility(dt, &shadowRenderCamera, &frustum, false);
+    }
+}
+
 const SharedResource<RenderPass>& LightRenderer::getRenderPass() const {
     return m_shadowRenderPass;
 }
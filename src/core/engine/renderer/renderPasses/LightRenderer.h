@@ -43,8 +43,13 @@ public:
 
     void renderShadowMaps(double dt, const vk::CommandBuffer& commandBuffer, const RenderCamera* renderCamera);
 
+    // Finds the visible shadow maps and their cascade cameras. Reads the registry and may create shadow map resources,
+    // so it must run on the render thread, before the visibility graph.
     void updateVisibleShadowMaps(double dt, const RenderCamera* renderCamera);
 
+    // Culls the terrain for each shadow cascade found by updateVisibleShadowMaps. Runs as a visibility graph node.
+    void updateShadowMapVisibility(double dt);
+
     const SharedResource<RenderPass>& getRenderPass() const;
 
     const std::shared_ptr<Texture>& getEmptyShadowMap() const;
@@ -11,6 +11,7 @@
 #include "core/graphics/Image2D.h"
 #include "core/graphics/ImageView.h"
 #include "core/graphics/DescriptorSet.h"
+#include "core/graphics/DescriptorAllocator.h"
 #include "core/graphics/Framebuffer.h"
 #include "core/graphics/RenderPass.h"
 #include "core/graphics/Texture.h"
@@ -48,7 +49,6 @@ PostProcessRenderer::~PostProcessRenderer() {
 
     for (uint32_t i = 0; i < CONCURRENT_FRAMES; ++i) {
         if (m_resources[i] != nullptr) {
-            delete m_resources[i]->postProcessDescriptorSet;
             delete m_resources[i]->postProcessUniformBuffer;
             delete m_resources[i]->bloomBlurUniformBuffer;
             delete m_resources[i]->bloomBlurInputDescriptorSet;
@@ -114,12 +114,6 @@ bool PostProcessRenderer::init() {
         uniformBufferConfig.size = sizeof(PostProcessUniformData);
         m_resources[i]->postProcessUniformBuffer = Buffer::create(uniformBufferConfig, "PostProcessRenderer-PostProcessUniformBuffer");
 
-        m_resources[i]->postProcessDescriptorSet = DescriptorSet::create(m_postProcessDescriptorSetLayout, descriptorPool, "PostProcessRenderer-PostProcessDescriptorSet");
-
-        DescriptorSetWriter(m_resources[i]->postProcessDescriptorSet)
-                .writeBuffer(POSTPROCESS_UNIFORM_BUFFER_BINDING, m_resources[i]->postProcessUniformBuffer, 0, m_resources[i]->postProcessUniformBuffer->getSize())
-                .write();
-
         vk::DeviceSize alignedUniformBufferSize = Engine::graphics()->getAlignedUniformBufferOffset(sizeof(BloomBlurUniformData));
         uniformBufferConfig.size = alignedUniformBufferSize;
         m_resources[i]->bloomBlurUniformBuffer = Buffer::create(uniformBufferConfig, "PostProcessRenderer-BloomBlurUniformBuffer");
@@ -284,24 +278,23 @@ void PostProcessRenderer::render(double dt, const vk::CommandBuffer& commandBuff
         setPostProcessUniformDataChanged(true);
     }
 
-    if (m_resources->updateInputImage) {
-        ImageView* frameImageView = Engine::instance()->getReprojectionRenderer()->getOutputFrameImageView();
-        ImageView* debugCompositeImageView = Engine::instance()->getImmediateRenderer()->getOutputFrameImageView();
-        if (debugCompositeImageView == nullptr)
-            debugCompositeImageView = frameImageView;
-
-        DescriptorSetWriter(m_resources->postProcessDescriptorSet)
-                .writeImage(POSTPROCESS_FRAME_COLOUR_TEXTURE_BINDING, m_frameSampler.get(), frameImageView, vk::ImageLayout::eShaderReadOnlyOptimal, 0, 1)
-                .write();
-
-        DescriptorSetWriter(m_resources->postProcessDescriptorSet)
-                .writeImage(POSTPROCESS_DEBUG_COMPOSITE_COLOUR_TEXTURE_BINDING, m_frameSampler.get(), debugCompositeImageView, vk::ImageLayout::eShaderReadOnlyOptimal, 0, 1)
-                .write();
-    }
-
-    DescriptorSetWriter(m_resources->postProcessDescriptorSet)
+    ImageView* frameImageView = Engine::instance()->getReprojectionRenderer()->getOutputFrameImageView();
+    ImageView* debugCompositeImageView = Engine::instance()->getImmediateRenderer()->getOutputFrameImageView();
+    if (debugCompositeImageView == nullptr)
+        debugCompositeImageView = frameImageView;
+
+    // The histogram buffer may be reallocated by updateExposure, so the set is rebuilt every frame from the transient
+    // pools instead of updating a persistent set which the previous frame could still be reading.
+    vk::DescriptorSet postProcessDescriptorSet = DescriptorSetWriter(m_postProcessDescriptorSetLayout)
+            .writeBuffer(POSTPROCESS_UNIFORM_BUFFER_BINDING, m_resources->postProcessUniformBuffer, 0, m_resources->postProcessUniformBuffer->getSize())
+            .writeImage(POSTPROCESS_FRAME_COLOUR_TEXTURE_BINDING, m_frameSampler.get(), frameImageView, vk::ImageLayout::eShaderReadOnlyOptimal, 0, 1)
+            .writeImage(POSTPROCESS_DEBUG_COMPOSITE_COLOUR_TEXTURE_BINDING, m_frameSampler.get(), debugCompositeImageView, vk::ImageLayout::eShaderReadOnlyOptimal, 0, 1)
+            .writeImage(POSTPROCESS_BLOOM_TEXTURE_BINDING, m_frameSampler.get(), m_resources->bloomTextureImageView, vk::ImageLayout::eShaderReadOnlyOptimal, 0, 1)
             .writeBuffer(POSTPROCESS_HISTOGRAM_BUFFER_BINDING, m_exposureHistogram->getHistogramBuffer())
-            .write();
+            .writeTransient();
+
+    // The engine flushed the frame's batch before recording the scene, so these writes must be applied before binding.
+    Engine::graphics()->descriptorAllocator().flushWrites();
 
     if (m_postProcessUniformData.histogramMinLogLum != m_exposureHistogram->getMinLogLuminance()) {
         m_postProcessUniformData.histogramMinLogLum = m_exposureHistogram->getMinLogLuminance();
@@ -316,10 +309,18 @@ void PostProcessRenderer::render(double dt, const vk::CommandBuffer& commandBuff
         m_resources->postProcessUniformBuffer->upload(0, sizeof(PostProcessUniformData), &m_postProcessUniformData);
     }
 
+    if (!postProcessDescriptorSet) {
+        // The allocator has already logged the cause. The pass is skipped for this frame rather than binding a null set.
+        LOG_ERROR("PostProcessRenderer failed to allocate its descriptor set, skipping the post process pass");
+        PROFILE_END_GPU_CMD("PostProcessRenderer::render", commandBuffer)
+        m_resources->updateInputImage = false;
+        return;
+    }
+
     m_postProcessGraphicsPipeline->bind(commandBuffer);
 
     std::array<vk::DescriptorSet, 1> descriptorSets = {
-            m_resources->postProcessDescriptorSet->getDescriptorSet()
+            postProcessDescriptorSet
     };
 
     const vk::PipelineLayout& pipelineLayout = m_postProcessGraphicsPipeline->getPipelineLayout();
@@ -515,10 +516,6 @@ bool PostProcessRenderer::createBloomBlurFramebuffer(RenderResources* resources)
     imageViewConfig.mipLevelCount = m_resources->bloomBlurIterations;
     resources->bloomTextureImageView = ImageView::create(imageViewConfig, "PostProcessRenderer-BloomTextureImageView");
 
-    DescriptorSetWriter(resources->postProcessDescriptorSet)
-            .writeImage(POSTPROCESS_BLOOM_TEXTURE_BINDING, m_frameSampler.get(), resources->bloomTextureImageView, vk::ImageLayout::eShaderReadOnlyOptimal, 0, 1)
-            .write();
-
     // This is janky... The render pass needs an initial layout in order to allow VK_ATTACHMENT_LOAD_OP_LOAD, and therefor the framebuffer image
     // needs to have an initial layout too. Surely there is a cleaner way to deal with this?
     const vk::CommandBuffer& commandBuffer = ImageUtil::beginTransferCommands();
@@ -48,7 +48,6 @@ private:
 
     struct RenderResources {
         Buffer* postProcessUniformBuffer = nullptr;
-        DescriptorSet* postProcessDescriptorSet = nullptr;
         Buffer* bloomBlurUniformBuffer = nullptr;
         DescriptorSet* bloomBlurInputDescriptorSet = nullptr;
         std::vector<DescriptorSet*> bloomBlurDescriptorSets;
@@ -10,6 +10,7 @@
 #include "core/graphics/CommandPool.h"
 #include "core/graphics/RenderPass.h"
 #include "core/graphics/GraphicsManager.h"
+#include "core/graphics/PipelineCache.h"
 #include "core/engine/ui/PerformanceGraphUI.h"
 #include "core/util/Logger.h"
 
@@ -81,7 +82,7 @@ bool UIRenderer::init(SDL_Window* windowHandle) {
     initInfo.Device = **Engine::graphics()->getDevice();
     initInfo.QueueFamily = Engine::graphics()->getGraphicsQueueFamilyIndex();
     initInfo.Queue = **Engine::graphics()->getQueue(QUEUE_GRAPHICS_MAIN);
-    initInfo.PipelineCache = VK_NULL_HANDLE;
+    initInfo.PipelineCache = static_cast<VkPipelineCache>(Engine::graphics()->pipelineCache().getPipelineCache());
     initInfo.DescriptorPool = static_cast<VkDescriptorPool>(Engine::graphics()->descriptorPool()->getDescriptorPool());
     initInfo.Allocator = nullptr;
     initInfo.MinImageCount = glm::max((uint32_t)2, (uint32_t)CONCURRENT_FRAMES);
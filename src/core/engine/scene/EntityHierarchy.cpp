@@ -1,5 +1,6 @@
 #include "core/engine/scene/EntityHierarchy.h"
 #include "core/engine/scene/Scene.h"
+#include "core/engine/scene/TransformHierarchy.h"
 #include "core/util/Profiler.h"
 
 bool EntityHierarchy::hasParent(const Entity& entity) {
@@ -123,6 +124,8 @@ bool EntityHierarchy::attachChild(const Entity& entity, const Entity& child) {
 
     ++parentNode.m_childCount;
 
+    entity.getScene()->getTransformHierarchy()->invalidate();
+
     return true;
 }
 
@@ -168,6 +171,8 @@ bool EntityHierarchy::detach(const Entity& entity) {
     childNode.m_nextSibling = nullptr;
     --parentNode.m_childCount;
 
+    entity.getScene()->getTransformHierarchy()->invalidate();
+
     return true;
 }
 
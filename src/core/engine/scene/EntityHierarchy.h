@@ -6,6 +6,7 @@
 #include "core/engine/scene/Scene.h"
 
 class EntityHierarchy {
+    friend class TransformHierarchy;
 public:
     class iterator {
         friend class EntityHierarchy;
@@ -105,6 +106,7 @@ private:
     Entity m_prevSibling = nullptr;
     Entity m_nextSibling = nullptr;
     uint32_t m_childCount = 0;
+    uint32_t m_transformNode = UINT32_MAX; // Index of this entity within the scene's TransformHierarchy
 };
 
 #endif //WORLDENGINE_ENTITYHIERARCHY_H
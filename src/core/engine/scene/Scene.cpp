@@ -3,16 +3,20 @@
 #include "core/engine/scene/EntityHierarchy.h"
 #include "core/engine/scene/Camera.h"
 #include "core/engine/scene/Transform.h"
+#include "core/engine/scene/TransformHierarchy.h"
 #include "core/engine/event/ApplicationEvents.h"
 #include "core/util/Profiler.h"
 #include "core/util/Util.h"
 
 Scene::Scene() {
     m_eventDispatcher = new EventDispatcher();
+    m_registry.on_destroy<Transform>().connect<&Transform::onDestroyed>();
+    m_transformHierarchy = new TransformHierarchy(this);
 }
 
 Scene::~Scene() {
     m_registry.clear();
+    delete m_transformHierarchy; // Destroying hierarchy entities detaches them, which invalidates the TransformHierarchy.
 }
 
 bool Scene::init() {
@@ -103,6 +107,10 @@ entt::registry* Scene::registry() {
     return &m_registry;
 }
 
+TransformHierarchy* Scene::getTransformHierarchy() const {
+    return m_transformHierarchy;
+}
+
 bool Scene::setMainCameraEntity(const Entity& entity) {
     PROFILE_SCOPE("Scene::setMainCameraEntity")
     if (entity == nullptr) {
@@ -8,6 +8,7 @@
 #include <entt/entt.hpp>
 
 struct ScreenResizeEvent;
+class TransformHierarchy;
 
 template<class T>
 struct ComponentAddedEvent {
@@ -62,6 +63,8 @@ public:
 
     entt::registry* registry();
 
+    TransformHierarchy* getTransformHierarchy() const;
+
     bool setMainCameraEntity(const Entity& entity);
 
     const Entity& getMainCameraEntity() const;
@@ -72,6 +75,7 @@ private:
 private:
     entt::registry m_registry;
     EventDispatcher* m_eventDispatcher;
+    TransformHierarchy* m_transformHierarchy;
     //std::unordered_map<entt::entity, std::vector<Entity*>> m_entityRefTracker;
     std::unordered_map<std::string, entt::entity> m_entityNameMap;
 
@@ -1,12 +1,15 @@
 #include "core/engine/scene/Transform.h"
 #include "core/application/Engine.h"
 #include "core/engine/renderer/SceneRenderer.h"
+#include "core/engine/scene/Scene.h"
+#include "core/engine/scene/TransformHierarchy.h"
 
 
 Transform::Transform():
         m_translation(0.0),
         m_rotation(1.0),
         m_scale(1.0) {
+    change();
 }
 
 Transform::Transform(const glm::mat4& transformationMatrix) {
@@ -349,6 +352,25 @@ Transform& Transform::operator=(const Transform& other) {
     return *this;
 }
 
+Transform& Transform::operator=(Transform&& other) noexcept {
+    // Assigning to a transform keeps its own entity index and hierarchy node, so it is still tracked.
+    m_translation = std::exchange(other.m_translation, glm::dvec3(0.0));
+    m_rotation = std::exchange(other.m_rotation, glm::dmat3(1.0));
+    m_scale = std::exchange(other.m_scale, glm::dvec3(1.0));
+    change();
+    return *this;
+}
+
+void swap(Transform& lhs, Transform& rhs) noexcept {
+    // The registry swaps components when it sorts or regroups them. Each binding stays with its entity's values.
+    std::swap(lhs.m_translation, rhs.m_translation);
+    std::swap(lhs.m_rotation, rhs.m_rotation);
+    std::swap(lhs.m_scale, rhs.m_scale);
+    std::swap(lhs.m_lastChangedTimestamp, rhs.m_lastChangedTimestamp);
+    std::swap(lhs.m_entityIndex, rhs.m_entityIndex);
+    std::swap(lhs.m_hierarchyNode, rhs.m_hierarchyNode);
+}
+
 bool Transform::equalsTranslation(const Transform& other, double epsilon) const {
     if (!glm::epsilonEqual(m_translation.x, other.m_translation.x, epsilon)) return false;
     if (!glm::epsilonEqual(m_translation.y, other.m_translation.y, epsilon)) return false;
@@ -521,13 +543,34 @@ Transform::operator glm::dmat4() const {
 
 void Transform::change() {
     m_lastChangedTimestamp = std::chrono::high_resolution_clock::now().time_since_epoch().count();
-//    Engine::instance()->getSceneRenderer()->notifyTransformChanged(m_entityIndex);
+
+    // Only transforms of render entities are indexed by the SceneRenderer.
+    if (m_entityIndex != EntityChangeTracker::INVALID_INDEX)
+        Engine::instance()->getSceneRenderer()->notifyTransformChanged(m_entityIndex);
+
+    // Only transforms of entities within an EntityHierarchy tree have a node.
+    if (m_hierarchyNode != UINT32_MAX)
+        Engine::scene()->getTransformHierarchy()->notifyTransformChanged(m_hierarchyNode);
+}
+
+void Transform::onDestroyed(entt::registry& registry, entt::entity entity) {
+    // The registry fills the removed slot by move assigning the last transform into it. Assignment keeps the bindings
+    // of the destination, so the removed transform takes over the bindings of the one about to replace it.
+    const auto& storage = registry.storage<Transform>();
+    entt::entity last = storage.data()[storage.size() - 1];
+    if (last == entity)
+        return;
+
+    Transform& removed = registry.get<Transform>(entity);
+    const Transform& replacement = registry.get<Transform>(last);
+    removed.m_entityIndex = replacement.m_entityIndex;
+    removed.m_hierarchyNode = replacement.m_hierarchyNode;
 }
 
-//void Transform::reindex(Transform& transform, const EntityChangeTracker::entity_index& newEntityIndex) {
-//    if (newEntityIndex == transform.m_entityIndex)
-//        return;
-////    Engine::renderer()->notifyTransformChanged(transform.m_entityIndex);
-////    Engine::renderer()->notifyTransformChanged(newEntityIndex);
-//    transform.m_entityIndex = newEntityIndex;
-//}
+void Transform::reindex(Transform& transform, const EntityChangeTracker::entity_index& newEntityIndex) {
+    if (newEntityIndex == transform.m_entityIndex)
+        return;
+    transform.m_entityIndex = newEntityIndex;
+    if (newEntityIndex != EntityChangeTracker::INVALID_INDEX)
+        Engine::instance()->getSceneRenderer()->notifyTransformChanged(newEntityIndex);
+}
@@ -3,10 +3,16 @@
 #define WORLDENGINE_TRANSFORM_H
 
 #include "core/core.h"
-//#include "core/util/EntityChangeTracker.h"
+#include "core/util/EntityChangeTracker.h"
+#include <entt/entt.hpp>
 
+// The entity index and hierarchy node bind the transform to the entity which owns it, so that changes are reported to
+// the SceneRenderer and TransformHierarchy. Constructing or assigning a transform never transfers them, only swap does,
+// which is how the registry reorders components.
 class Transform {
+    friend class Scene;
     friend class SceneRenderer;
+    friend class TransformHierarchy;
 public:
     Transform();
 
@@ -87,6 +93,9 @@ public:
 
     Transform& operator=(const glm::dmat4& other);
     Transform& operator=(const Transform& other);
+    Transform& operator=(Transform&& other) noexcept;
+
+    friend void swap(Transform& lhs, Transform& rhs) noexcept;
 
     bool equalsTranslation(const Transform& other, double epsilon) const;
     bool equalsRotation(const Transform& other, double epsilon) const;
@@ -119,7 +128,10 @@ public:
     operator glm::dmat4() const;
 
 private:
-//    static void reindex(Transform& transform, const EntityChangeTracker::entity_index& newEntityIndex);
+    static void reindex(Transform& transform, const EntityChangeTracker::entity_index& newEntityIndex);
+
+    // Registry hook, called before the transform is removed.
+    static void onDestroyed(entt::registry& registry, entt::entity entity);
 
     void change();
 
@@ -128,7 +140,8 @@ private:
     glm::mat3 m_rotation;
     glm::dvec3 m_scale;
     uint64_t m_lastChangedTimestamp;
-//    EntityChangeTracker::entity_index m_entityIndex = EntityChangeTracker::INVALID_INDEX;
+    EntityChangeTracker::entity_index m_entityIndex = EntityChangeTracker::INVALID_INDEX;
+    uint32_t m_hierarchyNode = UINT32_MAX; // Index of the entity's node within the scene's TransformHierarchy
 };
 
 
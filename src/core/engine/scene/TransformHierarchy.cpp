@@ -0,0 +1,237 @@
+#include "core/engine/scene/TransformHierarchy.h"
+#include "core/engine/scene/EntityHierarchy.h"
+#include "core/engine/scene/Scene.h"
+#include "core/engine/scene/Transform.h"
+#include "core/thread/ThreadUtils.h"
+#include "core/util/Profiler.h"
+
+
+TransformHierarchy::TransformHierarchy(Scene* scene):
+        m_scene(scene),
+        m_structureChanged(true) {
+    m_scene->registry()->on_construct<Transform>().connect<&TransformHierarchy::onTransformConstructed>(this);
+    m_scene->registry()->on_destroy<Transform>().connect<&TransformHierarchy::onTransformDestroyed>(this);
+}
+
+TransformHierarchy::~TransformHierarchy() {
+    m_scene->registry()->on_construct<Transform>().disconnect<&TransformHierarchy::onTransformConstructed>(this);
+    m_scene->registry()->on_destroy<Transform>().disconnect<&TransformHierarchy::onTransformDestroyed>(this);
+}
+
+void TransformHierarchy::update() {
+    PROFILE_SCOPE("TransformHierarchy::update")
+
+    m_changedEntities.clear();
+
+    if (m_structureChanged)
+        rebuild();
+
+    if (m_dirtyNodes.empty())
+        return;
+
+    // Only the topmost dirty nodes are walked. Any other dirty node is beneath one of them, and is updated along with
+    // its subtree.
+    m_updateLevel.clear();
+
+    for (node_index index : m_dirtyNodes) {
+        node_index parent = m_nodes[index].parent;
+        while (parent != INVALID_NODE && !m_nodesDirty[parent])
+            parent = m_nodes[parent].parent;
+
+        if (parent == INVALID_NODE)
+            m_updateLevel.emplace_back(index);
+    }
+
+    // The subtrees are walked one depth level at a time. Each level only reads the world matrices of the level before
+    // it, or of clean ancestors, so the nodes within a level can be updated in any order. Small levels are not worth
+    // the cost of dispatching tasks.
+    constexpr size_t nodesPerTask = 1024;
+
+    while (!m_updateLevel.empty()) {
+        PROFILE_REGION("Update level")
+
+        size_t nodeCount = m_updateLevel.size();
+        size_t taskCount = glm::min(INT_DIV_CEIL(nodeCount, nodesPerTask), ThreadUtils::getThreadCount());
+
+        if (taskCount <= 1) {
+            updateNodes(m_updateLevel.data(), nodeCount);
+        } else {
+            auto futures = ThreadUtils::parallel_range(nodeCount, nodesPerTask, taskCount, [this](size_t rangeStart, size_t rangeEnd) {
+                updateNodes(m_updateLevel.data() + rangeStart, rangeEnd - rangeStart);
+            });
+            ThreadUtils::wait(futures);
+        }
+
+        m_nextUpdateLevel.clear();
+
+        for (node_index index : m_updateLevel) {
+            const Node& node = m_nodes[index];
+            m_changedEntities.emplace_back(node.entity);
+
+            for (node_index child = node.firstChild; child < node.firstChild + node.childCount; ++child)
+                m_nextUpdateLevel.emplace_back(child);
+        }
+
+        std::swap(m_updateLevel, m_nextUpdateLevel);
+    }
+
+    for (node_index index : m_dirtyNodes)
+        m_nodesDirty[index] = false;
+    m_dirtyNodes.clear();
+}
+
+const glm::dmat4* TransformHierarchy::getWorldMatrix(entt::entity entity) const {
+    const EntityHierarchy* hierarchy = m_scene->registry()->try_get<EntityHierarchy>(entity);
+    if (hierarchy == nullptr || hierarchy->m_transformNode == INVALID_NODE)
+        return nullptr;
+
+    assert(hierarchy->m_transformNode < m_worldMatrices.size());
+    return &m_worldMatrices[hierarchy->m_transformNode];
+}
+
+const std::vector<entt::entity>& TransformHierarchy::getChangedEntities() const {
+    return m_changedEntities;
+}
+
+size_t TransformHierarchy::getNodeCount() const {
+    return m_nodes.size();
+}
+
+size_t TransformHierarchy::getDepth() const {
+    return m_levelOffsets.empty() ? 0 : m_levelOffsets.size() - 1;
+}
+
+void TransformHierarchy::notifyTransformChanged(node_index node) {
+    // Every node is updated after a rebuild, and the node indices are about to change anyway.
+    if (m_structureChanged || node >= m_nodes.size() || m_nodesDirty[node])
+        return;
+
+    m_nodesDirty[node] = true;
+    m_dirtyNodes.emplace_back(node);
+}
+
+void TransformHierarchy::invalidate() {
+    m_structureChanged = true;
+}
+
+void TransformHierarchy::rebuild() {
+    PROFILE_SCOPE("TransformHierarchy::rebuild")
+
+    entt::registry& registry = *m_scene->registry();
+
+    // Entities which are no longer part of a tree fall back to their local transform, so they are reported as changed.
+    for (const Node& node : m_nodes) {
+        if (!registry.valid(node.entity))
+            continue;
+
+        EntityHierarchy* hierarchy = registry.try_get<EntityHierarchy>(node.entity);
+        if (hierarchy != nullptr)
+            hierarchy->m_transformNode = INVALID_NODE;
+
+        Transform* transform = registry.try_get<Transform>(node.entity);
+        if (transform != nullptr)
+            transform->m_hierarchyNode = INVALID_NODE;
+
+        m_changedEntities.emplace_back(node.entity);
+    }
+
+    m_nodes.clear();
+    m_levelOffsets.clear();
+
+    const auto& hierarchyEntities = registry.view<EntityHierarchy>();
+
+    for (auto id : hierarchyEntities) {
+        const EntityHierarchy& hierarchy = hierarchyEntities.get<EntityHierarchy>(id);
+        if (hierarchy.m_parent == nullptr && hierarchy.m_childCount > 0)
+            m_nodes.emplace_back(Node{id, INVALID_NODE, INVALID_NODE, 0});
+    }
+
+    size_t rootCount = m_nodes.size();
+
+    // Breadth-first traversal of all trees at once. Children are appended after the whole of the current level, so
+    // the nodes end up sorted by depth, and the children of each node are adjacent.
+    size_t levelEnd = 0;
+
+    for (node_index index = 0; index < m_nodes.size(); ++index) {
+        if (index == levelEnd) {
+            m_levelOffsets.emplace_back(index);
+            levelEnd = m_nodes.size();
+        }
+
+        entt::entity entity = m_nodes[index].entity;
+
+        EntityHierarchy& hierarchy = registry.get<EntityHierarchy>(entity);
+        hierarchy.m_transformNode = index;
+
+        Transform* transform = registry.try_get<Transform>(entity);
+        if (transform != nullptr)
+            transform->m_hierarchyNode = index;
+
+        m_nodes[index].firstChild = (node_index)m_nodes.size();
+
+        for (Entity child = hierarchy.m_firstChild; child != nullptr; child = registry.get<EntityHierarchy>((entt::entity)child).m_nextSibling)
+            m_nodes.emplace_back(Node{(entt::entity)child, index, INVALID_NODE, 0});
+
+        m_nodes[index].childCount = (uint32_t)(m_nodes.size() - m_nodes[index].firstChild);
+    }
+
+    m_levelOffsets.emplace_back(m_nodes.size());
+
+    m_worldMatrices.resize(m_nodes.size());
+
+    // Every tree is walked on the first update after a rebuild.
+    m_nodesDirty.clear();
+    m_nodesDirty.resize(m_nodes.size(), false);
+    m_dirtyNodes.clear();
+
+    for (node_index index = 0; index < rootCount; ++index) {
+        m_nodesDirty[index] = true;
+        m_dirtyNodes.emplace_back(index);
+    }
+
+    m_structureChanged = false;
+}
+
+void TransformHierarchy::onTransformConstructed(entt::registry& registry, entt::entity entity) {
+    const EntityHierarchy* hierarchy = registry.try_get<EntityHierarchy>(entity);
+    if (hierarchy == nullptr || hierarchy->m_transformNode == INVALID_NODE || m_structureChanged)
+        return;
+
+    registry.get<Transform>(entity).m_hierarchyNode = hierarchy->m_transformNode;
+    notifyTransformChanged(hierarchy->m_transformNode);
+}
+
+void TransformHierarchy::onTransformDestroyed(entt::registry& registry, entt::entity entity) {
+    // The node falls back to its parent's world matrix.
+    const EntityHierarchy* hierarchy = registry.try_get<EntityHierarchy>(entity);
+    if (hierarchy != nullptr && hierarchy->m_transformNode != INVALID_NODE)
+        notifyTransformChanged(hierarchy->m_transformNode);
+}
+
+void TransformHierarchy::updateNodes(const node_index* nodes, size_t count) {
+    PROFILE_SCOPE("TransformHierarchy::updateNodes")
+
+    // Only const access to the registry is thread safe.
+    const entt::registry& registry = *m_scene->registry();
+
+    glm::dmat4 localMatrix;
+
+    for (size_t i = 0; i < count; ++i) {
+        node_index index = nodes[i];
+        const Node& node = m_nodes[index];
+        const Transform* transform = registry.try_get<Transform>(node.entity);
+
+        // Entities without a Transform inherit their parent's world matrix unchanged.
+        if (transform != nullptr) {
+            Transform::fillMatrixd(*transform, localMatrix);
+        } else {
+            localMatrix = glm::dmat4(1.0);
+        }
+
+        if (node.parent != INVALID_NODE) {
+            m_worldMatrices[index] = m_worldMatrices[node.parent] * localMatrix;
+        } else {
+            m_worldMatrices[index] = localMatrix;
+        }
+    }
+}
@@ -0,0 +1,79 @@
+
+#ifndef WORLDENGINE_TRANSFORMHIERARCHY_H
+#define WORLDENGINE_TRANSFORMHIERARCHY_H
+
+#include "core/core.h"
+#include <entt/entt.hpp>
+
+class Scene;
+
+// Composes the transforms of EntityHierarchy trees into world space matrices. Every tree with at least one child is
+// flattened in breadth-first order, so each depth level is contiguous and the children of a node are adjacent.
+// Transforms of hierarchy entities report their changes here, and an update only walks the subtrees beneath the
+// changed nodes, one depth level at a time. The nodes within a level are independent of each other, so large levels
+// are split across the thread pool. Entities without a parent or children are not part of the hierarchy, and their
+// world matrix is their local matrix.
+class TransformHierarchy {
+    friend class EntityHierarchy;
+public:
+    typedef uint32_t node_index;
+
+    static constexpr node_index INVALID_NODE = UINT32_MAX;
+
+private:
+    struct Node {
+        entt::entity entity;
+        node_index parent;
+        node_index firstChild;
+        uint32_t childCount;
+    };
+
+public:
+    explicit TransformHierarchy(Scene* scene);
+
+    ~TransformHierarchy();
+
+    NO_COPY(TransformHierarchy);
+    NO_MOVE(TransformHierarchy);
+
+    void update();
+
+    // Returns the world matrix of the entity, or nullptr if the entity is not part of a hierarchy.
+    const glm::dmat4* getWorldMatrix(entt::entity entity) const;
+
+    // Entities whose world matrix changed, or which were added to or removed from the hierarchy, during the last update.
+    const std::vector<entt::entity>& getChangedEntities() const;
+
+    size_t getNodeCount() const;
+
+    size_t getDepth() const;
+
+    // Called by the Transform of a hierarchy entity whenever it changes. Not thread safe.
+    void notifyTransformChanged(node_index node);
+
+private:
+    void invalidate();
+
+    void rebuild();
+
+    void onTransformConstructed(entt::registry& registry, entt::entity entity);
+
+    void onTransformDestroyed(entt::registry& registry, entt::entity entity);
+
+    void updateNodes(const node_index* nodes, size_t count);
+
+private:
+    Scene* m_scene;
+    std::vector<Node> m_nodes;
+    std::vector<glm::dmat4> m_worldMatrices;
+    std::vector<uint8_t> m_nodesDirty;
+    std::vector<node_index> m_dirtyNodes;
+    std::vector<node_index> m_updateLevel;
+    std::vector<node_index> m_nextUpdateLevel;
+    std::vector<size_t> m_levelOffsets;
+    std::vector<entt::entity> m_changedEntities;
+    bool m_structureChanged;
+};
+
+
+#endif //WORLDENGINE_TRANSFORMHIERARCHY_H
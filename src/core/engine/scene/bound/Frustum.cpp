@@ -6,6 +6,142 @@
 #include "core/engine/renderer/RenderCamera.h"
 #include "core/application/Engine.h"
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FRUSTUM_SIMD_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRUSTUM_SIMD_WIDTH 4
+#else
+#define FRUSTUM_SIMD_WIDTH 1
+#endif
+
+
+struct FrustumBatchPlanes {
+    float normalX[Frustum::NumPlanes];
+    float normalY[Frustum::NumPlanes];
+    float normalZ[Frustum::NumPlanes];
+    float absNormalX[Frustum::NumPlanes];
+    float absNormalY[Frustum::NumPlanes];
+    float absNormalZ[Frustum::NumPlanes];
+    float offset[Frustum::NumPlanes];
+};
+
+#if FRUSTUM_SIMD_WIDTH == 8
+typedef __m256 simd_float;
+static inline simd_float simd_load(const float* ptr) { return _mm256_loadu_ps(ptr); }
+static inline simd_float simd_set(float value) { return _mm256_set1_ps(value); }
+static inline simd_float simd_add(simd_float a, simd_float b) { return _mm256_add_ps(a, b); }
+static inline simd_float simd_sub(simd_float a, simd_float b) { return _mm256_sub_ps(a, b); }
+static inline simd_float simd_mul(simd_float a, simd_float b) { return _mm256_mul_ps(a, b); }
+static inline simd_float simd_or(simd_float a, simd_float b) { return _mm256_or_ps(a, b); }
+static inline simd_float simd_and(simd_float a, simd_float b) { return _mm256_and_ps(a, b); }
+static inline simd_float simd_less_than_zero(simd_float a) { return _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_LT_OQ); }
+static inline simd_float simd_greater_equal_zero(simd_float a) { return _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GE_OQ); }
+static inline simd_float simd_false() { return _mm256_setzero_ps(); }
+static inline simd_float simd_true() { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+static inline uint32_t simd_mask(simd_float a) { return (uint32_t)_mm256_movemask_ps(a); }
+#elif FRUSTUM_SIMD_WIDTH == 4
+typedef __m128 simd_float;
+static inline simd_float simd_load(const float* ptr) { return _mm_loadu_ps(ptr); }
+static inline simd_float simd_set(float value) { return _mm_set1_ps(value); }
+static inline simd_float simd_add(simd_float a, simd_float b) { return _mm_add_ps(a, b); }
+static inline simd_float simd_sub(simd_float a, simd_float b) { return _mm_sub_ps(a, b); }
+static inline simd_float simd_mul(simd_float a, simd_float b) { return _mm_mul_ps(a, b); }
+static inline simd_float simd_or(simd_float a, simd_float b) { return _mm_or_ps(a, b); }
+static inline simd_float simd_and(simd_float a, simd_float b) { return _mm_and_ps(a, b); }
+static inline simd_float simd_less_than_zero(simd_float a) { return _mm_cmplt_ps(a, _mm_setzero_ps()); }
+static inline simd_float simd_greater_equal_zero(simd_float a) { return _mm_cmpge_ps(a, _mm_setzero_ps()); }
+static inline simd_float simd_false() { return _mm_setzero_ps(); }
+static inline simd_float simd_true() { return _mm_castsi128_ps(_mm_set1_epi32(-1)); }
+static inline uint32_t simd_mask(simd_float a) { return (uint32_t)_mm_movemask_ps(a); }
+#endif
+
+static FrustumBatchPlanes getBatchPlanes(const Frustum& frustum) {
+    FrustumBatchPlanes planes{};
+    for (size_t i = 0; i < Frustum::NumPlanes; ++i) {
+        const Plane& plane = frustum.getPlane(i);
+        planes.normalX[i] = (float)plane.normal.x;
+        planes.normalY[i] = (float)plane.normal.y;
+        planes.normalZ[i] = (float)plane.normal.z;
+        planes.absNormalX[i] = glm::abs(planes.normalX[i]);
+        planes.absNormalY[i] = glm::abs(planes.normalY[i]);
+        planes.absNormalZ[i] = glm::abs(planes.normalZ[i]);
+        planes.offset[i] = (float)plane.offset;
+    }
+    return planes;
+}
+
+// For spheres, halfExtentX holds the radius and the other extents are unused. A volume is not visible if its most
+// positive point along any plane normal is behind that plane, and fully visible if its most negative point is in
+// front of all planes.
+template<bool Sphere>
+static void testBatch(const FrustumBatchPlanes& planes, const float* centerX, const float* centerY, const float* centerZ, const float* halfExtentX, const float* halfExtentY, const float* halfExtentZ, size_t count, uint8_t* outVisibility) {
+    size_t i = 0;
+
+#if FRUSTUM_SIMD_WIDTH > 1
+    for (; i + FRUSTUM_SIMD_WIDTH <= count; i += FRUSTUM_SIMD_WIDTH) {
+        simd_float cx = simd_load(&centerX[i]);
+        simd_float cy = simd_load(&centerY[i]);
+        simd_float cz = simd_load(&centerZ[i]);
+        simd_float ex = simd_load(&halfExtentX[i]);
+        simd_float ey, ez;
+        if constexpr (!Sphere) {
+            ey = simd_load(&halfExtentY[i]);
+            ez = simd_load(&halfExtentZ[i]);
+        }
+
+        simd_float outside = simd_false();
+        simd_float inside = simd_true();
+
+        for (size_t j = 0; j < Frustum::NumPlanes; ++j) {
+            simd_float distance = simd_add(simd_add(simd_mul(simd_set(planes.normalX[j]), cx), simd_mul(simd_set(planes.normalY[j]), cy)), simd_add(simd_mul(simd_set(planes.normalZ[j]), cz), simd_set(planes.offset[j])));
+            simd_float extent;
+            if constexpr (Sphere) {
+                extent = ex;
+            } else {
+                extent = simd_add(simd_add(simd_mul(simd_set(planes.absNormalX[j]), ex), simd_mul(simd_set(planes.absNormalY[j]), ey)), simd_mul(simd_set(planes.absNormalZ[j]), ez));
+            }
+            outside = simd_or(outside, simd_less_than_zero(simd_add(distance, extent)));
+            inside = simd_and(inside, simd_greater_equal_zero(simd_sub(distance, extent)));
+        }
+
+        uint32_t outsideMask = simd_mask(outside);
+        uint32_t insideMask = simd_mask(inside);
+
+        for (size_t k = 0; k < FRUSTUM_SIMD_WIDTH; ++k) {
+            if (outsideMask & (1u << k)) {
+                outVisibility[i + k] = Visibility_NotVisible;
+            } else if (insideMask & (1u << k)) {
+                outVisibility[i + k] = Visibility_FullyVisible;
+            } else {
+                outVisibility[i + k] = Visibility_PartiallyVisible;
+            }
+        }
+    }
+#endif
+
+    for (; i < count; ++i) {
+        bool outside = false;
+        bool inside = true;
+
+        for (size_t j = 0; j < Frustum::NumPlanes; ++j) {
+            float distance = planes.normalX[j] * centerX[i] + planes.normalY[j] * centerY[i] + planes.normalZ[j] * centerZ[i] + planes.offset[j];
+            float extent;
+            if constexpr (Sphere) {
+                extent = halfExtentX[i];
+            } else {
+                extent = planes.absNormalX[j] * halfExtentX[i] + planes.absNormalY[j] * halfExtentY[i] + planes.absNormalZ[j] * halfExtentZ[i];
+            }
+            outside |= distance + extent < 0.0F;
+            inside &= distance - extent >= 0.0F;
+        }
+
+        outVisibility[i] = outside ? Visibility_NotVisible : inside ? Visibility_FullyVisible : Visibility_PartiallyVisible;
+    }
+}
+
+
 Frustum::Frustum() :
         Frustum(glm::dvec3(0.0), glm::dmat4(1.0)) {
 }
@@ -318,6 +454,16 @@ bool Frustum::contains(const glm::dvec3& point) const {
     return true; // Point is on the positive side of all 6 frustum planes.
 }
 
+void Frustum::testSpheres(const float* centerX, const float* centerY, const float* centerZ, const float* radius, size_t count, uint8_t* outVisibility) const {
+    FrustumBatchPlanes planes = getBatchPlanes(*this);
+    testBatch<true>(planes, centerX, centerY, centerZ, radius, nullptr, nullptr, count, outVisibility);
+}
+
+void Frustum::testAABBs(const float* centerX, const float* centerY, const float* centerZ, const float* halfExtentX, const float* halfExtentY, const float* halfExtentZ, size_t count, uint8_t* outVisibility) const {
+    FrustumBatchPlanes planes = getBatchPlanes(*this);
+    testBatch<false>(planes, centerX, centerY, centerZ, halfExtentX, halfExtentY, halfExtentZ, count, outVisibility);
+}
+
 bool Frustum::isOrtho() const {
     return Plane::isParallel(m_planes[Plane_Top], m_planes[Plane_Bottom]);
 }
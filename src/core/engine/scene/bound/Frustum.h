@@ -78,6 +78,13 @@ public:
 
     bool contains(const glm::dvec3& point) const;
 
+    // Batched visibility tests for culling many volumes at once. Each component of the volumes is given as a separate
+    // array, and the Visibility of each volume is written to outVisibility. 4 or 8 volumes are tested per iteration
+    // when SSE or AVX is available. These test against the frustum planes only, in single precision.
+    void testSpheres(const float* centerX, const float* centerY, const float* centerZ, const float* radius, size_t count, uint8_t* outVisibility) const;
+
+    void testAABBs(const float* centerX, const float* centerY, const float* centerZ, const float* halfExtentX, const float* halfExtentY, const float* halfExtentZ, size_t count, uint8_t* outVisibility) const;
+
     static Frustum transform(const Frustum& frustum, const glm::dmat4& matrix);
 
     bool isOrtho() const;
@@ -0,0 +1,232 @@
+#include "core/engine/scene/terrain/HeightRangePyramid.h"
+#include "core/graphics/ImageData.h"
+#include "core/thread/ThreadUtils.h"
+#include "core/util/Logger.h"
+#include "core/util/Profiler.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HEIGHT_RANGE_PYRAMID_SSE 1
+#else
+#define HEIGHT_RANGE_PYRAMID_SSE 0
+#endif
+
+
+// Rows of fewer texels than this are not worth splitting across the thread pool.
+static constexpr size_t texelsPerTask = 64 * 1024;
+
+// Reduces two source rows to one destination row, where each destination texel is the range of the 2x2 source texels
+// above it. If the source width is odd, the last destination texel only covers the last source column.
+static void reduceRows(const float* srcMin0, const float* srcMin1, const float* srcMax0, const float* srcMax1, uint32_t srcWidth, float* dstMin, float* dstMax, uint32_t dstWidth) {
+    uint32_t x = 0;
+
+#if HEIGHT_RANGE_PYRAMID_SSE
+    // Four destination texels from eight source texels per row. The vertical reduction is done first, then even and
+    // odd columns are separated with a shuffle and reduced horizontally.
+    for (; x + 4 <= dstWidth && x * 2 + 8 <= srcWidth; x += 4) {
+        __m128 min0 = _mm_min_ps(_mm_loadu_ps(&srcMin0[x * 2 + 0]), _mm_loadu_ps(&srcMin1[x * 2 + 0]));
+        __m128 min1 = _mm_min_ps(_mm_loadu_ps(&srcMin0[x * 2 + 4]), _mm_loadu_ps(&srcMin1[x * 2 + 4]));
+        __m128 max0 = _mm_max_ps(_mm_loadu_ps(&srcMax0[x * 2 + 0]), _mm_loadu_ps(&srcMax1[x * 2 + 0]));
+        __m128 max1 = _mm_max_ps(_mm_loadu_ps(&srcMax0[x * 2 + 4]), _mm_loadu_ps(&srcMax1[x * 2 + 4]));
+
+        __m128 minEven = _mm_shuffle_ps(min0, min1, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 minOdd = _mm_shuffle_ps(min0, min1, _MM_SHUFFLE(3, 1, 3, 1));
+        __m128 maxEven = _mm_shuffle_ps(max0, max1, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 maxOdd = _mm_shuffle_ps(max0, max1, _MM_SHUFFLE(3, 1, 3, 1));
+
+        _mm_storeu_ps(&dstMin[x], _mm_min_ps(minEven, minOdd));
+        _mm_storeu_ps(&dstMax[x], _mm_max_ps(maxEven, maxOdd));
+    }
+#endif
+
+    for (; x < dstWidth; ++x) {
+        uint32_t x0 = x * 2;
+        uint32_t x1 = glm::min(x0 + 1, srcWidth - 1);
+        dstMin[x] = glm::min(glm::min(srcMin0[x0], srcMin0[x1]), glm::min(srcMin1[x0], srcMin1[x1]));
+        dstMax[x] = glm::max(glm::max(srcMax0[x0], srcMax0[x1]), glm::max(srcMax1[x0], srcMax1[x1]));
+    }
+}
+
+HeightRangePyramid::HeightRangePyramid():
+        m_heightmapResolution(0, 0) {
+}
+
+HeightRangePyramid::~HeightRangePyramid() = default;
+
+bool HeightRangePyramid::build(const ImageData* heightmapImageData, size_t channelIndex) {
+    PROFILE_SCOPE("HeightRangePyramid::build")
+
+    clear();
+
+    if (heightmapImageData == nullptr || heightmapImageData->getWidth() == 0 || heightmapImageData->getHeight() == 0) {
+        LOG_ERROR("Unable to build HeightRangePyramid: Heightmap is empty");
+        return false;
+    }
+
+    if (heightmapImageData->getPixelFormat() != ImagePixelFormat::Float32 && heightmapImageData->getPixelFormat() != ImagePixelFormat::Float16) {
+        LOG_ERROR("Unable to build HeightRangePyramid: Heightmap must be a Float32 or Float16 image");
+        return false;
+    }
+
+    if (channelIndex >= (size_t)ImageData::getChannels(heightmapImageData->getPixelLayout())) {
+        LOG_ERROR("Unable to build HeightRangePyramid: Heightmap does not have channel %zu", channelIndex);
+        return false;
+    }
+
+    m_heightmapResolution = glm::uvec2(heightmapImageData->getWidth(), heightmapImageData->getHeight());
+
+    glm::uvec2 resolution = m_heightmapResolution;
+    do {
+        resolution = (resolution + glm::uvec2(1)) / 2u;
+        addLevel(resolution);
+    } while (resolution.x > 1 || resolution.y > 1);
+
+    m_minHeights.resize(m_levels.back().offset + 1);
+    m_maxHeights.resize(m_levels.back().offset + 1);
+
+    // Rows within a level are independent. Each level only depends on the one below it.
+    for (uint32_t level = 0; level < (uint32_t)m_levels.size(); ++level) {
+        const glm::uvec2& levelResolution = m_levels[level].resolution;
+
+        size_t texelCount = (size_t)levelResolution.x * (size_t)levelResolution.y * (level == 0 ? 4 : 1);
+        size_t taskCount = glm::min(INT_DIV_CEIL(texelCount, texelsPerTask), ThreadUtils::getThreadCount());
+
+        auto buildRows = [this, level, heightmapImageData, channelIndex](size_t firstRow, size_t lastRow) {
+            if (level == 0) {
+                buildBaseLevel(heightmapImageData, channelIndex, (uint32_t)firstRow, (uint32_t)lastRow);
+            } else {
+                buildLevel(level, (uint32_t)firstRow, (uint32_t)lastRow);
+            }
+        };
+
+        if (taskCount <= 1) {
+            buildRows(0, levelResolution.y);
+        } else {
+            auto futures = ThreadUtils::parallel_range(levelResolution.y, 1, taskCount, buildRows);
+            ThreadUtils::wait(futures);
+        }
+    }
+
+    return true;
+}
+
+void HeightRangePyramid::clear() {
+    m_levels.clear();
+    m_minHeights.clear();
+    m_maxHeights.clear();
+    m_heightmapResolution = glm::uvec2(0, 0);
+}
+
+bool HeightRangePyramid::empty() const {
+    return m_levels.empty();
+}
+
+bool HeightRangePyramid::getHeightRange(const glm::uvec2& minCoord, const glm::uvec2& maxCoord, float& outMinHeight, float& outMaxHeight) const {
+    if (m_levels.empty())
+        return false;
+
+    glm::uvec2 lo = glm::min(minCoord, m_heightmapResolution - glm::uvec2(1));
+    glm::uvec2 hi = glm::min(maxCoord, m_heightmapResolution);
+    if (hi.x <= lo.x || hi.y <= lo.y)
+        return false;
+
+    hi -= glm::uvec2(1); // Inclusive
+
+    // Find the first level where the rectangle touches at most two texels on each axis.
+    uint32_t shift = 1;
+    while (((hi.x >> shift) - (lo.x >> shift)) > 1 || ((hi.y >> shift) - (lo.y >> shift)) > 1)
+        ++shift;
+
+    uint32_t level = glm::min(shift - 1, (uint32_t)m_levels.size() - 1);
+    shift = level + 1;
+
+    const Level& levelInfo = m_levels[level];
+    lo >>= shift;
+    hi = glm::min(hi >> shift, levelInfo.resolution - glm::uvec2(1));
+
+    float minHeight = +INFINITY;
+    float maxHeight = -INFINITY;
+
+    for (uint32_t y = lo.y; y <= hi.y; ++y) {
+        for (uint32_t x = lo.x; x <= hi.x; ++x) {
+            size_t index = levelInfo.offset + (size_t)y * levelInfo.resolution.x + x;
+            minHeight = glm::min(minHeight, m_minHeights[index]);
+            maxHeight = glm::max(maxHeight, m_maxHeights[index]);
+        }
+    }
+
+    outMinHeight = minHeight;
+    outMaxHeight = maxHeight;
+    return true;
+}
+
+float HeightRangePyramid::getMinHeight() const {
+    return m_levels.empty() ? 0.0F : m_minHeights[m_levels.back().offset];
+}
+
+float HeightRangePyramid::getMaxHeight() const {
+    return m_levels.empty() ? 0.0F : m_maxHeights[m_levels.back().offset];
+}
+
+uint32_t HeightRangePyramid::getLevelCount() const {
+    return (uint32_t)m_levels.size();
+}
+
+const glm::uvec2& HeightRangePyramid::getLevelResolution(uint32_t level) const {
+    assert(level < m_levels.size());
+    return m_levels[level].resolution;
+}
+
+const glm::uvec2& HeightRangePyramid::getHeightmapResolution() const {
+    return m_heightmapResolution;
+}
+
+void HeightRangePyramid::buildBaseLevel(const ImageData* heightmapImageData, size_t channelIndex, uint32_t firstRow, uint32_t lastRow) {
+    PROFILE_SCOPE("HeightRangePyramid::buildBaseLevel")
+
+    const Level& dstLevel = m_levels[0];
+    const uint32_t srcWidth = m_heightmapResolution.x;
+    const uint32_t srcHeight = m_heightmapResolution.y;
+
+    std::vector<float> row0(srcWidth);
+    std::vector<float> row1(srcWidth);
+
+    for (uint32_t y = firstRow; y < lastRow; ++y) {
+        uint32_t y0 = y * 2;
+        uint32_t y1 = glm::min(y0 + 1, srcHeight - 1);
+
+        heightmapImageData->readRowf(y0, channelIndex, row0.data());
+        heightmapImageData->readRowf(y1, channelIndex, row1.data());
+
+        size_t dstOffset = dstLevel.offset + (size_t)y * dstLevel.resolution.x;
+        reduceRows(row0.data(), row1.data(), row0.data(), row1.data(), srcWidth, &m_minHeights[dstOffset], &m_maxHeights[dstOffset], dstLevel.resolution.x);
+    }
+}
+
+void HeightRangePyramid::buildLevel(uint32_t level, uint32_t firstRow, uint32_t lastRow) {
+    PROFILE_SCOPE("HeightRangePyramid::buildLevel")
+    assert(level > 0);
+
+    const Level& srcLevel = m_levels[level - 1];
+    const Level& dstLevel = m_levels[level];
+
+    for (uint32_t y = firstRow; y < lastRow; ++y) {
+        uint32_t y0 = y * 2;
+        uint32_t y1 = glm::min(y0 + 1, srcLevel.resolution.y - 1);
+
+        size_t srcOffset0 = srcLevel.offset + (size_t)y0 * srcLevel.resolution.x;
+        size_t srcOffset1 = srcLevel.offset + (size_t)y1 * srcLevel.resolution.x;
+        size_t dstOffset = dstLevel.offset + (size_t)y * dstLevel.resolution.x;
+
+        reduceRows(&m_minHeights[srcOffset0], &m_minHeights[srcOffset1], &m_maxHeights[srcOffset0], &m_maxHeights[srcOffset1], srcLevel.resolution.x,
+                   &m_minHeights[dstOffset], &m_maxHeights[dstOffset], dstLevel.resolution.x);
+    }
+}
+
+void HeightRangePyramid::addLevel(const glm::uvec2& resolution) {
+    size_t offset = 0;
+    if (!m_levels.empty())
+        offset = m_levels.back().offset + (size_t)m_levels.back().resolution.x * (size_t)m_levels.back().resolution.y;
+
+    m_levels.emplace_back(Level{resolution, offset});
+}
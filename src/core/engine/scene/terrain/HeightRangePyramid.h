@@ -0,0 +1,63 @@
+
+#ifndef WORLDENGINE_HEIGHTRANGEPYRAMID_H
+#define WORLDENGINE_HEIGHTRANGEPYRAMID_H
+
+#include "core/core.h"
+
+class ImageData;
+
+// A mip chain of the minimum and maximum heights of a heightmap. Each texel of level i holds the range of a
+// 2^(i+1) x 2^(i+1) block of heightmap texels, so the full resolution heightmap is never duplicated. The height range
+// of any rectangle of texels is found by reading at most 2x2 texels from the level where the rectangle spans no more
+// than two texels on each axis. The range returned is conservative: it may include heights from texels just outside
+// the rectangle, unless the rectangle is aligned to the block size of that level.
+class HeightRangePyramid {
+    NO_COPY(HeightRangePyramid);
+    NO_MOVE(HeightRangePyramid);
+private:
+    struct Level {
+        glm::uvec2 resolution;
+        size_t offset;
+    };
+
+public:
+    HeightRangePyramid();
+
+    ~HeightRangePyramid();
+
+    // Builds the pyramid from one channel of a Float32 or Float16 heightmap.
+    bool build(const ImageData* heightmapImageData, size_t channelIndex = 0);
+
+    void clear();
+
+    bool empty() const;
+
+    // Finds the height range of the heightmap texels within [minCoord, maxCoord).
+    bool getHeightRange(const glm::uvec2& minCoord, const glm::uvec2& maxCoord, float& outMinHeight, float& outMaxHeight) const;
+
+    float getMinHeight() const;
+
+    float getMaxHeight() const;
+
+    uint32_t getLevelCount() const;
+
+    const glm::uvec2& getLevelResolution(uint32_t level) const;
+
+    const glm::uvec2& getHeightmapResolution() const;
+
+private:
+    void buildBaseLevel(const ImageData* heightmapImageData, size_t channelIndex, uint32_t firstRow, uint32_t lastRow);
+
+    void buildLevel(uint32_t level, uint32_t firstRow, uint32_t lastRow);
+
+    void addLevel(const glm::uvec2& resolution);
+
+private:
+    std::vector<Level> m_levels;
+    std::vector<float> m_minHeights;
+    std::vector<float> m_maxHeights;
+    glm::uvec2 m_heightmapResolution;
+};
+
+
+#endif //WORLDENGINE_HEIGHTRANGEPYRAMID_H
@@ -0,0 +1,631 @@
+#include "core/engine/scene/terrain/TerrainTileCache.h"
+#include "core/application/Application.h"
+#include "core/graphics/ImageData.h"
+#include "core/thread/ThreadUtils.h"
+#include "core/util/Float16.h"
+#include "core/util/Logger.h"
+#include "core/util/MappedFile.h"
+#include "core/util/Profiler.h"
+#include "core/util/Time.h"
+#include <filesystem>
+#include <fstream>
+
+// Version must be incremented whenever the file layout is changed, otherwise garbage data will get read from older
+// versions of the cache file.
+#define TERRAIN_TILE_CACHE_FILE_VERSION 2
+#define TERRAIN_TILE_CACHE_FILE_MAGIC 0x53454C54 // "TLES"
+
+// Tile payloads start on a page boundary, so a tile is paged in without touching its neighbours when its size is a
+// multiple of the page size.
+static constexpr size_t tileDataAlignment = 4096;
+
+struct TileCacheFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t tileSize;
+    uint32_t levelCount;
+    uint32_t format;
+    uint32_t channelIndex; // Channel of the source heightmap the heights were read from
+    uint64_t tileCount;
+    uint64_t tileDataOffset;
+};
+
+struct TileCacheFileLevel {
+    uint32_t width;
+    uint32_t height;
+    uint32_t tilesX;
+    uint32_t tilesY;
+    uint64_t firstTile;
+};
+
+struct TileCacheFileTile {
+    float minHeight;
+    float maxHeight;
+};
+
+static size_t getTexelSize(TerrainTileCache::Format format) {
+    return format == TerrainTileCache::Format_Float32 ? sizeof(float) : sizeof(int16_t);
+}
+
+static std::vector<TerrainTileCache::Level> computeLevels(const glm::uvec2& resolution, uint32_t tileSize) {
+    std::vector<TerrainTileCache::Level> levels;
+
+    TerrainTileCache::Level level{};
+    level.resolution = resolution;
+    level.firstTile = 0;
+
+    while (true) {
+        level.tileCount = (level.resolution + glm::uvec2(tileSize - 1)) / tileSize;
+        levels.emplace_back(level);
+
+        if (level.resolution.x <= tileSize && level.resolution.y <= tileSize)
+            break;
+
+        level.firstTile += (size_t)level.tileCount.x * (size_t)level.tileCount.y;
+        level.resolution = (level.resolution + glm::uvec2(1)) / 2u;
+    }
+
+    return levels;
+}
+
+// Finds the height range of one tile of a band. Texels beyond the edge of the level are clamped to the last row and
+// column, so every tile has the same size. The clamped texels duplicate texels within the tile, so the range is not
+// affected.
+static void computeTileHeightRange(const float* band, uint32_t bandWidth, uint32_t bandRows, uint32_t tileX, uint32_t tileSize, float& outMinHeight, float& outMaxHeight) {
+    const uint32_t x0 = glm::min(tileX * tileSize, bandWidth - 1);
+    const uint32_t x1 = glm::min(x0 + tileSize, bandWidth);
+
+    float minHeight = +INFINITY;
+    float maxHeight = -INFINITY;
+
+    for (uint32_t y = 0; y < glm::min(tileSize, bandRows); ++y) {
+        const float* row = band + (size_t)y * bandWidth;
+        for (uint32_t x = x0; x < x1; ++x) {
+            minHeight = glm::min(minHeight, row[x]);
+            maxHeight = glm::max(maxHeight, row[x]);
+        }
+    }
+
+    outMinHeight = minHeight;
+    outMaxHeight = maxHeight;
+}
+
+// Encodes one tile from a band of rows, clamping at the edges the same way. Unorm16 texels are relative to the tile's
+// height range, which must contain every texel.
+static void encodeTile(const float* band, uint32_t bandWidth, uint32_t bandRows, uint32_t tileX, uint32_t tileSize, TerrainTileCache::Format format, float minHeight, float maxHeight, float* rowBuffer, uint8_t* dstTexels) {
+    const uint32_t x0 = tileX * tileSize;
+    const size_t rowByteSize = (size_t)tileSize * getTexelSize(format);
+
+    for (uint32_t y = 0; y < tileSize; ++y) {
+        const float* row = band + (size_t)glm::min(y, bandRows - 1) * bandWidth;
+        for (uint32_t x = 0; x < tileSize; ++x)
+            rowBuffer[x] = row[glm::min(x0 + x, bandWidth - 1)];
+
+        uint8_t* dstRow = dstTexels + (size_t)y * rowByteSize;
+        if (format == TerrainTileCache::Format_Float16) {
+            floatToFloat16(rowBuffer, reinterpret_cast<short*>(dstRow), tileSize);
+        } else if (format == TerrainTileCache::Format_Unorm16) {
+            floatToUnorm16(rowBuffer, reinterpret_cast<uint16_t*>(dstRow), tileSize, maxHeight - minHeight, minHeight);
+        } else {
+            memcpy(dstRow, rowBuffer, rowByteSize);
+        }
+    }
+}
+
+// Averages 2x2 texels of a band into the columns [firstColumn, lastColumn) of the next level. The last row and column
+// are clamped when the band has an odd size.
+static void downsampleBand(const float* band, uint32_t bandWidth, uint32_t bandRows, float* dstBand, uint32_t dstWidth, uint32_t firstColumn, uint32_t lastColumn) {
+    const uint32_t dstRows = (bandRows + 1) / 2;
+
+    for (uint32_t y = 0; y < dstRows; ++y) {
+        const float* row0 = band + (size_t)(y * 2) * bandWidth;
+        const float* row1 = band + (size_t)glm::min(y * 2 + 1, bandRows - 1) * bandWidth;
+        float* dstRow = dstBand + (size_t)y * dstWidth;
+
+        for (uint32_t x = firstColumn; x < lastColumn; ++x) {
+            uint32_t x0 = x * 2;
+            uint32_t x1 = glm::min(x0 + 1, bandWidth - 1);
+            dstRow[x] = (row0[x0] + row0[x1] + row1[x0] + row1[x1]) * 0.25F;
+        }
+    }
+}
+
+TerrainTileCache::TerrainTileCache():
+        m_file(nullptr),
+        m_tileDataOffset(0),
+        m_tileByteSize(0),
+        m_tileSize(0),
+        m_format(Format_Float32),
+        m_channelIndex(0),
+        m_minHeight(0.0F),
+        m_maxHeight(0.0F) {
+}
+
+TerrainTileCache::~TerrainTileCache() {
+    delete m_file;
+}
+
+bool TerrainTileCache::build(const ImageData* heightmapImageData, const std::string& filePath, const BuildOptions& options) {
+    PROFILE_SCOPE("TerrainTileCache::build")
+
+    if (heightmapImageData == nullptr || heightmapImageData->getWidth() == 0 || heightmapImageData->getHeight() == 0) {
+        LOG_ERROR("Unable to build terrain tile cache \"%s\": Heightmap is empty", filePath.c_str());
+        return false;
+    }
+
+    if (heightmapImageData->getPixelFormat() != ImagePixelFormat::Float32 && heightmapImageData->getPixelFormat() != ImagePixelFormat::Float16) {
+        LOG_ERROR("Unable to build terrain tile cache \"%s\": Heightmap must be a Float32 or Float16 image", filePath.c_str());
+        return false;
+    }
+
+    if (options.channelIndex >= (size_t)ImageData::getChannels(heightmapImageData->getPixelLayout())) {
+        LOG_ERROR("Unable to build terrain tile cache \"%s\": Heightmap does not have channel %zu", filePath.c_str(), options.channelIndex);
+        return false;
+    }
+
+    if (options.tileSize < 2 || options.tileSize % 2 != 0) {
+        LOG_ERROR("Unable to build terrain tile cache \"%s\": Tile size %u must be a non-zero even number", filePath.c_str(), options.tileSize);
+        return false;
+    }
+
+    auto t0 = Time::now();
+
+    const uint32_t tileSize = options.tileSize;
+    const std::vector<Level> levels = computeLevels(glm::uvec2(heightmapImageData->getWidth(), heightmapImageData->getHeight()), tileSize);
+    const size_t tileCount = levels.back().firstTile + (size_t)levels.back().tileCount.x * (size_t)levels.back().tileCount.y;
+    const size_t tileByteSize = (size_t)tileSize * (size_t)tileSize * getTexelSize(options.format);
+    const size_t tileTableOffset = sizeof(TileCacheFileHeader) + levels.size() * sizeof(TileCacheFileLevel);
+    const size_t tileDataOffset = CEIL_TO_MULTIPLE(tileTableOffset + tileCount * sizeof(TileCacheFileTile), tileDataAlignment);
+
+    // Written to a temporary file first, since the tile table is written last. A crash while building would otherwise
+    // leave a file with a valid header and an empty tile table behind, which open would accept.
+    std::filesystem::path tempFilePath(filePath + ".tmp");
+
+    std::ofstream file(tempFilePath, std::ios::binary);
+    if (!file.is_open()) {
+        LOG_ERROR("Failed to create terrain tile cache file \"%s\"", tempFilePath.string().c_str());
+        return false;
+    }
+
+    LOG_INFO("Writing terrain tile cache file \"%s\" - %zu levels, %zu tiles", filePath.c_str(), levels.size(), tileCount);
+
+    TileCacheFileHeader header{};
+    header.magic = TERRAIN_TILE_CACHE_FILE_MAGIC;
+    header.version = TERRAIN_TILE_CACHE_FILE_VERSION;
+    header.width = levels[0].resolution.x;
+    header.height = levels[0].resolution.y;
+    header.tileSize = tileSize;
+    header.levelCount = (uint32_t)levels.size();
+    header.format = options.format;
+    header.channelIndex = (uint32_t)options.channelIndex;
+    header.tileCount = tileCount;
+    header.tileDataOffset = tileDataOffset;
+    file.write((const char*)&header, sizeof(TileCacheFileHeader));
+
+    for (const Level& level : levels) {
+        TileCacheFileLevel fileLevel{};
+        fileLevel.width = level.resolution.x;
+        fileLevel.height = level.resolution.y;
+        fileLevel.tilesX = level.tileCount.x;
+        fileLevel.tilesY = level.tileCount.y;
+        fileLevel.firstTile = level.firstTile;
+        file.write((const char*)&fileLevel, sizeof(TileCacheFileLevel));
+    }
+
+    // The tile table is only known once every tile has been encoded, so it is reserved here and written last.
+    std::vector<TileCacheFileTile> tiles(tileCount);
+    std::vector<char> padding(tileDataOffset - tileTableOffset, 0);
+    file.write(padding.data(), (std::streamsize)padding.size());
+
+    // Levels are produced one band of tile rows at a time. The source heightmap is read a band at a time, and only the
+    // downsampled copy of the current level is kept, which is a quarter of the size of the level.
+    std::vector<float> baseBand;
+    std::vector<float> srcLevelHeights;
+    std::vector<float> dstLevelHeights;
+    std::vector<uint8_t> bandTileData;
+
+    for (uint32_t levelIndex = 0; levelIndex < (uint32_t)levels.size(); ++levelIndex) {
+        const Level& level = levels[levelIndex];
+        const Level* nextLevel = levelIndex + 1 < levels.size() ? &levels[levelIndex + 1] : nullptr;
+
+        if (nextLevel != nullptr)
+            dstLevelHeights.resize((size_t)nextLevel->resolution.x * (size_t)nextLevel->resolution.y);
+
+        bandTileData.resize((size_t)level.tileCount.x * tileByteSize);
+
+        for (uint32_t tileY = 0; tileY < level.tileCount.y; ++tileY) {
+            PROFILE_SCOPE("TerrainTileCache::build - Band")
+
+            const uint32_t firstRow = tileY * tileSize;
+            const uint32_t bandRows = glm::min(tileSize, level.resolution.y - firstRow);
+            const float* band;
+
+            if (levelIndex == 0) {
+                baseBand.resize((size_t)bandRows * level.resolution.x);
+                for (uint32_t y = 0; y < bandRows; ++y)
+                    heightmapImageData->readRowf(firstRow + y, options.channelIndex, &baseBand[(size_t)y * level.resolution.x]);
+                band = baseBand.data();
+            } else {
+                band = &srcLevelHeights[(size_t)firstRow * level.resolution.x];
+            }
+
+            TileCacheFileTile* bandTiles = &tiles[level.firstTile + (size_t)tileY * level.tileCount.x];
+            float* dstBand = nextLevel != nullptr ? &dstLevelHeights[(size_t)(firstRow / 2) * nextLevel->resolution.x] : nullptr;
+
+            if (levelIndex > 0) {
+                // Averaging narrows the range, so coarser tiles take the range of the four tiles beneath them instead.
+                // This keeps the ranges of every level exact with respect to the source heightmap. The range is needed
+                // before encoding, since Unorm16 texels are relative to it.
+                const Level& childLevel = levels[levelIndex - 1];
+                for (uint32_t tileX = 0; tileX < level.tileCount.x; ++tileX) {
+                    bandTiles[tileX].minHeight = +INFINITY;
+                    bandTiles[tileX].maxHeight = -INFINITY;
+
+                    for (uint32_t i = 0; i < 4; ++i) {
+                        uint32_t childX = glm::min(tileX * 2 + (i & 1), childLevel.tileCount.x - 1);
+                        uint32_t childY = glm::min(tileY * 2 + (i >> 1), childLevel.tileCount.y - 1);
+                        const TileCacheFileTile& childTile = tiles[childLevel.firstTile + (size_t)childY * childLevel.tileCount.x + childX];
+                        bandTiles[tileX].minHeight = glm::min(bandTiles[tileX].minHeight, childTile.minHeight);
+                        bandTiles[tileX].maxHeight = glm::max(bandTiles[tileX].maxHeight, childTile.maxHeight);
+                    }
+                }
+            }
+
+            auto encodeTiles = [&](size_t firstTileX, size_t lastTileX) {
+                std::vector<float> rowBuffer(tileSize);
+
+                for (size_t tileX = firstTileX; tileX < lastTileX; ++tileX) {
+                    if (levelIndex == 0)
+                        computeTileHeightRange(band, level.resolution.x, bandRows, (uint32_t)tileX, tileSize, bandTiles[tileX].minHeight, bandTiles[tileX].maxHeight);
+
+                    encodeTile(band, level.resolution.x, bandRows, (uint32_t)tileX, tileSize, options.format, bandTiles[tileX].minHeight, bandTiles[tileX].maxHeight,
+                               rowBuffer.data(), &bandTileData[tileX * tileByteSize]);
+                }
+
+                if (dstBand != nullptr) {
+                    uint32_t firstColumn = glm::min((uint32_t)firstTileX * tileSize / 2, nextLevel->resolution.x);
+                    uint32_t lastColumn = glm::min((uint32_t)lastTileX * tileSize / 2, nextLevel->resolution.x);
+                    downsampleBand(band, level.resolution.x, bandRows, dstBand, nextLevel->resolution.x, firstColumn, lastColumn);
+                }
+            };
+
+            size_t taskCount = glm::min((size_t)level.tileCount.x, ThreadUtils::getThreadCount());
+            if (taskCount <= 1) {
+                encodeTiles(0, level.tileCount.x);
+            } else {
+                auto futures = ThreadUtils::parallel_range(level.tileCount.x, 1, taskCount, encodeTiles);
+                ThreadUtils::wait(futures);
+            }
+
+            file.write((const char*)bandTileData.data(), (std::streamsize)bandTileData.size());
+        }
+
+        std::swap(srcLevelHeights, dstLevelHeights);
+    }
+
+    file.seekp((std::streamoff)tileTableOffset);
+    file.write((const char*)tiles.data(), (std::streamsize)(tiles.size() * sizeof(TileCacheFileTile)));
+    file.close();
+
+    std::error_code error;
+
+    if (!file.good()) {
+        LOG_ERROR("Failed to write terrain tile cache file \"%s\"", tempFilePath.string().c_str());
+        std::filesystem::remove(tempFilePath, error);
+        return false;
+    }
+
+    std::filesystem::rename(tempFilePath, std::filesystem::path(filePath), error);
+    if (error) {
+        LOG_ERROR("Failed to replace terrain tile cache file \"%s\": %s", filePath.c_str(), error.message().c_str());
+        std::filesystem::remove(tempFilePath, error);
+        return false;
+    }
+
+    LOG_INFO("Finished writing terrain tile cache file \"%s\" - %.2f MiB, took %.2f msec", filePath.c_str(),
+             (double)(tileDataOffset + tileCount * tileByteSize) / (1024.0 * 1024.0), Time::milliseconds(t0));
+    return true;
+}
+
+TerrainTileCache* TerrainTileCache::open(const std::string& filePath) {
+    PROFILE_SCOPE("TerrainTileCache::open")
+
+    MappedFile* file = MappedFile::open(filePath);
+    if (file == nullptr)
+        return nullptr;
+
+    TileCacheFileHeader header{};
+    if (file->size() >= sizeof(TileCacheFileHeader))
+        memcpy(&header, file->data(), sizeof(TileCacheFileHeader));
+
+    if (header.magic != TERRAIN_TILE_CACHE_FILE_MAGIC || header.version != TERRAIN_TILE_CACHE_FILE_VERSION) {
+        LOG_WARN("Unable to open terrain tile cache \"%s\": Incompatible file version", filePath.c_str());
+        delete file;
+        return nullptr;
+    }
+
+    const size_t tileTableOffset = sizeof(TileCacheFileHeader) + (size_t)header.levelCount * sizeof(TileCacheFileLevel);
+    const size_t tileByteSize = (size_t)header.tileSize * (size_t)header.tileSize * getTexelSize((Format)header.format);
+
+    if (header.levelCount == 0 || header.tileSize == 0 || header.format > Format_Unorm16 ||
+        header.tileDataOffset < tileTableOffset + header.tileCount * sizeof(TileCacheFileTile) ||
+        file->size() < header.tileDataOffset + header.tileCount * tileByteSize) {
+        LOG_ERROR("Unable to open terrain tile cache \"%s\": The file is truncated or corrupt", filePath.c_str());
+        delete file;
+        return nullptr;
+    }
+
+    TerrainTileCache* tileCache = new TerrainTileCache();
+    tileCache->m_file = file;
+    tileCache->m_tileDataOffset = (size_t)header.tileDataOffset;
+    tileCache->m_tileByteSize = tileByteSize;
+    tileCache->m_tileSize = header.tileSize;
+    tileCache->m_format = (Format)header.format;
+    tileCache->m_channelIndex = header.channelIndex;
+
+    tileCache->m_levels.resize(header.levelCount);
+    for (uint32_t i = 0; i < header.levelCount; ++i) {
+        TileCacheFileLevel fileLevel{};
+        memcpy(&fileLevel, file->data() + sizeof(TileCacheFileHeader) + i * sizeof(TileCacheFileLevel), sizeof(TileCacheFileLevel));
+
+        Level& level = tileCache->m_levels[i];
+        level.resolution = glm::uvec2(fileLevel.width, fileLevel.height);
+        level.tileCount = glm::uvec2(fileLevel.tilesX, fileLevel.tilesY);
+        level.firstTile = (size_t)fileLevel.firstTile;
+
+        if (level.firstTile + (size_t)level.tileCount.x * (size_t)level.tileCount.y > header.tileCount) {
+            LOG_ERROR("Unable to open terrain tile cache \"%s\": The file is truncated or corrupt", filePath.c_str());
+            delete tileCache;
+            return nullptr;
+        }
+    }
+
+    // The tile table is small, and is needed for every tile request, so it is kept in memory.
+    tileCache->m_tileHeightRanges.resize(header.tileCount);
+    memcpy(tileCache->m_tileHeightRanges.data(), file->data() + tileTableOffset, header.tileCount * sizeof(TileCacheFileTile));
+
+    const Level& lastLevel = tileCache->m_levels.back();
+    tileCache->m_minHeight = +INFINITY;
+    tileCache->m_maxHeight = -INFINITY;
+    for (size_t i = 0; i < (size_t)lastLevel.tileCount.x * (size_t)lastLevel.tileCount.y; ++i) {
+        tileCache->m_minHeight = glm::min(tileCache->m_minHeight, tileCache->m_tileHeightRanges[lastLevel.firstTile + i].x);
+        tileCache->m_maxHeight = glm::max(tileCache->m_maxHeight, tileCache->m_tileHeightRanges[lastLevel.firstTile + i].y);
+    }
+
+    return tileCache;
+}
+
+TerrainTileCache* TerrainTileCache::load(const std::string& heightmapFilePath, const BuildOptions& options) {
+    std::string absFilePath = Application::instance()->getAbsoluteResourceFilePath(heightmapFilePath);
+    size_t extensionPos = absFilePath.find_last_of('.');
+
+    std::filesystem::path sourceFilePath(absFilePath);
+    std::filesystem::path cacheFilePath(absFilePath.substr(0, extensionPos) + ".tiles");
+
+    if (std::filesystem::exists(cacheFilePath)) {
+        bool outdated = false;
+        if (std::filesystem::exists(sourceFilePath))
+            outdated = std::filesystem::last_write_time(cacheFilePath) < std::filesystem::last_write_time(sourceFilePath);
+
+        if (!outdated) {
+            TerrainTileCache* tileCache = TerrainTileCache::open(cacheFilePath.string());
+            if (tileCache != nullptr && tileCache->m_tileSize == options.tileSize && tileCache->m_format == options.format && tileCache->m_channelIndex == options.channelIndex)
+                return tileCache;
+            // Built with different options, or failed to read. It will get re-generated.
+            delete tileCache;
+        }
+    }
+
+    ImageData* heightmapImageData = ImageData::load(heightmapFilePath, ImagePixelLayout::Invalid, ImagePixelFormat::Float32);
+    if (heightmapImageData == nullptr)
+        return nullptr;
+
+    bool built = TerrainTileCache::build(heightmapImageData, cacheFilePath.string(), options);
+
+    // The whole point of the cache is to not keep the source heightmap in memory.
+    ImageData::unload(absFilePath);
+
+    if (!built)
+        return nullptr;
+
+    return TerrainTileCache::open(cacheFilePath.string());
+}
+
+bool TerrainTileCache::getHeightRange(const glm::dvec2& offset, const glm::dvec2& size, float& outMinHeight, float& outMaxHeight) const {
+    const glm::uvec2& resolution = m_levels[0].resolution;
+
+    glm::uvec2 lo = glm::min(glm::uvec2(glm::floor(offset * glm::dvec2(resolution))), resolution - glm::uvec2(1));
+    glm::uvec2 hi = glm::min(glm::uvec2(glm::ceil((offset + size) * glm::dvec2(resolution))), resolution);
+    if (hi.x <= lo.x || hi.y <= lo.y)
+        return false;
+
+    hi -= glm::uvec2(1); // Inclusive
+
+    // Find the first level where the region touches at most two tiles on each axis.
+    uint32_t levelIndex = 0;
+    glm::uvec2 minTile, maxTile;
+    while (true) {
+        minTile = (lo >> levelIndex) / m_tileSize;
+        maxTile = (hi >> levelIndex) / m_tileSize;
+        if ((maxTile.x - minTile.x <= 1 && maxTile.y - minTile.y <= 1) || levelIndex + 1 == (uint32_t)m_levels.size())
+            break;
+        ++levelIndex;
+    }
+
+    const Level& level = m_levels[levelIndex];
+    maxTile = glm::min(maxTile, level.tileCount - glm::uvec2(1));
+
+    float minHeight = +INFINITY;
+    float maxHeight = -INFINITY;
+
+    for (uint32_t y = minTile.y; y <= maxTile.y; ++y) {
+        for (uint32_t x = minTile.x; x <= maxTile.x; ++x) {
+            const glm::vec2& range = m_tileHeightRanges[level.firstTile + (size_t)y * level.tileCount.x + x];
+            minHeight = glm::min(minHeight, range.x);
+            maxHeight = glm::max(maxHeight, range.y);
+        }
+    }
+
+    outMinHeight = minHeight;
+    outMaxHeight = maxHeight;
+    return true;
+}
+
+bool TerrainTileCache::readRegion(uint32_t levelIndex, const glm::uvec2& minCoord, const glm::uvec2& maxCoord, float* dstHeights) const {
+    PROFILE_SCOPE("TerrainTileCache::readRegion")
+
+    return readRegionRows(levelIndex, minCoord, maxCoord, [&](size_t tileIndex, size_t srcIndex, uint32_t count, size_t dstIndex) {
+        decodeTexels(tileIndex, srcIndex, count, dstHeights + dstIndex);
+    });
+}
+
+bool TerrainTileCache::readRegion(uint32_t levelIndex, const glm::uvec2& minCoord, const glm::uvec2& maxCoord, short* dstHeights) const {
+    PROFILE_SCOPE("TerrainTileCache::readRegion")
+
+    std::vector<float> rowBuffer;
+    if (m_format != Format_Float16)
+        rowBuffer.resize(m_tileSize);
+
+    return readRegionRows(levelIndex, minCoord, maxCoord, [&](size_t tileIndex, size_t srcIndex, uint32_t count, size_t dstIndex) {
+        if (m_format == Format_Float16) {
+            memcpy(dstHeights + dstIndex, getTileTexels(tileIndex) + srcIndex * sizeof(int16_t), count * sizeof(int16_t));
+        } else {
+            decodeTexels(tileIndex, srcIndex, count, rowBuffer.data());
+            floatToFloat16(rowBuffer.data(), dstHeights + dstIndex, count);
+        }
+    });
+}
+
+float TerrainTileCache::readTexel(uint32_t levelIndex, const glm::uvec2& coord) const {
+    assert(levelIndex < m_levels.size());
+
+    const Level& level = m_levels[levelIndex];
+    assert(coord.x < level.resolution.x && coord.y < level.resolution.y);
+
+    glm::uvec2 tileCoord = coord / m_tileSize;
+    size_t tileIndex = level.firstTile + (size_t)tileCoord.y * level.tileCount.x + tileCoord.x;
+    size_t srcIndex = (size_t)(coord.y - tileCoord.y * m_tileSize) * m_tileSize + (coord.x - tileCoord.x * m_tileSize);
+
+    float value;
+    decodeTexels(tileIndex, srcIndex, 1, &value);
+    return value;
+}
+
+ImageData* TerrainTileCache::readLevel(uint32_t levelIndex) const {
+    if (levelIndex >= m_levels.size())
+        return nullptr;
+
+    const glm::uvec2& resolution = m_levels[levelIndex].resolution;
+    ImageData* imageData = new ImageData(resolution.x, resolution.y, ImagePixelLayout::R, ImagePixelFormat::Float32);
+
+    if (!readRegion(levelIndex, glm::uvec2(0), resolution, static_cast<float*>(imageData->getData()))) {
+        delete imageData;
+        return nullptr;
+    }
+
+    return imageData;
+}
+
+ImageData* TerrainTileCache::readLevelFloat16(uint32_t levelIndex) const {
+    if (levelIndex >= m_levels.size())
+        return nullptr;
+
+    const glm::uvec2& resolution = m_levels[levelIndex].resolution;
+    ImageData* imageData = new ImageData(resolution.x, resolution.y, ImagePixelLayout::R, ImagePixelFormat::Float16);
+
+    if (!readRegion(levelIndex, glm::uvec2(0), resolution, static_cast<short*>(imageData->getData()))) {
+        delete imageData;
+        return nullptr;
+    }
+
+    return imageData;
+}
+
+uint32_t TerrainTileCache::getLevelCount() const {
+    return (uint32_t)m_levels.size();
+}
+
+const TerrainTileCache::Level& TerrainTileCache::getLevel(uint32_t level) const {
+    assert(level < m_levels.size());
+    return m_levels[level];
+}
+
+const glm::uvec2& TerrainTileCache::getResolution() const {
+    return m_levels[0].resolution;
+}
+
+uint32_t TerrainTileCache::getTileSize() const {
+    return m_tileSize;
+}
+
+TerrainTileCache::Format TerrainTileCache::getFormat() const {
+    return m_format;
+}
+
+size_t TerrainTileCache::getChannelIndex() const {
+    return m_channelIndex;
+}
+
+float TerrainTileCache::getMinHeight() const {
+    return m_minHeight;
+}
+
+float TerrainTileCache::getMaxHeight() const {
+    return m_maxHeight;
+}
+
+const std::string& TerrainTileCache::getFilePath() const {
+    return m_file->getFilePath();
+}
+
+const uint8_t* TerrainTileCache::getTileTexels(size_t tileIndex) const {
+    return m_file->data() + m_tileDataOffset + tileIndex * m_tileByteSize;
+}
+
+void TerrainTileCache::decodeTexels(size_t tileIndex, size_t srcIndex, size_t count, float* dstHeights) const {
+    // Tile data starts page aligned, and every tile is a whole number of texels, so 16 bit texels are always aligned.
+    const uint8_t* texels = getTileTexels(tileIndex);
+
+    if (m_format == Format_Float16) {
+        float16ToFloat(reinterpret_cast<const short*>(texels) + srcIndex, dstHeights, count);
+    } else if (m_format == Format_Unorm16) {
+        const glm::vec2& range = m_tileHeightRanges[tileIndex];
+        unorm16ToFloat(reinterpret_cast<const uint16_t*>(texels) + srcIndex, dstHeights, count, range.y - range.x, range.x);
+    } else {
+        memcpy(dstHeights, texels + srcIndex * sizeof(float), count * sizeof(float));
+    }
+}
+
+template<class Fn>
+bool TerrainTileCache::readRegionRows(uint32_t levelIndex, const glm::uvec2& minCoord, const glm::uvec2& maxCoord, Fn readRow) const {
+    if (levelIndex >= m_levels.size())
+        return false;
+
+    const Level& level = m_levels[levelIndex];
+    if (maxCoord.x > level.resolution.x || maxCoord.y > level.resolution.y || maxCoord.x <= minCoord.x || maxCoord.y <= minCoord.y)
+        return false;
+
+    const uint32_t dstWidth = maxCoord.x - minCoord.x;
+    const glm::uvec2 minTile = minCoord / m_tileSize;
+    const glm::uvec2 maxTile = (maxCoord - glm::uvec2(1)) / m_tileSize;
+
+    for (uint32_t tileY = minTile.y; tileY <= maxTile.y; ++tileY) {
+        for (uint32_t tileX = minTile.x; tileX <= maxTile.x; ++tileX) {
+            size_t tileIndex = level.firstTile + (size_t)tileY * level.tileCount.x + tileX;
+
+            glm::uvec2 tileMin = glm::uvec2(tileX, tileY) * m_tileSize;
+            glm::uvec2 lo = glm::max(minCoord, tileMin);
+            glm::uvec2 hi = glm::min(maxCoord, tileMin + glm::uvec2(m_tileSize));
+
+            for (uint32_t y = lo.y; y < hi.y; ++y) {
+                size_t srcIndex = (size_t)(y - tileMin.y) * m_tileSize + (lo.x - tileMin.x);
+                size_t dstIndex = (size_t)(y - minCoord.y) * dstWidth + (lo.x - minCoord.x);
+                readRow(tileIndex, srcIndex, hi.x - lo.x, dstIndex);
+            }
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,112 @@
+
+#ifndef WORLDENGINE_TERRAINTILECACHE_H
+#define WORLDENGINE_TERRAINTILECACHE_H
+
+#include "core/core.h"
+
+class ImageData;
+class MappedFile;
+
+// An offline tiling of a heightmap, stored as a chain of mip levels each split into fixed size square tiles. Every tile
+// stores the range of heights beneath it, and the payloads are optionally quantized to 16 bits. The file is memory
+// mapped when opened, so only the tiles which are actually read get paged in, and heightmaps far larger than memory
+// can be used. Reads are const and may happen from any thread.
+class TerrainTileCache {
+    NO_COPY(TerrainTileCache);
+    NO_MOVE(TerrainTileCache);
+public:
+    enum Format : uint32_t {
+        Format_Float32 = 0,
+        Format_Float16 = 1,
+        Format_Unorm16 = 2, // Relative to each tile's height range, so precision does not depend on the absolute height.
+    };
+
+    struct BuildOptions {
+        uint32_t tileSize = 256; // Texels along each edge of a tile. Must be even.
+        Format format = Format_Float16;
+        size_t channelIndex = 0; // Channel of the source heightmap to read heights from.
+    };
+
+    struct Level {
+        glm::uvec2 resolution;
+        glm::uvec2 tileCount;
+        size_t firstTile;
+    };
+
+private:
+    TerrainTileCache();
+
+public:
+    ~TerrainTileCache();
+
+    // Writes a tile cache for the heightmap to the file. Levels are halved until the whole level fits in one tile.
+    static bool build(const ImageData* heightmapImageData, const std::string& filePath, const BuildOptions& options);
+
+    static TerrainTileCache* open(const std::string& filePath);
+
+    // Opens the ".tiles" cache next to a heightmap resource. The cache is rebuilt if it does not exist, is outdated or
+    // was built with different options.
+    static TerrainTileCache* load(const std::string& heightmapFilePath, const BuildOptions& options);
+
+    // Conservative height range of a normalized region of the heightmap, from the tile table only. Never touches
+    // the tile payloads.
+    bool getHeightRange(const glm::dvec2& offset, const glm::dvec2& size, float& outMinHeight, float& outMaxHeight) const;
+
+    // Reads the texels in [minCoord, maxCoord) of a level into a tightly packed row-major float array. Only the tiles
+    // overlapping the region are touched.
+    bool readRegion(uint32_t level, const glm::uvec2& minCoord, const glm::uvec2& maxCoord, float* dstHeights) const;
+
+    // Reads the region as Float16 instead. Float16 tiles are copied without being decoded.
+    bool readRegion(uint32_t level, const glm::uvec2& minCoord, const glm::uvec2& maxCoord, short* dstHeights) const;
+
+    // Reads a single texel of a level. Cheaper than readRegion for scattered reads.
+    float readTexel(uint32_t level, const glm::uvec2& coord) const;
+
+    // Reads a whole level into a new single channel Float32 image. The caller owns the returned image.
+    ImageData* readLevel(uint32_t level) const;
+
+    // Reads a whole level into a new single channel Float16 image, for uploading at half the size.
+    ImageData* readLevelFloat16(uint32_t level) const;
+
+    uint32_t getLevelCount() const;
+
+    const Level& getLevel(uint32_t level) const;
+
+    const glm::uvec2& getResolution() const;
+
+    uint32_t getTileSize() const;
+
+    Format getFormat() const;
+
+    size_t getChannelIndex() const;
+
+    float getMinHeight() const;
+
+    float getMaxHeight() const;
+
+    const std::string& getFilePath() const;
+
+private:
+    const uint8_t* getTileTexels(size_t tileIndex) const;
+
+    // Decodes count texels of one tile starting at srcIndex.
+    void decodeTexels(size_t tileIndex, size_t srcIndex, size_t count, float* dstHeights) const;
+
+    template<class Fn>
+    bool readRegionRows(uint32_t level, const glm::uvec2& minCoord, const glm::uvec2& maxCoord, Fn readRow) const;
+
+private:
+    MappedFile* m_file;
+    std::vector<Level> m_levels;
+    std::vector<glm::vec2> m_tileHeightRanges;
+    size_t m_tileDataOffset;
+    size_t m_tileByteSize;
+    uint32_t m_tileSize;
+    Format m_format;
+    size_t m_channelIndex;
+    float m_minHeight;
+    float m_maxHeight;
+};
+
+
+#endif //WORLDENGINE_TERRAINTILECACHE_H
@@ -0,0 +1,209 @@
+#include "core/engine/scene/terrain/TerrainTileLoader.h"
+#include "core/thread/ThreadUtils.h"
+#include "core/util/Profiler.h"
+#include "core/util/Logger.h"
+
+
+TerrainTileLoader::Job::Job(TileData* tileData):
+        tileData(tileData),
+        tileOffset(tileData->tileOffset),
+        tileSize(tileData->tileSize),
+        cancelled(false),
+        state(JobState_Running) {
+}
+
+TerrainTileLoader::TerrainTileLoader(LoadFunction&& loadFunction, uint32_t maxInFlightJobs, uint32_t maxLoadAttempts):
+        m_loadFunction(std::move(loadFunction)),
+        m_maxInFlightJobs(glm::max(maxInFlightJobs, 1u)),
+        m_maxLoadAttempts(glm::clamp(maxLoadAttempts, 1u, (uint32_t)UINT8_MAX)),
+        m_failedTileCount(0) {
+}
+
+TerrainTileLoader::~TerrainTileLoader() {
+    PROFILE_SCOPE("TerrainTileLoader::~TerrainTileLoader")
+
+    // Jobs reference the load function, so they must finish before it is destroyed.
+    for (Job* job : m_inFlightJobs)
+        job->cancelled = true;
+
+    for (Job* job : m_inFlightJobs) {
+        job->future.wait();
+        delete job;
+    }
+}
+
+void TerrainTileLoader::request(TileData* tileData) {
+    assert(tileData != nullptr);
+    assert(tileData->state == TileData::State_Requested);
+    m_queuedTiles.emplace_back(tileData);
+}
+
+void TerrainTileLoader::remove(TileData* tileData) {
+    m_queuedTiles.erase(std::remove(m_queuedTiles.begin(), m_queuedTiles.end(), tileData), m_queuedTiles.end());
+
+    for (Job* job : m_inFlightJobs) {
+        if (job->tileData == tileData) {
+            job->tileData = nullptr;
+            job->cancelled = true;
+        }
+    }
+}
+
+void TerrainTileLoader::update() {
+    PROFILE_SCOPE("TerrainTileLoader::update")
+
+    PROFILE_REGION("Publish completed jobs")
+
+    m_publishedTiles.clear();
+
+    for (auto it = m_inFlightJobs.begin(); it != m_inFlightJobs.end();) {
+        Job* job = *it;
+
+        if (job->tileData != nullptr && job->tileData->idle)
+            job->cancelled = true;
+
+        if (job->state.load(std::memory_order_acquire) == JobState_Running) {
+            ++it;
+            continue;
+        }
+
+        publish(job);
+        delete job;
+        it = m_inFlightJobs.erase(it);
+    }
+
+    PROFILE_REGION("Dispatch queued tiles")
+
+    // Tiles which went idle while queued were un-requested by the supplier, and are dropped here. They are queued again
+    // if they become active, so a tile may appear more than once, but only the first entry will be dispatched.
+    m_queuedTiles.erase(std::remove_if(m_queuedTiles.begin(), m_queuedTiles.end(), [](const TileData* tileData) {
+        return tileData->state != TileData::State_Requested || tileData->idle || tileData->deleted;
+    }), m_queuedTiles.end());
+
+    if (m_queuedTiles.empty() || m_inFlightJobs.size() >= m_maxInFlightJobs)
+        return;
+
+    // Priorities change every frame, so the heap is rebuilt rather than maintained. Only the tiles which will be
+    // dispatched are popped from it, which is much cheaper than sorting the whole queue.
+    auto lessPriority = [](const TileData* lhs, const TileData* rhs) {
+        return lhs->priority < rhs->priority;
+    };
+
+    std::make_heap(m_queuedTiles.begin(), m_queuedTiles.end(), lessPriority);
+
+    // Tiles waiting to retry a failed load are popped with the others, and pushed back once dispatching is done.
+    std::vector<TileData*> waitingTiles;
+    auto now = Time::now();
+
+    ThreadUtils::beginBatch();
+    while (!m_queuedTiles.empty() && m_inFlightJobs.size() < m_maxInFlightJobs) {
+        std::pop_heap(m_queuedTiles.begin(), m_queuedTiles.end(), lessPriority);
+        TileData* tileData = m_queuedTiles.back();
+        m_queuedTiles.pop_back();
+
+        if (tileData->state != TileData::State_Requested)
+            continue;
+
+        if (tileData->timeRetry > now) {
+            waitingTiles.emplace_back(tileData);
+            continue;
+        }
+
+        dispatch(tileData);
+    }
+    ThreadUtils::endBatch();
+
+    m_queuedTiles.insert(m_queuedTiles.end(), waitingTiles.begin(), waitingTiles.end());
+}
+
+const std::vector<TileData*>& TerrainTileLoader::getPublishedTiles() const {
+    return m_publishedTiles;
+}
+
+size_t TerrainTileLoader::getQueuedTileCount() const {
+    return m_queuedTiles.size();
+}
+
+size_t TerrainTileLoader::getInFlightJobCount() const {
+    return m_inFlightJobs.size();
+}
+
+uint32_t TerrainTileLoader::getMaxInFlightJobs() const {
+    return m_maxInFlightJobs;
+}
+
+void TerrainTileLoader::setMaxInFlightJobs(uint32_t maxInFlightJobs) {
+    m_maxInFlightJobs = glm::max(maxInFlightJobs, 1u);
+}
+
+size_t TerrainTileLoader::getFailedTileCount() const {
+    return m_failedTileCount;
+}
+
+void TerrainTileLoader::dispatch(TileData* tileData) {
+    tileData->state = TileData::State_Pending;
+
+    Job* job = new Job(tileData);
+    m_inFlightJobs.emplace_back(job);
+
+    const LoadFunction* loadFunction = &m_loadFunction;
+
+    job->future = ThreadUtils::run([job, loadFunction]() {
+        PROFILE_SCOPE("TerrainTileLoader - Load tile")
+
+        bool loaded = false;
+        if (!job->cancelled)
+            loaded = (*loadFunction)(job->tileOffset, job->tileSize, job->cancelled, job->result);
+
+        job->state.store(loaded ? JobState_Complete : JobState_Failed, std::memory_order_release);
+    });
+}
+
+void TerrainTileLoader::publish(Job* job) {
+    TileData* tileData = job->tileData;
+
+    if (tileData == nullptr || tileData->deleted || tileData->state != TileData::State_Pending)
+        return; // The tile was removed, or was re-requested since this job was dispatched.
+
+    if (job->state == JobState_Complete && !job->cancelled) {
+        tileData->minHeight = job->result.minHeight;
+        tileData->maxHeight = job->result.maxHeight;
+
+        if (!job->result.heightData.empty()) {
+            delete[] tileData->heightData;
+            tileData->heightData = new short[job->result.heightData.size()];
+            tileData->heightDataResolution = job->result.heightDataResolution;
+            std::copy(job->result.heightData.begin(), job->result.heightData.end(), tileData->heightData);
+        }
+
+        tileData->timeProcessed = Time::now();
+        tileData->state = TileData::State_Available;
+        m_publishedTiles.emplace_back(tileData);
+
+    } else if (job->cancelled && !tileData->idle) {
+        // Cancelled, then became active again before the job finished. Try again.
+        tileData->state = TileData::State_Requested;
+        m_queuedTiles.emplace_back(tileData);
+
+    } else if (!job->cancelled) {
+        // The load function failed. The count is kept by the tile, so it is not reset if the tile goes idle in between.
+        ++tileData->loadFailureCount;
+
+        if (tileData->loadFailureCount >= m_maxLoadAttempts) {
+            glm::dvec2 tileOffset = tileData->tileOffset;
+            LOG_WARN("Failed to load terrain tile at [%.6f, %.6f] after %u attempts. It will not be requested again", tileOffset.x, tileOffset.y, (uint32_t)tileData->loadFailureCount);
+            tileData->state = TileData::State_Failed;
+            ++m_failedTileCount;
+        } else {
+            // 250 msec after the first failure, doubling after each one after that.
+            uint64_t retryDelayMsec = 250ull << (tileData->loadFailureCount - 1);
+            tileData->timeRetry = Time::now() + std::chrono::milliseconds(retryDelayMsec);
+            tileData->state = TileData::State_Requested;
+            m_queuedTiles.emplace_back(tileData);
+        }
+
+    } else {
+        // Requested again by the supplier if the tile becomes active.
+        tileData->state = TileData::State_None;
+    }
+}
@@ -0,0 +1,95 @@
+
+#ifndef WORLDENGINE_TERRAINTILELOADER_H
+#define WORLDENGINE_TERRAINTILELOADER_H
+
+#include "core/core.h"
+#include "core/engine/scene/terrain/TerrainTileSupplier.h"
+#include "core/thread/Task.h"
+#include <functional>
+
+struct TileLoadResult {
+    float minHeight = 0.0F;
+    float maxHeight = 0.0F;
+    std::vector<short> heightData; // Optional, Float16. Copied into TileData::heightData when the result is published.
+    glm::uvec2 heightDataResolution = glm::uvec2(0, 0);
+};
+
+// Produces tile data on the thread pool on behalf of a TerrainTileSupplier. Requested tiles are queued, and each
+// update the highest priority tiles are dispatched, up to a fixed number of jobs in flight. Jobs only see a copy of the
+// tile bounds, never the TileData itself, so TileData is only ever touched by the thread which owns the supplier.
+// The loader does not hold references to tiles, so the supplier must remove tiles from it before deleting them.
+// A job publishes its result by changing its atomic state, and completed results are copied into their tiles by the
+// next update. Tiles which become idle or are deleted while loading have their jobs cancelled and results discarded.
+// The load function is called concurrently, and should poll the cancelled flag if it does a lot of work. A tile whose
+// load fails is retried after an exponentially growing delay, and is put in State_Failed once it has failed
+// maxLoadAttempts times, so a tile which can never be loaded is not requested forever.
+class TerrainTileLoader {
+    NO_COPY(TerrainTileLoader);
+    NO_MOVE(TerrainTileLoader);
+public:
+    typedef std::function<bool(const glm::dvec2& tileOffset, const glm::dvec2& tileSize, const std::atomic_bool& cancelled, TileLoadResult& outResult)> LoadFunction;
+
+private:
+    enum JobState : uint8_t {
+        JobState_Running = 0,
+        JobState_Complete = 1,
+        JobState_Failed = 2,
+    };
+
+    struct Job {
+        TileData* tileData; // Null once the tile has been removed from the supplier
+        glm::dvec2 tileOffset;
+        glm::dvec2 tileSize;
+        std::atomic_bool cancelled;
+        std::atomic<JobState> state;
+        TileLoadResult result;
+        TaskFuture<void> future;
+
+        explicit Job(TileData* tileData);
+    };
+
+public:
+    explicit TerrainTileLoader(LoadFunction&& loadFunction, uint32_t maxInFlightJobs = 8, uint32_t maxLoadAttempts = 4);
+
+    ~TerrainTileLoader();
+
+    // Queues a tile in the State_Requested state to be loaded.
+    void request(TileData* tileData);
+
+    // Must be called before the supplier deletes a tile. Removes it from the queue, and cancels its job if one is
+    // in flight.
+    void remove(TileData* tileData);
+
+    // Publishes the results of completed jobs, then dispatches queued tiles in order of priority. Never blocks.
+    void update();
+
+    // Tiles which became available during the last update.
+    const std::vector<TileData*>& getPublishedTiles() const;
+
+    size_t getQueuedTileCount() const;
+
+    size_t getInFlightJobCount() const;
+
+    uint32_t getMaxInFlightJobs() const;
+
+    void setMaxInFlightJobs(uint32_t maxInFlightJobs);
+
+    size_t getFailedTileCount() const;
+
+private:
+    void dispatch(TileData* tileData);
+
+    void publish(Job* job);
+
+private:
+    LoadFunction m_loadFunction;
+    std::vector<TileData*> m_queuedTiles;
+    std::vector<Job*> m_inFlightJobs;
+    std::vector<TileData*> m_publishedTiles;
+    uint32_t m_maxInFlightJobs;
+    uint32_t m_maxLoadAttempts;
+    size_t m_failedTileCount;
+};
+
+
+#endif //WORLDENGINE_TERRAINTILELOADER_H
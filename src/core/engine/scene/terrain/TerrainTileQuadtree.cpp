@@ -27,10 +27,16 @@ TerrainTileQuadtree::TerrainTileQuadtree(uint32_t maxQuadtreeDepth, const glm::d
         m_size(size),
         m_heightScale(heightScale),
         m_splitThreshold(2.0),
+        m_cameraTravel(0.0),
+        m_prevLocalCameraOrigin(0.0),
+        m_prevCameraProjection(0.0),
+        m_invalidated(true),
+        m_parallelTraversalDepth(2),
+        m_structureChangeCount(0),
         m_tileSupplier(nullptr) {
 
     TileTreeNode rootNode{};
-    rootNode.childOffset = UINT32_MAX;
+    rootNode.firstChildIndex = UINT32_MAX;
     m_nodes.emplace_back(rootNode);
     m_nodeTileData.emplace_back(NodeData{
         .minElevation = 0.0F,
@@ -47,23 +53,27 @@ void TerrainTileQuadtree::update(const Frustum* frustum) {
 
     std::vector<size_t> tempNodeIndices;
     std::vector<size_t> unvisitedNodesStack;
-    std::vector<TraversalInfo> traversalStack;
 
     // tempNodeIndices will contain all deleted subtrees
-    updateSubdivisions(frustum, tempNodeIndices, traversalStack);
+    updateNodes(frustum, true, tempNodeIndices);
+    updateSubtreeExpiry();
 
     markDeletedSubtrees(tempNodeIndices, unvisitedNodesStack);
-    cleanupDeletedNodes();
 
-    // tempNodeIndices will contain all fully visible subtrees
-    tempNodeIndices.clear();
-    updateVisibility(frustum, traversalStack, tempNodeIndices);
-    markVisibleSubtrees(tempNodeIndices, unvisitedNodesStack);
+    // Free blocks get reused by later splits, which scatters siblings away from their parents over time. Restore the
+    // breadth-first layout once enough has changed.
+    size_t freeNodeCount = m_freeNodeBlocks.size() * 4;
+    if (freeNodeCount > m_nodes.size() / 4 || m_structureChangeCount > m_nodes.size() / 16)
+        compactNodes();
+}
+
+void TerrainTileQuadtree::updateVisibility(const Frustum* frustum) {
+    PROFILE_SCOPE("TerrainTileQuadtree::updateVisibility");
 
-    updatePriorities(traversalStack);
+    std::vector<size_t> deletedNodeIndices;
 
-    if (m_tileSupplier != nullptr)
-        m_tileSupplier->update();
+    updateNodes(frustum, false, deletedNodeIndices);
+    assert(deletedNodeIndices.empty());
 }
 
 glm::dvec2 TerrainTileQuadtree::getNormalizedNodeCoordinate(const glm::dvec2& treePosition, uint8_t treeDepth) const {
@@ -96,6 +106,7 @@ uint32_t TerrainTileQuadtree::getMaxQuadtreeDepth() const {
 
 void TerrainTileQuadtree::setMaxQuadtreeDepth(uint32_t maxQuadtreeDepth) {
     m_maxQuadtreeDepth = maxQuadtreeDepth;
+    m_invalidated = true;
 }
 
 const glm::dvec2& TerrainTileQuadtree::getSize() const {
@@ -104,6 +115,7 @@ const glm::dvec2& TerrainTileQuadtree::getSize() const {
 
 void TerrainTileQuadtree::setSize(const glm::dvec2& size) {
     m_size = size;
+    m_invalidated = true;
 }
 
 double TerrainTileQuadtree::getHeightScale() const {
@@ -112,6 +124,20 @@ double TerrainTileQuadtree::getHeightScale() const {
 
 void TerrainTileQuadtree::setHeightScale(double heightScale) {
     m_heightScale = heightScale;
+    m_invalidated = true;
+}
+
+uint8_t TerrainTileQuadtree::getParallelTraversalDepth() const {
+    return m_parallelTraversalDepth;
+}
+
+void TerrainTileQuadtree::setParallelTraversalDepth(uint8_t parallelTraversalDepth) {
+    assert(parallelTraversalDepth <= 8); // One task for each of 4^depth subtrees
+    m_parallelTraversalDepth = parallelTraversalDepth;
+}
+
+size_t TerrainTileQuadtree::getParallelTraversalTaskCount(uint8_t forkDepth) {
+    return 1 + ((size_t)1 << (forkDepth * 2));
 }
 
 const std::shared_ptr<TerrainTileSupplier>& TerrainTileQuadtree::getTileSupplier() const {
@@ -120,15 +146,15 @@ const std::shared_ptr<TerrainTileSupplier>& TerrainTileQuadtree::getTileSupplier
 
 void TerrainTileQuadtree::setTileSupplier(const std::shared_ptr<TerrainTileSupplier>& tileSupplier) {
     m_tileSupplier = tileSupplier;
+    m_invalidated = true;
 }
 
 bool TerrainTileQuadtree::hasChildren(size_t nodeIndex) {
-    return m_nodes[nodeIndex].childOffset != UINT32_MAX;
+    return m_nodes[nodeIndex].firstChildIndex != UINT32_MAX;
 }
 
 bool TerrainTileQuadtree::isDeleted(size_t nodeIndex) {
-    return m_nodes[nodeIndex].childOffset == 0;
-//    return m_nodes[nodeIndex].deleted;
+    return m_nodes[nodeIndex].deleted;
 }
 
 bool TerrainTileQuadtree::isVisible(size_t nodeIndex) {
@@ -136,7 +162,7 @@ bool TerrainTileQuadtree::isVisible(size_t nodeIndex) {
 }
 
 size_t TerrainTileQuadtree::getChildIndex(size_t nodeIndex, QuadIndex quadIndex) {
-    return nodeIndex + m_nodes[nodeIndex].childOffset + quadIndex;
+    return m_nodes[nodeIndex].firstChildIndex + quadIndex;
 }
 
 AxisAlignedBoundingBox TerrainTileQuadtree::getNodeBoundingBox(size_t nodeIndex, const glm::uvec2& treePosition, uint8_t treeDepth) const {
@@ -209,160 +235,217 @@ Visibility TerrainTileQuadtree::calculateNodeVisibility(const Frustum* frustum,
 //    return result;
 }
 
-void TerrainTileQuadtree::updateSubdivisions(const Frustum* frustum, std::vector<size_t>& deletedNodeIndices, std::vector<TraversalInfo>& traversalStack) {
-    PROFILE_SCOPE("TerrainTileQuadtree::updateSubdivisions")
-
-#if DEBUG_RENDER_ENABLED
-    glm::mat4 modelMatrix = glm::mat4(m_transform.getMatrix());
-    glm::mat4 viewMatrix = glm::inverse(glm::mat4(Engine::scene()->getMainCameraEntity().getComponent<Transform>().getMatrix()));
-    Engine::instance()->getImmediateRenderer()->matrixMode(MatrixMode_Projection);
-    Engine::instance()->getImmediateRenderer()->pushMatrix("TerrainTileQuadtree::updateSubdivisions/Projection");
-    Engine::instance()->getImmediateRenderer()->loadMatrix(Engine::scene()->getMainCameraEntity().getComponent<Camera>().getProjectionMatrix());
-    Engine::instance()->getImmediateRenderer()->matrixMode(MatrixMode_ModelView);
-    Engine::instance()->getImmediateRenderer()->pushMatrix("TerrainTileQuadtree::updateSubdivisions/ModelView");
-    Engine::instance()->getImmediateRenderer()->loadMatrix(viewMatrix * modelMatrix);
-
-    Engine::instance()->getImmediateRenderer()->setCullMode(vk::CullModeFlagBits::eNone);
-    Engine::instance()->getImmediateRenderer()->setColourBlendMode(vk::BlendFactor::eSrcAlpha, vk::BlendFactor::eOneMinusSrcAlpha, vk::BlendOp::eAdd);
-
-    Engine::instance()->getImmediateRenderer()->setLineWidth(1.0F);
-    Engine::instance()->getImmediateRenderer()->setBlendEnabled(false);
-    Engine::instance()->getImmediateRenderer()->setDepthTestEnabled(false);
-#endif
-
-    glm::dvec3 localCameraOrigin = glm::dvec3(glm::inverse(m_transform.getMatrix()) * glm::dvec4(frustum->getOrigin(), 1.0));
-    localCameraOrigin.x += m_size.x * 0.5;
-    localCameraOrigin.z += m_size.y * 0.5;
-
-    Camera cam = frustum->getCamera();
-    double height = cam.getTop() - cam.getBottom();
-    bool isOrtho = cam.isOrtho();
-    double fov = isOrtho ? 0.0 : cam.getFov();
-    double frustumNear = cam.getNear();
-    double frustumTop = cam.getTop();
-    double frustumBottom = cam.getBottom();
-    double fovDeg = cam.getFovDegrees();
-
-//    printf("Frustum: FOV %f deg, near: %f, top: %f, bottom: %f, height: %f\n", glm::degrees(fov), frustumNear, frustumTop, frustumBottom, glm::abs(frustumTop - frustumBottom));
+void TerrainTileQuadtree::calculateChildNodeVisibility(const Frustum* frustum, size_t nodeIndex, const glm::uvec2& treePosition, uint8_t treeDepth, uint8_t* outVisibility) {
+    float centerX[4], centerY[4], centerZ[4];
+    float halfExtentX[4], halfExtentY[4], halfExtentZ[4];
 
-    double maxSize = glm::max(m_size.x, m_size.y);
+    for (int i = 0; i < 4; ++i) {
+        size_t childIndex = getChildIndex(nodeIndex, (QuadIndex)i);
+        AxisAlignedBoundingBox aabb = getNodeBoundingBox(childIndex, treePosition * 2u + QUAD_OFFSETS[i], (uint8_t)(treeDepth + 1u));
+        centerX[i] = (float)aabb.getCenter().x;
+        centerY[i] = (float)aabb.getCenter().y;
+        centerZ[i] = (float)aabb.getCenter().z;
+        halfExtentX[i] = (float)aabb.getHalfExtents().x;
+        halfExtentY[i] = (float)aabb.getHalfExtents().y;
+        halfExtentZ[i] = (float)aabb.getHalfExtents().z;
+    }
 
-    m_parentOffsets.clear();
-    m_parentOffsets.resize(m_nodes.size(), UINT32_MAX);
+    frustum->testAABBs(centerX, centerY, centerZ, halfExtentX, halfExtentY, halfExtentZ, 4, outVisibility);
+}
 
+uint8_t TerrainTileQuadtree::getLeafNodeDepth(const glm::uvec2& treePosition, uint8_t treeDepth) const {
+    size_t nodeIndex = 0;
+    for (uint8_t depth = 0; depth < treeDepth; ++depth) {
+        if (m_nodes[nodeIndex].firstChildIndex == UINT32_MAX)
+            return depth;
 
-    traverseTreeNodes(traversalStack, [&](TerrainTileQuadtree*, const TraversalInfo& node) {
-        double normalizedNodeSize = getNormalizedNodeSizeForTreeDepth(node.treeDepth);
+        // The bits of the tree position from the root down select the quadrant at each level.
+        glm::uvec2 quadOffset = (treePosition >> (uint32_t)(treeDepth - depth - 1)) & 1u;
+        nodeIndex = m_nodes[nodeIndex].firstChildIndex + quadOffset.x * 2 + quadOffset.y;
+    }
+    return treeDepth;
+}
 
-        glm::dvec2 tileOffset = glm::dvec2(node.treePosition) * normalizedNodeSize;
-        TileDataReference tile = m_tileSupplier->getTile(tileOffset, glm::dvec2(normalizedNodeSize));
-        tile.notifyUsed();
+float TerrainTileQuadtree::calculateMorphFactor(const glm::dvec2& normalizedCoordinate, uint8_t treeDepth) const {
+    // The same projected size as the split decision in updateNodes, but measured at a point instead of the node
+    // center, with the elevation clamped towards the camera so it does not depend on any one node's height range.
+    glm::dvec2 coordinate = normalizedCoordinate * m_size;
+    glm::dvec3 position(coordinate.x, glm::clamp(m_prevLocalCameraOrigin.y, 0.0, m_heightScale), coordinate.y);
+    double cameraDistance = glm::distance(position, m_prevLocalCameraOrigin);
+
+    double edgeSize = getNormalizedNodeSizeForTreeDepth(treeDepth) * glm::max(m_size.x, m_size.y);
+    bool isOrtho = m_prevCameraProjection.x != 0.0;
+    double projectedSize = Camera::calculateProjectedSize(edgeSize, cameraDistance, isOrtho, m_prevCameraProjection.y, m_prevCameraProjection.z, m_prevCameraProjection.w);
+
+    // A leaf's projected size relative to the split threshold is between 0.5, where its parent merges, and 1, where it
+    // splits. Morph towards the parent over the lower part of that range, so the merge itself is invisible.
+    constexpr double morphStart = 0.7;
+    double lodFactor = projectedSize * m_splitThreshold;
+    return (float)glm::clamp((morphStart - lodFactor) / (morphStart - 0.5), 0.0, 1.0);
+}
 
-        if (tile.isAvailable()) {
-            m_nodeTileData[node.nodeIndex].minElevation = tile.getMinHeight();
-            m_nodeTileData[node.nodeIndex].maxElevation = tile.getMaxHeight();
-        } else {
-            m_nodeTileData[node.nodeIndex].minElevation = 0.0F;
-            m_nodeTileData[node.nodeIndex].maxElevation = 1.0F;
-        }
+void TerrainTileQuadtree::calculateNodeLodInfo(const TraversalInfo& traversalInfo, NodeLodInfo& outLodInfo) const {
+    const glm::uvec2& treePosition = traversalInfo.treePosition;
+    uint8_t treeDepth = traversalInfo.treeDepth;
+    double normalizedNodeSize = getNormalizedNodeSizeForTreeDepth(treeDepth);
 
-//        // TODO: check distance to closest AABB point, or maybe just check distance to center vertical line-segment?
-//        AxisAlignedBoundingBox aabb = getNodeBoundingBox(node.nodeIndex, node.treePosition, node.treeDepth);
-//        glm::dvec3 nodeClosestCameraPos = aabb.calculateClosestPoint(localCameraOrigin);
+    for (int i = 0; i < 4; ++i) {
+        glm::uvec2 corner(i % 2, i / 2);
+        outLodInfo.morphFactors[i] = calculateMorphFactor(glm::dvec2(treePosition + corner) * normalizedNodeSize, treeDepth);
+    }
 
-        float minElevation = m_nodeTileData[node.nodeIndex].minElevation;
-        float maxElevation = m_nodeTileData[node.nodeIndex].maxElevation;
-        float midElevation = (maxElevation + minElevation) * 0.5F;
+    constexpr int edgeDirections[4][2] = {{-1, 0}, {0, -1}, {1, 0}, {0, 1}};
+    int64_t nodeCount = (int64_t)1 << treeDepth;
 
-        glm::dvec2 normalizedNodeCenterCoord = (glm::dvec2(node.treePosition) + glm::dvec2(0.5)) * normalizedNodeSize;
-        glm::dvec3 nodeCenterPos(normalizedNodeCenterCoord.x * m_size.x, midElevation * m_heightScale, normalizedNodeCenterCoord.y * m_size.y);
+    for (int i = 0; i < 4; ++i) {
+        outLodInfo.neighbourDepthDeltas[i] = 0;
+        outLodInfo.neighbourMorphFactors[i][0] = 0.0F;
+        outLodInfo.neighbourMorphFactors[i][1] = 0.0F;
+
+        int64_t neighbourX = (int64_t)treePosition.x + edgeDirections[i][0];
+        int64_t neighbourY = (int64_t)treePosition.y + edgeDirections[i][1];
+        if (neighbourX < 0 || neighbourY < 0 || neighbourX >= nodeCount || neighbourY >= nodeCount)
+            continue; // Edge of the terrain
+
+        glm::uvec2 neighbourPosition((uint32_t)neighbourX, (uint32_t)neighbourY);
+        uint8_t neighbourDepth = getLeafNodeDepth(neighbourPosition, treeDepth);
+        if (neighbourDepth >= treeDepth)
+            continue; // Neighbours at the same depth share corners, finer neighbours stitch themselves to this node.
+
+        outLodInfo.neighbourDepthDeltas[i] = (uint8_t)(treeDepth - neighbourDepth);
+
+        // The coarser neighbour morphs along the shared edge between its own corner morph factors. Give the renderer
+        // those, so this node's edge vertices can follow it exactly.
+        glm::uvec2 coarsePosition = neighbourPosition >> (uint32_t)outLodInfo.neighbourDepthDeltas[i];
+        int edgeAxis = 1 - i % 2; // Axis along the edge
+        double coarseNodeSize = getNormalizedNodeSizeForTreeDepth(neighbourDepth);
+
+        glm::dvec2 edgeStart = glm::dvec2(treePosition) * normalizedNodeSize;
+        if (i >= 2)
+            edgeStart[1 - edgeAxis] += normalizedNodeSize;
+        edgeStart[edgeAxis] = (double)coarsePosition[edgeAxis] * coarseNodeSize;
+
+        glm::dvec2 edgeEnd = edgeStart;
+        edgeEnd[edgeAxis] += coarseNodeSize;
+
+        outLodInfo.neighbourMorphFactors[i][0] = calculateMorphFactor(edgeStart, neighbourDepth);
+        outLodInfo.neighbourMorphFactors[i][1] = calculateMorphFactor(edgeEnd, neighbourDepth);
+    }
+}
 
-        glm::dvec3 nodeClosestCameraPos = nodeCenterPos;
+bool TerrainTileQuadtree::sampleHeight(double x, double z, double& outHeight) const {
+    // Exact for terrains which are translated, scaled or rotated about the vertical axis, but not tilted.
+    glm::dmat4 localToWorld = getLocalToWorldMatrix();
+    glm::dvec3 localPosition = glm::dvec3(glm::inverse(localToWorld) * glm::dvec4(x, 0.0, z, 1.0));
 
-//        localCameraOrigin.y = nodeClosestCameraPos.y;
+    double localHeight;
+    if (!sampleLocalHeight(glm::dvec2(localPosition.x, localPosition.z), localHeight))
+        return false;
 
+    outHeight = (localToWorld * glm::dvec4(localPosition.x, localHeight, localPosition.z, 1.0)).y;
+    return true;
+}
 
-        double edgeSize = normalizedNodeSize * maxSize;
-//        double splitDistance;
+bool TerrainTileQuadtree::sampleNormal(double x, double z, glm::dvec3& outNormal) const {
+    glm::dmat4 localToWorld = getLocalToWorldMatrix();
+    glm::dvec3 localPosition = glm::dvec3(glm::inverse(localToWorld) * glm::dvec4(x, 0.0, z, 1.0));
 
-        double projectedSize;
-        double splitThresholdSize = 1.0 / m_splitThreshold;
+    double localHeight;
+    if (!sampleLocalHeight(glm::dvec2(localPosition.x, localPosition.z), localHeight))
+        return false;
 
-        if (isOrtho) {
-            projectedSize = Camera::calculateProjectedOrthographicSize(edgeSize, frustumTop, frustumBottom);
+    glm::dmat3 normalMatrix = glm::transpose(glm::inverse(glm::dmat3(localToWorld)));
+    outNormal = glm::normalize(normalMatrix * sampleLocalNormal(glm::dvec2(localPosition.x, localPosition.z)));
+    return true;
+}
 
-            // Priority scaled based on size. Larger tiles have a higher priority.
-            tile.setPriority((float) projectedSize);
+void TerrainTileQuadtree::sampleHeights(const glm::dvec2* positions, size_t count, double* outHeights) const {
+    PROFILE_SCOPE("TerrainTileQuadtree::sampleHeights")
 
-        } else {
-//            splitDistance = edgeSize * m_splitThreshold;
-            glm::dvec3 cameraToNodePosition = nodeClosestCameraPos - localCameraOrigin;
-            double cameraDistanceSq = glm::dot(cameraToNodePosition, cameraToNodePosition);
+    glm::dmat4 localToWorld = getLocalToWorldMatrix();
+    glm::dmat4 worldToLocal = glm::inverse(localToWorld);
 
-            projectedSize = cam.calculateProjectedSize(edgeSize, glm::sqrt(cameraDistanceSq));
+    auto sampleRange = [&](size_t rangeStart, size_t rangeEnd) {
+        for (size_t i = rangeStart; i < rangeEnd; ++i) {
+            glm::dvec3 localPosition = glm::dvec3(worldToLocal * glm::dvec4(positions[i].x, 0.0, positions[i].y, 1.0));
 
-            // Priority scaled based on distance. Closer tiles have a higher priority.
-            double levelPriority = 1.0 - ((double)(1 << node.treeDepth) / (double)(1 << m_maxQuadtreeDepth));
-            tile.setPriority((float)(1.0 / (1.0 + (cameraDistanceSq - levelPriority))));
+            double localHeight;
+            if (sampleLocalHeight(glm::dvec2(localPosition.x, localPosition.z), localHeight)) {
+                outHeights[i] = (localToWorld * glm::dvec4(localPosition.x, localHeight, localPosition.z, 1.0)).y;
+            } else {
+                outHeights[i] = std::numeric_limits<double>::quiet_NaN();
+            }
         }
+    };
 
+    // Each sample is only a few texel reads, so small batches are not worth dispatching.
+    constexpr size_t samplesPerTask = 1024;
+    size_t taskCount = glm::min(INT_DIV_CEIL(count, samplesPerTask), ThreadUtils::getThreadCount());
 
-//        uint32_t priority = *reinterpret_cast<uint32_t*>(&cameraDistanceSq); // Should preserve the order.
+    if (taskCount <= 1) {
+        sampleRange(0, count);
+    } else {
+        auto futures = ThreadUtils::parallel_range(count, 1, taskCount, sampleRange);
+        ThreadUtils::wait(futures);
+    }
+}
 
+void TerrainTileQuadtree::raycast(const Ray* rays, size_t count, RaycastHit* outHits) const {
+    PROFILE_SCOPE("TerrainTileQuadtree::raycast")
 
-        if (projectedSize > splitThresholdSize) {
-            // Close enough to split
+    bool hasHeights = m_tileSupplier != nullptr && m_tileSupplier->getHeightResolution() != glm::uvec2(0);
 
-            if (!hasChildren(node.nodeIndex) && node.treeDepth < m_maxQuadtreeDepth && tile.isAvailable()) {
-                // NOTE: splitNode here will grow the list, and potentially invalidate the node reference above.
-                splitNode(node.nodeIndex, node.treePosition, node.treeDepth);
-            }
+    glm::dmat4 localToWorld = getLocalToWorldMatrix();
+    glm::dmat4 worldToLocal = glm::inverse(localToWorld);
+    glm::dmat3 normalMatrix = glm::transpose(glm::inverse(glm::dmat3(localToWorld)));
 
-        } else if (projectedSize < splitThresholdSize) {
-            // Far enough to merge
+    auto raycastRange = [&](size_t rangeStart, size_t rangeEnd) {
+        std::vector<RaycastNode> stack;
 
-            if (hasChildren(node.nodeIndex)) {
-                // NOTE: mergeNode is okay while iterating, it will not affect the size of the array or move anything around.
-                size_t deletedChildIndex = mergeNode(node.nodeIndex);
-                for (int i = 0; i < 4; ++i)
-                    deletedNodeIndices.emplace_back(deletedChildIndex + i);
-            }
-        }
+        for (size_t i = rangeStart; i < rangeEnd; ++i) {
+            const Ray& ray = rays[i];
+            RaycastHit& hit = outHits[i];
+            hit.position = glm::dvec3(0.0);
+            hit.normal = glm::dvec3(0.0);
+            hit.distance = ray.maxDistance;
+            hit.hit = false;
 
-        // node reference above may have been invalidated here, so we must index the nodes array directly
-        if (hasChildren(node.nodeIndex)) {
-            size_t firstChildIndex = getChildIndex(node.nodeIndex, (QuadIndex)0);
-            assert(firstChildIndex <= m_nodes.size() - 4);
-            for (int i = 3; i >= 0; --i) {
-                size_t childIndex = firstChildIndex + i;
-                m_parentOffsets[childIndex] = (uint32_t)(childIndex - node.nodeIndex);
-            }
-        } else {
+            if (!hasHeights)
+                continue;
 
+            // An affine transform keeps distances along the ray, so the local hit distance is also the world distance.
+            glm::dvec3 localOrigin = glm::dvec3(worldToLocal * glm::dvec4(ray.origin, 1.0));
+            glm::dvec3 localDirection = glm::dvec3(worldToLocal * glm::dvec4(ray.direction, 0.0));
 
-#if DEBUG_RENDER_ENABLED && DEBUG_RENDER_BOUNDING_VOLUMES
-            Engine::instance()->getImmediateRenderer()->setBlendEnabled(false);
-            Engine::instance()->getImmediateRenderer()->setDepthTestEnabled(true);
-            Engine::instance()->getImmediateRenderer()->colour(0.2F, 0.2F, 1.0F, 1.0F);
-            getNodeBoundingBox(node.nodeIndex, node.treePosition, node.treeDepth).drawLines();
+            double distance;
+            if (!raycastLocal(localOrigin, localDirection, ray.maxDistance, stack, distance))
+                continue;
 
-//            Engine::instance()->getImmediateRenderer()->setBlendEnabled(true);
-//            Engine::instance()->getImmediateRenderer()->setDepthTestEnabled(false);
-//            Engine::instance()->getImmediateRenderer()->colour(0.2F, 0.2F, 0.8F, 0.25F);
-//            getNodeBoundingBox(node.nodeIndex, node.treePosition, node.treeDepth).drawFill();
-#endif
+            glm::dvec3 localPosition = localOrigin + localDirection * distance;
+            hit.position = ray.origin + ray.direction * distance;
+            hit.normal = glm::normalize(normalMatrix * sampleLocalNormal(glm::dvec2(localPosition.x, localPosition.z)));
+            hit.distance = distance;
+            hit.hit = true;
         }
-        return false; // Traverse subtree
-    });
+    };
 
-#if DEBUG_RENDER_ENABLED
-    Engine::instance()->getImmediateRenderer()->popMatrix(MatrixMode_ModelView, "TerrainTileQuadtree::updateSubdivisions/ModelView");
-    Engine::instance()->getImmediateRenderer()->popMatrix(MatrixMode_Projection, "TerrainTileQuadtree::updateSubdivisions/Projection");
-#endif
+    constexpr size_t raysPerTask = 64;
+    size_t taskCount = glm::min(INT_DIV_CEIL(count, raysPerTask), ThreadUtils::getThreadCount());
+
+    if (taskCount <= 1) {
+        raycastRange(0, count);
+    } else {
+        auto futures = ThreadUtils::parallel_range(count, 1, taskCount, raycastRange);
+        ThreadUtils::wait(futures);
+    }
 }
 
-void TerrainTileQuadtree::updateVisibility(const Frustum* frustum, std::vector<TraversalInfo>& traversalStack, std::vector<size_t>& fullyVisibleSubtrees) {
-    PROFILE_SCOPE("TerrainTileQuadtree::updateVisibility")
+void TerrainTileQuadtree::updateNodes(const Frustum* frustum, bool updateSubdivisions, std::vector<size_t>& deletedNodeIndices) {
+    PROFILE_SCOPE("TerrainTileQuadtree::updateNodes")
+
+    // Subdivision, visibility and tile priorities are all updated in a single traversal. Subtrees are skipped when
+    // the camera has not moved far enough to change any split decision within them, and their visibility is uniform
+    // and unchanged since the last update. Without updateSubdivisions, only the visibility is updated.
 
 //    Frustum localFrustum = Frustum::transform(*frustum, glm::inverse(m_transform.getMatrix()));
     Frustum localFrustum(*frustum);
@@ -374,10 +457,10 @@ void TerrainTileQuadtree::updateVisibility(const Frustum* frustum, std::vector<T
     glm::mat4 modelMatrix = glm::mat4(m_transform.getMatrix());
     glm::mat4 viewMatrix = glm::inverse(glm::mat4(Engine::scene()->getMainCameraEntity().getComponent<Transform>().getMatrix()));
     Engine::instance()->getImmediateRenderer()->matrixMode(MatrixMode_Projection);
-    Engine::instance()->getImmediateRenderer()->pushMatrix("TerrainTileQuadtree::updateVisibility/Projection");
+    Engine::instance()->getImmediateRenderer()->pushMatrix("TerrainTileQuadtree::updateNodes/Projection");
     Engine::instance()->getImmediateRenderer()->loadMatrix(Engine::scene()->getMainCameraEntity().getComponent<Camera>().getProjectionMatrix());
     Engine::instance()->getImmediateRenderer()->matrixMode(MatrixMode_ModelView);
-    Engine::instance()->getImmediateRenderer()->pushMatrix("TerrainTileQuadtree::updateVisibility/ModelView");
+    Engine::instance()->getImmediateRenderer()->pushMatrix("TerrainTileQuadtree::updateNodes/ModelView");
     Engine::instance()->getImmediateRenderer()->loadMatrix(viewMatrix * modelMatrix);
 
     Engine::instance()->getImmediateRenderer()->setCullMode(vk::CullModeFlagBits::eNone);
@@ -388,73 +471,265 @@ void TerrainTileQuadtree::updateVisibility(const Frustum* frustum, std::vector<T
     Engine::instance()->getImmediateRenderer()->setDepthTestEnabled(false);
 #endif
 
+    glm::dvec3 localCameraOrigin = glm::dvec3(glm::inverse(m_transform.getMatrix()) * glm::dvec4(frustum->getOrigin(), 1.0));
+    localCameraOrigin.x += m_size.x * 0.5;
+    localCameraOrigin.z += m_size.y * 0.5;
+
+    Camera cam = frustum->getCamera();
+    bool isOrtho = cam.isOrtho();
+    double fov = isOrtho ? 0.0 : cam.getFov();
+    double frustumTop = cam.getTop();
+    double frustumBottom = cam.getBottom();
+
+    bool forceUpdate = false;
+
+    if (updateSubdivisions) {
+        // Any change to the projection can change every split decision, so everything is re-evaluated.
+        glm::dvec4 cameraProjection(isOrtho ? 1.0 : 0.0, fov, frustumTop, frustumBottom);
+        forceUpdate = m_invalidated || cameraProjection != m_prevCameraProjection;
+        m_invalidated = false;
+        m_prevCameraProjection = cameraProjection;
+
+        // The distance from the camera to any node can only have changed by as much as the camera has moved.
+        m_cameraTravel += glm::distance(localCameraOrigin, m_prevLocalCameraOrigin);
+        m_prevLocalCameraOrigin = localCameraOrigin;
+    }
+
+    double maxSize = glm::max(m_size.x, m_size.y);
+    double splitThresholdSize = 1.0 / m_splitThreshold;
+
+    // Small trees are not worth the cost of dispatching tasks. The immediate renderer is not thread safe.
+    constexpr size_t minParallelNodeCount = 2048;
+    uint8_t forkDepth = m_nodes.size() >= minParallelNodeCount ? m_parallelTraversalDepth : 0;
+#if DEBUG_RENDER_ENABLED
+    forkDepth = 0;
+#endif
+
+    size_t taskCount = getParallelTraversalTaskCount(forkDepth);
+    if (m_nodeCommands.size() < taskCount)
+        m_nodeCommands.resize(taskCount);
+    if (m_visitedNodeIndices.size() < taskCount)
+        m_visitedNodeIndices.resize(taskCount);
+
+    for (auto& nodeCommands : m_nodeCommands)
+        nodeCommands.clear();
+    for (auto& visitedNodeIndices : m_visitedNodeIndices)
+        visitedNodeIndices.clear();
+
+    // Children are tested together when their parent is found to be partially visible, so the visibility of every
+    // node except the root is already known by the time it is visited.
+    m_nodes[0].visibility = (uint8_t)calculateNodeVisibility(&localFrustum, 0, glm::uvec2(0, 0), 0);
+
+    // Tasks only write to the nodes within their own subtree, and to their own command and visited lists. The tile
+    // supplier is not thread safe, so tiles are only read here, and looked up or touched when the commands are applied.
+    traverseTreeNodesParallel(forkDepth, m_traversalStacks, [&](TerrainTileQuadtree*, const TraversalInfo& node, size_t taskIndex) {
+        Visibility visibility = (Visibility)m_nodes[node.nodeIndex].visibility;
+        m_nodes[node.nodeIndex].visible = visibility != Visibility_NotVisible;
+
+        if (updateSubdivisions)
+            m_visitedNodeIndices[taskIndex].emplace_back(node.nodeIndex);
+
+        if (updateSubdivisions && (forceUpdate || m_nodeTileData[node.nodeIndex].splitExpireTravel <= m_cameraTravel)) {
+            NodeData& nodeData = m_nodeTileData[node.nodeIndex];
+
+            // Keep the last known elevation while a tile is reloaded, rather than popping back to the full range.
+            bool tileAvailable = nodeData.tile.isAvailable();
+            if (tileAvailable) {
+                nodeData.minElevation = nodeData.tile.getMinHeight();
+                nodeData.maxElevation = nodeData.tile.getMaxHeight();
+            }
+
+            double normalizedNodeSize = getNormalizedNodeSizeForTreeDepth(node.treeDepth);
+
+            float midElevation = (nodeData.maxElevation + nodeData.minElevation) * 0.5F;
+
+            glm::dvec2 normalizedNodeCenterCoord = (glm::dvec2(node.treePosition) + glm::dvec2(0.5)) * normalizedNodeSize;
+            glm::dvec3 nodeCenterPos(normalizedNodeCenterCoord.x * m_size.x, midElevation * m_heightScale, normalizedNodeCenterCoord.y * m_size.y);
+
+            double edgeSize = normalizedNodeSize * maxSize;
+
+            double projectedSize;
+            double splitSlack; // How far the camera can travel before this split decision could change.
+            float priority;
+
+            if (isOrtho) {
+                projectedSize = Camera::calculateProjectedOrthographicSize(edgeSize, frustumTop, frustumBottom);
+                splitSlack = std::numeric_limits<double>::infinity(); // Independent of the camera position
+
+                // Priority scaled based on size. Larger tiles have a higher priority.
+                priority = (float)projectedSize;
+
+            } else {
+                glm::dvec3 cameraToNodePosition = nodeCenterPos - localCameraOrigin;
+                double cameraDistanceSq = glm::dot(cameraToNodePosition, cameraToNodePosition);
+                double cameraDistance = glm::sqrt(cameraDistanceSq);
+
+                projectedSize = cam.calculateProjectedSize(edgeSize, cameraDistance);
+
+                // Projected size is inversely proportional to distance, so the decision flips at a fixed distance.
+                double splitDistance = edgeSize / (glm::tan(fov * 0.5) * splitThresholdSize);
+                splitSlack = glm::abs(cameraDistance - splitDistance);
+
+                // Priority scaled based on distance. Closer tiles have a higher priority.
+                double levelPriority = 1.0 - ((double)(1 << node.treeDepth) / (double)(1 << m_maxQuadtreeDepth));
+                priority = (float)(1.0 / (1.0 + (cameraDistanceSq - levelPriority)));
+            }
+
+            if (!tileAvailable) {
+                // Elevation and split decision are not final until the tile is available, so revisit next update.
+                splitSlack = 0.0;
+            }
+
+            nodeData.splitExpireTravel = m_cameraTravel + splitSlack;
+
+            std::vector<NodeCommand>& nodeCommands = m_nodeCommands[taskIndex];
+            nodeCommands.emplace_back(NodeCommand{ .node = node, .type = NodeCommand::Type_UseTile, .visibility = (uint8_t)visibility, .priority = priority });
 
-    for (auto& node : m_nodes)
-        node.visible = false;
+            if (projectedSize > splitThresholdSize) {
+                // Close enough to split
 
-    traverseTreeNodes(traversalStack, [&](TerrainTileQuadtree*, const TraversalInfo& traversalInfo) {
-        TileTreeNode& node = m_nodes[traversalInfo.nodeIndex];
+                if (!hasChildren(node.nodeIndex) && node.treeDepth < m_maxQuadtreeDepth && tileAvailable)
+                    nodeCommands.emplace_back(NodeCommand{ .node = node, .type = NodeCommand::Type_Split, .visibility = (uint8_t)visibility });
 
-        Visibility visibility = calculateNodeVisibility(&localFrustum, traversalInfo.nodeIndex, traversalInfo.treePosition, traversalInfo.treeDepth);
-        node.visible = visibility != Visibility_NotVisible;
+            } else if (projectedSize < splitThresholdSize) {
+                // Far enough to merge
+
+                if (hasChildren(node.nodeIndex)) {
+                    nodeCommands.emplace_back(NodeCommand{ .node = node, .type = NodeCommand::Type_Merge, .visibility = (uint8_t)visibility });
+                    return true; // Children are about to be deleted
+                }
+            }
+        }
 
 #if DEBUG_RENDER_ENABLED && DEBUG_RENDER_VISIBILITY_COLOURS
         if (visibility == Visibility_FullyVisible) {
             Engine::instance()->getImmediateRenderer()->colour(0.2F, 0.2F, 1.0F, 0.3F);
-            getNodeBoundingBox(traversalInfo.nodeIndex, traversalInfo.treePosition, traversalInfo.treeDepth).drawLines();
+            getNodeBoundingBox(node.nodeIndex, node.treePosition, node.treeDepth).drawLines();
         } else if (visibility == Visibility_PartiallyVisible) {
             Engine::instance()->getImmediateRenderer()->colour(1.0F, 1.0F, 0.2F, 1.0F);
-//            getNodeBoundingBox(traversalInfo.nodeIndex, traversalInfo.treePosition, traversalInfo.treeDepth).drawLines();
         } else if (visibility == Visibility_NotVisible) {
             Engine::instance()->getImmediateRenderer()->colour(1.0F, 0.2F, 0.2F, 1.0F);
         }
 #endif
 
-        if (visibility == Visibility_FullyVisible)
-            fullyVisibleSubtrees.emplace_back(traversalInfo.nodeIndex);
+        if (!hasChildren(node.nodeIndex)) {
+#if DEBUG_RENDER_ENABLED && DEBUG_RENDER_BOUNDING_VOLUMES
+            Engine::instance()->getImmediateRenderer()->setBlendEnabled(false);
+            Engine::instance()->getImmediateRenderer()->setDepthTestEnabled(true);
+            Engine::instance()->getImmediateRenderer()->colour(0.2F, 0.2F, 1.0F, 1.0F);
+            getNodeBoundingBox(node.nodeIndex, node.treePosition, node.treeDepth).drawLines();
+#endif
+            return false;
+        }
+
+        size_t firstChildIndex = getChildIndex(node.nodeIndex, QuadIndex_TopLeft);
+        assert(firstChildIndex <= m_nodes.size() - 4);
 
-        return visibility != Visibility_PartiallyVisible; // Skip subtrees that are fully visible or fully invisible
+        if (visibility == Visibility_PartiallyVisible) {
+            uint8_t childVisibility[4];
+            calculateChildNodeVisibility(&localFrustum, node.nodeIndex, node.treePosition, node.treeDepth, childVisibility);
+            for (int i = 0; i < 4; ++i)
+                m_nodes[firstChildIndex + i].visibility = childVisibility[i];
+            return false; // Traverse subtree
+        }
+
+        // A node only keeps a uniform visibility after its whole subtree was given that visibility, so if every child
+        // already has it, nothing below this node needs to change unless a split decision has expired.
+        bool subtreeExpired = updateSubdivisions && (forceUpdate || m_nodeTileData[node.nodeIndex].subtreeExpireTravel <= m_cameraTravel);
+        bool visibilityChanged = false;
+        for (int i = 0; i < 4; ++i) {
+            if (m_nodes[firstChildIndex + i].visibility != visibility) {
+                m_nodes[firstChildIndex + i].visibility = visibility;
+                visibilityChanged = true;
+            }
+        }
+
+        return !subtreeExpired && !visibilityChanged; // Skip unchanged subtrees
     });
 
+    if (updateSubdivisions) {
+        applyNodeCommands(&localFrustum, deletedNodeIndices);
+
+        size_t visitedNodeCount = 0;
+        for (size_t i = 0; i < taskCount; ++i)
+            visitedNodeCount += m_visitedNodeIndices[i].size();
+        PROFILE_COUNTER("TerrainTileQuadtree visited nodes", visitedNodeCount);
+    }
+
 #if DEBUG_RENDER_ENABLED
-    Engine::instance()->getImmediateRenderer()->popMatrix(MatrixMode_ModelView, "TerrainTileQuadtree::updateVisibility/ModelView");
-    Engine::instance()->getImmediateRenderer()->popMatrix(MatrixMode_Projection, "TerrainTileQuadtree::updateVisibility/Projection");
+    Engine::instance()->getImmediateRenderer()->popMatrix(MatrixMode_ModelView, "TerrainTileQuadtree::updateNodes/ModelView");
+    Engine::instance()->getImmediateRenderer()->popMatrix(MatrixMode_Projection, "TerrainTileQuadtree::updateNodes/Projection");
 #endif
 }
 
-void TerrainTileQuadtree::updatePriorities(std::vector<TraversalInfo>& traversalStack) {
+void TerrainTileQuadtree::applyNodeCommands(const Frustum* localFrustum, std::vector<size_t>& deletedNodeIndices) {
+    PROFILE_SCOPE("TerrainTileQuadtree::applyNodeCommands")
+
+    for (std::vector<NodeCommand>& nodeCommands : m_nodeCommands) {
+        for (const NodeCommand& command : nodeCommands) {
+            const TraversalInfo& node = command.node;
+
+            switch (command.type) {
+                case NodeCommand::Type_UseTile: {
+                    NodeData& nodeData = m_nodeTileData[node.nodeIndex];
+                    if (!nodeData.tile.valid()) {
+                        // The tile was evicted since this node last used it, or the node is new.
+                        double normalizedNodeSize = getNormalizedNodeSizeForTreeDepth(node.treeDepth);
+                        glm::dvec2 tileOffset = glm::dvec2(node.treePosition) * normalizedNodeSize;
+                        nodeData.tile = m_tileSupplier->getTile(tileOffset, glm::dvec2(normalizedNodeSize));
+                    } else {
+                        nodeData.tile.notifyUsed();
+                    }
 
-    // Distance-based priority already assigned in the updateSubdivisions function...
-    // Here we need to adjust the priorities to be higher for visible nodes.
+                    if (!nodeData.tile.isAvailable()) {
+                        // Only tiles which are still loading need a priority. Higher for visible nodes.
+                        nodeData.tile.setPriority(command.visibility != Visibility_NotVisible ? command.priority + 1.0F : command.priority);
+                    }
+                    break;
+                }
+                case NodeCommand::Type_Split: {
+                    size_t firstChildIndex = splitNode(node.nodeIndex, node.treePosition, node.treeDepth);
 
-    traverseTreeNodes(traversalStack, [&](TerrainTileQuadtree*, const TraversalInfo& traversalInfo) {
-        double normalizedNodeSize = getNormalizedNodeSizeForTreeDepth(traversalInfo.treeDepth);
-        glm::dvec2 tileOffset = glm::dvec2(traversalInfo.treePosition) * normalizedNodeSize;
-        TileDataReference tile = m_tileSupplier->getTile(tileOffset, glm::dvec2(normalizedNodeSize));
+                    // The new children are not visited until the next update, so they need their visibility now.
+                    uint8_t childVisibility[4] = { command.visibility, command.visibility, command.visibility, command.visibility };
+                    if (command.visibility == Visibility_PartiallyVisible)
+                        calculateChildNodeVisibility(localFrustum, node.nodeIndex, node.treePosition, node.treeDepth, childVisibility);
 
-        if (m_nodes[traversalInfo.nodeIndex].visible) {
-            tile.setPriority(tile.getPriority() + 1.0F);
+                    for (int i = 0; i < 4; ++i) {
+                        m_nodes[firstChildIndex + i].visibility = childVisibility[i];
+                        m_nodes[firstChildIndex + i].visible = childVisibility[i] != Visibility_NotVisible;
+                    }
+                    break;
+                }
+                case NodeCommand::Type_Merge: {
+                    size_t deletedChildIndex = mergeNode(node.nodeIndex);
+                    for (int i = 0; i < 4; ++i)
+                        deletedNodeIndices.emplace_back(deletedChildIndex + i);
+                    break;
+                }
+            }
         }
-    });
+    }
 }
 
-void TerrainTileQuadtree::markVisibleSubtrees(std::vector<size_t>& visibleNodeIndices, std::vector<size_t>& unvisitedNodesStack) {
-    unvisitedNodesStack.clear();
-    for (const size_t& nodeIndex : visibleNodeIndices)
-        unvisitedNodesStack.emplace_back(nodeIndex);
-
-    while (!unvisitedNodesStack.empty()) {
-        size_t nodeIndex = unvisitedNodesStack.back();
-        unvisitedNodesStack.pop_back();
-
-        TileTreeNode& node = m_nodes[nodeIndex];
-        node.visible = true;
+void TerrainTileQuadtree::updateSubtreeExpiry() {
+    PROFILE_SCOPE("TerrainTileQuadtree::updateSubtreeExpiry")
 
-        if (!hasChildren(nodeIndex))
-            continue;
+    // Each task visited its subtree in depth-first pre-order, and the subtrees hang below the nodes visited by task 0.
+    // In reverse, every visited child is updated before its parent. Children which were skipped still hold a valid
+    // subtree expiry from an earlier update.
+    for (auto taskIt = m_visitedNodeIndices.rbegin(); taskIt != m_visitedNodeIndices.rend(); ++taskIt) {
+        for (auto it = taskIt->rbegin(); it != taskIt->rend(); ++it) {
+            size_t nodeIndex = *it;
+            NodeData& nodeData = m_nodeTileData[nodeIndex];
+            nodeData.subtreeExpireTravel = nodeData.splitExpireTravel;
 
-        for (int i = 3; i >= 0; --i)
-            unvisitedNodesStack.emplace_back(getChildIndex(nodeIndex, (QuadIndex)i));
+            if (hasChildren(nodeIndex)) {
+                size_t firstChildIndex = getChildIndex(nodeIndex, QuadIndex_TopLeft);
+                for (int i = 0; i < 4; ++i)
+                    nodeData.subtreeExpireTravel = glm::min(nodeData.subtreeExpireTravel, m_nodeTileData[firstChildIndex + i].subtreeExpireTravel);
+            }
+        }
     }
 }
 
@@ -474,149 +749,290 @@ void TerrainTileQuadtree::markDeletedSubtrees(std::vector<size_t>& deletedNodeIn
                 unvisitedNodesStack.emplace_back(getChildIndex(nodeIndex, (QuadIndex)i));
         }
 
-//        m_nodes[nodeIndex].deleted = true;
-        m_nodes[nodeIndex].childOffset = 0;
-//        m_nodeTileData[nodeIndex].release();
+        m_nodes[nodeIndex].firstChildIndex = UINT32_MAX;
+        m_nodes[nodeIndex].deleted = true;
+        m_nodeTileData[nodeIndex] = NodeData{}; // Releases the tile
+
+        // Each merge deletes all four siblings, so every block in the subtree is freed exactly once.
+        if (isFirstInNodeBlock(nodeIndex))
+            m_freeNodeBlocks.emplace_back((uint32_t)nodeIndex);
     }
 }
 
-void TerrainTileQuadtree::cleanupDeletedNodes() {
-    PROFILE_SCOPE("TerrainTileQuadtree::cleanupDeletedNodes")
+void TerrainTileQuadtree::compactNodes() {
+    PROFILE_SCOPE("TerrainTileQuadtree::compactNodes")
 
-//    auto t0 = Time::now();
+    // Copies the live nodes in breadth-first order, so every sibling block follows the blocks of the level above it,
+    // and the children of neighbouring nodes are neighbours. Linear in the number of live nodes.
+    m_compactedNodes.clear();
+    m_compactedNodeTileData.clear();
+    m_compactedNodes.reserve(m_nodes.size() - m_freeNodeBlocks.size() * 4);
+    m_compactedNodeTileData.reserve(m_nodes.size() - m_freeNodeBlocks.size() * 4);
 
-    size_t firstIndex = 0;
-    for (; firstIndex < m_nodes.size() && !isDeleted(firstIndex); ++firstIndex);
+    m_compactedNodes.emplace_back(m_nodes[0]);
+    m_compactedNodeTileData.emplace_back(std::move(m_nodeTileData[0]));
 
-    if (firstIndex < m_nodes.size()) {
-        for (size_t i = firstIndex; i < m_nodes.size(); ++i) {
-            if (!isDeleted(i)) {
-                uint32_t offset = (uint32_t)(i - firstIndex);
+    for (size_t i = 0; i < m_compactedNodes.size(); ++i) {
+        if (m_compactedNodes[i].firstChildIndex == UINT32_MAX)
+            continue;
 
-                assert(m_parentOffsets[i] != UINT32_MAX);
+        size_t firstChildIndex = m_compactedNodes[i].firstChildIndex;
+        m_compactedNodes[i].firstChildIndex = (uint32_t)m_compactedNodes.size();
 
-                size_t parentIndex = i - m_parentOffsets[i];
-                assert(m_nodes[parentIndex].childOffset < m_nodes.size() - parentIndex);
+        for (size_t j = 0; j < 4; ++j) {
+            assert(!m_nodes[firstChildIndex + j].deleted);
+            m_compactedNodes.emplace_back(m_nodes[firstChildIndex + j]);
+            m_compactedNodeTileData.emplace_back(std::move(m_nodeTileData[firstChildIndex + j]));
+        }
+    }
 
-                if (hasChildren(i)) {
-                    for (int j = 0; j < 4; ++j) {
-                        size_t childIndex = i + m_nodes[i].childOffset + j;
-                        size_t childParentIndex = childIndex - m_parentOffsets[childIndex];
-                        assert(childParentIndex + m_nodes[childParentIndex].childOffset == childIndex - j);
-                        m_parentOffsets[childIndex] += offset;
-                    }
-                    m_nodes[i].childOffset += offset;
-                }
+//    LOG_DEBUG("Compacted %zu quadtree terrain nodes to %zu", m_nodes.size(), m_compactedNodes.size());
 
-                // This node is the first child of its parent. The offset from the parent to this node needs to shift accordingly.
-                if (parentIndex + m_nodes[parentIndex].childOffset == i) {
-                    assert(m_nodes[parentIndex].childOffset > offset);
-//                    assert(parentIndex + m_nodes[parentIndex].childOffset == i - m_nodes[i].quadIndex);
-                    m_nodes[parentIndex].childOffset -= offset;
-                }
+    std::swap(m_nodes, m_compactedNodes);
+    std::swap(m_nodeTileData, m_compactedNodeTileData);
+    m_compactedNodeTileData.clear(); // Releases the moved-from tiles of deleted nodes
+    m_freeNodeBlocks.clear();
+    m_structureChangeCount = 0;
 
-                // Node moves from index i to firstIndex, the offset from this node to its parent needs to decrement accordingly
-                if (parentIndex < firstIndex) {
-                    m_parentOffsets[i] -= offset;
-                    assert(m_parentOffsets[i] <= firstIndex);
-                }
+    if (m_nodes.capacity() > m_nodes.size() * 4) {
+        LOG_DEBUG("Deallocating unused memory for %zu quadtree terrain nodes", m_nodes.capacity() - m_nodes.size());
+        m_nodes.shrink_to_fit();
+        m_nodeTileData.shrink_to_fit();
+        m_compactedNodes.shrink_to_fit();
+        m_compactedNodeTileData.shrink_to_fit();
+    }
+}
 
-                // element at index i moves to firstIndex
-#if 0
-                std::swap(m_nodes[firstIndex], m_nodes[i]);
-                std::swap(m_parentOffsets[firstIndex], m_parentOffsets[i]);
-                std::swap(m_nodeTileData[firstIndex], m_nodeTileData[i]);
-#else
-                m_nodes[firstIndex] = m_nodes[i];
-                m_parentOffsets[firstIndex] = m_parentOffsets[i];
-                m_nodeTileData[firstIndex] = std::move(m_nodeTileData[i]);
-#endif
+glm::dmat4 TerrainTileQuadtree::getLocalToWorldMatrix() const {
+    return glm::translate(m_transform.getMatrix(), glm::dvec3(m_size.x * -0.5, 0.0, m_size.y * -0.5));
+}
 
-#if _DEBUG
-                if (m_parentOffsets[firstIndex] != UINT32_MAX) {
-                    size_t testParentIndex = firstIndex - m_parentOffsets[firstIndex];
-                    assert(m_nodes[testParentIndex].childOffset <= firstIndex - testParentIndex);
-//                    assert(testParentIndex + m_nodes[testParentIndex].childOffset == firstIndex - m_nodes[firstIndex].quadIndex);
-                }
-#endif
+bool TerrainTileQuadtree::sampleLocalHeight(const glm::dvec2& localPosition, double& outHeight) const {
+    if (m_tileSupplier == nullptr)
+        return false;
+
+    glm::dvec2 normalizedCoordinate = localPosition / m_size;
+    if (normalizedCoordinate.x < 0.0 || normalizedCoordinate.y < 0.0 || normalizedCoordinate.x > 1.0 || normalizedCoordinate.y > 1.0)
+        return false;
+
+    float height;
+    if (!m_tileSupplier->sampleHeight(normalizedCoordinate, height))
+        return false;
+
+    outHeight = (double)height * m_heightScale;
+    return true;
+}
+
+glm::dvec3 TerrainTileQuadtree::sampleLocalNormal(const glm::dvec2& localPosition) const {
+    // Central differences one texel apart, clamped to the edges of the terrain.
+    glm::dvec2 texelSize = m_size / glm::dvec2(glm::max(m_tileSupplier->getHeightResolution(), glm::uvec2(1)));
+    glm::dvec2 minPosition = glm::clamp(localPosition - texelSize, glm::dvec2(0.0), m_size);
+    glm::dvec2 maxPosition = glm::clamp(localPosition + texelSize, glm::dvec2(0.0), m_size);
+
+    double x0 = 0.0, x1 = 0.0, z0 = 0.0, z1 = 0.0;
+    sampleLocalHeight(glm::dvec2(minPosition.x, localPosition.y), x0);
+    sampleLocalHeight(glm::dvec2(maxPosition.x, localPosition.y), x1);
+    sampleLocalHeight(glm::dvec2(localPosition.x, minPosition.y), z0);
+    sampleLocalHeight(glm::dvec2(localPosition.x, maxPosition.y), z1);
+
+    glm::dvec2 slope = glm::dvec2(x1 - x0, z1 - z0) / glm::max(maxPosition - minPosition, glm::dvec2(1e-12));
+    return glm::normalize(glm::dvec3(-slope.x, 1.0, -slope.y));
+}
+
+bool TerrainTileQuadtree::raycastLocal(const glm::dvec3& origin, const glm::dvec3& direction, double maxDistance, std::vector<RaycastNode>& stack, double& outDistance) const {
+    glm::dvec3 inverseDirection = 1.0 / direction;
 
-                ++firstIndex;
+    TraversalInfo rootNode{};
+    rootNode.nodeIndex = 0;
+    rootNode.treePosition = glm::uvec2(0, 0);
+    rootNode.treeDepth = 0;
+    rootNode.quadIndex = (QuadIndex)0;
+
+    double entryDistance, exitDistance;
+    if (!intersectNodeBounds(rootNode, origin, inverseDirection, maxDistance, entryDistance, exitDistance))
+        return false; // Misses the whole terrain's height range
+
+    double nearestDistance = maxDistance;
+    bool hit = false;
+
+    stack.clear();
+    stack.emplace_back(RaycastNode{rootNode, entryDistance, exitDistance});
+
+    while (!stack.empty()) {
+        RaycastNode raycastNode = stack.back();
+        stack.pop_back();
+
+        if (raycastNode.entryDistance >= nearestDistance)
+            continue; // Behind a hit which was already found
+
+        size_t firstChildIndex = m_nodes[raycastNode.node.nodeIndex].firstChildIndex;
+
+        if (firstChildIndex == UINT32_MAX) {
+            double distance;
+            if (raycastNodeSurface(raycastNode, origin, direction, distance) && distance < nearestDistance) {
+                nearestDistance = distance;
+                hit = true;
             }
+            continue;
         }
 
-//        LOG_DEBUG("Removing %zu deleted nodes in %.2f msec", (size_t)m_nodes.size() - firstIndex, Time::milliseconds(t0));
+        RaycastNode children[4];
+        size_t childCount = 0;
+
+        for (int i = 0; i < 4; ++i) {
+            RaycastNode& child = children[childCount];
+            child.node.nodeIndex = firstChildIndex + i;
+            child.node.treePosition = raycastNode.node.treePosition * 2u + QUAD_OFFSETS[i];
+            child.node.treeDepth = (uint8_t)(raycastNode.node.treeDepth + 1u);
+            child.node.quadIndex = (QuadIndex)i;
+
+            if (intersectNodeBounds(child.node, origin, inverseDirection, nearestDistance, child.entryDistance, child.exitDistance))
+                ++childCount;
+        }
 
-        PROFILE_REGION("Erase deleted nodes")
-        m_nodes.erase(m_nodes.begin() + (decltype(m_nodes)::difference_type)firstIndex, m_nodes.end());
-        m_parentOffsets.erase(m_parentOffsets.begin() + (decltype(m_parentOffsets)::difference_type)firstIndex, m_parentOffsets.end());
-        m_nodeTileData.erase(m_nodeTileData.begin() + (decltype(m_nodeTileData)::difference_type)firstIndex, m_nodeTileData.end());
+        // Push the farthest child first, so the nearest is marched first and can cull the others.
+        std::sort(children, children + childCount, [](const RaycastNode& lhs, const RaycastNode& rhs) {
+            return lhs.entryDistance > rhs.entryDistance;
+        });
 
+        stack.insert(stack.end(), children, children + childCount);
+    }
 
-#if _DEBUG
-        assert(m_nodes.size() == m_parentOffsets.size());
-        assert(m_nodeTileData.size() == m_parentOffsets.size());
+    outDistance = nearestDistance;
+    return hit;
+}
 
-        // SANITY CHECK - every entry in the m_parentOffsets array must make sense.
-        for (size_t i = 1; i < m_nodes.size(); ++i) {
-            assert(!isDeleted(i));
-            size_t parentIndex = i - m_parentOffsets[i];
-            size_t parentFirstChildIndex = parentIndex + m_nodes[parentIndex].childOffset;
-            assert(i >= parentFirstChildIndex && i < parentFirstChildIndex + 4);
+bool TerrainTileQuadtree::intersectNodeBounds(const TraversalInfo& node, const glm::dvec3& origin, const glm::dvec3& inverseDirection, double maxDistance, double& outEntryDistance, double& outExitDistance) const {
+    double normalizedNodeSize = getNormalizedNodeSizeForTreeDepth(node.treeDepth);
+    glm::dvec2 boundMin = glm::dvec2(node.treePosition) * normalizedNodeSize * m_size;
+    glm::dvec2 boundMax = glm::dvec2(node.treePosition + glm::uvec2(1)) * normalizedNodeSize * m_size;
+
+    const NodeData& nodeData = m_nodeTileData[node.nodeIndex];
+    glm::dvec3 boxMin(boundMin.x, nodeData.minElevation * m_heightScale, boundMin.y);
+    glm::dvec3 boxMax(boundMax.x, nodeData.maxElevation * m_heightScale, boundMax.y);
+
+    outEntryDistance = 0.0;
+    outExitDistance = maxDistance;
+
+    for (int i = 0; i < 3; ++i) {
+        if (std::isinf(inverseDirection[i])) {
+            // The ray is parallel to this slab. (boxMin - origin) * inf would be NaN when the origin lies on one of its
+            // planes, so the slab is either missed entirely, or places no limit on the distance.
+            if (origin[i] < boxMin[i] || origin[i] > boxMax[i])
+                return false;
+            continue;
         }
-#endif
+
+        double t0 = (boxMin[i] - origin[i]) * inverseDirection[i];
+        double t1 = (boxMax[i] - origin[i]) * inverseDirection[i];
+        outEntryDistance = glm::max(outEntryDistance, glm::min(t0, t1));
+        outExitDistance = glm::min(outExitDistance, glm::max(t0, t1));
     }
 
-    if (m_nodes.capacity() > m_nodes.size() * 4) {
-        LOG_DEBUG("Deallocating unused memory for %zu quadtree terrain nodes", m_nodes.capacity() - m_nodes.size());
-        m_nodes.shrink_to_fit();
-        m_parentOffsets.shrink_to_fit();
-        m_nodeTileData.shrink_to_fit();
+    return outEntryDistance <= outExitDistance;
+}
+
+bool TerrainTileQuadtree::raycastNodeSurface(const RaycastNode& node, const glm::dvec3& origin, const glm::dvec3& direction, double& outDistance) const {
+    auto heightAboveSurface = [&](double distance) {
+        glm::dvec3 position = origin + direction * distance;
+        double height = 0.0;
+        sampleLocalHeight(glm::clamp(glm::dvec2(position.x, position.z), glm::dvec2(0.0), m_size), height);
+        return position.y - height;
+    };
+
+    // March in steps of about one height texel, but at most maxStepsPerNode steps, so coarse nodes far from the camera
+    // are marched more coarsely. A vertical ray crosses a single texel, so it is only checked at both ends.
+    constexpr double maxStepsPerNode = 256.0;
+    glm::dvec2 texelSize = m_size / glm::dvec2(glm::max(m_tileSupplier->getHeightResolution(), glm::uvec2(1)));
+    double horizontalLength = glm::length(glm::dvec2(direction.x, direction.z));
+    double length = node.exitDistance - node.entryDistance;
+    double stepDistance = glm::max(glm::min(texelSize.x, texelSize.y) / glm::max(horizontalLength, 1e-12), length / maxStepsPerNode);
+
+    double prevDistance = node.entryDistance;
+    if (heightAboveSurface(prevDistance) <= 0.0) {
+        outDistance = prevDistance; // Entered the node below the surface
+        return true;
+    }
+
+    while (prevDistance < node.exitDistance) {
+        double distance = glm::min(prevDistance + stepDistance, node.exitDistance);
+
+        if (heightAboveSurface(distance) <= 0.0) {
+            // Crossed the surface since the last step. Bisect down to the crossing.
+            double aboveDistance = prevDistance;
+            double belowDistance = distance;
+            for (int i = 0; i < 16; ++i) {
+                double midDistance = (aboveDistance + belowDistance) * 0.5;
+                if (heightAboveSurface(midDistance) > 0.0) {
+                    aboveDistance = midDistance;
+                } else {
+                    belowDistance = midDistance;
+                }
+            }
+
+            outDistance = belowDistance;
+            return true;
+        }
+
+        prevDistance = distance;
     }
+
+    return false;
+}
+
+bool TerrainTileQuadtree::isFirstInNodeBlock(size_t nodeIndex) {
+    // The root is alone at index 0. Every block of four siblings after it starts at 1 + 4k.
+    return nodeIndex != 0 && (nodeIndex - 1) % 4 == 0;
 }
 
 size_t TerrainTileQuadtree::splitNode(size_t nodeIndex, const glm::uvec2& treePosition, uint8_t treeDepth) {
     PROFILE_SCOPE("TerrainTileQuadtree::splitNode");
     assert(nodeIndex < m_nodes.size() && "TerrainTileQuadtree::splitNode - node index out of range");
 
-    TileTreeNode& node = m_nodes[nodeIndex];
-    assert(node.childOffset == UINT32_MAX && "TerrainTileQuadtree::splitNode - node already split");
+    assert(m_nodes[nodeIndex].firstChildIndex == UINT32_MAX && "TerrainTileQuadtree::splitNode - node already split");
 
     assert(!isDeleted(nodeIndex));
 
     if (hasChildren(nodeIndex))
-        return nodeIndex + node.childOffset; // Node already split, return index of first child
-
-    size_t firstChildIndex = m_nodes.size();
+        return m_nodes[nodeIndex].firstChildIndex; // Node already split, return index of first child
+
+    // Reuse a freed block of four if there is one, otherwise grow the arrays. Either way this is O(1).
+    size_t firstChildIndex;
+    if (!m_freeNodeBlocks.empty()) {
+        firstChildIndex = m_freeNodeBlocks.back();
+        m_freeNodeBlocks.pop_back();
+    } else {
+        firstChildIndex = m_nodes.size();
+        m_nodes.resize(m_nodes.size() + 4);
+        m_nodeTileData.resize(m_nodeTileData.size() + 4);
+    }
 
 //    LOG_DEBUG("Splitting node %zu [%u %u %u] - children at %zu", nodeIndex, node.treePosition.x, node.treePosition.y, node.treeDepth, firstChildIndex);
 
-    node.childOffset = (uint32_t)(firstChildIndex - nodeIndex);
+    m_nodes[nodeIndex].firstChildIndex = (uint32_t)firstChildIndex;
+    ++m_structureChangeCount;
 
     TileTreeNode childNode{};
-    childNode.childOffset = UINT32_MAX;
+    childNode.firstChildIndex = UINT32_MAX;
 
     double normalizedNodeSize = getNormalizedNodeSizeForTreeDepth(treeDepth + 1);
     glm::dvec2 tileSize = glm::dvec2(normalizedNodeSize);
 
-    // Note: node reference is invalidated by the addition of new children below.
     for (int i = 0; i < 4; ++i) {
         glm::dvec2 tileOffset = glm::dvec2(treePosition * 2u + QUAD_OFFSETS[i]) * normalizedNodeSize;
-        TileDataReference tile = m_tileSupplier->getTile(tileOffset, tileSize);
-        tile.notifyUsed();
-
-        NodeData nodeTileData{
+        NodeData& nodeTileData = m_nodeTileData[firstChildIndex + i];
+        nodeTileData = NodeData{
             .minElevation = 0.0F,
-            .maxElevation = 1.0F
+            .maxElevation = 1.0F,
+            .tile = m_tileSupplier->getTile(tileOffset, tileSize)
         };
 
-        if (tile.isAvailable()) {
-            nodeTileData.minElevation = tile.getMinHeight();
-            nodeTileData.maxElevation = tile.getMaxHeight();
+        if (nodeTileData.tile.isAvailable()) {
+            nodeTileData.minElevation = nodeTileData.tile.getMinHeight();
+            nodeTileData.maxElevation = nodeTileData.tile.getMaxHeight();
         }
 
-        m_nodeTileData.emplace_back(nodeTileData);
-        m_parentOffsets.emplace_back((uint32_t)(m_nodes.size() - nodeIndex)); // Offset to subtract from this child nodes index to reach its parent.
-        m_nodes.emplace_back(childNode);
+        m_nodes[firstChildIndex + i] = childNode;
     }
 
     return firstChildIndex;
@@ -632,12 +1048,14 @@ size_t TerrainTileQuadtree::mergeNode(size_t nodeIndex) {
         return SIZE_MAX; // Node has no children. Nothing to merge.
     }
 
-    size_t firstChildIndex = nodeIndex + node.childOffset;
+    size_t firstChildIndex = node.firstChildIndex;
 
 //    LOG_DEBUG("Merging node %zu [%u %u %u] - children at %lld", nodeIndex, node.treePosition.x, node.treePosition.y, node.treeDepth, firstChildIndex);
 
-    // Set the child offset of this node to UINT32_MAX, this will orphan the child subtrees, and they will get cleaned up later.
-    node.childOffset = UINT32_MAX;
+    // Set the first child index of this node to UINT32_MAX, this will orphan the child subtrees, and their blocks will
+    // be freed by markDeletedSubtrees.
+    node.firstChildIndex = UINT32_MAX;
+    ++m_structureChangeCount;
 
 
     return firstChildIndex;
@@ -4,12 +4,12 @@
 #include "core/core.h"
 #include "core/engine/scene/Transform.h"
 #include "core/engine/scene/bound/Visibility.h"
+#include "core/engine/scene/terrain/TerrainTileSupplier.h"
+#include "core/thread/ThreadUtils.h"
 
 class Frustum;
-class TerrainTileSupplier;
 class AxisAlignedBoundingBox;
 class BoundingSphere;
-class TileDataReference;
 
 class TerrainTileQuadtree {
     NO_COPY(TerrainTileQuadtree);
@@ -24,12 +24,16 @@ public:
 
     static std::array<glm::uvec2, 4> QUAD_OFFSETS;
 
+    // Nodes are stored in blocks of four siblings, after the root at index 0. Blocks freed by merging are reused by
+    // later splits, and the whole array is periodically compacted back into breadth-first order.
     struct TileTreeNode {
-        uint32_t childOffset;
+        uint32_t firstChildIndex; // Index of the first of four contiguous children, or UINT32_MAX for a leaf
         union {
             uint8_t _packed0;
             struct {
                 uint8_t visible : 1;
+                uint8_t visibility : 2; // Visibility written by the parent node during the last update that reached this node
+                uint8_t deleted : 1; // Node is part of a free block
             };
         };
     };
@@ -41,16 +45,56 @@ public:
         QuadIndex quadIndex;
     };
 
+    // Level of detail transition data for a leaf node, used by the renderer to morph and stitch the tile geometry.
+    // Corners are ordered (0,0), (1,0), (0,1), (1,1) and edges -X, -Y, +X, +Y, in tree coordinates.
+    struct NodeLodInfo {
+        float morphFactors[4]; // At each corner. 0 at this node's level of detail, 1 at its parent's.
+        uint8_t neighbourDepthDeltas[4]; // How many levels coarser the leaf across each edge is. 0 if it is not coarser.
+        float neighbourMorphFactors[4][2]; // Morph factors at both ends of the coarser neighbour's edge, where there is one.
+    };
+
+    struct Ray {
+        glm::dvec3 origin;
+        glm::dvec3 direction; // Normalized, so distances are in world units
+        double maxDistance = std::numeric_limits<double>::infinity();
+    };
+
+    struct RaycastHit {
+        glm::dvec3 position;
+        glm::dvec3 normal;
+        double distance;
+        bool hit;
+    };
+
 public:
     TerrainTileQuadtree(uint32_t maxQuadtreeDepth, const glm::dvec2& size, double heightScale);
 
     ~TerrainTileQuadtree();
 
+    // Updates subdivision, visibility and tile priorities for the main view. Only subtrees which could have changed
+    // since the last update are visited. Tiles are only requested here. The tile supplier's update streams them, and
+    // must be called separately on the render thread.
     void update(const Frustum* frustum);
 
+    // Updates only the visibility of the current subdivision, for views which render the same tiles as the main view.
+    void updateVisibility(const Frustum* frustum);
+
     template<class Fn>
     void traverseTreeNodes(std::vector<TraversalInfo>& traversalStack, Fn callback);
 
+    template<class Fn>
+    void traverseTreeNodes(const TraversalInfo& rootTraversalInfo, std::vector<TraversalInfo>& traversalStack, Fn callback);
+
+    // Traverses the tree like traverseTreeNodes, but every subtree rooted at forkDepth is traversed by its own task on
+    // the thread pool. Nodes above forkDepth are visited first, on the calling thread. The callback receives the index
+    // of the task visiting the node, which is 0 on the calling thread, and returns true to skip the subtree. It runs
+    // concurrently, so it must not split or merge nodes. A forkDepth of 0 traverses the whole tree on the calling thread.
+    template<class Fn>
+    void traverseTreeNodesParallel(uint8_t forkDepth, std::vector<std::vector<TraversalInfo>>& traversalStacks, Fn callback);
+
+    // Upper bound on the task index passed to a traverseTreeNodesParallel callback, plus one.
+    static size_t getParallelTraversalTaskCount(uint8_t forkDepth);
+
     glm::dvec2 getNormalizedNodeCoordinate(const glm::dvec2& treePosition, uint8_t treeDepth) const;
 
     double getNormalizedNodeSizeForTreeDepth(uint8_t treeDepth) const;
@@ -75,6 +119,11 @@ public:
 
     void setHeightScale(double heightScale);
 
+    uint8_t getParallelTraversalDepth() const;
+
+    // Depth at which update forks subtrees onto the thread pool. 0 disables parallel traversal.
+    void setParallelTraversalDepth(uint8_t parallelTraversalDepth);
+
     const std::shared_ptr<TerrainTileSupplier>& getTileSupplier() const;
 
     void setTileSupplier(const std::shared_ptr<TerrainTileSupplier>& tileSupplier);
@@ -93,28 +142,94 @@ public:
 
     Visibility calculateNodeVisibility(const Frustum* frustum, size_t nodeIndex, const glm::uvec2& treePosition, uint8_t treeDepth) const;
 
-private:
-    void updateSubdivisions(const Frustum* frustum, std::vector<size_t>& deletedNodeIndices, std::vector<TraversalInfo>& traversalStack);
+    // Tests all four children of the node as a single batch. outVisibility receives the Visibility of each child in
+    // QuadIndex order.
+    void calculateChildNodeVisibility(const Frustum* frustum, size_t nodeIndex, const glm::uvec2& treePosition, uint8_t treeDepth, uint8_t* outVisibility);
+
+    // Depth of the leaf containing the node at treePosition and treeDepth, or treeDepth if that node is subdivided.
+    uint8_t getLeafNodeDepth(const glm::uvec2& treePosition, uint8_t treeDepth) const;
+
+    // Morph factor at a normalized terrain coordinate for a node at treeDepth, relative to the camera of the last
+    // update. It only depends on the coordinate, so nodes agree on the morph factor at the corners they share.
+    float calculateMorphFactor(const glm::dvec2& normalizedCoordinate, uint8_t treeDepth) const;
+
+    void calculateNodeLodInfo(const TraversalInfo& traversalInfo, NodeLodInfo& outLodInfo) const;
 
-    void updateVisibility(const Frustum* frustum, std::vector<TraversalInfo>& traversalStack, std::vector<size_t>& fullyVisibleSubtrees);
+    // Height queries sample the tile supplier's CPU height data, in world space using the transform of the last update.
+    // They may be called from any thread, but not concurrently with update. They find nothing outside the terrain, or
+    // when the supplier has no CPU height data.
+    bool sampleHeight(double x, double z, double& outHeight) const;
 
-    void updatePriorities(std::vector<TraversalInfo>& traversalStack);
+    bool sampleNormal(double x, double z, glm::dvec3& outNormal) const;
 
-    void markVisibleSubtrees(std::vector<size_t>& visibleNodeIndices, std::vector<size_t>& unvisitedNodesStack);
+    // Samples the height below each x/z position, writing NaN where there is none. Large batches are split across the
+    // thread pool.
+    void sampleHeights(const glm::dvec2* positions, size_t count, double* outHeights) const;
+
+    // Finds the first intersection of each ray with the terrain surface. Only nodes whose bounds the ray passes through
+    // are marched, nearest first. Large batches are split across the thread pool.
+    void raycast(const Ray* rays, size_t count, RaycastHit* outHits) const;
+
+private:
+    void updateNodes(const Frustum* frustum, bool updateSubdivisions, std::vector<size_t>& deletedNodeIndices);
+
+    void applyNodeCommands(const Frustum* localFrustum, std::vector<size_t>& deletedNodeIndices);
+
+    void updateSubtreeExpiry();
 
     void markDeletedSubtrees(std::vector<size_t>& deletedNodeIndices, std::vector<size_t>& unvisitedNodesStack);
 
-    void cleanupDeletedNodes();
+    void compactNodes();
+
+    static bool isFirstInNodeBlock(size_t nodeIndex);
 
     size_t splitNode(size_t nodeIndex, const glm::uvec2& treePosition, uint8_t treeDepth);
 
     size_t mergeNode(size_t nodeIndex);
 
+    // Local space has the terrain's corner at the origin, and x/z increasing to m_size.
+    glm::dmat4 getLocalToWorldMatrix() const;
+
+    bool sampleLocalHeight(const glm::dvec2& localPosition, double& outHeight) const;
+
+    glm::dvec3 sampleLocalNormal(const glm::dvec2& localPosition) const;
+
 private:
     struct NodeData {
         float minElevation = 0.0F;
         float maxElevation = 1.0F;
+        TileDataReference tile{nullptr};
+        // Camera travel distance at which this node's split decision may change, and the minimum of that over the
+        // whole subtree. Nodes are only re-evaluated once the accumulated camera travel reaches these.
+        double splitExpireTravel = 0.0;
+        double subtreeExpireTravel = 0.0;
     };
+
+    // Changes requested while traversing in parallel, applied on the calling thread afterwards, in task order.
+    struct NodeCommand {
+        enum Type : uint8_t {
+            Type_UseTile = 0, // Look up or touch the node's tile, and update its load priority.
+            Type_Split = 1,
+            Type_Merge = 2,
+        };
+
+        TraversalInfo node;
+        Type type;
+        uint8_t visibility;
+        float priority;
+    };
+
+    struct RaycastNode {
+        TraversalInfo node;
+        double entryDistance;
+        double exitDistance;
+    };
+
+    bool raycastLocal(const glm::dvec3& origin, const glm::dvec3& direction, double maxDistance, std::vector<RaycastNode>& stack, double& outDistance) const;
+
+    bool intersectNodeBounds(const TraversalInfo& node, const glm::dvec3& origin, const glm::dvec3& inverseDirection, double maxDistance, double& outEntryDistance, double& outExitDistance) const;
+
+    bool raycastNodeSurface(const RaycastNode& node, const glm::dvec3& origin, const glm::dvec3& direction, double& outDistance) const;
 private:
     Transform m_transform;
     uint32_t m_maxQuadtreeDepth;
@@ -122,8 +237,19 @@ private:
     double m_heightScale;
     double m_splitThreshold;
     std::vector<TileTreeNode> m_nodes;
-    std::vector<uint32_t> m_parentOffsets;
     std::vector<NodeData> m_nodeTileData;
+    std::vector<uint32_t> m_freeNodeBlocks; // Index of the first node of each free block of four
+    std::vector<TileTreeNode> m_compactedNodes;
+    std::vector<NodeData> m_compactedNodeTileData;
+    std::vector<std::vector<TraversalInfo>> m_traversalStacks;
+    std::vector<std::vector<NodeCommand>> m_nodeCommands; // Per traversal task
+    std::vector<std::vector<size_t>> m_visitedNodeIndices; // Per traversal task
+    double m_cameraTravel;
+    glm::dvec3 m_prevLocalCameraOrigin;
+    glm::dvec4 m_prevCameraProjection;
+    bool m_invalidated;
+    uint8_t m_parallelTraversalDepth;
+    size_t m_structureChangeCount; // Splits and merges since the last compaction
     std::shared_ptr<TerrainTileSupplier> m_tileSupplier;
 };
 
@@ -138,6 +264,14 @@ void TerrainTileQuadtree::traverseTreeNodes(std::vector<TraversalInfo>& traversa
     traversalInfo.treeDepth = 0;
     traversalInfo.quadIndex = (QuadIndex)0;
 
+    traverseTreeNodes(traversalInfo, traversalStack, callback);
+}
+
+template<class Fn>
+void TerrainTileQuadtree::traverseTreeNodes(const TraversalInfo& rootTraversalInfo, std::vector<TraversalInfo>& traversalStack, Fn callback) {
+
+    TraversalInfo traversalInfo = rootTraversalInfo;
+
     traversalStack.clear();
     traversalStack.emplace_back(traversalInfo);
 
@@ -159,7 +293,7 @@ void TerrainTileQuadtree::traverseTreeNodes(std::vector<TraversalInfo>& traversa
         if (!hasChildren(traversalInfo.nodeIndex))
             continue;
 
-        size_t firstChildIndex = traversalInfo.nodeIndex + m_nodes[traversalInfo.nodeIndex].childOffset;
+        size_t firstChildIndex = m_nodes[traversalInfo.nodeIndex].firstChildIndex;
 
         for (int i = 3; i >= 0; --i) { // Push children in reverse order, so they are popped in ascending order.
             traversalStack.emplace_back(TraversalInfo{
@@ -172,5 +306,39 @@ void TerrainTileQuadtree::traverseTreeNodes(std::vector<TraversalInfo>& traversa
     }
 }
 
+template<class Fn>
+void TerrainTileQuadtree::traverseTreeNodesParallel(uint8_t forkDepth, std::vector<std::vector<TraversalInfo>>& traversalStacks, Fn callback) {
+    PROFILE_SCOPE("TerrainTileQuadtree::traverseTreeNodesParallel")
+
+    if (traversalStacks.size() < getParallelTraversalTaskCount(forkDepth))
+        traversalStacks.resize(getParallelTraversalTaskCount(forkDepth));
+
+    std::vector<TraversalInfo> forkNodes;
+
+    traverseTreeNodes(traversalStacks[0], [&](TerrainTileQuadtree* tileQuadtree, const TraversalInfo& traversalInfo) {
+        if (forkDepth != 0 && traversalInfo.treeDepth == forkDepth) {
+            forkNodes.emplace_back(traversalInfo);
+            return true; // Traversed by its own task below
+        }
+        return (bool)callback(tileQuadtree, traversalInfo, (size_t)0);
+    });
+
+    if (forkNodes.empty())
+        return;
+
+    auto traverseForkNodes = [&](size_t rangeStart, size_t rangeEnd) {
+        for (size_t i = rangeStart; i < rangeEnd; ++i) {
+            size_t taskIndex = i + 1;
+            traverseTreeNodes(forkNodes[i], traversalStacks[taskIndex], [&](TerrainTileQuadtree* tileQuadtree, const TraversalInfo& traversalInfo) {
+                return (bool)callback(tileQuadtree, traversalInfo, taskIndex);
+            });
+        }
+    };
+
+    // One task per subtree. Their sizes vary a lot, so more tasks than threads balances better.
+    auto futures = ThreadUtils::parallel_range(forkNodes.size(), 1, forkNodes.size(), traverseForkNodes);
+    ThreadUtils::wait(futures);
+}
+
 
 #endif //WORLDENGINE_TERRAINTILEQUADTREE_H
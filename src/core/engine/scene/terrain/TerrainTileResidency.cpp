@@ -0,0 +1,188 @@
+#include "core/engine/scene/terrain/TerrainTileResidency.h"
+#include "core/engine/scene/terrain/TerrainTileSupplier.h"
+#include "core/util/Profiler.h"
+
+uint32_t TerrainTileResidency::s_instanceCount = 0;
+
+TerrainTileResidency::TerrainTileResidency(const std::string& name, size_t budgetBytes):
+        m_name(name + "[" + std::to_string(s_instanceCount++) + "]"),
+        m_head(nullptr),
+        m_tail(nullptr),
+        m_idleBegin(nullptr),
+        m_frame(1),
+        m_budgetBytes(budgetBytes),
+        m_idleTimeoutNanoseconds((uint64_t)(10.0 * 1e+9)),
+        m_expireTimeoutNanoseconds((uint64_t)(30.0 * 1e+9)) {
+    m_counterNames[0] = m_name + " hits";
+    m_counterNames[1] = m_name + " misses";
+    m_counterNames[2] = m_name + " evictions";
+    m_counterNames[3] = m_name + " resident tiles";
+    m_counterNames[4] = m_name + " resident MiB";
+    m_counterNames[5] = m_name + " budget MiB";
+}
+
+TerrainTileResidency::~TerrainTileResidency() {
+    // Tiles are owned by the supplier. Only the links are cleared.
+    while (m_head != nullptr)
+        unlink(m_head);
+}
+
+void TerrainTileResidency::insert(TileData* tileData) {
+    assert(tileData != nullptr && tileData->residencyPrev == nullptr && tileData->residencyNext == nullptr && tileData != m_head);
+
+    ++m_stats.misses;
+    ++m_stats.residentTileCount;
+
+    tileData->residentBytes = getTileDataSize(tileData);
+    m_stats.residentBytes += tileData->residentBytes;
+
+    tileData->idle = false;
+    tileData->timeLastUsed = Time::now();
+    tileData->residencyFrame = m_frame;
+    pushFront(tileData);
+}
+
+bool TerrainTileResidency::touch(TileData* tileData) {
+    ++m_stats.hits;
+
+    tileData->timeLastUsed = Time::now();
+    tileData->residencyFrame = m_frame;
+
+    bool wasIdle = tileData->idle;
+    tileData->idle = false;
+
+    if (tileData != m_head) {
+        unlink(tileData);
+        pushFront(tileData);
+    }
+
+    return wasIdle;
+}
+
+void TerrainTileResidency::remove(TileData* tileData) {
+    unlink(tileData);
+    --m_stats.residentTileCount;
+    m_stats.residentBytes -= tileData->residentBytes;
+    tileData->residentBytes = 0;
+}
+
+void TerrainTileResidency::updateResidentBytes(TileData* tileData) {
+    size_t residentBytes = getTileDataSize(tileData);
+    m_stats.residentBytes = m_stats.residentBytes - tileData->residentBytes + residentBytes;
+    tileData->residentBytes = residentBytes;
+}
+
+void TerrainTileResidency::update(std::vector<TileData*>& outEvictedTiles) {
+    PROFILE_SCOPE("TerrainTileResidency::update")
+
+    auto now = Time::now();
+
+    // Idle tiles are always a suffix of the list, so only the tiles which became idle since the last update are visited.
+    TileData* tileData = m_idleBegin != nullptr ? m_idleBegin->residencyPrev : m_tail;
+    while (tileData != nullptr && Time::nanoseconds(tileData->timeLastUsed, now) > m_idleTimeoutNanoseconds) {
+        if (tileData->state == TileData::State_Requested)
+            tileData->state = TileData::State_None; // State did not progress to pending or available, so un-request this tile.
+        tileData->idle = true;
+
+        m_idleBegin = tileData;
+        tileData = tileData->residencyPrev;
+    }
+
+    // Evict from the least recently used end. Tiles which are still loading are skipped rather than stopping the
+    // search, since the supplier may not be able to cancel them.
+    tileData = m_tail;
+    while (tileData != nullptr) {
+        bool expired = tileData->idle && Time::nanoseconds(tileData->timeLastUsed, now) > m_expireTimeoutNanoseconds;
+        bool overBudget = m_stats.residentBytes > m_budgetBytes && tileData->residencyFrame != m_frame;
+        if (!expired && !overBudget)
+            break; // Every tile before this one was used more recently.
+
+        TileData* prev = tileData->residencyPrev;
+
+        if (tileData->referenceCount > 1) {
+            // Referenced by something other than the supplier's own reference, such as a quadtree node which has not
+            // re-evaluated its split decision since it last used the tile. The tile is still in use, so it is moved
+            // back to the front as if it had been used this frame, and is not visited again by this update.
+            tileData->idle = false;
+            tileData->timeLastUsed = now;
+            tileData->residencyFrame = m_frame;
+            unlink(tileData);
+            pushFront(tileData);
+
+        } else if (tileData->state != TileData::State_Pending) {
+            remove(tileData);
+            ++m_stats.evictions;
+            outEvictedTiles.emplace_back(tileData);
+        }
+        tileData = prev;
+    }
+
+    ++m_frame;
+
+#if PROFILING_ENABLED
+    const double counterValues[6] = {
+            (double)m_stats.hits,
+            (double)m_stats.misses,
+            (double)m_stats.evictions,
+            (double)m_stats.residentTileCount,
+            (double)m_stats.residentBytes / (1024.0 * 1024.0),
+            (double)m_budgetBytes / (1024.0 * 1024.0)
+    };
+    PROFILE_COUNTERS(m_counterNames, counterValues, 6);
+#endif
+}
+
+size_t TerrainTileResidency::getBudgetBytes() const {
+    return m_budgetBytes;
+}
+
+void TerrainTileResidency::setBudgetBytes(size_t budgetBytes) {
+    m_budgetBytes = budgetBytes;
+}
+
+void TerrainTileResidency::setIdleTimeout(float idleTimeoutSeconds) {
+    m_idleTimeoutNanoseconds = (uint64_t)(idleTimeoutSeconds * 1e+9);
+}
+
+void TerrainTileResidency::setExpireTimeout(float expireTimeoutSeconds) {
+    m_expireTimeoutNanoseconds = (uint64_t)(expireTimeoutSeconds * 1e+9);
+}
+
+const TerrainTileResidency::Stats& TerrainTileResidency::getStats() const {
+    return m_stats;
+}
+
+size_t TerrainTileResidency::getTileDataSize(const TileData* tileData) {
+    size_t size = sizeof(TileData);
+    if (tileData->heightData != nullptr)
+        size += (size_t)tileData->heightDataResolution.x * (size_t)tileData->heightDataResolution.y * sizeof(short);
+    return size;
+}
+
+void TerrainTileResidency::pushFront(TileData* tileData) {
+    tileData->residencyPrev = nullptr;
+    tileData->residencyNext = m_head;
+    if (m_head != nullptr)
+        m_head->residencyPrev = tileData;
+    m_head = tileData;
+    if (m_tail == nullptr)
+        m_tail = tileData;
+}
+
+void TerrainTileResidency::unlink(TileData* tileData) {
+    if (tileData == m_idleBegin)
+        m_idleBegin = tileData->residencyNext; // Still idle, or null if this was the last tile.
+
+    if (tileData->residencyPrev != nullptr)
+        tileData->residencyPrev->residencyNext = tileData->residencyNext;
+    else
+        m_head = tileData->residencyNext;
+
+    if (tileData->residencyNext != nullptr)
+        tileData->residencyNext->residencyPrev = tileData->residencyPrev;
+    else
+        m_tail = tileData->residencyPrev;
+
+    tileData->residencyPrev = nullptr;
+    tileData->residencyNext = nullptr;
+}
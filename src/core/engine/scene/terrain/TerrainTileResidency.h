@@ -0,0 +1,84 @@
+
+#ifndef WORLDENGINE_TERRAINTILERESIDENCY_H
+#define WORLDENGINE_TERRAINTILERESIDENCY_H
+
+#include "core/core.h"
+#include "core/util/Time.h"
+
+struct TileData;
+
+// Tracks the tiles held by a TerrainTileSupplier in least recently used order, using an intrusive list threaded through
+// TileData, so every operation is O(1) and nothing scans the whole set of tiles. Tiles unused for longer than the idle
+// timeout are marked idle, which un-requests them if they have not started loading. Once the resident size exceeds the
+// byte budget, or an idle tile passes the expire timeout, the least recently used tiles are handed back to the
+// supplier to be deleted. Tiles used since the last update, tiles still loading, and tiles referenced by anything other
+// than the supplier are never evicted, so the budget is a soft limit when the quadtree needs more tiles than fit in it.
+class TerrainTileResidency {
+    NO_COPY(TerrainTileResidency);
+    NO_MOVE(TerrainTileResidency);
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t residentTileCount = 0;
+        size_t residentBytes = 0;
+    };
+
+public:
+    explicit TerrainTileResidency(const std::string& name, size_t budgetBytes = 64 * 1024 * 1024);
+
+    ~TerrainTileResidency();
+
+    // Adds a tile which was just created for a request that missed, as the most recently used tile.
+    void insert(TileData* tileData);
+
+    // Marks a resident tile as used by a request that hit. Returns true if the tile was idle, in which case the supplier
+    // should request its data again if needed.
+    bool touch(TileData* tileData);
+
+    // Removes a tile without counting it as evicted.
+    void remove(TileData* tileData);
+
+    // Updates the accounted size of a tile, after its data was loaded or released.
+    void updateResidentBytes(TileData* tileData);
+
+    // Marks newly idle tiles, and appends the tiles to evict to outEvictedTiles. Evicted tiles are no longer tracked,
+    // and the supplier is responsible for deleting them. Also publishes the stats as profiler counters, prefixed with
+    // the name and an instance index.
+    void update(std::vector<TileData*>& outEvictedTiles);
+
+    size_t getBudgetBytes() const;
+
+    void setBudgetBytes(size_t budgetBytes);
+
+    void setIdleTimeout(float idleTimeoutSeconds);
+
+    void setExpireTimeout(float expireTimeoutSeconds);
+
+    const Stats& getStats() const;
+
+    static size_t getTileDataSize(const TileData* tileData);
+
+private:
+    void pushFront(TileData* tileData);
+
+    void unlink(TileData* tileData);
+
+private:
+    std::string m_name;
+    std::string m_counterNames[6]; // Built once so that publishing the counters does not allocate every frame.
+    TileData* m_head; // Most recently used
+    TileData* m_tail; // Least recently used
+    TileData* m_idleBegin; // Most recently used idle tile. Every tile after it is idle.
+    uint64_t m_frame;
+    size_t m_budgetBytes;
+    uint64_t m_idleTimeoutNanoseconds;
+    uint64_t m_expireTimeoutNanoseconds;
+    Stats m_stats;
+
+    static uint32_t s_instanceCount; // Distinguishes the counters of each supplier.
+};
+
+
+#endif //WORLDENGINE_TERRAINTILERESIDENCY_H
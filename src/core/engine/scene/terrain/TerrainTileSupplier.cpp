@@ -28,7 +28,13 @@ TileData::TileData(TerrainTileSupplier* tileSupplier, uint32_t tileTextureIndex,
         heightDataResolution(0, 0),
         heightData(nullptr),
         timeLastUsed(Time::now()),
+        timeRetry(Time::zero_moment),
         priority(std::numeric_limits<float>::max()),
+        residencyPrev(nullptr),
+        residencyNext(nullptr),
+        residentBytes(0),
+        residencyFrame(0),
+        loadFailureCount(0),
         state(State_None),
         idle(false),
         deleted(false) {
@@ -42,6 +48,8 @@ TileData::TileData(TerrainTileSupplier* tileSupplier, uint32_t tileTextureIndex,
 }
 
 TileData::~TileData() {
+    delete[] heightData;
+
 //    glm::uvec4 id = debugGetTileId(tileOffset, tileSize);
 //    --allocCounter;
 //    LOG_DEBUG("TileData [%u %u, %u %u] deleted - %zu tiles exist", id.x, id.y, id.y, id.z, allocCounter);
@@ -80,6 +88,7 @@ TileDataReference& TileDataReference::operator=(std::nullptr_t) {
 
 TileDataReference& TileDataReference::operator=(const TileDataReference& copy) {
     if (&copy != this) {
+        release();
         m_tileData = copy.m_tileData;
         if (m_tileData != nullptr)
             ++m_tileData->referenceCount;
@@ -89,6 +98,7 @@ TileDataReference& TileDataReference::operator=(const TileDataReference& copy) {
 
 TileDataReference& TileDataReference::operator=(TileDataReference&& move) noexcept {
     if (&move != this) {
+        release();
         m_tileData = std::exchange(move.m_tileData, nullptr);
     }
     return *this;
@@ -114,7 +124,7 @@ bool TileDataReference::operator!=(const TileDataReference& rhs) const {
 
 void TileDataReference::notifyUsed() {
     assert(valid());
-    m_tileData->timeLastUsed = Time::now();
+    m_tileData->tileSupplier->notifyTileUsed(m_tileData);
 }
 
 bool TileDataReference::valid() const {
@@ -192,6 +202,18 @@ TerrainTileSupplier::TerrainTileSupplier() {
 TerrainTileSupplier::~TerrainTileSupplier() {
 }
 
+void TerrainTileSupplier::notifyTileUsed(TileData* tileData) {
+    tileData->timeLastUsed = Time::now();
+}
+
+bool TerrainTileSupplier::sampleHeight(const glm::dvec2& normalizedCoordinate, float& outHeight) const {
+    return false;
+}
+
+glm::uvec2 TerrainTileSupplier::getHeightResolution() const {
+    return glm::uvec2(0);
+}
+
 
 
 
@@ -21,6 +21,7 @@ struct TileData {
         State_Requested = 1,
         State_Pending = 2,
         State_Available = 3,
+        State_Failed = 4, // Loading failed too many times. The tile is never requested again.
     };
 
     TerrainTileSupplier* tileSupplier;
@@ -30,16 +31,22 @@ struct TileData {
     glm::dvec2 tileSize;
     float minHeight;
     float maxHeight;
-    float* heightData;
+    short* heightData; // Float16
     glm::uvec2 heightDataResolution;
     Time::moment_t timeLastUsed;
     Time::moment_t timeRequested;
     Time::moment_t timeProcessed;
+    Time::moment_t timeRetry; // A tile whose load failed is not dispatched again before this time
     float priority;
+    TileData* residencyPrev; // More recently used neighbour in the supplier's TerrainTileResidency list
+    TileData* residencyNext; // Less recently used neighbour in the supplier's TerrainTileResidency list
+    size_t residentBytes;
+    uint64_t residencyFrame; // Residency frame in which this tile was last used
+    uint8_t loadFailureCount;
     union {
         uint8_t _flags;
         struct {
-            State state : 2;
+            State state : 3;
             bool idle: 1;
             bool deleted: 1;
         };
@@ -116,6 +123,21 @@ public:
 
     virtual TileDataReference getTile(const glm::dvec2& tileOffset, const glm::dvec2& tileSize) = 0;
 
+    // Marks a tile as used without looking it up, for callers which hold on to a TileDataReference between frames.
+    virtual void notifyTileUsed(TileData* tileData);
+
+    // Bilinearly samples the height at a normalized terrain coordinate from height data held on the CPU. Returns false
+    // if the supplier has none. May be called from any thread, but not concurrently with update.
+    virtual bool sampleHeight(const glm::dvec2& normalizedCoordinate, float& outHeight) const;
+
+    // Resolution of the heights sampled by sampleHeight, or zero if the supplier has none.
+    virtual glm::uvec2 getHeightResolution() const;
+
+protected:
+    // Samples between texel centers the same way the GPU samples the heightmap, clamping to the edge.
+    template<class Fn>
+    static float sampleBilinear(const glm::dvec2& normalizedCoordinate, const glm::uvec2& resolution, Fn getTexel);
+
 private:
 
 };
@@ -126,5 +148,18 @@ private:
 
 
 
+template<class Fn>
+float TerrainTileSupplier::sampleBilinear(const glm::dvec2& normalizedCoordinate, const glm::uvec2& resolution, Fn getTexel) {
+    glm::dvec2 texelCoord = glm::clamp(normalizedCoordinate * glm::dvec2(resolution) - 0.5, glm::dvec2(0.0), glm::dvec2(resolution - glm::uvec2(1)));
+    glm::uvec2 coord0 = glm::uvec2(texelCoord);
+    glm::uvec2 coord1 = glm::min(coord0 + glm::uvec2(1), resolution - glm::uvec2(1));
+    glm::vec2 t = glm::vec2(texelCoord - glm::dvec2(coord0));
+
+    float h00 = getTexel(coord0.x, coord0.y);
+    float h10 = getTexel(coord1.x, coord0.y);
+    float h01 = getTexel(coord0.x, coord1.y);
+    float h11 = getTexel(coord1.x, coord1.y);
+    return glm::mix(glm::mix(h00, h10, t.x), glm::mix(h01, h11, t.x), t.y);
+}
 
 #endif //WORLDENGINE_TERRAINTILESUPPLIER_H
@@ -0,0 +1,178 @@
+#include "core/engine/scene/terrain/tileSupplier/CachedTerrainTileSupplier.h"
+#include "core/engine/scene/terrain/TerrainTileCache.h"
+#include "core/graphics/GraphicsManager.h"
+#include "core/graphics/Image2D.h"
+#include "core/graphics/ImageData.h"
+#include "core/graphics/ImageView.h"
+#include "core/util/Logger.h"
+#include "core/util/Profiler.h"
+
+CachedTerrainTileSupplier::CachedTerrainTileSupplier(const std::shared_ptr<TerrainTileCache>& tileCache, uint32_t maxResidentTextureSize, size_t tileBudgetBytes):
+        TerrainTileSupplier(),
+        m_tileCache(tileCache),
+        m_heightmapImageView(nullptr),
+        m_tileResidency("CachedTerrainTileSupplier", tileBudgetBytes),
+    m_tileLoader([this](const glm::dvec2& tileOffset, const glm::dvec2& tileSize, const std::atomic_bool& cancelled, TileLoadResult& outResult) {
+            return loadTile(tileOffset, tileSize, cancelled, outResult);
+        }) {
+    assert(m_tileCache != nullptr);
+
+    // The renderer samples a single texture per terrain, so the finest level which fits in the resident size is
+    // uploaded. Full resolution heights are only ever read on the CPU, one tile at a time.
+    uint32_t overviewLevel = 0;
+    while (overviewLevel + 1 < m_tileCache->getLevelCount() && glm::max(m_tileCache->getLevel(overviewLevel).resolution.x, m_tileCache->getLevel(overviewLevel).resolution.y) > maxResidentTextureSize)
+        ++overviewLevel;
+
+    auto t0 = Time::now();
+    ImageData* overviewImageData = m_tileCache->readLevelFloat16(overviewLevel);
+    assert(overviewImageData != nullptr);
+
+    LOG_INFO("Read %u x %u terrain overview from level %u of terrain tile cache \"%s\" in %.2f msec", overviewImageData->getWidth(), overviewImageData->getHeight(),
+             overviewLevel, m_tileCache->getFilePath().c_str(), Time::milliseconds(t0));
+
+    Image2DConfiguration heightmapImageConfig{};
+    heightmapImageConfig.device = Engine::graphics()->getDevice();
+    heightmapImageConfig.imageData = overviewImageData;
+    heightmapImageConfig.usage = vk::ImageUsageFlagBits::eSampled;
+    heightmapImageConfig.format = vk::Format::eR16Sfloat;
+    heightmapImageConfig.mipLevels = UINT32_MAX;
+    m_heightmapImage = std::shared_ptr<Image2D>(Image2D::create(heightmapImageConfig, "CachedTerrainTileSupplier-TerrainHeightmapImage"));
+
+    delete overviewImageData; // Only needed for the upload.
+
+    ImageViewConfiguration heightmapImageViewConfig{};
+    heightmapImageViewConfig.device = Engine::graphics()->getDevice();
+    heightmapImageViewConfig.format = heightmapImageConfig.format;
+    heightmapImageViewConfig.setImage(m_heightmapImage.get());
+    m_heightmapImageView = std::shared_ptr<ImageView>(ImageView::create(heightmapImageViewConfig, "CachedTerrainTileSupplier-TerrainHeightmapImageView"));
+
+    m_loadedTileImageViews.emplace_back(m_heightmapImageView.get());
+}
+
+CachedTerrainTileSupplier::~CachedTerrainTileSupplier() {
+    for (auto& [id, tileData] : m_tiles) {
+        m_tileResidency.remove(tileData);
+        deleteTile(tileData);
+    }
+}
+
+void CachedTerrainTileSupplier::update() {
+    PROFILE_SCOPE("CachedTerrainTileSupplier::update")
+
+    m_evictedTiles.clear();
+    m_tileResidency.update(m_evictedTiles);
+
+    for (TileData* tileData : m_evictedTiles) {
+        m_tiles.erase(getTileId(tileData->tileOffset, tileData->tileSize));
+        deleteTile(tileData);
+    }
+
+    m_tileLoader.update();
+
+    for (TileData* tileData : m_tileLoader.getPublishedTiles())
+        m_tileResidency.updateResidentBytes(tileData);
+}
+
+const std::vector<ImageView*>& CachedTerrainTileSupplier::getLoadedTileImageViews() const {
+    return m_loadedTileImageViews;
+}
+
+TileDataReference CachedTerrainTileSupplier::getTile(const glm::dvec2& tileOffset, const glm::dvec2& tileSize) {
+    glm::uvec4 id = getTileId(tileOffset, tileSize);
+
+    auto it = m_tiles.find(id);
+    if (it != m_tiles.end()) {
+        TileData* tileData = it->second;
+        notifyTileUsed(tileData);
+        return TileDataReference(tileData);
+    }
+
+    // Tile was not already loaded. Request it.
+    auto result = m_tiles.insert(std::make_pair(id, new TileData(this, UINT32_MAX, tileOffset, tileSize)));
+    assert(result.second && "Tile ID conflict");
+
+    TileData* tileData = result.first->second;
+    tileData->referenceCount = 1; // Hold a fake reference to keep this tile alive while it's resident.
+    m_tileResidency.insert(tileData);
+
+    requestTileData(tileData);
+    return TileDataReference(tileData);
+}
+
+void CachedTerrainTileSupplier::notifyTileUsed(TileData* tileData) {
+    if (m_tileResidency.touch(tileData))
+        requestTileData(tileData); // The tile was idle, and may have been un-requested.
+}
+
+bool CachedTerrainTileSupplier::sampleHeight(const glm::dvec2& normalizedCoordinate, float& outHeight) const {
+    // Full resolution heights straight from the mapped cache, so queries do not depend on which tiles are resident.
+    outHeight = sampleBilinear(normalizedCoordinate, getHeightResolution(), [this](uint32_t x, uint32_t y) {
+        return m_tileCache->readTexel(0, glm::uvec2(x, y));
+    });
+    return true;
+}
+
+glm::uvec2 CachedTerrainTileSupplier::getHeightResolution() const {
+    return m_tileCache->getResolution();
+}
+
+TerrainTileResidency& CachedTerrainTileSupplier::getTileResidency() {
+    return m_tileResidency;
+}
+
+const std::shared_ptr<TerrainTileCache>& CachedTerrainTileSupplier::getTileCache() const {
+    return m_tileCache;
+}
+
+void CachedTerrainTileSupplier::requestTileData(TileData* tileData) {
+    if (tileData->state == TileData::State_None) {
+        tileData->state = TileData::State_Requested;
+        tileData->timeRequested = Time::now();
+        m_tileLoader.request(tileData);
+    }
+}
+
+void CachedTerrainTileSupplier::deleteTile(TileData* tileData) {
+    m_tileLoader.remove(tileData);
+
+    assert(tileData->referenceCount > 0);
+    --tileData->referenceCount; // Release the fake reference. The tile is deleted once nothing else references it.
+    TileDataReference::invalidateAllReferences(tileData);
+}
+
+glm::uvec4 CachedTerrainTileSupplier::getTileId(const glm::dvec2& tileOffset, const glm::dvec2& tileSize) const {
+    // Identified by full resolution texel bounds, since the uploaded overview is too coarse to tell deep tiles apart.
+    glm::dvec2 resolution = glm::dvec2(m_tileCache->getResolution());
+    glm::uvec2 texelBoundMin = glm::uvec2(glm::floor(resolution * tileOffset));
+    glm::uvec2 texelBoundMax = glm::uvec2(glm::ceil(resolution * (tileOffset + tileSize)));
+    return glm::uvec4(texelBoundMin, texelBoundMax);
+}
+
+bool CachedTerrainTileSupplier::loadTile(const glm::dvec2& tileOffset, const glm::dvec2& tileSize, const std::atomic_bool& cancelled, TileLoadResult& outResult) const {
+    // Called from the tile loader's worker threads. The cache is immutable once opened.
+    if (!m_tileCache->getHeightRange(tileOffset, tileSize, outResult.minHeight, outResult.maxHeight))
+        return false;
+
+    // Read heights from the finest level where the tile spans no more than one cache tile's worth of texels, so every
+    // quadtree tile costs about the same to load no matter how deep it is.
+    uint32_t level = 0;
+    glm::uvec2 minCoord, maxCoord;
+    while (true) {
+        glm::dvec2 resolution = glm::dvec2(m_tileCache->getLevel(level).resolution);
+        minCoord = glm::min(glm::uvec2(glm::floor(resolution * tileOffset)), m_tileCache->getLevel(level).resolution - glm::uvec2(1));
+        maxCoord = glm::max(glm::uvec2(glm::ceil(resolution * (tileOffset + tileSize))), minCoord + glm::uvec2(1));
+        maxCoord = glm::min(maxCoord, m_tileCache->getLevel(level).resolution);
+
+        glm::uvec2 extent = maxCoord - minCoord;
+        if ((extent.x <= m_tileCache->getTileSize() && extent.y <= m_tileCache->getTileSize()) || level + 1 == m_tileCache->getLevelCount())
+            break;
+        ++level;
+    }
+
+    if (cancelled)
+        return false;
+
+    outResult.heightDataResolution = maxCoord - minCoord;
+    outResult.heightData.resize((size_t)outResult.heightDataResolution.x * (size_t)outResult.heightDataResolution.y);
+    return m_tileCache->readRegion(level, minCoord, maxCoord, outResult.heightData.data());
+}
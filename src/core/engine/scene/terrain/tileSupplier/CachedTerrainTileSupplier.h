@@ -0,0 +1,63 @@
+
+#ifndef WORLDENGINE_CACHEDTERRAINTILESUPPLIER_H
+#define WORLDENGINE_CACHEDTERRAINTILESUPPLIER_H
+
+#include "core/core.h"
+#include "core/engine/scene/terrain/TerrainTileSupplier.h"
+#include "core/engine/scene/terrain/TerrainTileLoader.h"
+#include "core/engine/scene/terrain/TerrainTileResidency.h"
+
+class TerrainTileCache;
+class Image2D;
+
+// Supplies tiles from a memory mapped TerrainTileCache. Tile height ranges come from the cache's tile table, and each
+// tile's heights are paged in from the finest cache level which covers it in at most one tile's worth of texels. Only
+// one overview level, no larger than the resident texture size, is uploaded to the GPU.
+class CachedTerrainTileSupplier : public TerrainTileSupplier {
+    NO_COPY(CachedTerrainTileSupplier);
+    NO_MOVE(CachedTerrainTileSupplier);
+public:
+    explicit CachedTerrainTileSupplier(const std::shared_ptr<TerrainTileCache>& tileCache, uint32_t maxResidentTextureSize = 4096, size_t tileBudgetBytes = 256 * 1024 * 1024);
+
+    virtual ~CachedTerrainTileSupplier() override;
+
+    virtual void update() override;
+
+    virtual const std::vector<ImageView*>& getLoadedTileImageViews() const override;
+
+    virtual TileDataReference getTile(const glm::dvec2& tileOffset, const glm::dvec2& tileSize) override;
+
+    virtual void notifyTileUsed(TileData* tileData) override;
+
+    virtual bool sampleHeight(const glm::dvec2& normalizedCoordinate, float& outHeight) const override;
+
+    virtual glm::uvec2 getHeightResolution() const override;
+
+    TerrainTileResidency& getTileResidency();
+
+    const std::shared_ptr<TerrainTileCache>& getTileCache() const;
+
+private:
+    void requestTileData(TileData* tileData);
+
+    void deleteTile(TileData* tileData);
+
+    glm::uvec4 getTileId(const glm::dvec2& tileOffset, const glm::dvec2& tileSize) const;
+
+    bool loadTile(const glm::dvec2& tileOffset, const glm::dvec2& tileSize, const std::atomic_bool& cancelled, TileLoadResult& outResult) const;
+
+private:
+    std::shared_ptr<TerrainTileCache> m_tileCache;
+    std::shared_ptr<Image2D> m_heightmapImage;
+    std::shared_ptr<ImageView> m_heightmapImageView;
+    std::vector<ImageView*> m_loadedTileImageViews;
+
+    std::unordered_map<glm::uvec4, TileData*> m_tiles;
+    TerrainTileResidency m_tileResidency;
+    std::vector<TileData*> m_evictedTiles;
+
+    TerrainTileLoader m_tileLoader; // Destroyed first, so no load is in progress while the cache is unmapped.
+};
+
+
+#endif //WORLDENGINE_CACHEDTERRAINTILESUPPLIER_H
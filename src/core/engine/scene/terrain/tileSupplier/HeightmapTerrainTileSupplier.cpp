@@ -11,6 +11,7 @@
 #include "core/graphics/Texture.h"
 #include "core/application/Engine.h"
 #include "core/util/Logger.h"
+#include "core/util/Profiler.h"
 #include "core/graphics/Fence.h"
 
 struct TerrainTileHeightRangePushConstants {
@@ -30,9 +31,10 @@ Sampler* HeightmapTerrainTileSupplier::s_heightRangeComputeSampler = nullptr;
 
 
 
-HeightmapTerrainTileSupplier::HeightmapTerrainTileSupplier(const ImageData* heightmapImageData) :
+HeightmapTerrainTileSupplier::HeightmapTerrainTileSupplier(const ImageData* heightmapImageData, size_t tileBudgetBytes) :
         TerrainTileSupplier(),
         m_heightmapImageView(nullptr),
+        m_tileResidency("HeightmapTerrainTileSupplier", tileBudgetBytes),
         m_tileComputeSharedDescriptorSet(nullptr),
         m_numUsedRequestTextureDescriptors(0),
         m_initialized(false) {
@@ -55,6 +57,12 @@ HeightmapTerrainTileSupplier::HeightmapTerrainTileSupplier(const ImageData* heig
 }
 
 HeightmapTerrainTileSupplier::~HeightmapTerrainTileSupplier() {
+    m_requestedTilesQueue.clear();
+    for (auto& [id, tileData] : m_tiles) {
+        m_tileResidency.remove(tileData);
+        deleteTile(tileData);
+    }
+
     delete m_tileComputeSharedDescriptorSet;
 
     for (RequestTexture* requestTexture : m_availableRequestTextures)
@@ -80,78 +88,26 @@ HeightmapTerrainTileSupplier::~HeightmapTerrainTileSupplier() {
 }
 
 void HeightmapTerrainTileSupplier::update() {
+    PROFILE_SCOPE("HeightmapTerrainTileSupplier::update")
 
     if (!m_initialized)
         init();
 
-    auto now = Time::now();
-    uint64_t tileIdleTimeoutNanoseconds = (uint64_t)(10 * 1e+9); // 30 seconds
-    uint64_t tileExpireTimeoutNanoseconds = (uint64_t)(30 * 1e+9); // 3 minutes
-
-
-//    m_requestedTilesQueue.erase(std::remove_if(m_requestedTilesQueue.begin(), m_requestedTilesQueue.end(), [](const TileData* tile) {
-//        return tile->state != TileData::State_Requested || tile->idle;
-//    }), m_requestedTilesQueue.end());
+    m_evictedTiles.clear();
+    m_tileResidency.update(m_evictedTiles);
 
-    m_requestedTilesQueue.clear();
-
-
-    // Deallocate tiles that have been idle for too long.
-    for (auto it = m_idleTiles.begin(); it != m_idleTiles.end();) {
-        glm::uvec4 id = it->first;
-        TileData* tileData = it->second;
-
-        if (!tileData->deleted && Time::nanoseconds(tileData->timeLastUsed, now) > tileExpireTimeoutNanoseconds) {
-            tileData->deleted = true;
-        }
-
-        if (!tileData->deleted) {
-            ++it;
-            continue;
-        }
-
-        if (tileData->tileTextureIndex != UINT32_MAX) {
-            assert(tileData->tileTextureIndex < m_tileTextures.size());
-            m_availableTileTextureIndices.emplace_back(tileData->tileTextureIndex);
-        }
-        TileDataReference::invalidateAllReferences(tileData);
-        it = m_idleTiles.erase(it);
+    for (TileData* tileData : m_evictedTiles) {
+        m_tiles.erase(getTileId(tileData->tileOffset, tileData->tileSize));
+        deleteTile(tileData);
     }
 
     // TODO: keep availableTileTextureIndices array sorted, and always reuse the lowest index.
     // TODO: shrink availableTileTextureIndices array if possible, actually deallocate the images at the end
 
-    // Update the active tiles
-    for (auto it = m_activeTiles.begin(); it != m_activeTiles.end();) {
-        glm::uvec4 id = it->first;
-        TileData* tileData = it->second;
-
-        assert(tileData->referenceCount > 0 && !tileData->deleted && !tileData->idle);
-
-        if (Time::nanoseconds(tileData->timeLastUsed, now) > tileIdleTimeoutNanoseconds) {
-            it = markIdle(it);
-            continue;
-        }
-
-        if (tileData->state == TileData::State_Requested) {
-            if (tileData->tileTextureIndex == UINT32_MAX) {
-                if (!m_availableTileTextureIndices.empty()) {
-                    tileData->tileTextureIndex = m_availableTileTextureIndices.back();
-                    m_availableTileTextureIndices.pop_back();
-
-                } else {
-                    tileData->tileTextureIndex = (uint32_t)m_tileTextures.size();
-                    m_tileTextures.emplace_back(TextureData{});
-                }
-            }
-
-            tileData->state = TileData::State_Pending;
-            tileData->timeRequested = Time::now();
-            m_requestedTilesQueue.emplace_back(tileData);
-        }
-
-        ++it;
-    }
+    // Tiles stay queued across frames until they are submitted. Drop any which were un-requested after becoming idle.
+    m_requestedTilesQueue.erase(std::remove_if(m_requestedTilesQueue.begin(), m_requestedTilesQueue.end(), [](const TileData* tile) {
+        return tile->state != TileData::State_Requested || tile->idle;
+    }), m_requestedTilesQueue.end());
 
     if (!m_requestedTilesQueue.empty()) {
 
@@ -162,12 +118,32 @@ void HeightmapTerrainTileSupplier::update() {
         vk::CommandBufferBeginInfo commandBeginInfo{};
         commandBeginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
 
+        // Submit the highest priority tiles first, since the number of request textures in flight is limited. Only the
+        // submitted tiles are popped from the heap, rather than sorting the whole queue.
+        auto lessPriority = [](const TileData* lhs, const TileData* rhs) {
+            return lhs->priority < rhs->priority;
+        };
+
+        std::make_heap(m_requestedTilesQueue.begin(), m_requestedTilesQueue.end(), lessPriority);
+
         while (!m_requestedTilesQueue.empty()) {
-            TileData* tile = m_requestedTilesQueue.back();
+            TileData* tile = m_requestedTilesQueue.front();
+
+            if (tile->tileTextureIndex == UINT32_MAX) {
+                if (!m_availableTileTextureIndices.empty()) {
+                    tile->tileTextureIndex = m_availableTileTextureIndices.back();
+                    m_availableTileTextureIndices.pop_back();
+
+                } else {
+                    tile->tileTextureIndex = (uint32_t)m_tileTextures.size();
+                    m_tileTextures.emplace_back(TextureData{});
+                }
+            }
 
             if (!assignRequestTexture(tile))
                 break;
 
+            std::pop_heap(m_requestedTilesQueue.begin(), m_requestedTilesQueue.end(), lessPriority);
             m_requestedTilesQueue.pop_back();
 
             tile->timeProcessed = Time::now();
@@ -243,40 +219,32 @@ const std::vector<ImageView*>& HeightmapTerrainTileSupplier::getLoadedTileImageV
 TileDataReference HeightmapTerrainTileSupplier::getTile(const glm::dvec2& tileOffset, const glm::dvec2& tileSize) {
     glm::uvec4 id = getTileId(tileOffset, tileSize);
 
-    TileData* tileData;
-
-    auto it = m_activeTiles.find(id);
-    if (it != m_activeTiles.end()) {
-        // Tile found in active list. Use it.
-        tileData = it->second;
-        return TileDataReference(tileData);
-    }
-
-    auto it1 = m_idleTiles.find(id);
-    if (it1 != m_idleTiles.end()) {
-        // Tile was found in the idle list. Move it back to the active list.
-        tileData = it1->second;
-
-        assert(tileData != nullptr);
+    auto it = m_tiles.find(id);
+    if (it != m_tiles.end()) {
+        TileData* tileData = it->second;
         assert(getTileId(tileData->tileOffset, tileData->tileSize) == id);
 
-        markActive(it1);
-
+        notifyTileUsed(tileData);
         return TileDataReference(tileData);
     }
 
     // Tile was not already loaded. Request it.
-    auto result = m_activeTiles.insert(std::make_pair(id, new TileData(this, UINT32_MAX, tileOffset, tileSize)));
+    auto result = m_tiles.insert(std::make_pair(id, new TileData(this, UINT32_MAX, tileOffset, tileSize)));
     assert(result.second && "Tile ID conflict");
 
-    tileData = result.first->second;
-    tileData->idle = false;
-    tileData->referenceCount = 1;
+    TileData* tileData = result.first->second;
+    tileData->referenceCount = 1; // Hold a fake reference to keep this tile alive while it's resident.
+    m_tileResidency.insert(tileData);
 
     requestTileData(tileData);
     return TileDataReference(tileData);
 }
 
+void HeightmapTerrainTileSupplier::notifyTileUsed(TileData* tileData) {
+    if (m_tileResidency.touch(tileData))
+        requestTileData(tileData); // The tile was idle, and may have been un-requested.
+}
+
 
 const std::shared_ptr<Image2D>& HeightmapTerrainTileSupplier::getHeightmapImage() const {
     return m_heightmapImage;
@@ -286,51 +254,30 @@ const std::shared_ptr<ImageView>& HeightmapTerrainTileSupplier::getHeightmapImag
     return m_heightmapImageView;
 }
 
-HeightmapTerrainTileSupplier::TileIterator HeightmapTerrainTileSupplier::markIdle(const TileIterator& it) {
-    glm::uvec4 id = it->first;
-    TileData* tile = it->second;
-
-    assert(tile != nullptr);
-    assert(!tile->idle);
-
-    assert(tile->referenceCount > 0);
-    --tile->referenceCount; // Remove the fake reference so this tile can be deleted if needed.
-
-    if (tile->state == TileData::State_Requested)
-        tile->state = TileData::State_None; // State did not progress to pending or available, so un-request this tile.
-    tile->idle = true;
-
-//    LOG_DEBUG("Tile [%u %u, %u %u] became idle after %.2f seconds", id.x, id.y, id.z, id.w, Time::milliseconds(tile->timeLastUsed, Time::now()) * 0.001);
-
-    auto it1 = m_activeTiles.erase(it);
-    m_idleTiles.insert(std::make_pair(id, tile));
-    return it1;
+TerrainTileResidency& HeightmapTerrainTileSupplier::getTileResidency() {
+    return m_tileResidency;
 }
 
-HeightmapTerrainTileSupplier::TileIterator HeightmapTerrainTileSupplier::markActive(const TileIterator& it) {
-    glm::uvec4 id = it->first;
-    TileData* tile = it->second;
-
-    assert(tile != nullptr);
-    assert(tile->idle);
-
-    if (tile->state == TileData::State_None)
-        requestTileData(tile);
-
-    tile->idle = false;
-    ++tile->referenceCount; // Hold a fake reference to keep this tile alive while it's active.
+void HeightmapTerrainTileSupplier::requestTileData(TileData* tileData) {
+    if (tileData->state == TileData::State_None) {
+        tileData->state = TileData::State_Requested;
+        tileData->timeRequested = Time::now();
+        m_requestedTilesQueue.emplace_back(tileData);
+    }
+}
 
-//    LOG_DEBUG("Tile [%u %u, %u %u] became active again", id.x, id.y, id.z, id.w);
-    tile->timeLastUsed = Time::now();
+void HeightmapTerrainTileSupplier::deleteTile(TileData* tileData) {
+    // Evicted tiles are never pending, so only the request queue can still refer to this tile.
+    m_requestedTilesQueue.erase(std::remove(m_requestedTilesQueue.begin(), m_requestedTilesQueue.end(), tileData), m_requestedTilesQueue.end());
 
-    auto it1 = m_idleTiles.erase(it);
-    m_activeTiles.insert(std::make_pair(id, tile));
-    return it1;
-}
+    if (tileData->tileTextureIndex != UINT32_MAX) {
+        assert(tileData->tileTextureIndex < m_tileTextures.size());
+        m_availableTileTextureIndices.emplace_back(tileData->tileTextureIndex);
+    }
 
-void HeightmapTerrainTileSupplier::requestTileData(TileData* tileData) {
-    if (tileData->state == TileData::State_None)
-        tileData->state = TileData::State_Requested;
+    assert(tileData->referenceCount > 0);
+    --tileData->referenceCount; // Release the fake reference. The tile is deleted once nothing else references it.
+    TileDataReference::invalidateAllReferences(tileData);
 }
 
 
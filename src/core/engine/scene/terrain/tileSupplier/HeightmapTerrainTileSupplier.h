@@ -3,6 +3,7 @@
 
 #include "core/core.h"
 #include "core/engine/scene/terrain/TerrainTileSupplier.h"
+#include "core/engine/scene/terrain/TerrainTileResidency.h"
 
 
 class ImageData;
@@ -23,10 +24,8 @@ struct ShutdownGraphicsEvent;
 class HeightmapTerrainTileSupplier : public TerrainTileSupplier {
     NO_COPY(HeightmapTerrainTileSupplier);
     NO_MOVE(HeightmapTerrainTileSupplier);
-private:
-    using TileIterator = std::unordered_map<glm::uvec4, TileData*>::iterator;
 public:
-    explicit HeightmapTerrainTileSupplier(const ImageData* heightmapImageData);
+    explicit HeightmapTerrainTileSupplier(const ImageData* heightmapImageData, size_t tileBudgetBytes = 64 * 1024 * 1024);
 
     ~HeightmapTerrainTileSupplier() override;
 
@@ -36,17 +35,19 @@ public:
 
     TileDataReference getTile(const glm::dvec2& tileOffset, const glm::dvec2& tileSize) override;
 
+    void notifyTileUsed(TileData* tileData) override;
+
     const std::shared_ptr<Image2D>& getHeightmapImage() const;
 
     const std::shared_ptr<ImageView>& getHeightmapImageView() const;
 
-private:
-    TileIterator markIdle(const TileIterator& it);
-
-    TileIterator markActive(const TileIterator& it);
+    TerrainTileResidency& getTileResidency();
 
+private:
     void requestTileData(TileData* tileData);
 
+    void deleteTile(TileData* tileData);
+
     glm::uvec2 getTileTextureSize(const glm::dvec2& normalizedSize) const;
 
     glm::uvec2 getLowerTexelCoord(const glm::dvec2& normalizedCoord) const;
@@ -97,8 +98,9 @@ private:
     std::vector<uint32_t> m_availableTileTextureIndices;
     std::vector<TextureData> m_tileTextures;
 
-    std::unordered_map<glm::uvec4, TileData*> m_activeTiles;
-    std::unordered_map<glm::uvec4, TileData*> m_idleTiles;
+    std::unordered_map<glm::uvec4, TileData*> m_tiles;
+    TerrainTileResidency m_tileResidency;
+    std::vector<TileData*> m_evictedTiles;
 
     std::vector<TileData*> m_requestedTilesQueue;
     std::vector<TileData*> m_pendingTilesQueue;
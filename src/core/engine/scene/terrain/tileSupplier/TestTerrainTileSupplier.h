@@ -3,6 +3,9 @@
 
 #include "core/core.h"
 #include "core/engine/scene/terrain/TerrainTileSupplier.h"
+#include "core/engine/scene/terrain/HeightRangePyramid.h"
+#include "core/engine/scene/terrain/TerrainTileLoader.h"
+#include "core/engine/scene/terrain/TerrainTileResidency.h"
 
 class ImageData;
 class Image2D;
@@ -10,9 +13,6 @@ class Image2D;
 class TestTerrainTileSupplier : public TerrainTileSupplier {
     NO_COPY(TestTerrainTileSupplier);
     NO_MOVE(TestTerrainTileSupplier);
-private:
-    using TileIterator = std::unordered_map<glm::uvec4, TileData*>::iterator;
-
 public:
     TestTerrainTileSupplier(ImageData* heightmapImageData);
 
@@ -24,14 +24,19 @@ public:
 
     virtual TileDataReference getTile(const glm::dvec2& tileOffset, const glm::dvec2& tileSize) override;
 
+    virtual void notifyTileUsed(TileData* tileData) override;
 
-private:
-    TileIterator markIdle(const TileIterator& it);
+    virtual bool sampleHeight(const glm::dvec2& normalizedCoordinate, float& outHeight) const override;
+
+    virtual glm::uvec2 getHeightResolution() const override;
 
-    TileIterator markActive(const TileIterator& it);
+    TerrainTileResidency& getTileResidency();
 
+private:
     void requestTileData(TileData* tileData);
 
+    void deleteTile(TileData* tileData);
+
     glm::uvec2 getTileTextureSize(const glm::dvec2& normalizedSize) const;
 
     glm::uvec2 getLowerTexelCoord(const glm::dvec2& normalizedCoord) const;
@@ -40,25 +45,21 @@ private:
 
     glm::uvec4 getTileId(const glm::dvec2& tileOffset, const glm::dvec2& tileSize) const;
 
-    void computeTerrainTileHeightRange(TileData* tileData);
-
-    void computeTerrainTileMipLevel(glm::uvec2 minCoord, glm::uvec2 maxCoord, uint32_t level);
+    bool computeTerrainTileHeightRange(const glm::dvec2& tileOffset, const glm::dvec2& tileSize, TileLoadResult& outResult) const;
 
 private:
 
     ImageData* m_heightmapImageData;
+    HeightRangePyramid m_heightRangePyramid;
     std::shared_ptr<Image2D> m_heightmapImage;
     std::shared_ptr<ImageView> m_heightmapImageView;
     std::vector<ImageView*> m_loadedTileImageViews;
 
-    std::unordered_map<glm::uvec4, TileData*> m_activeTiles;
-    std::unordered_map<glm::uvec4, TileData*> m_idleTiles;
-
-    std::vector<TileData*> m_requestedTilesQueue;
-    std::vector<TileData*> m_pendingTilesQueue;
+    std::unordered_map<glm::uvec4, TileData*> m_tiles;
+    TerrainTileResidency m_tileResidency;
+    std::vector<TileData*> m_evictedTiles;
 
-    float m_tileIdleTimeoutSeconds; // How many seconds until an unused active tile becomes idle.
-    float m_tileExpireTimeoutSeconds; // How many seconds until an idle tile expires and is deleted.
+    TerrainTileLoader m_tileLoader; // Destroyed first, so no load is in progress while the pyramid is destroyed.
 };
 
 
@@ -196,6 +196,7 @@ void PerformanceGraphUI::draw(double dt) {
     }
     drawHeaderBar();
     ImGui::Separator();
+    drawCounters();
     drawProfileContent(dt);
     ImGui::End();
 }
@@ -309,6 +310,29 @@ void PerformanceGraphUI::drawHeaderBar() {
     ImGui::EndGroup();
 }
 
+void PerformanceGraphUI::drawCounters() {
+    PROFILE_SCOPE("PerformanceGraphUI::drawCounters")
+
+    if (!m_profilingPaused)
+        Profiler::getCounters(m_counters);
+
+    if (m_counters.empty() || !ImGui::CollapsingHeader("Counters"))
+        return;
+
+    if (ImGui::BeginTable("CounterTable", 2, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_PadOuterX)) {
+        for (const auto& [name, value] : m_counters) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.10g", value);
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::Separator();
+}
+
 void PerformanceGraphUI::drawProfileContent(double dt) {
     PROFILE_SCOPE("PerformanceGraphUI::drawProfileContent")
 
@@ -112,6 +112,8 @@ public:
 private:
     void drawHeaderBar();
 
+    void drawCounters();
+
     void drawProfileContent(double dt);
 
     void drawProfileCallStackTree(double dt);
@@ -216,6 +218,7 @@ private:
     float m_rollingAverageUpdateFactor;
     std::string m_profileNameFilterText;
     std::vector<std::string> m_profileNameFilterSearchTerms;
+    std::vector<std::pair<std::string, double>> m_counters;
 };
 
 
@@ -1,28 +1,25 @@
 #include "core/graphics/Buffer.h"
 #include "core/graphics/DeviceMemory.h"
 #include "core/graphics/CommandPool.h"
-#include "core/graphics/FrameResource.h"
 #include "core/graphics/GraphicsManager.h"
+#include "core/graphics/UploadManager.h"
 #include "core/application/Engine.h"
-#include "core/engine/event/EventDispatcher.h"
-#include "core/engine/event/GraphicsEvents.h"
-#include "core/util/Util.h"
 #include "core/util/Logger.h"
 
-FrameResource<Buffer> Buffer::s_stagingBuffer = nullptr;
-vk::DeviceSize Buffer::s_maxStagingBufferSize = 128 * 1024 * 1024; // 128 MiB
-
 Buffer::Buffer(const WeakResource<vkr::Device>& device, const vk::Buffer& buffer, DeviceMemoryBlock* memory, vk::DeviceSize size, const vk::MemoryPropertyFlags& memoryProperties, const ResourceId& resourceId, const std::string& name):
         GraphicsResource(ResourceType_Buffer, device, name),
         m_buffer(buffer),
         m_memory(memory),
         m_size(size),
-        m_memoryProperties(memoryProperties) {
+        m_memoryProperties(memoryProperties),
+        m_lastUploadId(UploadManager::INVALID_UPLOAD) {
     //printf("Create Buffer\n");
 }
 
 Buffer::~Buffer() {
     //printf("Destroy Buffer\n");
+    // A copy into the buffer may still be recorded in an open upload batch, or executing in a submitted one.
+    Engine::graphics()->waitForUpload(m_lastUploadId);
     (**m_device).destroyBuffer(m_buffer);
     vfree(m_memory);
 }
@@ -115,28 +112,11 @@ bool Buffer::copy(Buffer* srcBuffer, Buffer* dstBuffer, vk::DeviceSize size, vk:
         return true;
     }
 
-    const vk::Queue& transferQueue = **Engine::graphics()->getQueue(QUEUE_TRANSFER_MAIN);
-    const vk::CommandBuffer& transferCommandBuffer = **Engine::graphics()->commandPool()->getNamedCommandBuffer("transfer_buffer");
-
-    vk::CommandBufferBeginInfo commandBeginInfo;
-    commandBeginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-
-    transferCommandBuffer.begin(commandBeginInfo);
-    vk::BufferCopy copyRegion;
-    copyRegion.setSrcOffset(srcOffset);
-    copyRegion.setDstOffset(dstOffset);
-    copyRegion.setSize(size);
-    transferCommandBuffer.copyBuffer(srcBuffer->getBuffer(), dstBuffer->getBuffer(), 1, &copyRegion);
-    transferCommandBuffer.end();
-
-    vk::SubmitInfo queueSumbitInfo;
-    queueSumbitInfo.setCommandBufferCount(1);
-    queueSumbitInfo.setPCommandBuffers(&transferCommandBuffer);
-    vk::Result result = transferQueue.submit(1, &queueSumbitInfo, nullptr);
-#if _DEBUG
-    assert(result == vk::Result::eSuccess);
-#endif
-    transferQueue.waitIdle();
+    // Copies are used to read results back to the host, so this waits for the batch holding the copy, and nothing later.
+    UploadManager& uploads = Engine::graphics()->uploads();
+    UploadManager::UploadId uploadId = uploads.copyBuffer(srcBuffer, dstBuffer, size, srcOffset, dstOffset);
+    uploads.wait(uploadId);
+    dstBuffer->m_lastUploadId = uploadId;
 
     return true;
 }
@@ -209,7 +189,7 @@ bool Buffer::upload(Buffer* dstBuffer, vk::DeviceSize offset, vk::DeviceSize siz
 #endif
 
     if (!dstBuffer->hasMemoryProperties(vk::MemoryPropertyFlagBits::eHostVisible)) {
-        return Buffer::stagedUpload(dstBuffer, nullptr, offset, bufferSize, data, srcStride, dstStride, elementSize);
+        return Buffer::stagedUpload(dstBuffer, offset, bufferSize, data, srcStride, dstStride, elementSize);
     } else {
         return Buffer::mappedUpload(dstBuffer, offset, bufferSize, data, srcStride, dstStride, elementSize);
     }
@@ -259,52 +239,18 @@ bool Buffer::isMapped() const {
     return m_memory->isMapped();
 }
 
-const Buffer* Buffer::getStagingBuffer() {
-    return s_stagingBuffer.get();
-}
-
-bool Buffer::stagedUpload(Buffer* dstBuffer, Buffer* stagingBuffer, vk::DeviceSize offset, vk::DeviceSize size, const void* data, vk::DeviceSize srcStride, vk::DeviceSize dstStride, vk::DeviceSize elementSize) {
+bool Buffer::stagedUpload(Buffer* dstBuffer, vk::DeviceSize offset, vk::DeviceSize size, const void* data, vk::DeviceSize srcStride, vk::DeviceSize dstStride, vk::DeviceSize elementSize) {
     if (size == 0) {
         return true; // We "successfully" uploaded nothing... This is valid
     }
 
-    vk::DeviceSize dstSize = size;
-    if (dstStride != 0) {
-        assert(elementSize != 0);
-        assert(dstStride >= elementSize);
-        vk::DeviceSize elementCount = size / elementSize;
-        assert(elementCount * elementSize == size); // if elementSize is provided, the size of the data buffer must be a multiple of elementSize
-        dstSize = elementCount * dstStride;
-    }
-
-    if (stagingBuffer == nullptr) {
-        reserveStagingBuffer(dstBuffer->getDevice(), dstSize);
-        stagingBuffer = s_stagingBuffer.get();
-    }
-
-    vk::DeviceSize stageSize = glm::min(stagingBuffer->getSize(), dstSize);
-    if (dstStride != 0) {
-        stageSize = FLOOR_TO_MULTIPLE(stageSize, dstStride);
-        assert(stageSize != 0);
+    UploadManager::UploadId uploadId = Engine::graphics()->uploads().uploadBuffer(dstBuffer, offset, size, data, srcStride, dstStride, elementSize);
+    if (uploadId == UploadManager::INVALID_UPLOAD) {
+        LOG_ERROR("Failed to stage data for buffer \"%s\"", dstBuffer->getName().c_str());
+        return false;
     }
 
-    vk::DeviceSize stageOffset = 0;
-    const uint8_t* stageData = static_cast<const uint8_t*>(data);
-
-
-    vk::DeviceSize stages = INT_DIV_CEIL(dstSize, stageSize);
-
-    for (vk::DeviceSize i = 0; i < stages; ++i, stageOffset += stageSize) {
-        if (!Buffer::mappedUpload(stagingBuffer, 0, stageSize, stageData + stageOffset, srcStride, dstStride, elementSize)) {
-            LOG_ERROR("Failed to upload data to staging buffer");
-            return false;
-        }
-
-        if (!Buffer::copy(stagingBuffer, dstBuffer, stageSize, 0, offset + stageOffset)) {
-            LOG_ERROR("Failed to copy data from staging buffer");
-            return false;
-        }
-    }
+    dstBuffer->m_lastUploadId = uploadId;
 
     return true;
 }
@@ -349,41 +295,3 @@ bool Buffer::mappedUpload(Buffer* dstBuffer, vk::DeviceSize offset, vk::DeviceSi
 
     return true;
 }
-
-void Buffer::resizeStagingBuffer(const WeakResource<vkr::Device>& device, vk::DeviceSize size) {
-    vk::DeviceSize stagingBufferSize = glm::min(size, s_maxStagingBufferSize);
-
-    if (!s_stagingBuffer)
-        Engine::eventDispatcher()->connect(&Buffer::onCleanupGraphics);
-
-    if (s_stagingBuffer) {
-        if (stagingBufferSize == s_stagingBuffer->getSize()) {
-            return; // Do nothing, we are resizing to the same size.
-        }
-
-        s_stagingBuffer.reset();
-    }
-
-    char c1[6] = "";
-    LOG_INFO("Resizing Buffer staging buffer to %.3f %s", Util::getMemorySizeMagnitude(stagingBufferSize, c1), c1);
-
-    BufferConfiguration stagingBufferConfig{};
-    stagingBufferConfig.device = device;
-    stagingBufferConfig.size = stagingBufferSize;
-    stagingBufferConfig.usage = vk::BufferUsageFlagBits::eTransferSrc;
-    stagingBufferConfig.memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
-    if (!FrameResource<Buffer>::create(s_stagingBuffer, stagingBufferConfig, "Buffer-UploadStagingBuffer")) {
-        LOG_FATAL("Failed to create buffer staging buffer");
-        assert(false);
-    }
-}
-
-void Buffer::reserveStagingBuffer(const WeakResource<vkr::Device>& device, vk::DeviceSize size) {
-    if (!s_stagingBuffer || size > s_stagingBuffer->getSize()) {
-        Buffer::resizeStagingBuffer(device, size);
-    }
-}
-
-void Buffer::onCleanupGraphics(ShutdownGraphicsEvent* event) {
-    s_stagingBuffer.reset();
-}
@@ -6,7 +6,6 @@
 #include "core/graphics/GraphicsResource.h"
 #include "core/graphics/FrameResource.h"
 
-struct ShutdownGraphicsEvent;
 class DeviceMemoryBlock;
 
 struct BufferConfiguration {
@@ -62,27 +61,17 @@ public:
     bool isMapped() const;
 
 public:
-    static const Buffer* getStagingBuffer();
-
-    static bool stagedUpload(Buffer* dstBuffer, Buffer* stagingBuffer, vk::DeviceSize offset, vk::DeviceSize size, const void* data, vk::DeviceSize srcStride = 0, vk::DeviceSize dstStride = 0, vk::DeviceSize elementSize = 0);
+    // Stages the data through the UploadManager. The copy completes asynchronously, before the next frame is rendered.
+    static bool stagedUpload(Buffer* dstBuffer, vk::DeviceSize offset, vk::DeviceSize size, const void* data, vk::DeviceSize srcStride = 0, vk::DeviceSize dstStride = 0, vk::DeviceSize elementSize = 0);
 
     static bool mappedUpload(Buffer* dstBuffer, vk::DeviceSize offset, vk::DeviceSize size, const void* data, vk::DeviceSize srcStride = 0, vk::DeviceSize dstStride = 0, vk::DeviceSize elementSize = 0);
 
-private:
-    static void resizeStagingBuffer(const WeakResource<vkr::Device>& device, vk::DeviceSize size);
-
-    static void reserveStagingBuffer(const WeakResource<vkr::Device>& device, vk::DeviceSize size);
-
-    static void onCleanupGraphics(ShutdownGraphicsEvent* event);
-
 private:
     vk::Buffer m_buffer;
     DeviceMemoryBlock* m_memory;
     vk::MemoryPropertyFlags m_memoryProperties;
     vk::DeviceSize m_size;
-
-    static FrameResource<Buffer> s_stagingBuffer;
-    static vk::DeviceSize s_maxStagingBufferSize;
+    uint64_t m_lastUploadId; // UploadManager batch of the last copy into this buffer
 };
 
 
@@ -3,6 +3,7 @@
 #include "core/graphics/ComputePipeline.h"
 #include "core/graphics/DescriptorSet.h"
 #include "core/graphics/GraphicsManager.h"
+#include "core/graphics/PipelineCache.h"
 #include "core/graphics/ShaderUtils.h"
 #include "core/application/Engine.h"
 #include "core/engine/event/GraphicsEvents.h"
@@ -130,7 +131,7 @@ bool ComputePipeline::recreate(const ComputePipelineConfiguration& computePipeli
     pipelineCreateInfo.setStage(computeShaderStageCreateInfo);
     pipelineCreateInfo.setLayout(m_pipelineLayout);
 
-    auto createComputePipelineResult = device.createComputePipeline(nullptr, pipelineCreateInfo);
+    auto createComputePipelineResult = device.createComputePipeline(Engine::graphics()->pipelineCache().getPipelineCache(), pipelineCreateInfo);
     if (createComputePipelineResult.result != vk::Result::eSuccess) {
         LOG_ERROR("Failed to create ComputePipeline: %s", vk::to_string(createComputePipelineResult.result).c_str());
         device.destroyShaderModule(computeShaderModule);
@@ -0,0 +1,234 @@
+#include "core/graphics/DescriptorAllocator.h"
+#include "core/graphics/DescriptorSet.h"
+#include "core/graphics/GraphicsManager.h"
+#include "core/application/Engine.h"
+#include "core/util/Util.h"
+#include "core/util/Logger.h"
+#include "core/util/Profiler.h"
+
+DescriptorAllocator::DescriptorAllocator(const WeakResource<vkr::Device>& device, const DescriptorAllocatorConfiguration& config, const std::string& name):
+        m_device(device, "DescriptorAllocator-Device"),
+        m_name(name),
+        m_descriptorsPerSet(config.descriptorsPerSet),
+        m_initialPoolSetCount(config.initialPoolSetCount),
+        m_maxPoolSetCount(config.maxPoolSetCount),
+        m_currentFrameIndex(0) {
+}
+
+DescriptorAllocator::~DescriptorAllocator() {
+    flushWrites();
+
+    for (FramePools& framePools : m_framePools) {
+        for (const vk::DescriptorPool& pool : framePools.pools)
+            (**m_device).destroyDescriptorPool(pool);
+        framePools.pools.clear();
+    }
+}
+
+DescriptorAllocator* DescriptorAllocator::create(const DescriptorAllocatorConfiguration& descriptorAllocatorConfiguration, const std::string& name) {
+    if (descriptorAllocatorConfiguration.initialPoolSetCount == 0 || descriptorAllocatorConfiguration.maxPoolSetCount < descriptorAllocatorConfiguration.initialPoolSetCount) {
+        LOG_ERROR("Unable to create DescriptorAllocator \"%s\": Invalid pool set counts [initial: %u, max: %u]", name.c_str(), descriptorAllocatorConfiguration.initialPoolSetCount, descriptorAllocatorConfiguration.maxPoolSetCount);
+        return nullptr;
+    }
+
+    return new DescriptorAllocator(descriptorAllocatorConfiguration.device, descriptorAllocatorConfiguration, name);
+}
+
+void DescriptorAllocator::beginFrame(uint32_t frameIndex) {
+    PROFILE_SCOPE("DescriptorAllocator::beginFrame");
+    assert(frameIndex < CONCURRENT_FRAMES);
+
+    m_currentFrameIndex = frameIndex;
+    FramePools& framePools = m_framePools[frameIndex];
+
+    // Only the pools which were allocated from need resetting. Resetting returns every set to the pool at once. The
+    // index is one past the last pool if creating a new pool failed.
+    size_t usedPoolCount = glm::min(framePools.currentPoolIndex + 1, framePools.pools.size());
+    for (size_t i = 0; i < usedPoolCount; ++i)
+        (**m_device).resetDescriptorPool(framePools.pools[i]);
+
+    framePools.currentPoolIndex = 0;
+    framePools.transientDescriptorSets.clear();
+}
+
+vk::DescriptorSet DescriptorAllocator::allocateTransient(const DescriptorSetLayout* descriptorSetLayout) {
+    assert(descriptorSetLayout != nullptr);
+
+    FramePools& framePools = m_framePools[m_currentFrameIndex];
+
+    vk::DescriptorSetAllocateInfo allocateInfo;
+    allocateInfo.setDescriptorSetCount(1);
+    allocateInfo.setPSetLayouts(&descriptorSetLayout->getDescriptorSetLayout());
+
+    while (true) {
+        bool createdPool = false;
+        if (framePools.currentPoolIndex == framePools.pools.size()) {
+            // Every pool of this frame is full. Each new pool holds twice as many sets as the previous one.
+            uint32_t shift = (uint32_t)glm::min(framePools.pools.size(), (size_t)31);
+            uint64_t maxSets = glm::min((uint64_t)m_initialPoolSetCount << shift, (uint64_t)m_maxPoolSetCount);
+            vk::DescriptorPool pool = createPool((uint32_t)maxSets);
+            if (!pool)
+                return nullptr;
+            framePools.pools.emplace_back(pool);
+            createdPool = true;
+        }
+
+        allocateInfo.setDescriptorPool(framePools.pools[framePools.currentPoolIndex]);
+
+        vk::DescriptorSet descriptorSet = nullptr;
+        vk::Result result = (**m_device).allocateDescriptorSets(&allocateInfo, &descriptorSet);
+        if (result == vk::Result::eSuccess)
+            return descriptorSet;
+
+        if (result != vk::Result::eErrorOutOfPoolMemory && result != vk::Result::eErrorFragmentedPool) {
+            LOG_ERROR("DescriptorAllocator \"%s\" failed to allocate a descriptor set: %s", m_name.c_str(), vk::to_string(result).c_str());
+            return nullptr;
+        }
+
+        if (createdPool) {
+            // The set does not fit in an empty pool, and would not fit in any other pool either.
+            LOG_ERROR("DescriptorAllocator \"%s\" failed to allocate a descriptor set: The layout needs more descriptors than a pool holds", m_name.c_str());
+            return nullptr;
+        }
+
+        ++framePools.currentPoolIndex;
+    }
+}
+
+vk::DescriptorSet DescriptorAllocator::getTransientDescriptorSet(const DescriptorSetWriter& writer) {
+    getContentKey(writer, m_tempContentKey);
+    uint64_t contentHash = Util::hashBytes(m_tempContentKey.data(), m_tempContentKey.size() * sizeof(uint64_t));
+
+    FramePools& framePools = m_framePools[m_currentFrameIndex];
+    auto range = framePools.transientDescriptorSets.equal_range(contentHash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.contentKey == m_tempContentKey)
+            return it->second.descriptorSet;
+    }
+
+    vk::DescriptorSet descriptorSet = allocateTransient(writer.m_layout);
+    if (!descriptorSet)
+        return nullptr;
+
+    enqueueWrites(writer, descriptorSet);
+    framePools.transientDescriptorSets.insert(std::make_pair(contentHash, TransientDescriptorSet{m_tempContentKey, descriptorSet}));
+    return descriptorSet;
+}
+
+void DescriptorAllocator::enqueueWrites(const DescriptorSetWriter& writer) {
+    enqueueWrites(writer, writer.m_dstSet);
+}
+
+void DescriptorAllocator::flushWrites() {
+    PROFILE_SCOPE("DescriptorAllocator::flushWrites");
+
+    if (m_pendingWrites.empty())
+        return;
+
+    for (auto& write : m_pendingWrites) {
+        if (write.pImageInfo != nullptr) write.pImageInfo = &m_pendingImageInfo[(size_t)write.pImageInfo - 1];
+        if (write.pBufferInfo != nullptr) write.pBufferInfo = &m_pendingBufferInfo[(size_t)write.pBufferInfo - 1];
+        if (write.pTexelBufferView != nullptr) write.pTexelBufferView = &m_pendingBufferViews[(size_t)write.pTexelBufferView - 1];
+    }
+
+    (**m_device).updateDescriptorSets((uint32_t)m_pendingWrites.size(), m_pendingWrites.data(), 0, nullptr);
+
+    m_pendingWrites.clear();
+    m_pendingImageInfo.clear();
+    m_pendingBufferInfo.clear();
+    m_pendingBufferViews.clear();
+}
+
+bool DescriptorAllocator::hasPendingWrites() const {
+    return !m_pendingWrites.empty();
+}
+
+size_t DescriptorAllocator::getPoolCount() const {
+    size_t count = 0;
+    for (const FramePools& framePools : m_framePools)
+        count += framePools.pools.size();
+    return count;
+}
+
+vk::DescriptorPool DescriptorAllocator::createPool(uint32_t maxSets) {
+    std::vector<vk::DescriptorPoolSize> poolSizes;
+    for (const auto& [descriptorType, descriptorsPerSet] : m_descriptorsPerSet) {
+        uint32_t descriptorCount = (uint32_t)glm::ceil(descriptorsPerSet * (float)maxSets);
+        if (descriptorCount == 0)
+            continue;
+
+        vk::DescriptorPoolSize& poolSize = poolSizes.emplace_back();
+        poolSize.setType(descriptorType);
+        poolSize.setDescriptorCount(descriptorCount);
+    }
+
+    vk::DescriptorPoolCreateInfo createInfo;
+    createInfo.setMaxSets(maxSets);
+    createInfo.setPoolSizes(poolSizes);
+
+    const vk::Device& device = **m_device;
+
+    vk::DescriptorPool pool = nullptr;
+    vk::Result result = device.createDescriptorPool(&createInfo, nullptr, &pool);
+    if (result != vk::Result::eSuccess) {
+        LOG_ERROR("DescriptorAllocator \"%s\" failed to create a descriptor pool for %u sets: %s", m_name.c_str(), maxSets, vk::to_string(result).c_str());
+        return nullptr;
+    }
+
+    std::string poolName = m_name + "-Frame" + std::to_string(m_currentFrameIndex) + "-Pool" + std::to_string(m_framePools[m_currentFrameIndex].pools.size());
+    Engine::graphics()->setObjectName(device, (uint64_t)(VkDescriptorPool)pool, vk::ObjectType::eDescriptorPool, poolName);
+
+    LOG_DEBUG("DescriptorAllocator \"%s\" created a descriptor pool for %u sets", m_name.c_str(), maxSets);
+    return pool;
+}
+
+void DescriptorAllocator::enqueueWrites(const DescriptorSetWriter& writer, const vk::DescriptorSet& dstSet) {
+    if (writer.m_writes.empty())
+        return;
+
+    // The writer's pointers are index + 1 into its own arrays. They are offset to index into the pending arrays.
+    size_t imageInfoOffset = m_pendingImageInfo.size();
+    size_t bufferInfoOffset = m_pendingBufferInfo.size();
+    size_t bufferViewOffset = m_pendingBufferViews.size();
+
+    m_pendingImageInfo.insert(m_pendingImageInfo.end(), writer.m_tempImageInfo.begin(), writer.m_tempImageInfo.end());
+    m_pendingBufferInfo.insert(m_pendingBufferInfo.end(), writer.m_tempBufferInfo.begin(), writer.m_tempBufferInfo.end());
+    m_pendingBufferViews.insert(m_pendingBufferViews.end(), writer.m_tempBufferViews.begin(), writer.m_tempBufferViews.end());
+
+    for (const vk::WriteDescriptorSet& writerWrite : writer.m_writes) {
+        vk::WriteDescriptorSet& write = m_pendingWrites.emplace_back(writerWrite);
+        write.setDstSet(dstSet);
+        if (write.pImageInfo != nullptr) write.pImageInfo = (vk::DescriptorImageInfo*)((size_t)write.pImageInfo + imageInfoOffset);
+        if (write.pBufferInfo != nullptr) write.pBufferInfo = (vk::DescriptorBufferInfo*)((size_t)write.pBufferInfo + bufferInfoOffset);
+        if (write.pTexelBufferView != nullptr) write.pTexelBufferView = (vk::BufferView*)((size_t)write.pTexelBufferView + bufferViewOffset);
+    }
+}
+
+void DescriptorAllocator::getContentKey(const DescriptorSetWriter& writer, std::vector<uint64_t>& outContentKey) {
+    // Built field by field, since the vulkan structs contain padding.
+    outContentKey.clear();
+    outContentKey.emplace_back((uint64_t)(VkDescriptorSetLayout)writer.m_layout->getDescriptorSetLayout());
+
+    for (const vk::WriteDescriptorSet& write : writer.m_writes) {
+        outContentKey.emplace_back(((uint64_t)write.dstBinding << 32) | (uint64_t)write.dstArrayElement);
+        outContentKey.emplace_back(((uint64_t)write.descriptorCount << 32) | (uint64_t)(uint32_t)write.descriptorType);
+
+        for (uint32_t i = 0; i < write.descriptorCount; ++i) {
+            if (write.pImageInfo != nullptr) {
+                const vk::DescriptorImageInfo& imageInfo = writer.m_tempImageInfo[(size_t)write.pImageInfo - 1 + i];
+                outContentKey.emplace_back((uint64_t)(VkSampler)imageInfo.sampler);
+                outContentKey.emplace_back((uint64_t)(VkImageView)imageInfo.imageView);
+                outContentKey.emplace_back((uint64_t)(uint32_t)imageInfo.imageLayout);
+            }
+            if (write.pBufferInfo != nullptr) {
+                const vk::DescriptorBufferInfo& bufferInfo = writer.m_tempBufferInfo[(size_t)write.pBufferInfo - 1 + i];
+                outContentKey.emplace_back((uint64_t)(VkBuffer)bufferInfo.buffer);
+                outContentKey.emplace_back((uint64_t)bufferInfo.offset);
+                outContentKey.emplace_back((uint64_t)bufferInfo.range);
+            }
+            if (write.pTexelBufferView != nullptr) {
+                outContentKey.emplace_back((uint64_t)(VkBufferView)writer.m_tempBufferViews[(size_t)write.pTexelBufferView - 1 + i]);
+            }
+        }
+    }
+}
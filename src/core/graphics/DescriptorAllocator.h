@@ -0,0 +1,112 @@
+
+#ifndef WORLDENGINE_DESCRIPTORALLOCATOR_H
+#define WORLDENGINE_DESCRIPTORALLOCATOR_H
+
+#include "core/core.h"
+#include "core/graphics/GraphicsResource.h"
+
+class DescriptorSetLayout;
+class DescriptorSetWriter;
+
+struct DescriptorAllocatorConfiguration {
+    WeakResource<vkr::Device> device;
+    uint32_t initialPoolSetCount = 64;
+    uint32_t maxPoolSetCount = 4096;
+
+    // Number of descriptors of each type reserved in a pool for every set it can hold.
+    std::unordered_map<vk::DescriptorType, float> descriptorsPerSet = {
+            {vk::DescriptorType::eSampler,              0.5F},
+            {vk::DescriptorType::eCombinedImageSampler, 4.0F},
+            {vk::DescriptorType::eSampledImage,         4.0F},
+            {vk::DescriptorType::eStorageImage,         1.0F},
+            {vk::DescriptorType::eUniformTexelBuffer,   1.0F},
+            {vk::DescriptorType::eStorageTexelBuffer,   1.0F},
+            {vk::DescriptorType::eUniformBuffer,        2.0F},
+            {vk::DescriptorType::eStorageBuffer,        2.0F},
+            {vk::DescriptorType::eUniformBufferDynamic, 1.0F},
+            {vk::DescriptorType::eStorageBufferDynamic, 1.0F},
+            {vk::DescriptorType::eInputAttachment,      0.5F}
+    };
+};
+
+// Allocates descriptor sets which only live for one frame, and batches descriptor writes.
+//
+// Each frame in flight owns a list of pools, which never free individual sets. When the current pool is full the next
+// one is used, and a new pool twice the size of the last one is created if there are none left. Every pool of a frame
+// is reset at once in beginFrame, after the frame's fence has signalled. Requesting a transient set with the same layout
+// and contents as one already allocated in the frame returns the existing set, so identical sets are only written once.
+//
+// DescriptorSetWriter::enqueue adds its writes to a pending batch instead of updating the set immediately. flushWrites
+// applies the whole batch with one vkUpdateDescriptorSets call, and must be called before any command buffer binds one
+// of the written sets. Not thread safe, it is used from the render thread like the rest of the graphics API.
+class DescriptorAllocator {
+    NO_COPY(DescriptorAllocator);
+    NO_MOVE(DescriptorAllocator);
+private:
+    struct TransientDescriptorSet {
+        std::vector<uint64_t> contentKey;
+        vk::DescriptorSet descriptorSet;
+    };
+
+    struct FramePools {
+        std::vector<vk::DescriptorPool> pools;
+        size_t currentPoolIndex = 0;
+        std::unordered_multimap<uint64_t, TransientDescriptorSet> transientDescriptorSets; // Content key hash to set
+    };
+
+    DescriptorAllocator(const WeakResource<vkr::Device>& device, const DescriptorAllocatorConfiguration& config, const std::string& name);
+
+public:
+    ~DescriptorAllocator();
+
+    static DescriptorAllocator* create(const DescriptorAllocatorConfiguration& descriptorAllocatorConfiguration, const std::string& name);
+
+    // Resets every pool used by the frame. The frame's fence must have signalled, since its sets are no longer valid.
+    void beginFrame(uint32_t frameIndex);
+
+    // Allocates an empty set from the current frame's pools. It is valid until this frame index begins again.
+    vk::DescriptorSet allocateTransient(const DescriptorSetLayout* descriptorSetLayout);
+
+    // Returns a set for the current frame with the writer's layout and contents, allocating and writing a new one only
+    // if no identical set was requested earlier in the frame. The writes are enqueued, not applied immediately.
+    vk::DescriptorSet getTransientDescriptorSet(const DescriptorSetWriter& writer);
+
+    void enqueueWrites(const DescriptorSetWriter& writer);
+
+    // Applies every enqueued write in a single update call.
+    void flushWrites();
+
+    bool hasPendingWrites() const;
+
+    size_t getPoolCount() const;
+
+private:
+    vk::DescriptorPool createPool(uint32_t maxSets);
+
+    void enqueueWrites(const DescriptorSetWriter& writer, const vk::DescriptorSet& dstSet);
+
+    // Flattens the layout and every written descriptor into the key. Sets are only shared when their keys are equal,
+    // the hash just selects the bucket.
+    static void getContentKey(const DescriptorSetWriter& writer, std::vector<uint64_t>& outContentKey);
+
+private:
+    SharedResource<vkr::Device> m_device;
+    std::string m_name;
+    std::unordered_map<vk::DescriptorType, float> m_descriptorsPerSet;
+    uint32_t m_initialPoolSetCount;
+    uint32_t m_maxPoolSetCount;
+
+    std::array<FramePools, CONCURRENT_FRAMES> m_framePools;
+    uint32_t m_currentFrameIndex;
+    std::vector<uint64_t> m_tempContentKey;
+
+    // Pointers in the pending writes hold an index + 1 into the info arrays until they are flushed, the same as
+    // DescriptorSetWriter, since the arrays may be reallocated while writes are being added.
+    std::vector<vk::WriteDescriptorSet> m_pendingWrites;
+    std::vector<vk::DescriptorImageInfo> m_pendingImageInfo;
+    std::vector<vk::DescriptorBufferInfo> m_pendingBufferInfo;
+    std::vector<vk::BufferView> m_pendingBufferViews;
+};
+
+
+#endif //WORLDENGINE_DESCRIPTORALLOCATOR_H
@@ -7,6 +7,7 @@
 #include "core/graphics/ImageView.h"
 #include "core/application/Engine.h"
 #include "core/graphics/GraphicsManager.h"
+#include "core/graphics/DescriptorAllocator.h"
 #include "core/util/Logger.h"
 
 DescriptorSetLayout::Cache DescriptorSetLayout::s_descriptorSetLayoutCache;
@@ -295,24 +296,30 @@ const SharedResource<DescriptorSetLayout>& DescriptorSet::getLayout() const {
 
 
 DescriptorSetWriter::DescriptorSetWriter(DescriptorSet* descriptorSet):
-        m_descriptorSet(descriptorSet) {
+        m_layout(descriptorSet->getLayout().get()),
+        m_dstSet(descriptorSet->getDescriptorSet()) {
 }
 
 DescriptorSetWriter::DescriptorSetWriter(const SharedResource<DescriptorSet>& descriptorSet):
-        m_descriptorSet(descriptorSet.get()) {
+        DescriptorSetWriter(descriptorSet.get()) {
 }
 
 DescriptorSetWriter::DescriptorSetWriter(const WeakResource<DescriptorSet>& descriptorSet):
-        m_descriptorSet(descriptorSet.lock("DescriptorSetWriter").get()) {
+        DescriptorSetWriter(descriptorSet.lock("DescriptorSetWriter").get()) {
+}
+
+DescriptorSetWriter::DescriptorSetWriter(const SharedResource<DescriptorSetLayout>& descriptorSetLayout):
+        m_layout(descriptorSetLayout.get()),
+        m_dstSet(nullptr) {
 }
 
 DescriptorSetWriter::~DescriptorSetWriter() = default;
 
 DescriptorSetWriter& DescriptorSetWriter::writeBuffer(uint32_t binding, const vk::DescriptorBufferInfo& bufferInfo) {
-    int bindingIndex = m_descriptorSet->getLayout()->findBindingIndex(binding);
+    int bindingIndex = m_layout->findBindingIndex(binding);
     assert(bindingIndex >= 0);
 
-    const auto& bindingInfo = m_descriptorSet->getLayout()->getBindingByIndex(bindingIndex);
+    const auto& bindingInfo = m_layout->getBindingByIndex(bindingIndex);
 
     assert(bindingInfo.descriptorCount == 1);
 
@@ -320,7 +327,7 @@ DescriptorSetWriter& DescriptorSetWriter::writeBuffer(uint32_t binding, const vk
     m_tempBufferInfo.emplace_back(bufferInfo);
 
     vk::WriteDescriptorSet& write = m_writes.emplace_back();
-    write.setDstSet(m_descriptorSet->getDescriptorSet());
+    write.setDstSet(m_dstSet);
     write.setDescriptorType(bindingInfo.descriptorType);
     write.setDstBinding(binding);
     write.setPBufferInfo((vk::DescriptorBufferInfo*)(firstIndex + 1));
@@ -347,10 +354,10 @@ DescriptorSetWriter& DescriptorSetWriter::writeBuffer(uint32_t binding, const Bu
 }
 
 DescriptorSetWriter& DescriptorSetWriter::writeTexelBufferView(uint32_t binding, const vk::BufferView& bufferView) {
-    int bindingIndex = m_descriptorSet->getLayout()->findBindingIndex(binding);
+    int bindingIndex = m_layout->findBindingIndex(binding);
     assert(bindingIndex >= 0);
 
-    const auto& bindingInfo = m_descriptorSet->getLayout()->getBindingByIndex(bindingIndex);
+    const auto& bindingInfo = m_layout->getBindingByIndex(bindingIndex);
 
     assert(bindingInfo.descriptorCount == 1);
 
@@ -358,7 +365,7 @@ DescriptorSetWriter& DescriptorSetWriter::writeTexelBufferView(uint32_t binding,
     m_tempBufferViews.emplace_back(bufferView);
 
     vk::WriteDescriptorSet& write = m_writes.emplace_back();
-    write.setDstSet(m_descriptorSet->getDescriptorSet());
+    write.setDstSet(m_dstSet);
     write.setDescriptorType(bindingInfo.descriptorType);
     write.setDstBinding(binding);
     write.setPTexelBufferView((vk::BufferView*)(firstIndex + 1));
@@ -373,14 +380,14 @@ DescriptorSetWriter& DescriptorSetWriter::writeTexelBufferView(uint32_t binding,
 }
 
 DescriptorSetWriter& DescriptorSetWriter::writeImage(uint32_t binding, const vk::DescriptorImageInfo* imageInfos, uint32_t arrayIndex, uint32_t arrayCount) {
-    int bindingIndex = m_descriptorSet->getLayout()->findBindingIndex(binding);
+    int bindingIndex = m_layout->findBindingIndex(binding);
 #if _DEBUG
     bool hasBinding = bindingIndex >= 0;
     assert(hasBinding);
 #endif
     assert(imageInfos != nullptr);
 
-    const auto& bindingInfo = m_descriptorSet->getLayout()->getBindingByIndex(bindingIndex);
+    const auto& bindingInfo = m_layout->getBindingByIndex(bindingIndex);
 
     assert(arrayCount > 0);
     assert((arrayIndex + arrayCount) <= bindingInfo.descriptorCount);
@@ -391,7 +398,7 @@ DescriptorSetWriter& DescriptorSetWriter::writeImage(uint32_t binding, const vk:
     }
 
     vk::WriteDescriptorSet& write = m_writes.emplace_back();
-    write.setDstSet(m_descriptorSet->getDescriptorSet());
+    write.setDstSet(m_dstSet);
     write.setDescriptorType(bindingInfo.descriptorType);
     write.setDstBinding(binding);
     // This is a horrible hack. The pointer directly has the value of firstIndex, which is later resolved to the correct pointer.
@@ -552,8 +559,9 @@ DescriptorSetWriter& DescriptorSetWriter::writeImage(uint32_t binding, const Tex
 }
 
 bool DescriptorSetWriter::write() {
+    assert(m_dstSet);
     if (!m_writes.empty()) {
-        const auto& device = m_descriptorSet->getDevice();
+        const auto& device = m_layout->getDevice();
         for (auto& write : m_writes) {
             if (write.pImageInfo != nullptr) write.pImageInfo = &m_tempImageInfo[(size_t)write.pImageInfo - 1];
             if (write.pBufferInfo != nullptr) write.pBufferInfo = &m_tempBufferInfo[(size_t)write.pBufferInfo - 1];
@@ -564,6 +572,15 @@ bool DescriptorSetWriter::write() {
     return true;
 }
 
+void DescriptorSetWriter::enqueue() {
+    assert(m_dstSet);
+    Engine::graphics()->descriptorAllocator().enqueueWrites(*this);
+}
+
+vk::DescriptorSet DescriptorSetWriter::writeTransient() {
+    return Engine::graphics()->descriptorAllocator().getTransientDescriptorSet(*this);
+}
+
 
 DescriptorSetLayout::Key::Key(const vk::DescriptorSetLayoutCreateInfo& rhs) {
     bindingCount = rhs.bindingCount;
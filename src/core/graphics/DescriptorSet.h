@@ -194,6 +194,7 @@ private:
 
 class DescriptorSetWriter {
     NO_COPY(DescriptorSetWriter);
+    friend class DescriptorAllocator;
 public:
     explicit DescriptorSetWriter(DescriptorSet* descriptorSet);
 
@@ -201,6 +202,9 @@ public:
 
     explicit DescriptorSetWriter(const WeakResource<DescriptorSet>& descriptorSet);
 
+    // Writes a transient descriptor set with this layout, which is allocated by writeTransient.
+    explicit DescriptorSetWriter(const SharedResource<DescriptorSetLayout>& descriptorSetLayout);
+
     ~DescriptorSetWriter();
 
     DescriptorSetWriter& writeBuffer(uint32_t binding, const vk::DescriptorBufferInfo& bufferInfo);
@@ -222,11 +226,19 @@ public:
     DescriptorSetWriter& writeImage(uint32_t binding, const Texture* const* textures, const vk::ImageLayout& imageLayout, uint32_t arrayIndex, uint32_t arrayCount);
     DescriptorSetWriter& writeImage(uint32_t binding, const Texture* texture, const vk::ImageLayout& imageLayout, uint32_t arrayIndex, uint32_t arrayCount);
 
+    // Updates the descriptor set immediately.
     bool write();
 
+    // Adds the writes to the DescriptorAllocator batch. The set is updated when the batch is flushed.
+    void enqueue();
+
+    // Returns a transient descriptor set holding these writes, valid for the current frame only.
+    vk::DescriptorSet writeTransient();
+
 private:
     std::vector<vk::WriteDescriptorSet> m_writes;
-    DescriptorSet* m_descriptorSet;
+    const DescriptorSetLayout* m_layout;
+    vk::DescriptorSet m_dstSet;
 
     std::vector<vk::BufferView> m_tempBufferViews;
     std::vector<vk::DescriptorBufferInfo> m_tempBufferInfo;
@@ -4,6 +4,7 @@
 
 #include "core/core.h"
 #include "core/graphics/GraphicsResource.h"
+#include "core/util/OffsetAllocator.h"
 
 class Buffer;
 
@@ -47,19 +48,11 @@ private:
 };
 
 
+// A single device memory allocation, sub-allocated by an OffsetAllocator, so allocating and freeing blocks is O(1) no
+// matter how many blocks the heap holds.
 class DeviceMemoryHeap : public GraphicsResource {
     friend class DeviceMemoryBlock;
 
-public:
-    struct BlockRange {
-#if _DEBUG
-        std::string name;
-#endif
-        vk::DeviceSize offset;
-        vk::DeviceSize size;
-        bool free;
-    };
-
 private:
     DeviceMemoryHeap(const WeakResource<vkr::Device>& device, const vk::DeviceMemory& deviceMemory, vk::DeviceSize size, const std::string& name);
 
@@ -84,56 +77,23 @@ public:
 
     bool freeBlock(DeviceMemoryBlock* block);
 
-    vk::DeviceSize getMaxAllocatableSize(vk::DeviceSize alignment = 0) const;
-
-private:
-    size_t findBlockIndex(vk::DeviceSize size, vk::DeviceSize alignment);
-
-    size_t freeBlocksBeginIndex();
-
-    size_t freeBlocksEndIndex();
-
-    size_t allocatedBlocksBeginIndex();
-
-    size_t allocatedBlocksEndIndex();
-
-    bool moveBlock(size_t srcBlockIndex, size_t dstBlockIndex);
+    bool canAllocate(vk::DeviceSize size, vk::DeviceSize alignment) const;
 
-    size_t resizeBlock(size_t blockIndex, vk::DeviceSize newSize);
-
-    size_t updateBlock(size_t blockIndex, const BlockRange& newBlock);
-
-    void insertBlock(const BlockRange& block);
-
-    size_t getBlockSequenceIndex(const BlockRange& block);
-
-    void insertBlockSequence(size_t index);
-
-    void eraseBlockSequence(size_t index);
-
-    bool isContiguous(const BlockRange& firstBlock, const BlockRange& secondBlock);
+    vk::DeviceSize getMaxAllocatableSize(vk::DeviceSize alignment = 0) const;
 
-    bool equalBlocks(const BlockRange& lhs, const BlockRange& rhs);
+    OffsetAllocator::Stats getStats() const;
 
+private:
     void map(DeviceMemoryBlock* block);
 
     void unmap(DeviceMemoryBlock* block);
 
-#if _DEBUG
-    void sanityCheckBlocks();
-
-    void sanityCheckSizeSequence();
-#endif
 private:
     vk::DeviceMemory m_deviceMemory;
     vk::DeviceSize m_size;
 
-    vk::DeviceSize m_allocatedBytes;
-
+    OffsetAllocator m_allocator;
     std::unordered_set<DeviceMemoryBlock*> m_allocatedBlocks;
-    std::vector<BlockRange> m_blocks;
-    std::vector<size_t> m_blockSizeSequence;
-    size_t m_numFreeBlocks;
 
     vk::DeviceSize m_mappedOffset;
     vk::DeviceSize m_mappedSize;
@@ -145,7 +105,7 @@ class DeviceMemoryBlock {
     friend class DeviceMemoryHeap;
 
 private:
-    DeviceMemoryBlock(DeviceMemoryHeap* heap, vk::DeviceSize offset, vk::DeviceSize size, vk::DeviceSize alignment);
+    DeviceMemoryBlock(DeviceMemoryHeap* heap, vk::DeviceSize offset, vk::DeviceSize size, vk::DeviceSize alignment, uint32_t allocationIndex);
 
     ~DeviceMemoryBlock();
 
@@ -176,6 +136,7 @@ private:
     vk::DeviceSize m_offset;
     vk::DeviceSize m_size;
     vk::DeviceSize m_alignment;
+    uint32_t m_allocationIndex; // Identifies the block to the heap's OffsetAllocator
     void* m_mappedPtr;
 };
 
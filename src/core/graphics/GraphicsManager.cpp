@@ -3,11 +3,14 @@
 #include "core/graphics/CommandPool.h"
 #include "core/graphics/DeviceMemory.h"
 #include "core/graphics/DescriptorSet.h"
+#include "core/graphics/DescriptorAllocator.h"
 #include "core/graphics/ImageView.h"
 #include "core/graphics/Image2D.h"
 #include "core/graphics/Buffer.h"
 #include "core/graphics/Framebuffer.h"
 #include "core/graphics/Fence.h"
+#include "core/graphics/UploadManager.h"
+#include "core/graphics/PipelineCache.h"
 #include "core/application/Engine.h"
 #include "core/application/Application.h"
 #include "core/engine/event/EventDispatcher.h"
@@ -30,7 +33,10 @@ GraphicsManager::GraphicsManager():
         m_renderPass(nullptr),
         m_commandPool(nullptr),
         m_descriptorPool(nullptr),
+        m_descriptorAllocator(nullptr),
         m_memory(nullptr),
+        m_uploads(nullptr),
+        m_pipelineCache(nullptr),
         m_debugMessenger(nullptr),
         m_preferredPresentMode(vk::PresentModeKHR::eImmediate), // eMailbox
         m_isInitialized(false),
@@ -69,6 +75,10 @@ GraphicsManager::~GraphicsManager() {
     if (m_commandPool.use_count() > 1)
         LOG_WARN("Destroyed GraphicsManager but CommandPool has %llu external references", (uint64_t)m_commandPool.use_count() - 1);
 
+    delete m_uploads;
+    m_uploads = nullptr;
+    delete m_pipelineCache;
+    delete m_descriptorAllocator;
     delete m_memory;
     m_descriptorPool.reset();
     m_commandPool.reset();
@@ -121,6 +131,12 @@ bool GraphicsManager::init(SDL_Window* windowHandle, const char* applicationName
     deviceFeatures.shaderStorageImageArrayDynamicIndexing = true;
     deviceFeatures.shaderStorageBufferArrayDynamicIndexing = true;
 
+    // Optional. Indirect draws with a non-zero firstInstance are invalid without it.
+    vk::PhysicalDeviceFeatures supportedFeatures = m_device.physicalDevice->getFeatures();
+    deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+    if (!supportedFeatures.drawIndirectFirstInstance)
+        LOG_WARN("The physical device does not support drawIndirectFirstInstance. Indirect drawing will be unavailable");
+
 
     vk::PhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures;
     descriptorIndexingFeatures.shaderInputAttachmentArrayDynamicIndexing = true;
@@ -154,6 +170,16 @@ bool GraphicsManager::init(SDL_Window* windowHandle, const char* applicationName
     }
 
     m_memory = new DeviceMemoryManager(m_device.device);
+
+    PipelineCacheConfiguration pipelineCacheConfig{};
+    pipelineCacheConfig.device = m_device.device;
+    pipelineCacheConfig.physicalDeviceProperties = m_device.physicalDeviceProperties;
+    pipelineCacheConfig.filePath = Application::instance()->getResourceDirectory() + "cache/pipelines.bin";
+    m_pipelineCache = PipelineCache::create(pipelineCacheConfig, "GraphicsManager-PipelineCache");
+    if (m_pipelineCache == nullptr) {
+        LOG_ERROR("Failed to create PipelineCache");
+        return false;
+    }
     //GPUMemoryConfiguration memoryConfig;
     //memoryConfig.device = m_device.device;
     //memoryConfig.size = (size_t)(6.0 * 1024 * 1024 * 1024); // Allocate 8 GiB
@@ -174,12 +200,29 @@ bool GraphicsManager::init(SDL_Window* windowHandle, const char* applicationName
     commandPoolConfig.transient = false;
     m_commandPool = SharedResource<CommandPool>(CommandPool::create(commandPoolConfig, "GraphicsManager-DefaultCommandPool"));
 
+    // Uploads are submitted on a graphics family queue, so uploaded resources need no queue family ownership transfer.
+    UploadManagerConfiguration uploadManagerConfig{};
+    uploadManagerConfig.device = m_device.device;
+    uploadManagerConfig.queueFamilyIndex = m_queues.queueFamilies.graphicsQueueFamilyIndex.value();
+    uploadManagerConfig.queueName = QUEUE_GRAPHICS_TRANSFER_MAIN;
+    m_uploads = UploadManager::create(uploadManagerConfig, "GraphicsManager-UploadManager");
+    if (m_uploads == nullptr) {
+        LOG_ERROR("Failed to create UploadManager");
+        return false;
+    }
+
     DescriptorPoolConfiguration descriptorPoolConfig{};
     descriptorPoolConfig.device = m_device.device;
     //descriptorPoolConfig.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
     m_descriptorPool = SharedResource<DescriptorPool>(DescriptorPool::create(descriptorPoolConfig, "GraphicsManager-DefaultDescriptorPool"));
 
-    m_commandPool->allocateNamedCommandBuffer("transfer_buffer", {vk::CommandBufferLevel::ePrimary});
+    DescriptorAllocatorConfiguration descriptorAllocatorConfig{};
+    descriptorAllocatorConfig.device = m_device.device;
+    m_descriptorAllocator = DescriptorAllocator::create(descriptorAllocatorConfig, "GraphicsManager-DescriptorAllocator");
+    if (m_descriptorAllocator == nullptr) {
+        LOG_ERROR("Failed to create DescriptorAllocator");
+        return false;
+    }
 
     m_isInitialized = true;
     m_recreateSwapchain = true;
@@ -616,6 +659,7 @@ bool GraphicsManager::createLogicalDevice(std::vector<const char*> const& enable
     createInfo.setPEnabledExtensionNames(enabledExtensions);
     createInfo.setPEnabledFeatures(enabledFeatures);
     m_device.device = SharedResource<vkr::Device>(new vkr::Device(*m_device.physicalDevice, createInfo), "GraphicsManager-Device");
+    m_device.enabledFeatures = enabledFeatures != nullptr ? *enabledFeatures : vk::PhysicalDeviceFeatures();
 
     for (auto& entry : queueIndexMap) {
         uint32_t queueFamilyIndex = entry.first;
@@ -863,6 +907,10 @@ bool GraphicsManager::createRenderPass() {
 
 void GraphicsManager::shutdownGraphics() {
     LOG_INFO("Shutting down GraphicsManager");
+    if (m_uploads != nullptr)
+        m_uploads->synchronize(); // Run any outstanding completion callbacks while their owners still exist
+    if (m_pipelineCache != nullptr)
+        m_pipelineCache->save(); // Waits for pre-warm tasks, which may reference resources destroyed by the event below
     ShutdownGraphicsEvent event{};
     Engine::eventDispatcher()->trigger(&event);
 }
@@ -872,6 +920,8 @@ bool GraphicsManager::beginFrame() {
 
     m_debugInfo.reset();
 
+    m_uploads->update();
+
     if (m_recreateSwapchain) {
         m_resolutionChanged = false;
         bool recreated = recreateSwapchain();
@@ -894,6 +944,9 @@ bool GraphicsManager::beginFrame() {
     vk::Result result = m_device.device->waitForFences({frameFence}, true, UINT64_MAX);
     assert(result == vk::Result::eSuccess);
 
+    // The previous use of this frame index has finished on the GPU, so its transient descriptor sets can be reused.
+    m_descriptorAllocator->beginFrame(m_swapchain.currentFrameIndex);
+
 //    PROFILE_REGION("Reset frame fence")
 //    m_device.device->resetFences({ frameFence });
 
@@ -953,6 +1006,13 @@ void GraphicsManager::endFrame() {
     const vk::SwapchainKHR& swapchain = **m_swapchain.swapchain;
     const vk::CommandBuffer& commandBuffer = getCurrentCommandBuffer();
 
+    if (m_descriptorAllocator->hasPendingWrites()) {
+        // Updating a set after it was bound would invalidate the command buffer, so these must be for sets not used
+        // this frame.
+        LOG_WARN("Descriptor writes were enqueued after the last flush of the frame");
+        m_descriptorAllocator->flushWrites();
+    }
+
     PROFILE_REGION("End command buffer")
     PROFILE_END_GPU_CMD("Frame", commandBuffer);
 
@@ -973,12 +1033,19 @@ void GraphicsManager::endFrame() {
 
     PROFILE_REGION("Submit queues")
 
-    vk::PipelineStageFlags waitStages[] = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
+    vk::PipelineStageFlags waitStages[] = {vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eAllCommands};
+    vk::Semaphore waitSemaphores[] = {imageAvailableSemaphore, nullptr};
+    uint32_t waitSemaphoreCount = 1;
+
+    // Anything uploaded during the frame must have arrived before the frame is rendered.
+    const vk::Semaphore* uploadSemaphore = m_uploads->flushFrame(m_swapchain.currentFrameIndex);
+    if (uploadSemaphore != nullptr)
+        waitSemaphores[waitSemaphoreCount++] = *uploadSemaphore;
 
     std::vector<vk::SubmitInfo> submitInfos;
     vk::SubmitInfo& submitInfo = submitInfos.emplace_back();
-    submitInfo.setWaitSemaphoreCount(1);
-    submitInfo.setPWaitSemaphores(&imageAvailableSemaphore);
+    submitInfo.setWaitSemaphoreCount(waitSemaphoreCount);
+    submitInfo.setPWaitSemaphores(waitSemaphores);
     submitInfo.setPWaitDstStageMask(waitStages);
     submitInfo.setCommandBufferCount(1);
     submitInfo.setPCommandBuffers(&commandBuffer);
@@ -1077,6 +1144,10 @@ const vk::PhysicalDeviceLimits& GraphicsManager::getPhysicalDeviceLimits() const
     return m_device.physicalDeviceProperties.limits;
 }
 
+const vk::PhysicalDeviceFeatures& GraphicsManager::getEnabledDeviceFeatures() const {
+    return m_device.enabledFeatures;
+}
+
 vk::DeviceSize GraphicsManager::getAlignedUniformBufferOffset(vk::DeviceSize offset) {
     vk::DeviceSize minOffsetAlignment = Engine::graphics()->getPhysicalDeviceLimits().minUniformBufferOffsetAlignment;
     return CEIL_TO_MULTIPLE(offset, minOffsetAlignment);
@@ -1157,6 +1228,8 @@ void GraphicsManager::endOneTimeCommandBuffer(const vk::CommandBuffer& commandBu
 
     Fence* fence = commandPool()->releaseTemporaryCommandBufferFence(commandBuffer);
 
+    m_uploads->synchronize(); // The commands may read uploaded data, but are not submitted on the upload queue
+
     vk::SubmitInfo queueSubmitInfo{};
     queueSubmitInfo.setCommandBufferCount(1);
     queueSubmitInfo.setPCommandBuffers(&commandBuffer);
@@ -1255,6 +1328,23 @@ DeviceMemoryManager& GraphicsManager::memory() {
     return *m_memory;
 }
 
+DescriptorAllocator& GraphicsManager::descriptorAllocator() {
+    return *m_descriptorAllocator;
+}
+
+UploadManager& GraphicsManager::uploads() {
+    return *m_uploads;
+}
+
+void GraphicsManager::waitForUpload(uint64_t uploadId) {
+    if (m_uploads != nullptr && uploadId != UploadManager::INVALID_UPLOAD)
+        m_uploads->wait(uploadId);
+}
+
+PipelineCache& GraphicsManager::pipelineCache() {
+    return *m_pipelineCache;
+}
+
 vk::ColorSpaceKHR GraphicsManager::getColourSpace() const {
     return m_surface.surfaceFormat.colorSpace;
 }
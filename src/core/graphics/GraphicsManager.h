@@ -34,8 +34,11 @@
 class RenderPass;
 class CommandPool;
 class DescriptorPool;
+class DescriptorAllocator;
 class DeviceMemoryManager;
 class DeviceMemoryBlock;
+class UploadManager;
+class PipelineCache;
 class Framebuffer;
 class ImageView;
 class Fence;
@@ -77,6 +80,7 @@ struct DeviceDetails {
     SharedResource<vkr::Device> device;
     vk::PhysicalDeviceMemoryProperties memoryProperties;
     vk::PhysicalDeviceProperties physicalDeviceProperties;
+    vk::PhysicalDeviceFeatures enabledFeatures;
 };
 
 struct SurfaceDetails {
@@ -169,6 +173,9 @@ public:
 
     const vk::PhysicalDeviceLimits& getPhysicalDeviceLimits() const;
 
+    // The core features enabled when the logical device was created. Optional features are only enabled if supported.
+    const vk::PhysicalDeviceFeatures& getEnabledDeviceFeatures() const;
+
     vk::DeviceSize getAlignedUniformBufferOffset(vk::DeviceSize offset);
 
     uint32_t getPreviousFrameIndex() const;
@@ -205,8 +212,18 @@ public:
 
     const SharedResource<DescriptorPool>& descriptorPool();
 
+    DescriptorAllocator& descriptorAllocator();
+
     DeviceMemoryManager& memory();
 
+    UploadManager& uploads();
+
+    // Blocks until the upload batch has completed. Does nothing once the UploadManager is destroyed at shutdown, since
+    // it waits for every batch first.
+    void waitForUpload(uint64_t uploadId);
+
+    PipelineCache& pipelineCache();
+
     glm::ivec2 getResolution() const;
 
     glm::vec2 getNormalizedPixelSize() const;
@@ -264,7 +281,10 @@ private:
     SharedResource<RenderPass> m_renderPass;
     SharedResource<CommandPool> m_commandPool;
     SharedResource<DescriptorPool> m_descriptorPool;
+    DescriptorAllocator* m_descriptorAllocator;
     DeviceMemoryManager* m_memory;
+    UploadManager* m_uploads;
+    PipelineCache* m_pipelineCache;
 
     std::unique_ptr<vkr::DebugUtilsMessengerEXT> m_debugMessenger;
 
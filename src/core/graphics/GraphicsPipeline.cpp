@@ -2,12 +2,14 @@
 #include "core/application/Application.h"
 #include "core/application/Engine.h"
 #include "core/graphics/GraphicsManager.h"
+#include "core/graphics/PipelineCache.h"
 #include "core/graphics/RenderPass.h"
 #include "core/graphics/DescriptorSet.h"
 #include "core/graphics/Buffer.h"
 #include "core/graphics/ShaderUtils.h"
 #include "core/engine/event/EventDispatcher.h"
 #include "core/engine/event/GraphicsEvents.h"
+#include "core/util/Profiler.h"
 #include "core/util/Util.h"
 #include "core/util/Logger.h"
 
@@ -204,22 +206,36 @@ GraphicsPipeline* GraphicsPipeline::create(const GraphicsPipelineConfiguration&
     return graphicsPipeline;
 }
 
-bool GraphicsPipeline::recreate(const GraphicsPipelineConfiguration& graphicsPipelineConfiguration, const std::string& name) {
-    assert(!graphicsPipelineConfiguration.device.expired() && graphicsPipelineConfiguration.device.get() == m_device.get());
-
-    const vk::Device& device = **m_device;
-
-    cleanup();
-
-    GraphicsPipelineConfiguration pipelineConfig(graphicsPipelineConfiguration);
-
-    vk::Result result;
-
-    std::vector<vk::DynamicState> dynamicStates = {};
-
+// Everything needed to create the pipeline, resolved from a configuration on the calling thread. Building the pipeline
+// from it touches no engine state, so that part may run on any thread.
+struct GraphicsPipelineBuildState {
+    GraphicsPipelineConfiguration config;
+    std::vector<vk::DynamicState> dynamicStates;
+    vk::Viewport viewport;
+    vk::Rect2D scissor;
+    vk::FrontFace frontFace;
+    vk::RenderPass renderPass;
+    std::vector<vk::ShaderModule> shaderModules;
+    std::vector<vk::ShaderStageFlagBits> shaderStages;
+};
+
+static void destroyShaderModules(const vk::Device& device, GraphicsPipelineBuildState& state) {
+    for (const auto& shaderModule : state.shaderModules)
+        device.destroyShaderModule(shaderModule);
+    state.shaderModules.clear();
+    state.shaderStages.clear();
+}
+
+// Loads the shader modules and resolves the configuration. Must be called from the main thread, since loading shaders
+// goes through the shader loading state and events.
+static bool prepareBuildState(const vk::Device& device, const GraphicsPipelineConfiguration& graphicsPipelineConfiguration, GraphicsPipelineBuildState& state) {
+    state.config = graphicsPipelineConfiguration;
+    GraphicsPipelineConfiguration& pipelineConfig = state.config;
+
+    state.dynamicStates.clear();
     for (auto it = pipelineConfig.dynamicStates.begin(); it != pipelineConfig.dynamicStates.end(); ++it)
         if (it->second)
-            dynamicStates.emplace_back(it->first);
+            state.dynamicStates.emplace_back(it->first);
 
     vk::Viewport viewport = pipelineConfig.viewport;
     if (viewport.width < 1 || viewport.height < 1) {
@@ -231,19 +247,16 @@ bool GraphicsPipeline::recreate(const GraphicsPipelineConfiguration& graphicsPip
         viewport.maxDepth = 1.0F;
     }
 
-    LOG_INFO("Recreating graphics pipeline \"%s\" [%g x %g]", name.c_str(), viewport.width, viewport.height);
-
-    vk::FrontFace frontFace = pipelineConfig.frontFace;
+    state.frontFace = pipelineConfig.frontFace;
 
-    vk::Rect2D scissor;
-    scissor.offset.x = 0;
-    scissor.offset.y = 0;
-    scissor.extent.width = (uint32_t)viewport.width;
-    scissor.extent.height = (uint32_t)viewport.height;
+    state.scissor.offset.x = 0;
+    state.scissor.offset.y = 0;
+    state.scissor.extent.width = (uint32_t)viewport.width;
+    state.scissor.extent.height = (uint32_t)viewport.height;
 
-    viewport = GraphicsPipeline::getScreenViewport(viewport);
+    state.viewport = GraphicsPipeline::getScreenViewport(viewport);
     if (Application::instance()->isViewportInverted())
-        frontFace = frontFace == vk::FrontFace::eClockwise ? vk::FrontFace::eCounterClockwise : frontFace = vk::FrontFace::eClockwise;
+        state.frontFace = state.frontFace == vk::FrontFace::eClockwise ? vk::FrontFace::eCounterClockwise : vk::FrontFace::eClockwise;
 
 
     if (!pipelineConfig.vertexShader.has_value()) {
@@ -261,52 +274,70 @@ bool GraphicsPipeline::recreate(const GraphicsPipelineConfiguration& graphicsPip
         return false;
     }
 
-    std::vector<vk::ShaderModule> allShaderModules;
-    allShaderModules.reserve(10); // Reallocation will break the references kept
-
-    auto cleanupShaderModules = [&allShaderModules, &device]() {
-        for (const auto& shaderModule : allShaderModules)
-            device.destroyShaderModule(shaderModule);
-    };
+    const RenderPass* renderPass = pipelineConfig.renderPass.get();
+    state.renderPass = renderPass->getRenderPass();
 
     // pipelineConfig is a copy
     Util::trim(pipelineConfig.vertexShaderEntryPoint);
     Util::trim(pipelineConfig.fragmentShaderEntryPoint);
-
-    m_renderPass.set(pipelineConfig.renderPass, name + "-RenderPass");
-
-    std::vector<vk::PipelineShaderStageCreateInfo> pipelineShaderStages;
+    if (pipelineConfig.vertexShaderEntryPoint.empty())
+        pipelineConfig.vertexShaderEntryPoint = "main";
+    if (pipelineConfig.fragmentShaderEntryPoint.empty())
+        pipelineConfig.fragmentShaderEntryPoint = "main";
+
+    // Both stages are compiled in parallel if neither is loaded yet. Failures are reported by loadShaderModule below.
+    std::vector<ShaderUtils::ShaderLoadRequest> shaderLoadRequests;
+    if (pipelineConfig.vertexShader.has_value())
+        shaderLoadRequests.emplace_back(ShaderUtils::ShaderLoadRequest{ ShaderUtils::ShaderStage_VertexShader, pipelineConfig.vertexShader.value(), pipelineConfig.vertexShaderEntryPoint });
+    if (pipelineConfig.fragmentShader.has_value())
+        shaderLoadRequests.emplace_back(ShaderUtils::ShaderLoadRequest{ ShaderUtils::ShaderStage_FragmentShader, pipelineConfig.fragmentShader.value(), pipelineConfig.fragmentShaderEntryPoint });
+    ShaderUtils::loadShaderStages(shaderLoadRequests);
 
     if (pipelineConfig.vertexShader.has_value()) {
-        if (pipelineConfig.vertexShaderEntryPoint.empty())
-            pipelineConfig.vertexShaderEntryPoint = "main";
-        vk::ShaderModule& vertexShaderModule = allShaderModules.emplace_back(nullptr);
+        vk::ShaderModule vertexShaderModule = nullptr;
         if (!ShaderUtils::loadShaderModule(ShaderUtils::ShaderStage_VertexShader, device, pipelineConfig.vertexShader.value(), pipelineConfig.vertexShaderEntryPoint, &vertexShaderModule)) {
-            cleanupShaderModules();
+            destroyShaderModules(device, state);
             return false;
         }
-        vk::PipelineShaderStageCreateInfo& vertexShaderStageCreateInfo = pipelineShaderStages.emplace_back();
-        vertexShaderStageCreateInfo.setStage(vk::ShaderStageFlagBits::eVertex);
-        vertexShaderStageCreateInfo.setModule(vertexShaderModule);
-//        vertexShaderStageCreateInfo.setPName(vertexShaderEntryPoint.c_str());
-        vertexShaderStageCreateInfo.setPName("main"); // For GLSL, the entry point is redefined as "main" with a macro
-        vertexShaderStageCreateInfo.setPSpecializationInfo(nullptr); // TODO
+        state.shaderModules.emplace_back(vertexShaderModule);
+        state.shaderStages.emplace_back(vk::ShaderStageFlagBits::eVertex);
     }
 
     if (pipelineConfig.fragmentShader.has_value()) {
-        if (pipelineConfig.fragmentShaderEntryPoint.empty())
-            pipelineConfig.fragmentShaderEntryPoint = "main";
-        vk::ShaderModule& fragmentShaderModule = allShaderModules.emplace_back(nullptr);
+        vk::ShaderModule fragmentShaderModule = nullptr;
         if (!ShaderUtils::loadShaderModule(ShaderUtils::ShaderStage_FragmentShader, device, pipelineConfig.fragmentShader.value(), pipelineConfig.fragmentShaderEntryPoint, &fragmentShaderModule)) {
-            cleanupShaderModules();
+            destroyShaderModules(device, state);
             return false;
         }
-        vk::PipelineShaderStageCreateInfo& fragmentShaderStageCreateInfo = pipelineShaderStages.emplace_back();
-        fragmentShaderStageCreateInfo.setStage(vk::ShaderStageFlagBits::eFragment);
-        fragmentShaderStageCreateInfo.setModule(fragmentShaderModule);
-//        fragmentShaderStageCreateInfo.setPName(fragmentShaderEntryPoint.c_str());
-        fragmentShaderStageCreateInfo.setPName("main");
-        fragmentShaderStageCreateInfo.setPSpecializationInfo(nullptr); // TODO
+        state.shaderModules.emplace_back(fragmentShaderModule);
+        state.shaderStages.emplace_back(vk::ShaderStageFlagBits::eFragment);
+    }
+
+    while ((uint32_t)pipelineConfig.attachmentBlendStates.size() < renderPass->getColourAttachmentCount(pipelineConfig.subpass))
+        pipelineConfig.attachmentBlendStates.emplace_back(); // Expand attachmentBlendStates array until it matches the size of the render pass attachments
+
+    return true;
+}
+
+static vk::Result createPipelineLayout(const vk::Device& device, const GraphicsPipelineBuildState& state, vk::PipelineLayout* outPipelineLayout) {
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+    pipelineLayoutCreateInfo.setSetLayouts(state.config.descriptorSetLayouts);
+    pipelineLayoutCreateInfo.setPushConstantRanges(state.config.pushConstantRanges);
+
+    return device.createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, outPipelineLayout);
+}
+
+static vk::Result buildPipeline(const vk::Device& device, const vk::PipelineCache& pipelineCache, const GraphicsPipelineBuildState& state, const vk::PipelineLayout& pipelineLayout, vk::Pipeline* outPipeline) {
+    const GraphicsPipelineConfiguration& pipelineConfig = state.config;
+
+    std::vector<vk::PipelineShaderStageCreateInfo> pipelineShaderStages;
+
+    for (size_t i = 0; i < state.shaderModules.size(); ++i) {
+        vk::PipelineShaderStageCreateInfo& shaderStageCreateInfo = pipelineShaderStages.emplace_back();
+        shaderStageCreateInfo.setStage(state.shaderStages[i]);
+        shaderStageCreateInfo.setModule(state.shaderModules[i]);
+        shaderStageCreateInfo.setPName("main"); // For GLSL, the entry point is redefined as "main" with a macro
+        shaderStageCreateInfo.setPSpecializationInfo(nullptr); // TODO
     }
 
     vk::PipelineVertexInputStateCreateInfo vertexInputStateCreateInfo;
@@ -319,16 +350,16 @@ bool GraphicsPipeline::recreate(const GraphicsPipelineConfiguration& graphicsPip
 
     vk::PipelineViewportStateCreateInfo viewportStateCreateInfo;
     viewportStateCreateInfo.setViewportCount(1);
-    viewportStateCreateInfo.setPViewports(&viewport);
+    viewportStateCreateInfo.setPViewports(&state.viewport);
     viewportStateCreateInfo.setScissorCount(1);
-    viewportStateCreateInfo.setPScissors(&scissor);
+    viewportStateCreateInfo.setPScissors(&state.scissor);
 
     vk::PipelineRasterizationStateCreateInfo rasterizationStateCreateInfo;
     rasterizationStateCreateInfo.setDepthClampEnable(false);
     rasterizationStateCreateInfo.setRasterizerDiscardEnable(false);
     rasterizationStateCreateInfo.setPolygonMode(pipelineConfig.polygonMode);
     rasterizationStateCreateInfo.setCullMode(pipelineConfig.cullMode);
-    rasterizationStateCreateInfo.setFrontFace(frontFace);
+    rasterizationStateCreateInfo.setFrontFace(state.frontFace);
     rasterizationStateCreateInfo.setDepthBiasEnable(pipelineConfig.depthBiasEnable);
     rasterizationStateCreateInfo.setDepthBiasConstantFactor(pipelineConfig.depthBias.constant);
     rasterizationStateCreateInfo.setDepthBiasClamp(pipelineConfig.depthBias.clamp);
@@ -359,9 +390,6 @@ bool GraphicsPipeline::recreate(const GraphicsPipelineConfiguration& graphicsPip
     //depthStencilStateCreateInfo.front;
     //depthStencilStateCreateInfo.back;
 
-    while ((uint32_t)pipelineConfig.attachmentBlendStates.size() < m_renderPass->getColourAttachmentCount(graphicsPipelineConfiguration.subpass))
-        pipelineConfig.attachmentBlendStates.emplace_back(); // Expand attachmentBlendStates array until it matches the size of the render pass attachments
-
     std::vector<vk::PipelineColorBlendAttachmentState> attachmentBlendStates;
     for (const auto& blendState : pipelineConfig.attachmentBlendStates) {
         vk::PipelineColorBlendAttachmentState& colourBlendAttachmentState = attachmentBlendStates.emplace_back();
@@ -389,19 +417,7 @@ bool GraphicsPipeline::recreate(const GraphicsPipelineConfiguration& graphicsPip
     colourBlendStateCreateInfo.setBlendConstants(blendConstants);
 
     vk::PipelineDynamicStateCreateInfo dynamicStateCreateInfo;
-    dynamicStateCreateInfo.setDynamicStates(dynamicStates);
-
-    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
-    pipelineLayoutCreateInfo.setSetLayouts(pipelineConfig.descriptorSetLayouts);
-    pipelineLayoutCreateInfo.setPushConstantRanges(pipelineConfig.pushConstantRanges);
-
-    result = device.createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &m_pipelineLayout);
-    if (result != vk::Result::eSuccess) {
-        LOG_ERROR("Unable to create GraphicsPipeline: Failed to create PipelineLayout: %s", vk::to_string(result).c_str());
-        cleanupShaderModules();
-        cleanup();
-        return false;
-    }
+    dynamicStateCreateInfo.setDynamicStates(state.dynamicStates);
 
     vk::GraphicsPipelineCreateInfo graphicsPipelineCreateInfo;
     graphicsPipelineCreateInfo.setStages(pipelineShaderStages);
@@ -414,36 +430,98 @@ bool GraphicsPipeline::recreate(const GraphicsPipelineConfiguration& graphicsPip
     graphicsPipelineCreateInfo.setPDepthStencilState(&depthStencilStateCreateInfo); // TODO
     graphicsPipelineCreateInfo.setPColorBlendState(&colourBlendStateCreateInfo);
     graphicsPipelineCreateInfo.setPDynamicState(&dynamicStateCreateInfo);
-    graphicsPipelineCreateInfo.setLayout(m_pipelineLayout);
-    graphicsPipelineCreateInfo.setRenderPass(m_renderPass->getRenderPass());
-    graphicsPipelineCreateInfo.setSubpass(graphicsPipelineConfiguration.subpass);
+    graphicsPipelineCreateInfo.setLayout(pipelineLayout);
+    graphicsPipelineCreateInfo.setRenderPass(state.renderPass);
+    graphicsPipelineCreateInfo.setSubpass(pipelineConfig.subpass);
     graphicsPipelineCreateInfo.setBasePipelineHandle(nullptr);
     graphicsPipelineCreateInfo.setBasePipelineIndex(-1);
 
+    auto createGraphicsPipelineResult = device.createGraphicsPipeline(pipelineCache, graphicsPipelineCreateInfo);
+    *outPipeline = createGraphicsPipelineResult.value;
+    return createGraphicsPipelineResult.result;
+}
+
+bool GraphicsPipeline::recreate(const GraphicsPipelineConfiguration& graphicsPipelineConfiguration, const std::string& name) {
+    assert(!graphicsPipelineConfiguration.device.expired() && graphicsPipelineConfiguration.device.get() == m_device.get());
+
+    const vk::Device& device = **m_device;
+
+    cleanup();
+
+    GraphicsPipelineBuildState state;
+    if (!prepareBuildState(device, graphicsPipelineConfiguration, state))
+        return false;
+
+    LOG_INFO("Recreating graphics pipeline \"%s\" [%u x %u]", name.c_str(), state.scissor.extent.width, state.scissor.extent.height);
+
+    m_renderPass.set(state.config.renderPass, name + "-RenderPass");
+
+    vk::Result result = createPipelineLayout(device, state, &m_pipelineLayout);
+    if (result != vk::Result::eSuccess) {
+        LOG_ERROR("Unable to create GraphicsPipeline: Failed to create PipelineLayout: %s", vk::to_string(result).c_str());
+        destroyShaderModules(device, state);
+        cleanup();
+        return false;
+    }
+
+    vk::Pipeline graphicsPipeline = nullptr;
+
     bool doAbort = Engine::graphics()->doAbortOnVulkanError();
     Engine::graphics()->setAbortOnVulkanError(false);
-    auto createGraphicsPipelineResult = device.createGraphicsPipeline(nullptr, graphicsPipelineCreateInfo);
+    result = buildPipeline(device, Engine::graphics()->pipelineCache().getPipelineCache(), state, m_pipelineLayout, &graphicsPipeline);
     Engine::graphics()->setAbortOnVulkanError(doAbort);
 
-    if (createGraphicsPipelineResult.result != vk::Result::eSuccess) {
-        LOG_ERROR("Failed to create GraphicsPipeline: %s", vk::to_string(createGraphicsPipelineResult.result).c_str());
-        cleanupShaderModules();
+    destroyShaderModules(device, state);
+
+    if (result != vk::Result::eSuccess) {
+        LOG_ERROR("Failed to create GraphicsPipeline: %s", vk::to_string(result).c_str());
         cleanup();
         return false;
     }
 
-    const vk::Pipeline& graphicsPipeline = createGraphicsPipelineResult.value;
-
     Engine::graphics()->setObjectName(device, (uint64_t)(VkPipeline)graphicsPipeline, vk::ObjectType::ePipeline, name);
 
-    cleanupShaderModules();
-
     m_pipeline = graphicsPipeline;
-    m_config = std::move(pipelineConfig);
+    m_config = std::move(state.config);
     m_name = name;
     return true;
 }
 
+void GraphicsPipeline::prewarm(const GraphicsPipelineConfiguration& graphicsPipelineConfiguration, const std::string& name) {
+    PROFILE_SCOPE("GraphicsPipeline::prewarm");
+
+    assert(!graphicsPipelineConfiguration.device.expired());
+
+    const vk::Device& device = **graphicsPipelineConfiguration.device.get();
+
+    std::shared_ptr<GraphicsPipelineBuildState> state = std::make_shared<GraphicsPipelineBuildState>();
+    if (!prepareBuildState(device, graphicsPipelineConfiguration, *state)) {
+        LOG_WARN("Unable to pre-warm graphics pipeline \"%s\"", name.c_str());
+        return;
+    }
+
+    // The task only holds plain Vulkan handles, resource references are not safe to release on another thread.
+    state->config.device = WeakResource<vkr::Device>();
+    state->config.renderPass = WeakResource<RenderPass>();
+
+    Engine::graphics()->pipelineCache().prewarm([state, name](const vk::Device& device, const vk::PipelineCache& pipelineCache) {
+        vk::PipelineLayout pipelineLayout = nullptr;
+        vk::Pipeline pipeline = nullptr;
+
+        vk::Result result = createPipelineLayout(device, *state, &pipelineLayout);
+        if (result == vk::Result::eSuccess)
+            result = buildPipeline(device, pipelineCache, *state, pipelineLayout, &pipeline);
+
+        if (result != vk::Result::eSuccess)
+            LOG_WARN("Failed to pre-warm graphics pipeline \"%s\": %s", name.c_str(), vk::to_string(result).c_str());
+
+        // Only the cache entry is wanted. The pipeline is created again from the cache on first use.
+        device.destroyPipeline(pipeline);
+        device.destroyPipelineLayout(pipelineLayout);
+        destroyShaderModules(device, *state);
+    });
+}
+
 void GraphicsPipeline::bind(const vk::CommandBuffer& commandBuffer) const {
     commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, m_pipeline);
 }
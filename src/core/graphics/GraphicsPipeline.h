@@ -131,6 +131,11 @@ public:
 
     bool recreate(const GraphicsPipelineConfiguration& graphicsPipelineConfiguration, const std::string& name);
 
+    // Builds the pipeline on a worker thread only to fill the pipeline cache, so creating it later is fast. Shaders are
+    // loaded on the calling thread. The render pass and descriptor set layouts must stay alive until the pre-warm pass
+    // has finished.
+    static void prewarm(const GraphicsPipelineConfiguration& graphicsPipelineConfiguration, const std::string& name);
+
     void bind(const vk::CommandBuffer& commandBuffer) const;
 
     const vk::Pipeline& getPipeline() const;
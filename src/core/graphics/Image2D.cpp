@@ -4,6 +4,7 @@
 #include "core/graphics/DeviceMemory.h"
 #include "core/graphics/CommandPool.h"
 #include "core/graphics/GraphicsManager.h"
+#include "core/graphics/UploadManager.h"
 #include "core/application/Engine.h"
 #include "core/util/Logger.h"
 
@@ -37,10 +38,13 @@ Image2D::Image2D(const WeakResource<vkr::Device>& device, const vk::Image& image
         m_memory(memory),
         m_size(width, height),
         m_mipLevelCount(mipLevelCount),
-        m_format(format) {
+        m_format(format),
+        m_lastUploadId(UploadManager::INVALID_UPLOAD) {
 }
 
 Image2D::~Image2D() {
+    // A transfer into the image may still be recorded in an open upload batch, or executing in a submitted one.
+    Engine::graphics()->waitForUpload(m_lastUploadId);
     (**m_device).destroyImage(m_image);
     vfree(m_memory);
 }
@@ -203,23 +207,26 @@ bool Image2D::upload(Image2D* dstImage, void* data, ImagePixelLayout pixelLayout
         return false;
     }
 
-    const vk::CommandBuffer& transferCommandBuffer = ImageUtil::beginTransferCommands();
-
-    bool success = ImageUtil::upload(transferCommandBuffer, dstImage->getImage(), uploadData, bytesPerPixel, aspectMask, imageRegion, srcState, dstState);
-
-    if (dstImage->getMipLevelCount() > 1) {
-        // Transition all other mip levels to dstState, since transferBuffer only transitions imageCopy.imageSubresource.mipLevel
-        vk::ImageSubresourceRange subresourceRange{};
-        subresourceRange.setAspectMask(aspectMask);
-        subresourceRange.setBaseArrayLayer(imageRegion.baseLayer);
-        subresourceRange.setLayerCount(imageRegion.layerCount);
-        subresourceRange.setBaseMipLevel(0);
-        subresourceRange.setLevelCount(dstImage->getMipLevelCount());
-        ImageUtil::transitionLayout(transferCommandBuffer, dstImage->getImage(), subresourceRange, ImageTransition::FromAny(), dstState);
+    // The pixels are copied into staging memory immediately, and reach the image before the next frame is rendered.
+    UploadManager& uploads = Engine::graphics()->uploads();
+    UploadManager::UploadId uploadId = uploads.uploadImage(dstImage->getImage(), uploadData, bytesPerPixel, aspectMask, imageRegion, srcState, dstState);
+    bool success = uploadId != UploadManager::INVALID_UPLOAD;
+    if (success)
+        dstImage->m_lastUploadId = uploadId;
+
+    if (success && dstImage->getMipLevelCount() > 1) {
+        dstImage->m_lastUploadId = uploads.record([&](const vk::CommandBuffer& commandBuffer) {
+            // Transition all other mip levels to dstState, since transferBuffer only transitions imageCopy.imageSubresource.mipLevel
+            vk::ImageSubresourceRange subresourceRange{};
+            subresourceRange.setAspectMask(aspectMask);
+            subresourceRange.setBaseArrayLayer(imageRegion.baseLayer);
+            subresourceRange.setLayerCount(imageRegion.layerCount);
+            subresourceRange.setBaseMipLevel(0);
+            subresourceRange.setLevelCount(dstImage->getMipLevelCount());
+            ImageUtil::transitionLayout(commandBuffer, dstImage->getImage(), subresourceRange, ImageTransition::FromAny(), dstState);
+        });
     }
 
-    ImageUtil::endTransferCommands(transferCommandBuffer, **Engine::graphics()->getQueue(QUEUE_TRANSFER_MAIN), true, nullptr);
-
     delete tempImageData;
     return success;
 }
@@ -300,11 +307,11 @@ bool Image2D::readPixels(void* dstPixels, ImagePixelLayout pixelLayout, ImagePix
 }
 
 bool Image2D::generateMipmap(Image2D* image, vk::Filter filter, vk::ImageAspectFlags aspectMask, uint32_t mipLevels, const ImageTransitionState& srcState, const ImageTransitionState& dstState) {
-    const vk::CommandBuffer& commandBuffer = ImageUtil::beginTransferCommands();
-
-    bool success = ImageUtil::generateMipmap(commandBuffer, image->getImage(), image->getFormat(), filter, aspectMask, 0, 1, image->getWidth(), image->getHeight(), 1, mipLevels, srcState, dstState, 0);
-
-    ImageUtil::endTransferCommands(commandBuffer, **Engine::graphics()->getQueue(QUEUE_GRAPHICS_TRANSFER_MAIN), true, nullptr);
+    // Recorded after the upload of the base level, on the same graphics family queue, which supports blits.
+    bool success = false;
+    image->m_lastUploadId = Engine::graphics()->uploads().record([&](const vk::CommandBuffer& commandBuffer) {
+        success = ImageUtil::generateMipmap(commandBuffer, image->getImage(), image->getFormat(), filter, aspectMask, 0, 1, image->getWidth(), image->getHeight(), 1, mipLevels, srcState, dstState, 0);
+    });
     return success;
 }
 
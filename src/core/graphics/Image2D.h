@@ -77,6 +77,7 @@ private:
     glm::uvec2 m_size;
     uint32_t m_mipLevelCount;
     vk::Format m_format;
+    uint64_t m_lastUploadId; // UploadManager batch of the last transfer into this image
 };
 
 
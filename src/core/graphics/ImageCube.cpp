@@ -5,6 +5,7 @@
 #include "core/graphics/DeviceMemory.h"
 #include "core/graphics/CommandPool.h"
 #include "core/graphics/GraphicsManager.h"
+#include "core/graphics/UploadManager.h"
 #include "core/graphics/ComputePipeline.h"
 #include "core/graphics/DescriptorSet.h"
 #include "core/application/Engine.h"
@@ -87,10 +88,13 @@ ImageCube::ImageCube(const WeakResource<vkr::Device>& device, const vk::Image& i
         m_memory(memory),
         m_size(size),
         m_mipLevelCount(mipLevelCount),
-        m_format(format) {
+        m_format(format),
+        m_lastUploadId(UploadManager::INVALID_UPLOAD) {
 }
 
 ImageCube::~ImageCube() {
+    // A transfer into the image may still be recorded in an open upload batch, or executing in a submitted one.
+    Engine::graphics()->waitForUpload(m_lastUploadId);
     (**m_device).destroyImage(m_image);
     vfree(m_memory);
 }
@@ -319,11 +323,10 @@ bool ImageCube::uploadFace(ImageCube* dstImage, ImageCubeFace face, void* data,
         return false;
     }
 
-    const vk::CommandBuffer& commandBuffer = ImageUtil::beginTransferCommands();
-
-    bool success = ImageUtil::upload(commandBuffer, dstImage->getImage(), uploadData, bytesPerPixel, aspectMask, imageRegion, srcState, dstState);
-
-    ImageUtil::endTransferCommands(commandBuffer, **Engine::graphics()->getQueue(QUEUE_TRANSFER_MAIN), true, nullptr);
+    UploadManager::UploadId uploadId = Engine::graphics()->uploads().uploadImage(dstImage->getImage(), uploadData, bytesPerPixel, aspectMask, imageRegion, srcState, dstState);
+    bool success = uploadId != UploadManager::INVALID_UPLOAD;
+    if (success)
+        dstImage->m_lastUploadId = uploadId;
 
     delete tempImageData;
     return success;
@@ -465,6 +468,8 @@ bool ImageCube::uploadEquirectangular(ImageCube* dstImage, void* data, ImagePixe
     PROFILE_END_GPU_CMD("ImageCube::uploadEquirectangular/ComputeCubeMap", commandBuffer);
     commandBuffer.end();
 
+    Engine::graphics()->uploads().synchronize(); // The equirectangular image may still be uploading
+
     vk::SubmitInfo queueSubmitInfo;
     queueSubmitInfo.setCommandBufferCount(1);
     queueSubmitInfo.setPCommandBuffers(&commandBuffer);
@@ -522,11 +527,10 @@ bool ImageCube::uploadEquirectangular(void* data, ImagePixelLayout pixelLayout,
 }
 
 bool ImageCube::generateMipmap(ImageCube* image, vk::Filter filter, vk::ImageAspectFlags aspectMask, uint32_t mipLevels, const ImageTransitionState& srcState, const ImageTransitionState& dstState) {
-    const vk::CommandBuffer& commandBuffer = ImageUtil::beginTransferCommands();
-
-    bool success = ImageUtil::generateMipmap(commandBuffer, image->getImage(), image->getFormat(), filter, aspectMask, 0, 6, image->getWidth(), image->getHeight(), 1, mipLevels, srcState, dstState, 0);
-
-    ImageUtil::endTransferCommands(commandBuffer, **Engine::graphics()->getQueue(QUEUE_GRAPHICS_TRANSFER_MAIN), true, nullptr);
+    bool success = false;
+    image->m_lastUploadId = Engine::graphics()->uploads().record([&](const vk::CommandBuffer& commandBuffer) {
+        success = ImageUtil::generateMipmap(commandBuffer, image->getImage(), image->getFormat(), filter, aspectMask, 0, 6, image->getWidth(), image->getHeight(), 1, mipLevels, srcState, dstState, 0);
+    });
     return success;
 }
 
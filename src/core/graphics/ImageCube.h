@@ -125,6 +125,7 @@ private:
     uint32_t m_size;
     uint32_t m_mipLevelCount;
     vk::Format m_format;
+    uint64_t m_lastUploadId; // UploadManager batch of the last transfer into this image
 
     static ComputePipeline* s_computeEquirectangularPipeline;
     static DescriptorSet* s_computeEquirectangularDescriptorSet;
@@ -1,6 +1,7 @@
 #include "core/graphics/ImageData.h"
 #include "core/application/Engine.h"
 #include "core/graphics/GraphicsManager.h"
+#include "core/graphics/UploadManager.h"
 #include "core/graphics/Buffer.h"
 #include "core/graphics/CommandPool.h"
 #include "core/graphics/ComputePipeline.h"
@@ -325,6 +326,21 @@ float ImageData::getChannelf(ImageRegion::offset_type x, ImageRegion::offset_typ
     }
 }
 
+void ImageData::readRowf(ImageRegion::offset_type y, size_t channelIndex, float* dstRow) const {
+    assert(m_pixelFormat == ImagePixelFormat::Float32 || m_pixelFormat == ImagePixelFormat::Float16);
+    size_t channelSize = ImageData::getChannelSize(m_pixelFormat);
+    size_t pixelStride = ImageData::getChannels(m_pixelLayout) * channelSize;
+    const uint8_t* src = static_cast<const uint8_t*>(m_data) + ImageData::getChannelOffset(0, y, channelIndex, m_width, m_height, m_pixelLayout, m_pixelFormat);
+
+    if (m_pixelFormat == ImagePixelFormat::Float16) {
+        for (ImageRegion::size_type x = 0; x < m_width; ++x, src += pixelStride)
+            dstRow[x] = (float)(*reinterpret_cast<const Float16*>(src));
+    } else {
+        for (ImageRegion::size_type x = 0; x < m_width; ++x, src += pixelStride)
+            memcpy(&dstRow[x], src, sizeof(float));
+    }
+}
+
 uint32_t ImageData::getChannelu8(ImageRegion::offset_type x, ImageRegion::offset_type y, size_t channelIndex) const {
     assert(m_pixelFormat == ImagePixelFormat::UInt8);
     size_t channelOffset = ImageData::getChannelOffset(x, y, channelIndex, m_width, m_height, m_pixelLayout, m_pixelFormat);
@@ -1296,6 +1312,8 @@ void ImageUtil::endTransferCommands(const vk::CommandBuffer& transferCommandBuff
     PROFILE_END_GPU_CMD("ImageUtil::beginTransferCommands", transferCommandBuffer);
     transferCommandBuffer.end();
 
+    Engine::graphics()->uploads().synchronize(); // The commands may read uploaded data, but are not submitted on the upload queue
+
     vk::SubmitInfo queueSumbitInfo;
     queueSumbitInfo.setCommandBufferCount(1);
     queueSumbitInfo.setPCommandBuffers(&transferCommandBuffer);
@@ -124,6 +124,10 @@ public:
     uint32_t getChannelu32(ImageRegion::offset_type x, ImageRegion::offset_type y, size_t channelIndex) const;
     int64_t getChannel(ImageRegion::offset_type x, ImageRegion::offset_type y, size_t channelIndex) const;
 
+    // Reads one channel of a whole row of a Float32 or Float16 image into a contiguous float array, without the
+    // per-texel format dispatch of getChannelf.
+    void readRowf(ImageRegion::offset_type y, size_t channelIndex, float* dstRow) const;
+
     void setChannelf(ImageRegion::offset_type x, ImageRegion::offset_type y, size_t channelIndex, float value);
     void setChannel(ImageRegion::offset_type x, ImageRegion::offset_type y, size_t channelIndex, int64_t value);
 
@@ -141,6 +141,29 @@ void Mesh::draw(const vk::CommandBuffer& commandBuffer, uint32_t instanceCount,
 #endif
 }
 
+void Mesh::drawIndirect(const vk::CommandBuffer& commandBuffer, const Buffer* commandsBuffer, vk::DeviceSize offset) {
+    PROFILE_SCOPE("Mesh::drawIndirect")
+
+    assert(m_vertexBuffer != nullptr);
+    assert(commandsBuffer != nullptr);
+
+    const vk::Buffer& vertexBuffer = m_vertexBuffer->getBuffer();
+    const vk::DeviceSize vertexOffset = 0;
+
+    commandBuffer.bindVertexBuffers(0, 1, &vertexBuffer, &vertexOffset);
+    if (m_indexBuffer != nullptr) {
+        commandBuffer.bindIndexBuffer(m_indexBuffer->getBuffer(), 0, vk::IndexType::eUint32);
+        commandBuffer.drawIndexedIndirect(commandsBuffer->getBuffer(), offset, 1, sizeof(vk::DrawIndexedIndirectCommand));
+    } else {
+        commandBuffer.drawIndirect(commandsBuffer->getBuffer(), offset, 1, sizeof(vk::DrawIndirectCommand));
+    }
+
+#if TRACK_DRAW_DEBUG_INFO
+    // The instance count is not known on the CPU, so only the draw call is counted.
+    Engine::graphics()->debugInfo().drawCalls++;
+#endif
+}
+
 void Mesh::reset() {
     delete m_vertexBuffer;
     m_vertexBuffer = nullptr;
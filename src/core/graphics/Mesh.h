@@ -62,6 +62,10 @@ public:
 
     void draw(const vk::CommandBuffer& commandBuffer, uint32_t instanceCount, uint32_t firstInstance);
 
+    // Draws this mesh with the parameters of a single VkDrawIndexedIndirectCommand (or VkDrawIndirectCommand if this
+    // mesh has no indices) read from the given buffer.
+    void drawIndirect(const vk::CommandBuffer& commandBuffer, const Buffer* commandsBuffer, vk::DeviceSize offset);
+
     void reset();
 
     uint32_t getVertexCount() const;
@@ -0,0 +1,227 @@
+#include "core/graphics/PipelineCache.h"
+#include "core/graphics/GraphicsManager.h"
+#include "core/application/Engine.h"
+#include "core/thread/ThreadUtils.h"
+#include "core/util/Profiler.h"
+#include "core/util/Util.h"
+#include "core/util/Logger.h"
+#include <filesystem>
+#include <fstream>
+
+// Version must be incremented whenever the file layout is changed.
+#define PIPELINE_CACHE_FILE_VERSION 1
+#define PIPELINE_CACHE_FILE_MAGIC 0x45435050 // "PPCE"
+
+struct PipelineCacheFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint32_t _pad0;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    uint64_t dataSize;
+    uint64_t dataHash; // Detects a truncated or corrupt file before the data reaches the driver
+};
+
+PipelineCache::PipelineCache(const WeakResource<vkr::Device>& device, const vk::PipelineCache& pipelineCache, const vk::PhysicalDeviceProperties& physicalDeviceProperties, const std::string& filePath):
+        m_device(device, "PipelineCache-Device"),
+        m_pipelineCache(pipelineCache),
+        m_physicalDeviceProperties(physicalDeviceProperties),
+        m_filePath(filePath) {
+}
+
+PipelineCache::~PipelineCache() {
+    waitPrewarm();
+    (**m_device).destroyPipelineCache(m_pipelineCache);
+}
+
+PipelineCache* PipelineCache::create(const PipelineCacheConfiguration& pipelineCacheConfiguration, const std::string& name) {
+    PROFILE_SCOPE("PipelineCache::create");
+
+    SharedResource<vkr::Device> devicePtr = pipelineCacheConfiguration.device.lock(name);
+    const vk::Device& device = **devicePtr;
+
+    std::vector<uint8_t> initialData;
+    if (!pipelineCacheConfiguration.filePath.empty())
+        readFile(pipelineCacheConfiguration.filePath, pipelineCacheConfiguration.physicalDeviceProperties, initialData);
+
+    vk::PipelineCacheCreateInfo pipelineCacheCreateInfo{};
+    pipelineCacheCreateInfo.setInitialDataSize(initialData.size());
+    pipelineCacheCreateInfo.setPInitialData(initialData.empty() ? nullptr : initialData.data());
+
+    vk::PipelineCache pipelineCache = nullptr;
+    vk::Result result = device.createPipelineCache(&pipelineCacheCreateInfo, nullptr, &pipelineCache);
+
+    if (result != vk::Result::eSuccess && !initialData.empty()) {
+        // The driver may still reject data which passed the header checks. Start again with an empty cache.
+        LOG_WARN("Failed to create pipeline cache from \"%s\": %s - Starting with an empty cache", pipelineCacheConfiguration.filePath.c_str(), vk::to_string(result).c_str());
+        pipelineCacheCreateInfo.setInitialDataSize(0);
+        pipelineCacheCreateInfo.setPInitialData(nullptr);
+        result = device.createPipelineCache(&pipelineCacheCreateInfo, nullptr, &pipelineCache);
+    }
+
+    if (result != vk::Result::eSuccess) {
+        LOG_ERROR("Failed to create pipeline cache: %s", vk::to_string(result).c_str());
+        return nullptr;
+    }
+
+    Engine::graphics()->setObjectName(device, (uint64_t)(VkPipelineCache)pipelineCache, vk::ObjectType::ePipelineCache, name);
+
+    return new PipelineCache(pipelineCacheConfiguration.device, pipelineCache, pipelineCacheConfiguration.physicalDeviceProperties, pipelineCacheConfiguration.filePath);
+}
+
+const vk::PipelineCache& PipelineCache::getPipelineCache() const {
+    return m_pipelineCache;
+}
+
+void PipelineCache::prewarm(const PrewarmTask& task) {
+    // Release the futures of finished tasks, so the list does not grow for the lifetime of the cache.
+    for (size_t i = m_prewarmFutures.size(); i > 0; --i) {
+        if (m_prewarmFutures[i - 1].isReady()) {
+            m_prewarmFutures[i - 1] = std::move(m_prewarmFutures.back());
+            m_prewarmFutures.pop_back();
+        }
+    }
+
+    const vk::Device& device = **m_device;
+    const vk::PipelineCache& pipelineCache = m_pipelineCache;
+
+    // Access to the pipeline cache is internally synchronized, so pre-warm tasks may build pipelines in parallel with
+    // each other, and with the main thread.
+    m_prewarmFutures.emplace_back(ThreadUtils::run([task, device, pipelineCache]() {
+        PROFILE_SCOPE("PipelineCache - Pre-warm pipeline")
+        task(device, pipelineCache);
+    }));
+}
+
+void PipelineCache::waitPrewarm() {
+    PROFILE_SCOPE("PipelineCache::waitPrewarm");
+    if (!m_prewarmFutures.empty()) {
+        ThreadUtils::wait(m_prewarmFutures);
+        m_prewarmFutures.clear();
+    }
+}
+
+size_t PipelineCache::getPendingPrewarmCount() {
+    size_t count = 0;
+    for (const auto& future : m_prewarmFutures)
+        if (!future.isReady())
+            ++count;
+    return count;
+}
+
+bool PipelineCache::save() {
+    PROFILE_SCOPE("PipelineCache::save");
+
+    waitPrewarm();
+
+    if (m_filePath.empty())
+        return false;
+
+    const vk::Device& device = **m_device;
+
+    size_t dataSize = 0;
+    vk::Result result = device.getPipelineCacheData(m_pipelineCache, &dataSize, nullptr);
+    if (result != vk::Result::eSuccess) {
+        LOG_ERROR("Unable to save pipeline cache \"%s\": Failed to get pipeline cache data: %s", m_filePath.c_str(), vk::to_string(result).c_str());
+        return false;
+    }
+
+    std::vector<uint8_t> data(dataSize);
+    result = device.getPipelineCacheData(m_pipelineCache, &dataSize, data.data());
+    if (result != vk::Result::eSuccess && result != vk::Result::eIncomplete) {
+        LOG_ERROR("Unable to save pipeline cache \"%s\": Failed to get pipeline cache data: %s", m_filePath.c_str(), vk::to_string(result).c_str());
+        return false;
+    }
+    data.resize(dataSize);
+
+    PipelineCacheFileHeader header{};
+    header.magic = PIPELINE_CACHE_FILE_MAGIC;
+    header.version = PIPELINE_CACHE_FILE_VERSION;
+    header.vendorID = m_physicalDeviceProperties.vendorID;
+    header.deviceID = m_physicalDeviceProperties.deviceID;
+    header.driverVersion = m_physicalDeviceProperties.driverVersion;
+    memcpy(header.pipelineCacheUUID, m_physicalDeviceProperties.pipelineCacheUUID.data(), VK_UUID_SIZE);
+    header.dataSize = data.size();
+    header.dataHash = Util::hashBytes(data.data(), data.size());
+
+    // Written to a temporary file first, so a crash while writing never leaves a half written cache behind.
+    std::filesystem::path filePath(m_filePath);
+    std::filesystem::path tempFilePath(m_filePath + ".tmp");
+
+    std::error_code error;
+    if (filePath.has_parent_path())
+        std::filesystem::create_directories(filePath.parent_path(), error);
+
+    {
+        std::ofstream file(tempFilePath, std::ios::binary);
+        if (!file.is_open()) {
+            LOG_ERROR("Unable to save pipeline cache: Failed to create file \"%s\"", tempFilePath.string().c_str());
+            return false;
+        }
+        file.write((const char*)&header, sizeof(PipelineCacheFileHeader));
+        file.write((const char*)data.data(), (std::streamsize)data.size());
+        if (!file.good()) {
+            LOG_ERROR("Unable to save pipeline cache: Failed to write file \"%s\"", tempFilePath.string().c_str());
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tempFilePath, filePath, error);
+    if (error) {
+        LOG_ERROR("Unable to save pipeline cache \"%s\": %s", m_filePath.c_str(), error.message().c_str());
+        std::filesystem::remove(tempFilePath, error);
+        return false;
+    }
+
+    LOG_INFO("Saved pipeline cache \"%s\" - %.2f KiB", m_filePath.c_str(), (double)data.size() / 1024.0);
+    return true;
+}
+
+const std::string& PipelineCache::getFilePath() const {
+    return m_filePath;
+}
+
+bool PipelineCache::readFile(const std::string& filePath, const vk::PhysicalDeviceProperties& physicalDeviceProperties, std::vector<uint8_t>& outData) {
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file.is_open()) {
+        LOG_INFO("No pipeline cache found at \"%s\" - Starting with an empty cache", filePath.c_str());
+        return false;
+    }
+
+    PipelineCacheFileHeader header{};
+    file.read((char*)&header, sizeof(PipelineCacheFileHeader));
+
+    if (!file.good() || header.magic != PIPELINE_CACHE_FILE_MAGIC || header.version != PIPELINE_CACHE_FILE_VERSION) {
+        LOG_WARN("Discarding pipeline cache \"%s\": Incompatible file version", filePath.c_str());
+        return false;
+    }
+
+    if (header.vendorID != physicalDeviceProperties.vendorID ||
+        header.deviceID != physicalDeviceProperties.deviceID ||
+        header.driverVersion != physicalDeviceProperties.driverVersion ||
+        memcmp(header.pipelineCacheUUID, physicalDeviceProperties.pipelineCacheUUID.data(), VK_UUID_SIZE) != 0) {
+        LOG_INFO("Discarding pipeline cache \"%s\": It was created by a different device or driver version", filePath.c_str());
+        return false;
+    }
+
+    std::error_code error;
+    uint64_t fileSize = (uint64_t)std::filesystem::file_size(filePath, error);
+    if (error || header.dataSize > fileSize - sizeof(PipelineCacheFileHeader)) {
+        LOG_WARN("Discarding pipeline cache \"%s\": The file is truncated", filePath.c_str());
+        return false;
+    }
+
+    outData.resize(header.dataSize);
+    file.read((char*)outData.data(), (std::streamsize)outData.size());
+
+    if (!file.good() || Util::hashBytes(outData.data(), outData.size()) != header.dataHash) {
+        LOG_WARN("Discarding pipeline cache \"%s\": The file is corrupt", filePath.c_str());
+        outData.clear();
+        return false;
+    }
+
+    LOG_INFO("Loaded pipeline cache \"%s\" - %.2f KiB", filePath.c_str(), (double)outData.size() / 1024.0);
+    return true;
+}
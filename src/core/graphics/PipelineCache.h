@@ -0,0 +1,63 @@
+
+#ifndef WORLDENGINE_PIPELINECACHE_H
+#define WORLDENGINE_PIPELINECACHE_H
+
+#include "core/core.h"
+#include "core/graphics/GraphicsResource.h"
+#include "core/thread/Task.h"
+#include <functional>
+
+struct PipelineCacheConfiguration {
+    WeakResource<vkr::Device> device;
+    vk::PhysicalDeviceProperties physicalDeviceProperties;
+    std::string filePath; // Empty to keep the cache in memory only
+};
+
+// Process-wide pipeline cache passed to every pipeline creation. It is loaded from a file at startup and written back on
+// shutdown, so pipelines compiled in a previous run are not compiled again. The file stores the vendor, device, driver
+// version and cache UUID it was written with, and is discarded if any of them differ from the current device.
+//
+// Pipelines known ahead of time can be pre-warmed, which builds them on the thread pool only to fill the cache, so the
+// first real use does not stall the frame.
+class PipelineCache {
+    NO_COPY(PipelineCache);
+    NO_MOVE(PipelineCache);
+public:
+    // Runs on a worker thread. It must only use the device and pipeline cache, not any engine state.
+    typedef std::function<void(const vk::Device& device, const vk::PipelineCache& pipelineCache)> PrewarmTask;
+
+private:
+    PipelineCache(const WeakResource<vkr::Device>& device, const vk::PipelineCache& pipelineCache, const vk::PhysicalDeviceProperties& physicalDeviceProperties, const std::string& filePath);
+
+public:
+    ~PipelineCache();
+
+    static PipelineCache* create(const PipelineCacheConfiguration& pipelineCacheConfiguration, const std::string& name);
+
+    const vk::PipelineCache& getPipelineCache() const;
+
+    void prewarm(const PrewarmTask& task);
+
+    // Blocks until every queued pre-warm task has finished.
+    void waitPrewarm();
+
+    size_t getPendingPrewarmCount();
+
+    // Waits for any pre-warm tasks, then writes the cache data to the file.
+    bool save();
+
+    const std::string& getFilePath() const;
+
+private:
+    static bool readFile(const std::string& filePath, const vk::PhysicalDeviceProperties& physicalDeviceProperties, std::vector<uint8_t>& outData);
+
+private:
+    SharedResource<vkr::Device> m_device;
+    vk::PipelineCache m_pipelineCache;
+    vk::PhysicalDeviceProperties m_physicalDeviceProperties;
+    std::string m_filePath;
+    std::vector<TaskFuture<void>> m_prewarmFutures;
+};
+
+
+#endif //WORLDENGINE_PIPELINECACHE_H
@@ -3,12 +3,37 @@
 #include <fstream>
 #include <sstream>
 #include <filesystem>
+#include <cstring>
 #include "core/application/Application.h"
 #include "core/graphics/GraphicsManager.h"
 #include "core/engine/event/EventDispatcher.h"
+#include "core/thread/ThreadUtils.h"
+#include "core/util/Profiler.h"
 #include "core/util/Util.h"
 #include "core/util/Logger.h"
 
+#if SHADERC_ENABLED
+#include <shaderc/shaderc.hpp>
+#endif
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+// Part of every shader cache key. Must be incremented whenever the compile options change, otherwise shaders compiled
+// with the old options are still loaded from the cache.
+#define SHADER_CACHE_VERSION "1"
+
+// Also part of the key. The backends may be different versions of the compiler, so shaders compiled by one are never
+// loaded by the other when they share a cache directory.
+#if SHADERC_ENABLED
+#define SHADER_CACHE_BACKEND "shaderc"
+#else
+#define SHADER_CACHE_BACKEND "glslc"
+#endif
+
 struct DependencyFileInfo {
     std::string filePath;
     std::filesystem::file_time_type lastCheckTime;
@@ -26,6 +51,11 @@ struct LoadedShaderInfo {
     bool isValidShader;
 };
 
+struct ShaderCompileResult {
+    std::vector<char> bytecode;
+    std::vector<std::string> dependencyFilePaths;
+};
+
 
 class ShaderLoadingUpdater {
 private:
@@ -36,7 +66,9 @@ private:
 public:
     static ShaderLoadingUpdater* instance();
 
-    LoadedShaderInfo* notifyShaderLoaded(const LoadedShaderInfo& shaderInfo, bool reloaded);
+    LoadedShaderInfo* storeLoadedShader(const LoadedShaderInfo& shaderInfo);
+
+    void dispatchShaderLoaded(const LoadedShaderInfo* shaderInfo, bool reloaded);
 
     LoadedShaderInfo* getLoadedShaderInfo(const std::string& filePath, const std::string& entryPoint);
 
@@ -66,7 +98,7 @@ ShaderLoadingUpdater* ShaderLoadingUpdater::instance() {
     return s_instance;
 }
 
-LoadedShaderInfo* ShaderLoadingUpdater::notifyShaderLoaded(const LoadedShaderInfo& shaderInfo, bool reloaded) {
+LoadedShaderInfo* ShaderLoadingUpdater::storeLoadedShader(const LoadedShaderInfo& shaderInfo) {
     std::string key = getShaderKey(shaderInfo.filePath, shaderInfo.entryPoint);
     auto [it0, inserted0] = m_loadedShaders.insert(std::make_pair(key, shaderInfo));
     LoadedShaderInfo* newShaderInfo = &it0->second;
@@ -78,6 +110,7 @@ LoadedShaderInfo* ShaderLoadingUpdater::notifyShaderLoaded(const LoadedShaderInf
         newShaderInfo->stage = shaderInfo.stage;
         newShaderInfo->fileLoadedTime = shaderInfo.fileLoadedTime;
         newShaderInfo->dependencyFilePaths = shaderInfo.dependencyFilePaths; // vector copy
+        newShaderInfo->isValidShader = shaderInfo.isValidShader;
     }
 
     for (const std::string& dependencyFilePath : shaderInfo.dependencyFilePaths) {
@@ -90,15 +123,19 @@ LoadedShaderInfo* ShaderLoadingUpdater::notifyShaderLoaded(const LoadedShaderInf
         dependencyInfo.dependentShaderKeys.insert(key);
     }
 
+    // Cleared before any event is dispatched, so listeners recreating their pipelines get the new bytecode instead of
+    // compiling the shader again.
+    newShaderInfo->shouldReload = false;
+    return newShaderInfo;
+}
+
+void ShaderLoadingUpdater::dispatchShaderLoaded(const LoadedShaderInfo* newShaderInfo, bool reloaded) {
     ShaderLoadedEvent event{};
     event.filePath = newShaderInfo->filePath;
     event.entryPoint = newShaderInfo->entryPoint;
     event.reloaded = reloaded;
 //    printf("======== ======== DISPATCH ShaderLoadedEvent %s@%s (%s)======== ========\n\n", event.filePath.c_str(), event.entryPoint.c_str(), reloaded ? "reloaded" : "first loaded");
     Engine::eventDispatcher()->trigger(&event);
-
-    newShaderInfo->shouldReload = false;
-    return newShaderInfo;
 }
 
 LoadedShaderInfo* ShaderLoadingUpdater::getLoadedShaderInfo(const std::string& filePath, const std::string& entryPoint) {
@@ -137,6 +174,8 @@ void ShaderLoadingUpdater::checkModifiedShaders() {
         }
     }
 
+    std::vector<ShaderUtils::ShaderLoadRequest> reloadRequests;
+
     for (auto& [key, shaderInfo] : m_loadedShaders) {
         std::string absFilePath = Application::instance()->getResourceDirectory() + shaderInfo.filePath;
         if (std::filesystem::last_write_time(absFilePath) < shaderInfo.fileLoadedTime) {
@@ -145,11 +184,12 @@ void ShaderLoadingUpdater::checkModifiedShaders() {
 
         LOG_INFO("Reloading shader %s@%s", shaderInfo.filePath.c_str(), shaderInfo.entryPoint.c_str());
         shaderInfo.shouldReload = true;
+        reloadRequests.emplace_back(ShaderUtils::ShaderLoadRequest{ shaderInfo.stage, shaderInfo.filePath, shaderInfo.entryPoint });
+    }
 
-        if (!ShaderUtils::loadShaderStage(shaderInfo.stage, shaderInfo.filePath, shaderInfo.entryPoint, nullptr)) {
-            LOG_ERROR("Failed to reload shader %s@%s", shaderInfo.filePath.c_str(), shaderInfo.entryPoint.c_str());
-            continue;
-        }
+    // Editing a common include reloads every shader using it, so they are recompiled together.
+    if (!reloadRequests.empty() && !ShaderUtils::loadShaderStages(reloadRequests)) {
+        LOG_ERROR("Failed to reload one or more of %zu modified shaders", reloadRequests.size());
     }
 }
 
@@ -160,7 +200,205 @@ std::string ShaderLoadingUpdater::getShaderKey(const std::string& filePath, cons
 
 
 
-bool getShaderDependencies(const std::string shaderFilePath, const std::string& dependencyFilePath, std::vector<std::string>& outDependencyFiles) {
+static std::string getShaderCacheDirectory() {
+    return Application::instance()->getResourceDirectory() + "cache/shaders/";
+}
+
+static bool readFile(const std::string& filePath, std::string& outData) {
+    std::ifstream file(filePath, std::ios::ate | std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    outData.resize((size_t)file.tellg());
+    file.seekg(0);
+    file.read(outData.data(), (std::streamsize)outData.size());
+    return file.good();
+}
+
+static bool readBytecode(const std::string& filePath, std::vector<char>& outBytecode) {
+    std::ifstream file(filePath, std::ios::ate | std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    outBytecode.resize((size_t)file.tellg());
+    file.seekg(0);
+    file.read(outBytecode.data(), (std::streamsize)outBytecode.size());
+
+    // SPIR-V is a stream of 32-bit words.
+    return file.good() && !outBytecode.empty() && outBytecode.size() % 4 == 0;
+}
+
+// Thread ids alone may repeat between processes sharing the cache, so temporary files are named by process id as well.
+static std::string getTempFileSuffix() {
+#if defined(_WIN32)
+    int processId = _getpid();
+#else
+    int processId = (int)getpid();
+#endif
+    return ".tmp" + std::to_string(processId) + "-" + std::to_string(ThreadUtils::getCurrentThreadHashedId());
+}
+
+// Written to a temporary file first, then renamed, so that another process sharing the cache never reads a partially
+// written file.
+static bool writeCacheFile(const std::string& filePath, const void* data, size_t size) {
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(filePath).parent_path(), error);
+
+    std::string tempFilePath = filePath + getTempFileSuffix();
+    {
+        std::ofstream file(tempFilePath, std::ios::binary);
+        if (!file.is_open())
+            return false;
+        file.write((const char*)data, (std::streamsize)size);
+        if (!file.good())
+            return false;
+    }
+
+    std::filesystem::rename(tempFilePath, filePath, error);
+    if (error) {
+        std::filesystem::remove(tempFilePath, error);
+        return false;
+    }
+    return true;
+}
+
+// The key covers everything which affects the compiled output. The preprocessed source already contains every included
+// file and the entry point definition, so touching a file without changing it, or changing an unused include, does not
+// cause a recompile.
+static std::string getShaderCacheKey(const ShaderUtils::ShaderStage& shaderStage, const std::string& entryPoint, const std::string& preprocessedSource) {
+    uint64_t hash = Util::hashBytes(SHADER_CACHE_VERSION, strlen(SHADER_CACHE_VERSION));
+    hash = Util::hashBytes(SHADER_CACHE_BACKEND, strlen(SHADER_CACHE_BACKEND), hash);
+    hash = Util::hashBytes(&shaderStage, sizeof(shaderStage), hash);
+    hash = Util::hashBytes(entryPoint.data(), entryPoint.size(), hash);
+    hash = Util::hashBytes(preprocessedSource.data(), preprocessedSource.size(), hash);
+
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", (unsigned long long)hash);
+    return std::string(key);
+}
+
+static void addShaderDependency(const std::string& shaderFilePath, const std::filesystem::path& dependencyFilePath, std::vector<std::string>& outDependencyFiles) {
+    std::error_code error;
+    if (std::filesystem::equivalent(dependencyFilePath, shaderFilePath, error))
+        return;
+
+    // Relative to the resource directory, the same as the shader file paths.
+    std::string dependencyFile = std::filesystem::relative(dependencyFilePath, Application::instance()->getResourceDirectory(), error).string();
+    if (std::find(outDependencyFiles.begin(), outDependencyFiles.end(), dependencyFile) == outDependencyFiles.end())
+        outDependencyFiles.emplace_back(dependencyFile);
+}
+
+#if SHADERC_ENABLED
+
+// Resolves #include directives against the resource directory, or the directory of the including file, and records
+// every included file so that modifying it reloads the shader.
+class ShaderIncluder : public shaderc::CompileOptions::IncluderInterface {
+    struct IncludeData {
+        shaderc_include_result result;
+        std::string sourceName;
+        std::string content;
+    };
+
+public:
+    ShaderIncluder(const std::string& shaderFilePath, std::vector<std::string>* outDependencyFiles):
+            m_shaderFilePath(shaderFilePath),
+            m_dependencyFiles(outDependencyFiles) {
+    }
+
+    // Source names are kept relative to the resource directory. They end up in #line directives of the preprocessed
+    // source, which must not depend on where the resources are, for the cache to be shared between checkouts.
+    shaderc_include_result* GetInclude(const char* requestedSource, shaderc_include_type type, const char* requestingSource, size_t includeDepth) override {
+        std::filesystem::path resourceDirectory(Application::instance()->getResourceDirectory());
+        std::filesystem::path includePath = resourceDirectory / requestedSource;
+        if (type == shaderc_include_type_relative && !std::filesystem::exists(includePath))
+            includePath = resourceDirectory / std::filesystem::path(requestingSource).parent_path() / requestedSource;
+
+        IncludeData* data = new IncludeData();
+        if (readFile(includePath.string(), data->content)) {
+            std::error_code error;
+            data->sourceName = std::filesystem::relative(includePath, resourceDirectory, error).generic_string();
+            addShaderDependency(m_shaderFilePath, includePath, *m_dependencyFiles);
+        } else {
+            // An empty source name tells the compiler the include failed, and the content is the error message.
+            data->content = std::string("Unable to open included file \"") + requestedSource + "\"";
+        }
+
+        data->result.source_name = data->sourceName.c_str();
+        data->result.source_name_length = data->sourceName.size();
+        data->result.content = data->content.c_str();
+        data->result.content_length = data->content.size();
+        data->result.user_data = data;
+        return &data->result;
+    }
+
+    void ReleaseInclude(shaderc_include_result* result) override {
+        delete static_cast<IncludeData*>(result->user_data);
+    }
+
+private:
+    std::string m_shaderFilePath;
+    std::vector<std::string>* m_dependencyFiles;
+};
+
+static shaderc_shader_kind getShaderKind(const ShaderUtils::ShaderStage& shaderStage) {
+    switch (shaderStage) {
+        case ShaderUtils::ShaderStage_VertexShader: return shaderc_vertex_shader;
+        case ShaderUtils::ShaderStage_FragmentShader: return shaderc_fragment_shader;
+        case ShaderUtils::ShaderStage_TessellationControlShader: return shaderc_tess_control_shader;
+        case ShaderUtils::ShaderStage_TessellationEvaluationShader: return shaderc_tess_evaluation_shader;
+        case ShaderUtils::ShaderStage_GeometryShader: return shaderc_geometry_shader;
+        case ShaderUtils::ShaderStage_ComputeShader: return shaderc_compute_shader;
+        default: return shaderc_glsl_infer_from_source;
+    }
+}
+
+static const shaderc::Compiler& getShaderCompiler() {
+    // Compiling with one compiler from several threads is safe.
+    static shaderc::Compiler s_compiler;
+    return s_compiler;
+}
+
+static bool preprocessShader(const ShaderUtils::ShaderStage& shaderStage, const std::string& filePath, const std::string& absFilePath, const std::string& entryPoint, std::string& outPreprocessedSource, std::vector<std::string>& outDependencyFiles) {
+    std::string source;
+    if (!readFile(absFilePath, source)) {
+        LOG_ERROR("Shader source file \"%s\" was not found", absFilePath.c_str());
+        return false;
+    }
+
+    shaderc::CompileOptions options;
+    options.AddMacroDefinition(entryPoint, "main");
+    options.SetIncluder(std::make_unique<ShaderIncluder>(absFilePath, &outDependencyFiles));
+
+    shaderc::PreprocessedSourceCompilationResult result = getShaderCompiler().PreprocessGlsl(source, getShaderKind(shaderStage), filePath.c_str(), options);
+    if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+        LOG_ERROR("Failed to preprocess shader \"%s\"\n%s", absFilePath.c_str(), result.GetErrorMessage().c_str());
+        return false;
+    }
+
+    outPreprocessedSource.assign(result.cbegin(), result.cend());
+    return true;
+}
+
+static bool compileShader(const ShaderUtils::ShaderStage& shaderStage, const std::string& absFilePath, const std::string& preprocessedSource, const std::string& outputFilePath) {
+    shaderc::CompileOptions options;
+    options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+
+    shaderc::SpvCompilationResult result = getShaderCompiler().CompileGlslToSpv(preprocessedSource, getShaderKind(shaderStage), absFilePath.c_str(), "main", options);
+    if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+        LOG_ERROR("SPIR-V compilation failed\n%s", result.GetErrorMessage().c_str());
+        return false;
+    }
+
+    if (!writeCacheFile(outputFilePath, result.cbegin(), (size_t)(result.cend() - result.cbegin()) * sizeof(uint32_t))) {
+        LOG_ERROR("Failed to write compiled shader \"%s\"", outputFilePath.c_str());
+        return false;
+    }
+    return true;
+}
+
+#else
+
+static bool getShaderDependencies(const std::string& shaderFilePath, const std::string& dependencyFilePath, std::vector<std::string>& outDependencyFiles) {
     std::ifstream fs(dependencyFilePath.c_str(), std::ifstream::in);
     if (!fs.is_open()) {
         LOG_ERROR("Failed to open shader dependencies file \"%s\"", dependencyFilePath.c_str());
@@ -173,55 +411,156 @@ bool getShaderDependencies(const std::string shaderFilePath, const std::string&
     fs.close();
 
     Util::trim(dependencies);
-    size_t startSize = outDependencyFiles.size();
-    if (!Util::splitString(dependencies, ' ', outDependencyFiles)) {
+    std::vector<std::string> dependencyFiles;
+    if (!Util::splitString(dependencies, ' ', dependencyFiles)) {
         return true;
     }
 
-    auto it = outDependencyFiles.begin() + startSize;
-    assert(it != outDependencyFiles.end());
-    it = outDependencyFiles.erase(it); // Remove the first item in the split, since it is the name of the compiled SPIR-V output file.
+    // The first item in the split is the name of the output file.
+    for (auto it = dependencyFiles.begin() + 1; it != dependencyFiles.end(); ++it)
+        addShaderDependency(shaderFilePath, *it, outDependencyFiles);
 
-    const std::string& executionDir = Application::instance()->getExecutionDirectory();
+    return true;
+}
 
-    for (; it != outDependencyFiles.end();) {
-        std::string& dependencyFile = *it;
-        dependencyFile = std::filesystem::relative(dependencyFile, executionDir).string();
-        if (std::filesystem::equivalent(dependencyFile, shaderFilePath)) {
-            it = outDependencyFiles.erase(it);
-        } else {
-            ++it;
-        }
+static std::string getShaderCompilerCommand(const ShaderUtils::ShaderStage& shaderStage) {
+#if defined(_WIN32)
+    std::string command = Application::instance()->getShaderCompilerDirectory() + "glslc.exe";
+#else
+    std::string command = Application::instance()->getShaderCompilerDirectory() + "glslc";
+#endif
+    command +=
+            shaderStage == ShaderUtils::ShaderStage_VertexShader ? " -fshader-stage=vert" :
+            shaderStage == ShaderUtils::ShaderStage_FragmentShader ? " -fshader-stage=frag" :
+            shaderStage == ShaderUtils::ShaderStage_TessellationControlShader ? " -fshader-stage=tesc" :
+            shaderStage == ShaderUtils::ShaderStage_TessellationEvaluationShader ? " -fshader-stage=tese" :
+            shaderStage == ShaderUtils::ShaderStage_GeometryShader ? " -fshader-stage=geom" :
+            shaderStage == ShaderUtils::ShaderStage_ComputeShader ? " -fshader-stage=comp" : "";
+    return command;
+}
+
+static std::string getShaderPreprocessCommand(const ShaderUtils::ShaderStage& shaderStage, const std::string& absFilePath, const std::string& entryPoint) {
+    std::string command = getShaderCompilerCommand(shaderStage);
+    command += " -D" + entryPoint + "=main";
+//    command += " -fentry-point=" + entryPoint;
+
+    std::string includeDirectory = Application::instance()->getResourceDirectory(); // Always includes trailing file separator
+    includeDirectory = includeDirectory.substr(0, includeDirectory.size() - 1); // glsl compiler does not like trailing file separator on this file path
+
+    command += std::string(" \"") + absFilePath + "\"";
+    command += std::string(" -I \"") + includeDirectory + "\"";
+    return command;
+}
+
+static bool preprocessShader(const ShaderUtils::ShaderStage& shaderStage, const std::string& filePath, const std::string& absFilePath, const std::string& entryPoint, std::string& outPreprocessedSource, std::vector<std::string>& outDependencyFiles) {
+    if (!std::filesystem::exists(absFilePath)) {
+        LOG_ERROR("Shader source file \"%s\" was not found", absFilePath.c_str());
+        return false;
     }
 
+    // Each entry point gets its own dependency file, since entry points of one file may be preprocessed in parallel.
+    // They are kept in the cache rather than next to the sources, named after the source path relative to the
+    // resource directory.
+    std::string dependencyFileName = filePath + "." + entryPoint + ".dep";
+    std::replace_if(dependencyFileName.begin(), dependencyFileName.end(), [](char c) { return c == '/' || c == '\\' || c == ':'; }, '_');
+    std::string dependencyFilePath = getShaderCacheDirectory() + "deps/" + dependencyFileName;
+
+    std::error_code fsError;
+    std::filesystem::create_directories(std::filesystem::path(dependencyFilePath).parent_path(), fsError);
+
+    std::string command = getShaderPreprocessCommand(shaderStage, absFilePath, entryPoint);
+    int error = Util::executeCommand(command + " -E -MD -MF \"" + dependencyFilePath + "\"", outPreprocessedSource);
+    if (error != EXIT_SUCCESS) {
+        LOG_ERROR("Failed to preprocess shader \"%s\": The GLSL compiler was not found or failed. Make sure the location of the GLSL compiler is specified correctly using the --spvcdir program argument", absFilePath.c_str());
+        return false;
+    }
+
+    if (!getShaderDependencies(absFilePath, dependencyFilePath, outDependencyFiles)) {
+        LOG_WARN("Failed to get dependencies for shader \"%s\" - Modifications to any dependencies will not be reloaded", absFilePath.c_str());
+    }
     return true;
 }
 
-bool generateShaderDependencies(const std::string& command, const std::string& shaderFilePath, const std::string& dependencyFilePath) {
+static bool compileShader(const ShaderUtils::ShaderStage& shaderStage, const std::string& absFilePath, const std::string& preprocessedSource, const std::string& outputFilePath) {
+    std::string tempFilePath = outputFilePath + getTempFileSuffix();
+
+    // The preprocessed text is what was hashed for the cache key, so that is what gets compiled, rather than the source
+    // file, which may have changed since it was preprocessed. Its #line directives still refer to the original files.
+    std::string tempSourceFilePath = tempFilePath + ".glsl";
+    if (!writeCacheFile(tempSourceFilePath, preprocessedSource.data(), preprocessedSource.size())) {
+        LOG_ERROR("Failed to write preprocessed shader \"%s\"", absFilePath.c_str());
+        return false;
+    }
 
+    std::error_code error;
+
+    // The same target environment as the shaderc backend. glslc would otherwise target Vulkan 1.0.
     std::string commandResponse;
-    int error = Util::executeCommand(command + " -E -w -MD -MF \"" + dependencyFilePath + "\"", commandResponse);
-    if (error != EXIT_SUCCESS) {
+    int result = Util::executeCommand(getShaderCompilerCommand(shaderStage) + " --target-env=vulkan1.2 -x glsl \"" + tempSourceFilePath + "\" -o \"" + tempFilePath + "\"", commandResponse);
+    std::filesystem::remove(tempSourceFilePath, error);
+
+    if (result != EXIT_SUCCESS) {
         Util::trim(commandResponse);
-        commandResponse += "\n";
-        LOG_ERROR("Failed to retrieve dependencies for shader \"%s\"%s", commandResponse.c_str(), shaderFilePath.c_str());
+        LOG_ERROR("SPIR-V compile command failed for shader \"%s\"\n%s", absFilePath.c_str(), commandResponse.c_str());
+        std::filesystem::remove(tempFilePath, error);
         return false;
     }
 
+    std::filesystem::rename(tempFilePath, outputFilePath, error);
+    if (error) {
+        LOG_ERROR("Failed to write compiled shader \"%s\"", outputFilePath.c_str());
+        std::filesystem::remove(tempFilePath, error);
+        return false;
+    }
     return true;
 }
 
+#endif
 
+// Touches no shared state, so shaders can be compiled on any thread.
+static bool compileShaderStage(const ShaderUtils::ShaderStage& shaderStage, const std::string& filePath, const std::string& entryPoint, ShaderCompileResult& outResult) {
+    PROFILE_SCOPE("compileShaderStage");
 
+    std::string absFilePath = Application::instance()->getResourceDirectory() + filePath;
 
+    outResult.bytecode.clear();
+    outResult.dependencyFilePaths.clear();
 
-bool ShaderUtils::loadShaderStage(const ShaderStage& shaderStage, std::string filePath, std::string entryPoint, std::vector<char>* bytecode) {
+    if (absFilePath.ends_with(".spv")) {
+        // Precompiled SPIR-V is loaded as it is.
+        if (!readBytecode(absFilePath, outResult.bytecode)) {
+            LOG_ERROR("Shader file \"%s\" was not found", absFilePath.c_str());
+            return false;
+        }
+        return true;
+    }
 
-    Util::trim(filePath);
-    Util::trim(entryPoint);
+    // TODO: determine if source file is GLSL or HLSL and call correct compiler
 
+    std::string preprocessedSource;
+    if (!preprocessShader(shaderStage, filePath, absFilePath, entryPoint, preprocessedSource, outResult.dependencyFilePaths))
+        return false;
 
-    std::string absFilePath = Application::instance()->getResourceDirectory() + filePath;
+    std::string cacheFilePath = getShaderCacheDirectory() + getShaderCacheKey(shaderStage, entryPoint, preprocessedSource) + ".spv";
+
+    if (readBytecode(cacheFilePath, outResult.bytecode))
+        return true; // Identical source was already compiled, by this process or any other sharing the cache
+
+    LOG_INFO("Compiling shader: %s@%s", filePath.c_str(), entryPoint.c_str());
+
+    if (!compileShader(shaderStage, absFilePath, preprocessedSource, cacheFilePath))
+        return false;
+
+    if (!readBytecode(cacheFilePath, outResult.bytecode)) {
+        LOG_ERROR("Shader file \"%s\" was not found", cacheFilePath.c_str());
+        return false;
+    }
+    return true;
+}
+
+static bool validateShaderStage(std::string& filePath, std::string& entryPoint) {
+    Util::trim(filePath);
+    Util::trim(entryPoint);
 
     if (entryPoint.empty()) {
         LOG_ERROR("Cannot compile shader \"%s\": Entry point is not specified", filePath.c_str());
@@ -233,6 +572,38 @@ bool ShaderUtils::loadShaderStage(const ShaderStage& shaderStage, std::string fi
         return false;
     }
 
+    return true;
+}
+
+// Stores a compiled shader without dispatching any events, and returns the stored shader, or null if it failed to
+// compile. Must be called on the main thread.
+static LoadedShaderInfo* storeShaderStage(const ShaderUtils::ShaderStage& shaderStage, const std::string& filePath, const std::string& entryPoint, LoadedShaderInfo* loadedShaderInfo, bool compiled, ShaderCompileResult& result) {
+    if (compiled) {
+        LoadedShaderInfo newShaderInfo{};
+        newShaderInfo.stage = shaderStage;
+        newShaderInfo.filePath = filePath;
+        newShaderInfo.entryPoint = entryPoint;
+        newShaderInfo.fileLoadedTime = std::chrono::file_clock::now();
+        newShaderInfo.bytecode = std::move(result.bytecode);
+        newShaderInfo.isValidShader = true;
+        newShaderInfo.dependencyFilePaths = std::move(result.dependencyFilePaths);
+
+        return ShaderLoadingUpdater::instance()->storeLoadedShader(newShaderInfo);
+
+    } else if (loadedShaderInfo != nullptr) {
+        // This shader was reloaded, but was not valid. Don't keep trying to reload it.
+        loadedShaderInfo->fileLoadedTime = std::chrono::file_clock::now();
+        loadedShaderInfo->shouldReload = false;
+        loadedShaderInfo->isValidShader = false;
+    }
+
+    return nullptr;
+}
+
+bool ShaderUtils::loadShaderStage(const ShaderStage& shaderStage, std::string filePath, std::string entryPoint, std::vector<char>* bytecode) {
+    if (!validateShaderStage(filePath, entryPoint))
+        return false;
+
     LoadedShaderInfo* loadedShaderInfo = ShaderLoadingUpdater::instance()->getLoadedShaderInfo(filePath, entryPoint);
     if (loadedShaderInfo != nullptr && !loadedShaderInfo->shouldReload) {
         if (bytecode != nullptr)
@@ -240,132 +611,91 @@ bool ShaderUtils::loadShaderStage(const ShaderStage& shaderStage, std::string fi
         return true;
     }
 
-#if defined(ALWAYS_RELOAD_SHADERS)
-    constexpr bool alwaysReloadShaders = true;
-#else
-    constexpr bool alwaysReloadShaders = true;
-#endif
-
-    // TODO: determine if source file is GLSL or HLSL and call correct compiler
-
-    std::string outputFilePath = absFilePath;
-    std::string dependencyFilePath = outputFilePath + ".dep";
-
-    bool isValidShader = true; // By default, we assume the shader is valid. This is overwritten if the shader gets recompiled.
+    ShaderCompileResult result;
+    bool compiled = compileShaderStage(shaderStage, filePath, entryPoint, result);
+    bool reloaded = loadedShaderInfo != nullptr;
 
-    if (!outputFilePath.ends_with(".spv")) {
+    LoadedShaderInfo* newShaderInfo = storeShaderStage(shaderStage, filePath, entryPoint, loadedShaderInfo, compiled, result);
+    if (newShaderInfo == nullptr)
+        return false;
 
-        outputFilePath += ".spv";
-        dependencyFilePath = outputFilePath + ".dep";
+    if (bytecode != nullptr)
+        *bytecode = newShaderInfo->bytecode; // copy assignment
 
-        bool shouldCompile = false;
+    ShaderLoadingUpdater::instance()->dispatchShaderLoaded(newShaderInfo, reloaded);
+    return true;
+}
 
-        if (alwaysReloadShaders) {
-            shouldCompile = true;
-        } else {
-            if (!std::filesystem::exists(outputFilePath)) {
-                // Compiled file does not exist.
+bool ShaderUtils::loadShaderStages(const std::vector<ShaderLoadRequest>& shaderStages) {
+    PROFILE_SCOPE("ShaderUtils::loadShaderStages");
 
-                if (!std::filesystem::exists(absFilePath)) {
-                    // Source file does not exist
-                    LOG_ERROR("Shader source file \"%s\" was not found", filePath.c_str());
-                    return false;
-                }
+    struct PendingShader {
+        ShaderLoadRequest request;
+        LoadedShaderInfo* loadedShaderInfo;
+        ShaderCompileResult result;
+        bool compiled;
+    };
 
-                shouldCompile = true;
+    bool success = true;
+    std::vector<PendingShader> pendingShaders;
 
-            } else if (std::filesystem::exists(absFilePath)) {
-                // Compiled file and source file both exist
+    for (const ShaderLoadRequest& shaderStage : shaderStages) {
+        ShaderLoadRequest request = shaderStage;
+        if (!validateShaderStage(request.filePath, request.entryPoint)) {
+            success = false;
+            continue;
+        }
 
-                auto lastModifiedSource = std::filesystem::last_write_time(absFilePath);
-                auto lastCompiled = std::filesystem::last_write_time(outputFilePath);
+        LoadedShaderInfo* loadedShaderInfo = ShaderLoadingUpdater::instance()->getLoadedShaderInfo(request.filePath, request.entryPoint);
+        if (loadedShaderInfo != nullptr && !loadedShaderInfo->shouldReload)
+            continue;
 
-                if (lastModifiedSource > lastCompiled) {
-                    // Source file was modified after the shader was last compiled
-                    shouldCompile = true;
-                }
-            }
-        }
+        bool duplicate = false;
+        for (const PendingShader& pendingShader : pendingShaders)
+            duplicate |= pendingShader.request.filePath == request.filePath && pendingShader.request.entryPoint == request.entryPoint;
 
-        if (shouldCompile) {
-            LOG_INFO("Compiling shader: %s@%s", filePath.c_str(), entryPoint.c_str());
-
-            const std::string& glslcdir = Application::instance()->getShaderCompilerDirectory();
-            if (!glslcdir.empty() && !std::filesystem::exists(glslcdir + "glslc.exe")) {
-                LOG_ERROR("Unable to compile shader: GLSL compiler (glslc.exe) was not found in the directory \"%s\". Make sure the location of the GLSL compiler is specified correctly using the --spvcdir program argument",
-                       Application::instance()->getShaderCompilerDirectory().c_str());
-                isValidShader = false;
-            } else {
-
-                std::string command = glslcdir + "glslc.exe";
-                command +=
-                        shaderStage == ShaderStage_VertexShader ? " -fshader-stage=vert" :
-                        shaderStage == ShaderStage_FragmentShader ? " -fshader-stage=frag" :
-                        shaderStage == ShaderStage_TessellationControlShader ? " -fshader-stage=tesc" :
-                        shaderStage == ShaderStage_TessellationEvaluationShader ? " -fshader-stage=tese" :
-                        shaderStage == ShaderStage_GeometryShader ? " -fshader-stage=geom" :
-                        shaderStage == ShaderStage_ComputeShader ? " -fshader-stage=comp" : "";
-
-                command += " -D" + entryPoint + "=main";
-//            command += " -fentry-point=" + entryPoint;
-
-                std::string includeDirectory = Application::instance()->getResourceDirectory(); // Always includes trailing file separator
-                includeDirectory = includeDirectory.substr(0, includeDirectory.size() - 1); // glsl compiler does not like trailing file separator on this file path
-
-                command += std::string(" \"") + absFilePath + "\"";
-                command += std::string(" -I \"") + includeDirectory + "\"";
-
-                std::string commandResponse;
-                int error = Util::executeCommand(command + " -o \"" + outputFilePath + "\"", commandResponse);
-                isValidShader = error == EXIT_SUCCESS;
-                if (!isValidShader) {
-                    Util::trim(commandResponse);
-                    LOG_ERROR("SPIR-V compile command failed\n%s", commandResponse.c_str());
-                } else {
-                    generateShaderDependencies(command, filePath, dependencyFilePath);
-                }
-            }
-        }
+        if (!duplicate)
+            pendingShaders.emplace_back(PendingShader{ request, loadedShaderInfo, {}, false });
     }
 
-    if (isValidShader) {
-        std::ifstream file(outputFilePath, std::ios::ate | std::ios::binary);
+    if (pendingShaders.size() == 1) {
+        PendingShader& pendingShader = pendingShaders[0];
+        pendingShader.compiled = compileShaderStage(pendingShader.request.stage, pendingShader.request.filePath, pendingShader.request.entryPoint, pendingShader.result);
 
-        if (!file.is_open()) {
-            LOG_ERROR("Shader file \"%s\" was not found", outputFilePath.c_str());
-            return false;
-        }
-
-        LoadedShaderInfo newShaderInfo{};
-        newShaderInfo.stage = shaderStage;
-        newShaderInfo.filePath = filePath;
-        newShaderInfo.entryPoint = entryPoint;
-        newShaderInfo.fileLoadedTime = std::chrono::file_clock::now();
-        newShaderInfo.bytecode.resize((size_t)file.tellg());
-        newShaderInfo.isValidShader = isValidShader;
-        newShaderInfo.dependencyFilePaths.clear();
+    } else if (pendingShaders.size() > 1) {
+        std::vector<TaskFuture<void>> futures;
+        futures.reserve(pendingShaders.size());
 
-        if (!getShaderDependencies(absFilePath, dependencyFilePath, newShaderInfo.dependencyFilePaths)) {
-            LOG_WARN("Failed to get dependencies for shader \"%s\" - Modifications to any dependencies will not be reloaded", absFilePath.c_str());
+        for (PendingShader& pendingShader : pendingShaders) {
+            PendingShader* shader = &pendingShader;
+            futures.emplace_back(ThreadUtils::run([shader]() {
+                shader->compiled = compileShaderStage(shader->request.stage, shader->request.filePath, shader->request.entryPoint, shader->result);
+            }));
         }
 
-        file.seekg(0);
-        file.read(newShaderInfo.bytecode.data(), (std::streamsize) newShaderInfo.bytecode.size());
-        file.close();
-
-        if (bytecode != nullptr)
-            *bytecode = newShaderInfo.bytecode; // copy assignment
-
-        ShaderLoadingUpdater::instance()->notifyShaderLoaded(newShaderInfo, loadedShaderInfo != nullptr && loadedShaderInfo->shouldReload);
+        ThreadUtils::wait(futures);
+    }
 
-    } else if (loadedShaderInfo != nullptr) {
-        // This shader was reloaded, but was not valid. Don't keep trying to reload it.
-        loadedShaderInfo->fileLoadedTime = std::chrono::file_clock::now();
-        loadedShaderInfo->shouldReload = false;
-        loadedShaderInfo->isValidShader = false;
+    // Every shader is stored before any events are dispatched. A listener recreating its pipeline may load other shaders
+    // from this batch, and must not compile them again.
+    std::vector<std::pair<LoadedShaderInfo*, bool>> loadedShaders;
+    loadedShaders.reserve(pendingShaders.size());
+
+    for (PendingShader& pendingShader : pendingShaders) {
+        const ShaderLoadRequest& request = pendingShader.request;
+        bool reloaded = pendingShader.loadedShaderInfo != nullptr;
+        LoadedShaderInfo* newShaderInfo = storeShaderStage(request.stage, request.filePath, request.entryPoint, pendingShader.loadedShaderInfo, pendingShader.compiled, pendingShader.result);
+        if (newShaderInfo == nullptr) {
+            success = false;
+            continue;
+        }
+        loadedShaders.emplace_back(newShaderInfo, reloaded);
     }
 
-    return isValidShader;
+    for (const auto& [newShaderInfo, reloaded] : loadedShaders)
+        ShaderLoadingUpdater::instance()->dispatchShaderLoaded(newShaderInfo, reloaded);
+
+    return success;
 }
 
 bool ShaderUtils::loadShaderModule(const ShaderStage& shaderStage, const vk::Device& device, const std::string& filePath, const std::string& entryPoint, vk::ShaderModule* outShaderModule) {
@@ -19,8 +19,18 @@ namespace ShaderUtils {
         ShaderStage_GeometryShader = 5,
         ShaderStage_ComputeShader = 6,
     };
+
+    struct ShaderLoadRequest {
+        ShaderStage stage;
+        std::string filePath;
+        std::string entryPoint;
+    };
+
     bool loadShaderStage(const ShaderStage& shaderStage, std::string filePath, std::string entryPoint, std::vector<char>* bytecode);
 
+    // Loads several shader stages at once. Stages which are not loaded yet are compiled in parallel on the thread pool.
+    bool loadShaderStages(const std::vector<ShaderLoadRequest>& shaderStages);
+
     bool loadShaderModule(const ShaderStage& shaderStage, const vk::Device& device, const std::string& filePath, const std::string& entryPoint, vk::ShaderModule* outShaderModule);
 };
 
@@ -0,0 +1,469 @@
+#include "core/graphics/UploadManager.h"
+#include "core/graphics/Buffer.h"
+#include "core/graphics/CommandPool.h"
+#include "core/graphics/Fence.h"
+#include "core/graphics/GraphicsManager.h"
+#include "core/application/Engine.h"
+#include "core/util/Util.h"
+#include "core/util/Logger.h"
+#include "core/util/Profiler.h"
+#include <numeric>
+
+static void copyElements(uint8_t* dstBytes, const uint8_t* srcBytes, vk::DeviceSize size, vk::DeviceSize srcStride, vk::DeviceSize dstStride, vk::DeviceSize elementSize) {
+    if (srcStride == 0 && dstStride == 0) {
+        memcpy(dstBytes, srcBytes, (size_t)size);
+        return;
+    }
+
+    assert(elementSize != 0);
+    vk::DeviceSize srcIncr = srcStride == 0 ? elementSize : srcStride;
+    vk::DeviceSize dstIncr = dstStride == 0 ? elementSize : dstStride;
+    vk::DeviceSize elementCount = size / elementSize;
+
+    for (vk::DeviceSize i = 0; i < elementCount; ++i)
+        memcpy(dstBytes + (size_t)(i * dstIncr), srcBytes + (size_t)(i * srcIncr), (size_t)elementSize);
+}
+
+UploadManager::UploadManager(const WeakResource<vkr::Device>& device, Buffer* stagingBuffer, void* stagingData, const SharedResource<CommandPool>& commandPool, const std::shared_ptr<vkr::Queue>& queue):
+        m_device(device, "UploadManager-Device"),
+        m_queue(queue),
+        m_commandPool(commandPool),
+        m_stagingBuffer(stagingBuffer),
+        m_stagingData(static_cast<uint8_t*>(stagingData)),
+        m_stagingBufferSize(stagingBuffer->getSize()),
+        m_ringHead(0),
+        m_ringTail(0),
+        m_openBatch(nullptr),
+        m_nextBatchId(1),
+        m_lastCompletedBatchId(INVALID_UPLOAD),
+        m_submittedSinceFrame(false) {
+
+    vk::SemaphoreCreateInfo semaphoreCreateInfo{};
+    for (size_t i = 0; i < CONCURRENT_FRAMES; ++i)
+        m_frameSemaphores[i] = std::make_unique<vkr::Semaphore>(*m_device, semaphoreCreateInfo);
+}
+
+UploadManager::~UploadManager() {
+    synchronize();
+
+    if (m_openBatch != nullptr) {
+        (**m_openBatch->commandBuffer).end();
+        m_unusedBatches.emplace_back(m_openBatch);
+        m_openBatch = nullptr;
+    }
+
+    for (Batch* batch : m_unusedBatches) {
+        delete batch->fence;
+        delete batch;
+    }
+    m_unusedBatches.clear();
+
+    for (auto& semaphore : m_frameSemaphores)
+        semaphore.reset();
+
+    m_stagingBuffer->unmap();
+    delete m_stagingBuffer;
+
+    m_commandPool.reset();
+}
+
+UploadManager* UploadManager::create(const UploadManagerConfiguration& uploadManagerConfiguration, const std::string& name) {
+    SharedResource<vkr::Device> device = uploadManagerConfiguration.device.lock(name);
+
+    BufferConfiguration stagingBufferConfig{};
+    stagingBufferConfig.device = device;
+    stagingBufferConfig.size = uploadManagerConfiguration.stagingBufferSize;
+    stagingBufferConfig.usage = vk::BufferUsageFlagBits::eTransferSrc;
+    stagingBufferConfig.memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+    Buffer* stagingBuffer = Buffer::create(stagingBufferConfig, name + "-StagingBuffer");
+    if (stagingBuffer == nullptr) {
+        LOG_ERROR("Unable to create UploadManager \"%s\": Failed to create staging buffer", name.c_str());
+        return nullptr;
+    }
+
+    void* stagingData = stagingBuffer->map(); // Stays mapped until the UploadManager is destroyed
+    if (stagingData == nullptr) {
+        LOG_ERROR("Unable to create UploadManager \"%s\": Failed to map staging buffer", name.c_str());
+        delete stagingBuffer;
+        return nullptr;
+    }
+
+    CommandPoolConfiguration commandPoolConfig{};
+    commandPoolConfig.device = device;
+    commandPoolConfig.queueFamilyIndex = uploadManagerConfiguration.queueFamilyIndex;
+    commandPoolConfig.resetCommandBuffer = true;
+    commandPoolConfig.transient = true;
+    CommandPool* commandPool = CommandPool::create(commandPoolConfig, name + "-CommandPool");
+    if (commandPool == nullptr) {
+        LOG_ERROR("Unable to create UploadManager \"%s\": Failed to create command pool", name.c_str());
+        stagingBuffer->unmap();
+        delete stagingBuffer;
+        return nullptr;
+    }
+
+    char c1[6] = "";
+    LOG_INFO("Created UploadManager \"%s\" with a %.3f %s staging buffer", name.c_str(), Util::getMemorySizeMagnitude(stagingBuffer->getSize(), c1), c1);
+
+    return new UploadManager(device, stagingBuffer, stagingData, SharedResource<CommandPool>(commandPool), Engine::graphics()->getQueue(uploadManagerConfiguration.queueName));
+}
+
+UploadManager::UploadId UploadManager::uploadBuffer(Buffer* dstBuffer, vk::DeviceSize offset, vk::DeviceSize size, const void* data, vk::DeviceSize srcStride, vk::DeviceSize dstStride, vk::DeviceSize elementSize, const CompletionCallback& callback) {
+    PROFILE_SCOPE("UploadManager::uploadBuffer")
+    assert(dstBuffer != nullptr);
+
+    if (size == 0)
+        return recordCallback(callback);
+
+    vk::DeviceSize dstSize = size;
+    if (dstStride != 0) {
+        assert(elementSize != 0);
+        assert(dstStride >= elementSize);
+        vk::DeviceSize elementCount = size / elementSize;
+        assert(elementCount * elementSize == size); // if elementSize is provided, the size of the data buffer must be a multiple of elementSize
+        dstSize = elementCount * dstStride;
+    }
+
+    vk::DeviceSize alignment = Engine::graphics()->getPhysicalDeviceLimits().optimalBufferCopyOffsetAlignment;
+
+    vk::Buffer srcBuffer = nullptr;
+    vk::DeviceSize srcOffset = 0;
+    uint8_t* stagingData = allocateStaging(dstSize, alignment, srcBuffer, srcOffset);
+    if (stagingData == nullptr) {
+        LOG_ERROR("Unable to upload %llu bytes to buffer \"%s\": Failed to allocate staging memory", (unsigned long long)dstSize, dstBuffer->getName().c_str());
+        return INVALID_UPLOAD;
+    }
+
+    copyElements(stagingData, static_cast<const uint8_t*>(data), size, srcStride, dstStride, elementSize);
+
+    vk::BufferCopy copyRegion{};
+    copyRegion.setSrcOffset(srcOffset);
+    copyRegion.setDstOffset(offset);
+    copyRegion.setSize(dstSize);
+    (**getOpenBatch().commandBuffer).copyBuffer(srcBuffer, dstBuffer->getBuffer(), 1, &copyRegion);
+
+    return recordCallback(callback);
+}
+
+UploadManager::UploadId UploadManager::uploadImage(const vk::Image& dstImage, const void* data, uint32_t bytesPerPixel, vk::ImageAspectFlags aspectMask, const ImageRegion& imageRegion, const ImageTransitionState& srcState, const ImageTransitionState& dstState, const CompletionCallback& callback) {
+    PROFILE_SCOPE("UploadManager::uploadImage")
+
+    if (!dstImage || data == nullptr || bytesPerPixel == 0) {
+        assert(false);
+        return INVALID_UPLOAD;
+    }
+
+    if (imageRegion.width >= ImageRegion::WHOLE_SIZE
+        || imageRegion.height >= ImageRegion::WHOLE_SIZE
+        || imageRegion.depth >= ImageRegion::WHOLE_SIZE
+        || imageRegion.layerCount >= ImageRegion::WHOLE_SIZE) {
+        LOG_ERROR("Unable to upload Image: Image region is out of bounds");
+        return INVALID_UPLOAD;
+    }
+
+    if (imageRegion.mipLevelCount != 1) {
+        LOG_ERROR("Unable to upload Image: Only one mip level can be uploaded at a time");
+        return INVALID_UPLOAD;
+    }
+
+    vk::DeviceSize size = ImageUtil::getImageSizeBytes(imageRegion, bytesPerPixel);
+
+    // Buffer offsets for image copies must be a multiple of the texel size and of 4.
+    vk::DeviceSize alignment = std::lcm((vk::DeviceSize)bytesPerPixel, (vk::DeviceSize)4);
+    alignment = std::lcm(alignment, Engine::graphics()->getPhysicalDeviceLimits().optimalBufferCopyOffsetAlignment);
+
+    vk::Buffer srcBuffer = nullptr;
+    vk::DeviceSize srcOffset = 0;
+    uint8_t* stagingData = allocateStaging(size, alignment, srcBuffer, srcOffset);
+    if (stagingData == nullptr) {
+        LOG_ERROR("Unable to upload Image: Failed to allocate %llu bytes of staging memory", (unsigned long long)size);
+        return INVALID_UPLOAD;
+    }
+
+    memcpy(stagingData, data, (size_t)size);
+
+    vk::BufferImageCopy imageCopy{};
+    imageCopy.setBufferOffset(srcOffset);
+    imageCopy.setBufferRowLength(0);
+    imageCopy.setBufferImageHeight(0);
+    imageCopy.imageSubresource.setAspectMask(aspectMask);
+    imageCopy.imageSubresource.setMipLevel(imageRegion.baseMipLevel);
+    imageCopy.imageSubresource.setBaseArrayLayer(imageRegion.baseLayer);
+    imageCopy.imageSubresource.setLayerCount(imageRegion.layerCount);
+    imageCopy.imageOffset.setX((int32_t)imageRegion.x);
+    imageCopy.imageOffset.setY((int32_t)imageRegion.y);
+    imageCopy.imageOffset.setZ((int32_t)imageRegion.z);
+    imageCopy.imageExtent.setWidth(imageRegion.width);
+    imageCopy.imageExtent.setHeight(imageRegion.height);
+    imageCopy.imageExtent.setDepth(imageRegion.depth);
+
+    ImageUtil::transferBufferToImage(**getOpenBatch().commandBuffer, dstImage, srcBuffer, imageCopy, srcState, dstState);
+
+    return recordCallback(callback);
+}
+
+UploadManager::UploadId UploadManager::copyBuffer(Buffer* srcBuffer, Buffer* dstBuffer, vk::DeviceSize size, vk::DeviceSize srcOffset, vk::DeviceSize dstOffset, const CompletionCallback& callback) {
+    assert(srcBuffer != nullptr && dstBuffer != nullptr);
+
+    vk::BufferCopy copyRegion{};
+    copyRegion.setSrcOffset(srcOffset);
+    copyRegion.setDstOffset(dstOffset);
+    copyRegion.setSize(size);
+    (**getOpenBatch().commandBuffer).copyBuffer(srcBuffer->getBuffer(), dstBuffer->getBuffer(), 1, &copyRegion);
+
+    return recordCallback(callback);
+}
+
+UploadManager::UploadId UploadManager::record(const std::function<void(const vk::CommandBuffer&)>& recordCommands, const CompletionCallback& callback) {
+    recordCommands(**getOpenBatch().commandBuffer);
+    return recordCallback(callback);
+}
+
+void UploadManager::flush() {
+    if (m_openBatch != nullptr && !m_openBatch->empty)
+        submitBatch(m_openBatch, nullptr);
+}
+
+void UploadManager::update() {
+    PROFILE_SCOPE("UploadManager::update")
+
+    while (!m_submittedBatches.empty() && m_submittedBatches.front()->fence->getStatus() == Fence::Status_Signaled)
+        retireBatch();
+}
+
+bool UploadManager::isComplete(UploadId uploadId) const {
+    if (uploadId <= m_lastCompletedBatchId)
+        return true;
+
+    for (Batch* batch : m_submittedBatches) {
+        if (batch->id == uploadId)
+            return batch->fence->getStatus() == Fence::Status_Signaled;
+    }
+
+    return false; // Still recording
+}
+
+void UploadManager::wait(UploadId uploadId) {
+    if (uploadId <= m_lastCompletedBatchId)
+        return;
+
+    PROFILE_SCOPE("UploadManager::wait")
+
+    if (m_openBatch != nullptr && m_openBatch->id <= uploadId)
+        flush();
+
+    while (!m_submittedBatches.empty() && m_submittedBatches.front()->id <= uploadId)
+        waitOldestBatch();
+}
+
+void UploadManager::synchronize() {
+    if (!hasPendingUploads())
+        return;
+
+    PROFILE_SCOPE("UploadManager::synchronize")
+
+    flush();
+
+    while (!m_submittedBatches.empty())
+        waitOldestBatch();
+}
+
+const vk::Semaphore* UploadManager::flushFrame(uint32_t frameIndex) {
+    PROFILE_SCOPE("UploadManager::flushFrame")
+
+    // The frame's previous use of this semaphore was waited on by a submit whose fence has since been waited on.
+    const vk::Semaphore* semaphore = &**m_frameSemaphores[frameIndex];
+
+    if (m_openBatch != nullptr && !m_openBatch->empty) {
+        submitBatch(m_openBatch, semaphore);
+    } else if (m_submittedSinceFrame) {
+        submitBatch(nullptr, semaphore); // Signals once all earlier submits to the queue have completed
+    } else {
+        return nullptr;
+    }
+
+    m_submittedSinceFrame = false;
+    return semaphore;
+}
+
+bool UploadManager::hasPendingUploads() const {
+    return (m_openBatch != nullptr && !m_openBatch->empty) || !m_submittedBatches.empty();
+}
+
+vk::DeviceSize UploadManager::getStagingBufferSize() const {
+    return m_stagingBufferSize;
+}
+
+vk::DeviceSize UploadManager::getStagingBytesInUse() const {
+    return m_ringHead - m_ringTail;
+}
+
+uint8_t* UploadManager::allocateStaging(vk::DeviceSize size, vk::DeviceSize alignment, vk::Buffer& outBuffer, vk::DeviceSize& outOffset) {
+    if (size > m_stagingBufferSize) {
+        // Would never fit in the ring, so it gets a buffer of its own, which lives until its batch completes.
+        BufferConfiguration stagingBufferConfig{};
+        stagingBufferConfig.device = m_device;
+        stagingBufferConfig.size = size;
+        stagingBufferConfig.usage = vk::BufferUsageFlagBits::eTransferSrc;
+        stagingBufferConfig.memoryProperties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+        Buffer* stagingBuffer = Buffer::create(stagingBufferConfig, "UploadManager-DedicatedStagingBuffer");
+        if (stagingBuffer == nullptr)
+            return nullptr;
+
+        getOpenBatch().dedicatedStagingBuffers.emplace_back(stagingBuffer);
+        outBuffer = stagingBuffer->getBuffer();
+        outOffset = 0;
+        return static_cast<uint8_t*>(stagingBuffer->map());
+    }
+
+    vk::DeviceSize offset;
+    while (!tryAllocateRing(size, alignment, offset)) {
+        // The ring is full. Submit whatever holds it, and free the oldest part.
+        flush();
+        assert(!m_submittedBatches.empty());
+        waitOldestBatch();
+    }
+
+    getOpenBatch().stagingEnd = m_ringHead;
+    outBuffer = m_stagingBuffer->getBuffer();
+    outOffset = offset;
+    return m_stagingData + (size_t)offset;
+}
+
+bool UploadManager::tryAllocateRing(vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize& outOffset) {
+    if (m_ringHead == m_ringTail) {
+        // Nothing is in use, so start from the beginning of the ring, where the whole of it is contiguous.
+        m_ringHead = CEIL_TO_MULTIPLE(m_ringHead, m_stagingBufferSize);
+        m_ringTail = m_ringHead;
+    }
+
+    uint64_t offset = m_ringHead % m_stagingBufferSize;
+    uint64_t alignedOffset = CEIL_TO_MULTIPLE(offset, alignment);
+    uint64_t start = m_ringHead + (alignedOffset - offset);
+
+    if (alignedOffset + size > m_stagingBufferSize) {
+        // Does not fit before the end of the ring. Skip the rest of it and start again from the beginning.
+        start = m_ringHead + (m_stagingBufferSize - offset);
+        alignedOffset = 0;
+    }
+
+    uint64_t end = start + size;
+    if (end - m_ringTail > m_stagingBufferSize)
+        return false; // Would overwrite staging data which is still being copied from
+
+    m_ringHead = end;
+    outOffset = alignedOffset;
+    return true;
+}
+
+UploadManager::Batch& UploadManager::getOpenBatch() {
+    if (m_openBatch != nullptr)
+        return *m_openBatch;
+
+    if (m_unusedBatches.empty()) {
+        Batch* batch = new Batch();
+        batch->commandBuffer = m_commandPool->allocateCommandBuffer({vk::CommandBufferLevel::ePrimary}, "UploadManager-BatchCommandBuffer");
+
+        FenceConfiguration fenceConfig{};
+        fenceConfig.device = m_device;
+        fenceConfig.createSignaled = false;
+        batch->fence = Fence::create(fenceConfig, "UploadManager-BatchFence");
+        m_unusedBatches.emplace_back(batch);
+    }
+
+    m_openBatch = m_unusedBatches.back();
+    m_unusedBatches.pop_back();
+
+    m_openBatch->id = m_nextBatchId++;
+    m_openBatch->stagingEnd = m_ringHead;
+    m_openBatch->empty = true;
+
+    const vk::CommandBuffer& commandBuffer = **m_openBatch->commandBuffer;
+
+    vk::CommandBufferBeginInfo commandBeginInfo{};
+    commandBeginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+    commandBuffer.begin(commandBeginInfo);
+
+    // Batches are not otherwise ordered against each other, and may copy to the same destination.
+    vk::MemoryBarrier memoryBarrier{};
+    memoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+    memoryBarrier.setDstAccessMask(vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+    return *m_openBatch;
+}
+
+UploadManager::UploadId UploadManager::recordCallback(const CompletionCallback& callback) {
+    Batch& batch = getOpenBatch();
+    batch.empty = false;
+    if (callback)
+        batch.callbacks.emplace_back(callback);
+    return batch.id;
+}
+
+void UploadManager::submitBatch(Batch* batch, const vk::Semaphore* signalSemaphore) {
+    PROFILE_SCOPE("UploadManager::submitBatch")
+
+    vk::SubmitInfo queueSubmitInfo{};
+    vk::Fence fence = nullptr;
+
+    if (batch != nullptr) {
+        assert(batch == m_openBatch);
+        const vk::CommandBuffer& commandBuffer = **batch->commandBuffer;
+        commandBuffer.end();
+        queueSubmitInfo.setCommandBufferCount(1);
+        queueSubmitInfo.setPCommandBuffers(&commandBuffer);
+        fence = batch->fence->getFence();
+    }
+
+    if (signalSemaphore != nullptr) {
+        queueSubmitInfo.setSignalSemaphoreCount(1);
+        queueSubmitInfo.setPSignalSemaphores(signalSemaphore);
+    }
+
+    vk::Result result = (**m_queue).submit(1, &queueSubmitInfo, fence);
+    assert(result == vk::Result::eSuccess);
+
+    if (batch != nullptr) {
+        m_submittedBatches.emplace_back(batch);
+        m_openBatch = nullptr;
+        m_submittedSinceFrame = true;
+    }
+}
+
+void UploadManager::retireBatch() {
+    assert(!m_submittedBatches.empty());
+
+    Batch* batch = m_submittedBatches.front();
+    m_submittedBatches.pop_front();
+
+    m_ringTail = glm::max(m_ringTail, batch->stagingEnd); // Batches which staged nothing may end before the ring was restarted
+    m_lastCompletedBatchId = batch->id;
+
+    for (Buffer* stagingBuffer : batch->dedicatedStagingBuffers) {
+        stagingBuffer->unmap();
+        delete stagingBuffer;
+    }
+    batch->dedicatedStagingBuffers.clear();
+
+    batch->fence->reset();
+
+    // Callbacks may upload more, so the batch is recycled before they run.
+    std::vector<CompletionCallback> callbacks;
+    std::swap(callbacks, batch->callbacks);
+    m_unusedBatches.emplace_back(batch);
+
+    for (const CompletionCallback& callback : callbacks)
+        callback();
+}
+
+void UploadManager::waitOldestBatch() {
+    assert(!m_submittedBatches.empty());
+
+    PROFILE_SCOPE("UploadManager::waitOldestBatch")
+
+    Batch* batch = m_submittedBatches.front();
+    bool signaled = batch->fence->wait(UINT64_MAX);
+    assert(signaled);
+
+    retireBatch();
+}
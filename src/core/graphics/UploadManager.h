@@ -0,0 +1,136 @@
+
+#ifndef WORLDENGINE_UPLOADMANAGER_H
+#define WORLDENGINE_UPLOADMANAGER_H
+
+#include "core/core.h"
+#include "core/graphics/GraphicsResource.h"
+#include "core/graphics/ImageData.h"
+#include <functional>
+#include <deque>
+
+class Buffer;
+class CommandPool;
+class Fence;
+
+struct UploadManagerConfiguration {
+    WeakResource<vkr::Device> device;
+    uint32_t queueFamilyIndex;
+    std::string queueName;
+    vk::DeviceSize stagingBufferSize = 64 * 1024 * 1024; // 64 MiB
+};
+
+// Streams buffer and image data to the GPU without stalling the calling thread. Data is written straight into a
+// persistently mapped ring staging buffer, and the copies are recorded into the currently open batch. A batch is
+// submitted with a fence at the end of the frame, or earlier when the ring is full, so many small uploads share one
+// submit. Batches retire in submission order as their fences signal, which frees their part of the ring and runs their
+// completion callbacks. Uploads larger than the whole ring are staged through a dedicated buffer, retired with its batch.
+//
+// The frame's graphics submit waits on the uploads submitted during that frame, so anything uploaded before endFrame is
+// visible to rendering. Other submits must call synchronize first if they may read uploaded data. Not thread safe, it is
+// used from the render thread like the rest of the graphics API.
+class UploadManager {
+    NO_COPY(UploadManager);
+    NO_MOVE(UploadManager);
+public:
+    // Identifies the batch an upload was recorded in. Later uploads never complete before earlier ones.
+    typedef uint64_t UploadId;
+    typedef std::function<void()> CompletionCallback;
+
+    static constexpr UploadId INVALID_UPLOAD = 0;
+
+private:
+    struct Batch {
+        UploadId id;
+        std::shared_ptr<vkr::CommandBuffer> commandBuffer;
+        Fence* fence;
+        uint64_t stagingEnd; // Ring position after the last staging allocation of this batch
+        std::vector<CompletionCallback> callbacks;
+        std::vector<Buffer*> dedicatedStagingBuffers;
+        bool empty;
+    };
+
+    UploadManager(const WeakResource<vkr::Device>& device, Buffer* stagingBuffer, void* stagingData, const SharedResource<CommandPool>& commandPool, const std::shared_ptr<vkr::Queue>& queue);
+
+public:
+    ~UploadManager();
+
+    static UploadManager* create(const UploadManagerConfiguration& uploadManagerConfiguration, const std::string& name);
+
+    // Copies size bytes of data into the buffer at offset, with the same stride rules as Buffer::upload.
+    UploadId uploadBuffer(Buffer* dstBuffer, vk::DeviceSize offset, vk::DeviceSize size, const void* data, vk::DeviceSize srcStride = 0, vk::DeviceSize dstStride = 0, vk::DeviceSize elementSize = 0, const CompletionCallback& callback = nullptr);
+
+    // Copies one mip level of tightly packed pixels into the image region, transitioning it from srcState to dstState.
+    UploadId uploadImage(const vk::Image& dstImage, const void* data, uint32_t bytesPerPixel, vk::ImageAspectFlags aspectMask, const ImageRegion& imageRegion, const ImageTransitionState& srcState, const ImageTransitionState& dstState, const CompletionCallback& callback = nullptr);
+
+    UploadId copyBuffer(Buffer* srcBuffer, Buffer* dstBuffer, vk::DeviceSize size, vk::DeviceSize srcOffset = 0, vk::DeviceSize dstOffset = 0, const CompletionCallback& callback = nullptr);
+
+    // Records arbitrary transfer commands into the open batch, ordered after every upload recorded before it.
+    UploadId record(const std::function<void(const vk::CommandBuffer&)>& recordCommands, const CompletionCallback& callback = nullptr);
+
+    // Submits the open batch, if anything was recorded into it.
+    void flush();
+
+    // Retires every batch whose fence has signalled. Called once per frame.
+    void update();
+
+    bool isComplete(UploadId uploadId) const;
+
+    // Blocks until the batch holding the upload has completed, submitting it first if it is still open.
+    void wait(UploadId uploadId);
+
+    // Submits and waits for everything uploaded so far. Does nothing if no upload is pending.
+    void synchronize();
+
+    // Submits the open batch, and returns a semaphore signalled once every batch submitted since the last frame has
+    // completed, or nullptr if there were none. The frame's graphics submit must wait on it.
+    const vk::Semaphore* flushFrame(uint32_t frameIndex);
+
+    bool hasPendingUploads() const;
+
+    vk::DeviceSize getStagingBufferSize() const;
+
+    // Bytes of the ring staging buffer held by submitted or open batches.
+    vk::DeviceSize getStagingBytesInUse() const;
+
+private:
+    // Returns a pointer into mapped staging memory for size bytes, and the buffer and offset to copy from.
+    uint8_t* allocateStaging(vk::DeviceSize size, vk::DeviceSize alignment, vk::Buffer& outBuffer, vk::DeviceSize& outOffset);
+
+    bool tryAllocateRing(vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize& outOffset);
+
+    Batch& getOpenBatch();
+
+    UploadId recordCallback(const CompletionCallback& callback);
+
+    // Submits the batch, which must be the open one, or only signals the semaphore if batch is nullptr.
+    void submitBatch(Batch* batch, const vk::Semaphore* signalSemaphore);
+
+    void retireBatch();
+
+    void waitOldestBatch();
+
+private:
+    SharedResource<vkr::Device> m_device;
+    std::shared_ptr<vkr::Queue> m_queue;
+    SharedResource<CommandPool> m_commandPool;
+
+    Buffer* m_stagingBuffer;
+    uint8_t* m_stagingData;
+    vk::DeviceSize m_stagingBufferSize;
+
+    // Monotonic positions in the ring. Bytes in [m_ringTail, m_ringHead) are in use, wrapped by the ring size.
+    uint64_t m_ringHead;
+    uint64_t m_ringTail;
+
+    Batch* m_openBatch;
+    std::deque<Batch*> m_submittedBatches;
+    std::vector<Batch*> m_unusedBatches;
+    UploadId m_nextBatchId;
+    UploadId m_lastCompletedBatchId;
+
+    std::array<std::unique_ptr<vkr::Semaphore>, CONCURRENT_FRAMES> m_frameSemaphores;
+    bool m_submittedSinceFrame;
+};
+
+
+#endif //WORLDENGINE_UPLOADMANAGER_H
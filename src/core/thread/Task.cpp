@@ -1,2 +1,70 @@
-
 #include "core/thread/Task.h"
+#include "core/thread/ThreadPool.h"
+
+
+BaseTask::BaseTask():
+        m_arenaBlock(nullptr),
+        m_refCount(2),
+        m_started(false),
+        m_complete(false),
+        m_exception(nullptr) {
+}
+
+void BaseTask::run() {
+    m_started.store(true, std::memory_order_release);
+
+    try {
+        exec();
+    } catch (...) {
+        m_exception = std::current_exception();
+    }
+
+    m_complete.store(true, std::memory_order_release);
+    m_complete.notify_all();
+}
+
+bool BaseTask::isComplete() const {
+    return m_complete.load(std::memory_order_acquire);
+}
+
+void BaseTask::waitComplete() const {
+    if (isComplete())
+        return;
+
+    ThreadPool* pool = ThreadPool::current();
+
+    if (pool != nullptr) {
+        PROFILE_SCOPE("BaseTask::waitComplete - Run pending tasks")
+
+        // A worker that blocks here would take a core away from the pool, and if every worker is waiting on a child
+        // task, nothing would be left to run them. Instead, the worker keeps executing pending tasks until the awaited
+        // one completes. Failing to find a task does not mean the queues are empty, since a lock or a steal may have
+        // lost a race, so we only stop helping and block once the awaited task has started on another thread.
+        while (!isComplete()) {
+            if (pool->runPendingTask())
+                continue;
+
+            if (m_started.load(std::memory_order_acquire))
+                break;
+
+            std::this_thread::yield();
+        }
+    }
+
+    while (!m_complete.load(std::memory_order_acquire))
+        m_complete.wait(false, std::memory_order_acquire);
+}
+
+void BaseTask::release() {
+    if (m_refCount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    TaskArena::Block* block = m_arenaBlock;
+
+    if (block == nullptr) {
+        delete this;
+    } else {
+        this->~BaseTask();
+        TaskArena::deallocate(block);
+    }
+}
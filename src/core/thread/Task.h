@@ -1,47 +1,218 @@
-
 #ifndef WORLDENGINE_TASK_H
 #define WORLDENGINE_TASK_H
 
 #include "core/core.h"
+#include "core/thread/TaskArena.h"
 #include "core/util/Profiler.h"
 
 
 class BaseTask {
+    template<typename T> friend class TaskFuture;
 public:
+    BaseTask();
+
     virtual ~BaseTask() = default;
 
+    void run();
+
+    bool isComplete() const;
+
+    void waitComplete() const;
+
+    // Tasks are referenced by the executing thread and by their future. The task is destroyed, and its memory returned
+    // to the arena it was allocated from, once both have released it.
+    void release();
+
+protected:
     virtual void exec() = 0;
+
+    template<typename TaskType, typename... CtorArgs>
+    static TaskType* allocate(CtorArgs&&... args);
+
+private:
+    TaskArena::Block* m_arenaBlock;
+    std::atomic_uint32_t m_refCount;
+    std::atomic_bool m_started;
+    std::atomic_bool m_complete;
+    std::exception_ptr m_exception;
 };
 
 
 
+template<typename T>
+class ResultTask : public BaseTask {
+    template<typename U> friend class TaskFuture;
+protected:
+    template<typename Func, typename Tuple>
+    void invoke(Func& func, Tuple& args);
+
+private:
+    std::optional<T> m_result;
+};
+
+template<>
+class ResultTask<void> : public BaseTask {
+protected:
+    template<typename Func, typename Tuple>
+    void invoke(Func& func, Tuple& args);
+};
 
-template<typename Func, typename... Args>
-class Task : public BaseTask {
 
+
+// Lightweight handle to the result of a task. Unlike std::future, no shared state is allocated, the result is stored
+// within the task itself, which stays alive until both the handle and the executing thread have released it.
+template<typename T>
+class TaskFuture {
+public:
+    TaskFuture();
+
+    explicit TaskFuture(ResultTask<T>* task);
+
+    TaskFuture(TaskFuture&& move) noexcept;
+
+    ~TaskFuture();
+
+    NO_COPY(TaskFuture);
+
+    TaskFuture& operator=(TaskFuture&& move) noexcept;
+
+    bool valid() const;
+
+    bool isReady() const;
+
+    void wait() const;
+
+    T get();
+
+private:
+    ResultTask<T>* m_task;
+};
+
+
+
+template<typename Func, typename... Args>
+class Task : public ResultTask<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>> {
 public:
     typedef std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...> return_t;
-    typedef std::future<return_t> future_t;
+    typedef TaskFuture<return_t> future_t;
 
 public:
     explicit Task(Func&& func, std::decay_t<Args>... args);
 
     ~Task() override;
 
-    void exec() override;
+    // Allocates the task from the calling thread's TaskArena rather than the heap.
+    static Task* create(Func&& func, std::decay_t<Args>... args);
 
+    // May only be called once. The returned future holds the second reference to the task.
     future_t getFuture();
 
+protected:
+    void exec() override;
+
 private:
-    Func m_func;
+    std::decay_t<Func> m_func;
     std::tuple<std::decay_t<Args>...> m_args;
-    std::promise<return_t> m_promise;
 };
 
 
 
 
 
+template<typename TaskType, typename... CtorArgs>
+TaskType* BaseTask::allocate(CtorArgs&&... args) {
+    TaskArena::Block* block = nullptr;
+    void* memory = TaskArena::current().allocate(sizeof(TaskType), alignof(TaskType), &block);
+    TaskType* task = new (memory) TaskType(std::forward<CtorArgs>(args)...);
+    task->m_arenaBlock = block;
+    return task;
+}
+
+
+
+template<typename T>
+template<typename Func, typename Tuple>
+void ResultTask<T>::invoke(Func& func, Tuple& args) {
+    m_result.emplace(std::apply(func, args));
+}
+
+template<typename Func, typename Tuple>
+void ResultTask<void>::invoke(Func& func, Tuple& args) {
+    std::apply(func, args);
+}
+
+
+
+template<typename T>
+TaskFuture<T>::TaskFuture():
+        m_task(nullptr) {
+}
+
+template<typename T>
+TaskFuture<T>::TaskFuture(ResultTask<T>* task):
+        m_task(task) {
+}
+
+template<typename T>
+TaskFuture<T>::TaskFuture(TaskFuture&& move) noexcept:
+        m_task(std::exchange(move.m_task, nullptr)) {
+}
+
+template<typename T>
+TaskFuture<T>::~TaskFuture() {
+    if (m_task != nullptr)
+        m_task->release();
+}
+
+template<typename T>
+TaskFuture<T>& TaskFuture<T>::operator=(TaskFuture&& move) noexcept {
+    if (this != &move) {
+        if (m_task != nullptr)
+            m_task->release();
+        m_task = std::exchange(move.m_task, nullptr);
+    }
+    return *this;
+}
+
+template<typename T>
+bool TaskFuture<T>::valid() const {
+    return m_task != nullptr;
+}
+
+template<typename T>
+bool TaskFuture<T>::isReady() const {
+    assert(valid());
+    return m_task->isComplete();
+}
+
+template<typename T>
+void TaskFuture<T>::wait() const {
+    assert(valid());
+    m_task->waitComplete();
+}
+
+template<typename T>
+T TaskFuture<T>::get() {
+    assert(valid());
+    m_task->waitComplete();
+
+    ResultTask<T>* task = std::exchange(m_task, nullptr);
+
+    if (task->m_exception) {
+        std::exception_ptr exception = task->m_exception;
+        task->release();
+        std::rethrow_exception(exception);
+    }
+
+    if constexpr (std::is_same<T, void>::value) {
+        task->release();
+    } else {
+        T result = std::move(task->m_result.value());
+        task->release();
+        return result;
+    }
+}
+
 
 
 template<typename Func, typename... Args>
@@ -55,22 +226,20 @@ Task<Func, Args...>::~Task() {
 
 }
 
+template<typename Func, typename... Args>
+Task<Func, Args...>* Task<Func, Args...>::create(Func&& func, std::decay_t<Args>... args) {
+    return BaseTask::allocate<Task<Func, Args...>>(std::forward<Func>(func), std::forward<std::decay_t<Args>>(args)...);
+}
+
 template<typename Func, typename... Args>
 void Task<Func, Args...>::exec() {
     PROFILE_SCOPE("Task::exec")
-
-    if constexpr (std::is_same<return_t, void>::value) {
-        std::apply(m_func, m_args);
-        m_promise.set_value();
-    } else {
-        return_t ret = std::apply(m_func, m_args);
-        m_promise.set_value(std::move(ret));
-    }
+    this->invoke(m_func, m_args);
 }
 
 template<typename Func, typename... Args>
 typename Task<Func, Args...>::future_t Task<Func, Args...>::getFuture() {
-    return m_promise.get_future();
+    return future_t(this);
 }
 
 
@@ -0,0 +1,131 @@
+#include "core/thread/TaskArena.h"
+
+
+std::atomic_uint64_t TaskArena::s_frameIndex = 0;
+
+
+TaskArena::TaskArena():
+        m_currentBlock(nullptr),
+        m_frameIndex(s_frameIndex) {
+}
+
+TaskArena::~TaskArena() {
+    if (m_currentBlock != nullptr)
+        m_usedBlocks.emplace_back(m_currentBlock);
+
+    // Blocks which still contain live tasks are leaked rather than freed, since another thread may still reference them.
+    for (Block* block : m_usedBlocks)
+        if (block->liveCount == 0)
+            destroyBlock(block);
+
+    for (Block* block : m_freeBlocks)
+        destroyBlock(block);
+}
+
+TaskArena& TaskArena::current() {
+    static thread_local TaskArena arena;
+    return arena;
+}
+
+void TaskArena::nextFrame() {
+    ++s_frameIndex;
+}
+
+void* TaskArena::allocate(size_t size, size_t alignment, Block** outBlock) {
+    assert(outBlock != nullptr);
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+    if (m_frameIndex != s_frameIndex)
+        recycle();
+
+    size_t offset = 0;
+
+    if (m_currentBlock != nullptr)
+        offset = CEIL_TO_MULTIPLE(m_currentBlock->offset, alignment);
+
+    if (m_currentBlock == nullptr || offset + size > m_currentBlock->capacity) {
+        if (m_currentBlock != nullptr)
+            m_usedBlocks.emplace_back(m_currentBlock);
+
+        m_currentBlock = acquireBlock(size + alignment);
+        offset = CEIL_TO_MULTIPLE(m_currentBlock->offset, alignment);
+    }
+
+    m_currentBlock->offset = offset + size;
+    m_currentBlock->liveCount.fetch_add(1, std::memory_order_relaxed);
+
+    *outBlock = m_currentBlock;
+    return m_currentBlock->data + offset;
+}
+
+void TaskArena::deallocate(Block* block) {
+    assert(block != nullptr);
+    assert(block->liveCount > 0);
+    block->liveCount.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+size_t TaskArena::getBlockCount() const {
+    return m_usedBlocks.size() + m_freeBlocks.size() + (m_currentBlock != nullptr ? 1 : 0);
+}
+
+size_t TaskArena::getReservedBytes() const {
+    size_t bytes = m_currentBlock != nullptr ? m_currentBlock->capacity : 0;
+    for (Block* block : m_usedBlocks)
+        bytes += block->capacity;
+    for (Block* block : m_freeBlocks)
+        bytes += block->capacity;
+    return bytes;
+}
+
+void TaskArena::recycle() {
+    m_frameIndex = s_frameIndex;
+
+    if (m_currentBlock != nullptr) {
+        m_usedBlocks.emplace_back(m_currentBlock);
+        m_currentBlock = nullptr;
+    }
+
+    // Blocks with outstanding tasks are kept until a later frame boundary finds them empty.
+    for (size_t i = 0; i < m_usedBlocks.size();) {
+        Block* block = m_usedBlocks[i];
+
+        if (block->liveCount.load(std::memory_order_acquire) != 0) {
+            ++i;
+            continue;
+        }
+
+        m_usedBlocks[i] = m_usedBlocks.back();
+        m_usedBlocks.pop_back();
+
+        if (m_freeBlocks.size() >= MaxFreeBlocks || block->capacity > DefaultBlockSize) {
+            destroyBlock(block);
+        } else {
+            block->offset = 0;
+            m_freeBlocks.emplace_back(block);
+        }
+    }
+}
+
+TaskArena::Block* TaskArena::acquireBlock(size_t minCapacity) {
+    if (minCapacity <= DefaultBlockSize && !m_freeBlocks.empty()) {
+        Block* block = m_freeBlocks.back();
+        m_freeBlocks.pop_back();
+        return block;
+    }
+
+    return createBlock(std::max(minCapacity, DefaultBlockSize));
+}
+
+TaskArena::Block* TaskArena::createBlock(size_t capacity) {
+    Block* block = new Block();
+    block->data = static_cast<uint8_t*>(::operator new(capacity, std::align_val_t(64)));
+    block->capacity = capacity;
+    block->offset = 0;
+    block->liveCount = 0;
+    return block;
+}
+
+void TaskArena::destroyBlock(Block* block) {
+    ::operator delete(block->data, std::align_val_t(64));
+    delete block;
+}
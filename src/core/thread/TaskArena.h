@@ -0,0 +1,61 @@
+#ifndef WORLDENGINE_TASKARENA_H
+#define WORLDENGINE_TASKARENA_H
+
+#include "core/core.h"
+
+// Per-thread linear allocator for task objects. Allocation is a pointer bump within the current block, and never
+// touches the global heap once the arena has warmed up. Each block counts the tasks still alive within it, and
+// blocks whose tasks have all been released are recycled by the owning thread at the next frame boundary.
+// Tasks may be released from any thread, but only the owning thread ever allocates from or recycles its blocks.
+class TaskArena {
+public:
+    struct Block {
+        uint8_t* data;
+        size_t capacity;
+        size_t offset;
+        std::atomic_size_t liveCount;
+    };
+
+    static constexpr size_t DefaultBlockSize = 64 * 1024;
+    static constexpr size_t MaxFreeBlocks = 16;
+
+public:
+    TaskArena();
+
+    ~TaskArena();
+
+    NO_COPY(TaskArena);
+    NO_MOVE(TaskArena);
+
+    static TaskArena& current();
+
+    static void nextFrame();
+
+    void* allocate(size_t size, size_t alignment, Block** outBlock);
+
+    static void deallocate(Block* block);
+
+    size_t getBlockCount() const;
+
+    size_t getReservedBytes() const;
+
+private:
+    void recycle();
+
+    Block* acquireBlock(size_t minCapacity);
+
+    static Block* createBlock(size_t capacity);
+
+    static void destroyBlock(Block* block);
+
+private:
+    Block* m_currentBlock;
+    std::vector<Block*> m_usedBlocks;
+    std::vector<Block*> m_freeBlocks;
+    uint64_t m_frameIndex;
+
+    static std::atomic_uint64_t s_frameIndex;
+};
+
+
+#endif //WORLDENGINE_TASKARENA_H
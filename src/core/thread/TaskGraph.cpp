@@ -0,0 +1,213 @@
+#include "core/thread/TaskGraph.h"
+#include "core/thread/ThreadUtils.h"
+#include "core/util/Logger.h"
+
+
+TaskGraph::TaskGraph():
+        m_changed(false),
+        m_valid(true),
+        m_pendingNodes(0),
+        m_executingNodes(0),
+        m_complete(true),
+        m_exception(nullptr) {
+}
+
+TaskGraph::~TaskGraph() {
+    assert(!isRunning());
+    clear();
+}
+
+TaskGraph::NodeId TaskGraph::addNode(const std::string& name, std::function<void()>&& func) {
+    assert(!isRunning());
+
+    NodeId id = (NodeId)m_nodes.size();
+    Node* node = new Node();
+    node->name = name;
+    node->func = std::move(func);
+    m_nodes.emplace_back(node);
+    m_changed = true;
+    return id;
+}
+
+void TaskGraph::addDependency(NodeId node, NodeId dependency) {
+    assert(!isRunning());
+    assert(node < m_nodes.size() && dependency < m_nodes.size());
+    assert(node != dependency);
+
+    std::vector<NodeId>& successors = m_nodes[dependency]->successors;
+    if (std::find(successors.begin(), successors.end(), node) != successors.end())
+        return; // Dependency was already declared
+
+    successors.emplace_back(node);
+    ++m_nodes[node]->dependencyCount;
+    m_changed = true;
+}
+
+void TaskGraph::clear() {
+    assert(!isRunning());
+
+    for (Node* node : m_nodes)
+        delete node;
+
+    m_nodes.clear();
+    m_rootNodes.clear();
+    m_changed = false;
+    m_valid = true;
+}
+
+void TaskGraph::run() {
+    PROFILE_SCOPE("TaskGraph::run")
+    assert(!isRunning());
+
+    if (m_changed) {
+        m_valid = validate();
+        m_changed = false;
+    }
+
+    if (!m_valid) {
+        LOG_ERROR("Unable to run TaskGraph: The graph contains a dependency cycle");
+        return;
+    }
+
+    if (m_nodes.empty())
+        return;
+
+    for (Node* node : m_nodes)
+        node->pendingDependencies.store(node->dependencyCount, std::memory_order_relaxed);
+
+    m_exception = nullptr;
+    m_complete = false;
+    m_pendingNodes = m_nodes.size();
+
+    ThreadUtils::beginBatch();
+    for (NodeId id : m_rootNodes)
+        dispatch(id);
+    ThreadUtils::endBatch();
+
+    ThreadPool* pool = ThreadPool::current();
+    if (pool != nullptr) {
+        PROFILE_SCOPE("TaskGraph::run - Run pending tasks")
+        // Failing to find a task may be a lost race rather than an empty queue, so we keep helping until the graph
+        // completes, and only block while one of its nodes is executing on another thread.
+        while (!m_complete) {
+            if (pool->runPendingTask())
+                continue;
+
+            if (m_executingNodes.load(std::memory_order_acquire) > 0)
+                break;
+
+            std::this_thread::yield();
+        }
+    }
+
+    {
+        PROFILE_SCOPE("TaskGraph::run - Wait for nodes")
+        // The lock is always taken, even if the graph already completed, so that we don't return while the thread
+        // which completed it is still notifying.
+        std::unique_lock<std::mutex> lock(m_completeMutex);
+        while (!m_complete)
+            m_completeCondition.wait(lock);
+    }
+
+    if (m_exception)
+        std::rethrow_exception(m_exception);
+}
+
+size_t TaskGraph::getNodeCount() const {
+    return m_nodes.size();
+}
+
+const std::string& TaskGraph::getNodeName(NodeId node) const {
+    assert(node < m_nodes.size());
+    return m_nodes[node]->name;
+}
+
+bool TaskGraph::isRunning() const {
+    return m_pendingNodes > 0;
+}
+
+bool TaskGraph::validate() {
+    PROFILE_SCOPE("TaskGraph::validate")
+
+    m_rootNodes.clear();
+
+    // Kahn's algorithm. If any node is never reached, it is part of a cycle.
+    std::vector<uint32_t> dependencyCounts;
+    dependencyCounts.resize(m_nodes.size());
+
+    std::vector<NodeId> readyNodes;
+
+    for (NodeId id = 0; id < m_nodes.size(); ++id) {
+        dependencyCounts[id] = m_nodes[id]->dependencyCount;
+        if (dependencyCounts[id] == 0) {
+            m_rootNodes.emplace_back(id);
+            readyNodes.emplace_back(id);
+        }
+    }
+
+    size_t visitedCount = 0;
+
+    while (!readyNodes.empty()) {
+        NodeId id = readyNodes.back();
+        readyNodes.pop_back();
+        ++visitedCount;
+
+        for (NodeId successor : m_nodes[id]->successors)
+            if (--dependencyCounts[successor] == 0)
+                readyNodes.emplace_back(successor);
+    }
+
+    return visitedCount == m_nodes.size();
+}
+
+void TaskGraph::dispatch(NodeId node) {
+    ThreadUtils::run([this, node]() {
+        execute(node);
+    });
+}
+
+void TaskGraph::execute(NodeId id) {
+    m_executingNodes.fetch_add(1, std::memory_order_acq_rel);
+
+    while (id != INVALID_NODE) {
+        Node* node = m_nodes[id];
+
+        PROFILE_SCOPE("TaskGraph::execute")
+
+        try {
+            node->func();
+        } catch (...) {
+            std::unique_lock<std::mutex> lock(m_exceptionMutex);
+            if (!m_exception)
+                m_exception = std::current_exception();
+        }
+
+        // The first successor to become ready is executed on this thread rather than being pushed to the pool,
+        // which avoids a round trip through the queue for linear chains of nodes.
+        NodeId continuation = INVALID_NODE;
+
+        for (NodeId successor : node->successors) {
+            if (m_nodes[successor]->pendingDependencies.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                continue;
+
+            if (continuation == INVALID_NODE) {
+                continuation = successor;
+            } else {
+                dispatch(successor);
+            }
+        }
+
+        // This thread stops executing nodes before the graph can complete, since run() may return, and the graph be
+        // destroyed, as soon as it has.
+        if (continuation == INVALID_NODE)
+            m_executingNodes.fetch_sub(1, std::memory_order_acq_rel);
+
+        if (m_pendingNodes.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::unique_lock<std::mutex> lock(m_completeMutex);
+            m_complete = true;
+            m_completeCondition.notify_all();
+        }
+
+        id = continuation;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef WORLDENGINE_TASKGRAPH_H
+#define WORLDENGINE_TASKGRAPH_H
+
+#include "core/core.h"
+#include <functional>
+
+// A directed acyclic graph of tasks. The graph is declared once, then run any number of times, typically once per
+// frame. Each run dispatches every node with no dependencies to the thread pool, and each node is dispatched as soon
+// as the last of its dependencies completes. run() blocks until every node has completed. If run() is called from a
+// thread pool worker, the worker executes pending tasks while it waits.
+class TaskGraph {
+public:
+    typedef uint32_t NodeId;
+
+    static constexpr NodeId INVALID_NODE = UINT32_MAX;
+
+private:
+    struct Node {
+        std::string name;
+        std::function<void()> func;
+        std::vector<NodeId> successors;
+        uint32_t dependencyCount = 0;
+        std::atomic_uint32_t pendingDependencies = 0;
+    };
+
+public:
+    TaskGraph();
+
+    ~TaskGraph();
+
+    NO_COPY(TaskGraph);
+    NO_MOVE(TaskGraph);
+
+    NodeId addNode(const std::string& name, std::function<void()>&& func);
+
+    // Declares that node may not start until dependency has completed.
+    void addDependency(NodeId node, NodeId dependency);
+
+    void clear();
+
+    void run();
+
+    size_t getNodeCount() const;
+
+    const std::string& getNodeName(NodeId node) const;
+
+    bool isRunning() const;
+
+private:
+    bool validate();
+
+    void dispatch(NodeId node);
+
+    void execute(NodeId node);
+
+private:
+    std::vector<Node*> m_nodes;
+    std::vector<NodeId> m_rootNodes;
+    bool m_changed;
+    bool m_valid;
+
+    std::atomic_size_t m_pendingNodes;
+    std::atomic_size_t m_executingNodes;
+    std::atomic_bool m_complete;
+    std::mutex m_completeMutex;
+    std::condition_variable m_completeCondition;
+    std::exception_ptr m_exception;
+    std::mutex m_exceptionMutex;
+};
+
+
+#endif //WORLDENGINE_TASKGRAPH_H
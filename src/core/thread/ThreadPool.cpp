@@ -6,22 +6,30 @@
 #include "core/util/Time.h"
 
 
-std::unordered_map<std::thread::id, std::atomic_size_t> ThreadPool::s_maxTaskSizes;
+thread_local ThreadPool::Thread* ThreadPool::s_currentThread = nullptr;
+thread_local ThreadPool::TaskBatch ThreadPool::s_batchedTasks;
 
 
 ThreadPool::ThreadPool(size_t concurrency) {
+    if (concurrency == 0)
+        concurrency = 1;
+
     m_threads.resize(concurrency, nullptr);
 
-    m_pushThreadIndex = 0;
+    m_injectedTaskCount = 0;
     m_taskCount = 0;
+    m_sleepingThreadCount = 0;
 
-    m_isBatchingTasks = false;
-
+    // All workers must be allocated before any of them start, since each worker may attempt to steal from any other.
     for (size_t i = 0; i < concurrency; ++i) {
         m_threads[i] = new Thread();
+        m_threads[i]->pool = this;
+        m_threads[i]->index = i;
         m_threads[i]->running = true;
-        m_threads[i]->thread = std::thread(&ThreadPool::executor, this);
     }
+
+    for (size_t i = 0; i < concurrency; ++i)
+        m_threads[i]->thread = std::thread(&ThreadPool::executor, this, i);
 }
 
 ThreadPool::~ThreadPool() {
@@ -30,8 +38,10 @@ ThreadPool::~ThreadPool() {
 
     wakeThreads();
 
-    for (size_t i = 0; i < m_threads.size(); ++i)
+    for (size_t i = 0; i < m_threads.size(); ++i) {
         m_threads[i]->thread.join();
+        delete m_threads[i];
+    }
 }
 
 ThreadPool* ThreadPool::instance() {
@@ -39,80 +49,38 @@ ThreadPool* ThreadPool::instance() {
     return instance;
 }
 
+ThreadPool* ThreadPool::current() {
+    return s_currentThread != nullptr ? s_currentThread->pool : nullptr;
+}
+
 size_t ThreadPool::getThreadCount() const {
     return m_threads.size();
 }
 
 size_t ThreadPool::getTaskCount() const {
-    return m_taskCount + m_batchedTasks.size();
+    return m_taskCount + s_batchedTasks.tasks.size();
 }
 
 BaseTask* ThreadPool::nextTask(Thread* currentThread) {
     PROFILE_SCOPE("ThreadPool::nextTask")
 
-
     assert(currentThread != nullptr);
-    assert(currentThread->thread.get_id() == std::this_thread::get_id());
+    assert(currentThread == s_currentThread);
 
     if (!wakeThreadCondition(currentThread)) {
         PROFILE_SCOPE("ThreadPool::nextTask - Wait for tasks")
 
         std::unique_lock<std::mutex> lock(m_tasksAvailableMutex);
+
+        // Pushing threads only lock and notify if they observe a sleeping thread. The sleeping count is incremented
+        // before the task count is re-checked, so a concurrent push will either be seen here, or will see this thread.
+        ++m_sleepingThreadCount;
         while (!wakeThreadCondition(currentThread))
             m_tasksAvailableCondition.wait(lock);
-
-        currentThread->forceWake = false;
+        --m_sleepingThreadCount;
     }
 
-//    if (m_taskCount == 0)
-//        syncBatchedTasks();
-
-    BaseTask* task = nullptr;
-
-    constexpr size_t maxAttempts = 128;
-
-    size_t attempts = 0;
-    size_t failedLocks = 0;
-    size_t emptyQueues = 0;
-    auto t0 = Time::now();
-
-    std::uniform_int_distribution<size_t> rand(0, m_threads.size() - 1);
-    size_t offset = rand(random());
-
-    PROFILE_REGION("ThreadPool::nextTask - Attempt lock & pop")
-    while (task == nullptr && attempts < maxAttempts && m_taskCount > 0) {
-
-        ++attempts;
-
-        for (size_t i = 0; i < m_threads.size(); ++i) {
-            size_t index = (offset + i) % m_threads.size();
-
-            Thread* thread = m_threads[index];
-
-            if (thread->taskQueue.empty())
-                continue;
-
-            {
-                std::unique_lock<std::mutex> lock(thread->mutex, std::try_to_lock);
-                if (!lock) {
-                    ++failedLocks;
-                    continue;
-                }
-
-                if (thread->taskQueue.empty()) {
-                    ++emptyQueues;
-                    continue;
-                }
-
-                task = thread->taskQueue.front();
-                thread->taskQueue.pop_front();
-            }
-
-            --m_taskCount;
-
-            break;
-        }
-    }
+    BaseTask* task = findTask(currentThread);
 
     if (task == nullptr) {
         PROFILE_REGION("ThreadPool::nextTask - Yield")
@@ -122,37 +90,29 @@ BaseTask* ThreadPool::nextTask(Thread* currentThread) {
     return task;
 }
 
-void ThreadPool::executor() {
-    PROFILE_SCOPE("ThreadPool::executor");
+bool ThreadPool::runPendingTask() {
+    PROFILE_SCOPE("ThreadPool::runPendingTask")
 
-    LOG_INFO("Starting thread pool executor for thread 0x%016llx", ThreadUtils::getCurrentThreadHashedId());
+    Thread* thread = getCurrentThread();
+    if (thread == nullptr)
+        return false;
 
-    // Wait for all threads to be allocated.
-    while (true) {
-        for (const auto& thread : m_threads)
-            if (thread == nullptr)
-                continue; // One or more threads are unallocated
-        break; // All threads are allocated
-    }
+    BaseTask* task = findTask(thread);
+    if (task == nullptr)
+        return false;
 
-    Thread* thread = getCurrentThread();
+    task->run();
+    task->release();
+    return true;
+}
 
-    // TODO: implement less hacky way of dealing with this.
-    // Sometimes getCurrentThread() is called before all threads have been spun up, resulting in a nullptr.
-    // We retry 100 times, once every 10 milliseconds if it fails. 99% of the time it should work on the first or second attempt.
-    // 1000 milliseconds should be enough for even the slowest systems.
-    for (size_t i = 0; thread == nullptr && i < 100; ++i) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        thread = getCurrentThread();
-    }
+void ThreadPool::executor(size_t threadIndex) {
+    PROFILE_SCOPE("ThreadPool::executor");
 
-    if (thread == nullptr) {
-        LOG_FATAL("Failed to initialize ThreadPool worker thread");
-        assert(false);
-        return;
-    }
+    LOG_INFO("Starting thread pool executor for thread 0x%016llx", ThreadUtils::getCurrentThreadHashedId());
 
-    thread->forceWake = false;
+    Thread* thread = m_threads[threadIndex];
+    s_currentThread = thread;
 
     while (thread->running) {
         Profiler::beginFrame();
@@ -163,30 +123,22 @@ void ThreadPool::executor() {
             if (task == nullptr)
                 continue;
 
-            task->exec();
-
-            thread->completeTasks.emplace_back(task);
+            task->run();
+            task->release();
         }
         Profiler::endFrame();
     }
+
+    s_currentThread = nullptr;
 }
 
 size_t ThreadPool::getCurrentThreadIndex() {
-    PROFILE_SCOPE("ThreadPool::getCurrentThreadIndex")
-    // TODO: optimise this by sorting threads by ID at initialization, then using std::lower_bound to find the current thread
-    // O(log N) instead of O(N), improvement would be more significant on highly multi-threaded systems.
-    auto id = std::this_thread::get_id();
-    for (size_t i = 0; i < m_threads.size(); ++i) {
-        if (m_threads[i]->thread.get_id() == id)
-            return i;
-    }
-    return SIZE_MAX;
+    Thread* thread = getCurrentThread();
+    return thread != nullptr ? thread->index : SIZE_MAX;
 }
 
 ThreadPool::Thread* ThreadPool::getCurrentThread() {
-    PROFILE_SCOPE("ThreadPool::getCurrentThread")
-    size_t index = getCurrentThreadIndex();
-    return index < m_threads.size() ? m_threads[index] : nullptr;
+    return s_currentThread != nullptr && s_currentThread->pool == this ? s_currentThread : nullptr;
 }
 
 std::default_random_engine& ThreadPool::random() {
@@ -205,98 +157,141 @@ std::default_random_engine& ThreadPool::random() {
 
 void ThreadPool::beginBatch() {
     PROFILE_SCOPE("ThreadPool::beginBatch")
-    assert(!m_isBatchingTasks);
+    assert(!s_batchedTasks.active);
 
-    m_batchedTasksMutex.lock();
-    m_isBatchingTasks = true;
+    s_batchedTasks.active = true;
 }
 
 void ThreadPool::endBatch() {
     PROFILE_SCOPE("ThreadPool::endBatch")
-    assert(m_isBatchingTasks);
+    assert(s_batchedTasks.active);
 
-    syncBatchedTasks();
-    m_isBatchingTasks = false;
-    m_batchedTasksMutex.unlock();
+    s_batchedTasks.active = false;
+    enqueueTasks(s_batchedTasks.tasks.data(), s_batchedTasks.tasks.size());
+    s_batchedTasks.tasks.clear();
 }
 
-void ThreadPool::syncBatchedTasks() {
-    PROFILE_SCOPE("ThreadPool::syncBatchedTasks")
+void ThreadPool::enqueueTasks(BaseTask* const* tasks, size_t count) {
+    PROFILE_SCOPE("ThreadPool::enqueueTasks")
+
+    if (count == 0)
+        return;
+
+    Thread* currentThread = getCurrentThread();
 
-    PROFILE_REGION("ThreadPool::syncBatchedTasks - Acquire lock")
-    std::unique_lock<std::recursive_mutex> batchTasksLock(m_batchedTasksMutex);
+    if (currentThread != nullptr) {
+        // Workers push to their own queue without locking. Idle workers will steal from it.
+        PROFILE_REGION("ThreadPool::enqueueTasks - Push local")
+        for (size_t i = 0; i < count; ++i)
+            currentThread->taskQueue.push(tasks[i]);
 
-    PROFILE_REGION("ThreadPool::syncBatchedTasks - Distribute tasks to workers")
+    } else {
+        PROFILE_REGION("ThreadPool::enqueueTasks - Push injected")
+        std::unique_lock<std::mutex> lock(m_injectedTasksMutex);
+        m_injectedTasks.insert(m_injectedTasks.end(), tasks, tasks + count);
+        m_injectedTaskCount += count;
+    }
 
-    size_t numBatchedTasks = m_batchedTasks.size();
+    m_taskCount += count;
 
-    std::uniform_int_distribution<size_t> rand(0, m_threads.size() - 1);
-    size_t threadIndex = rand(random());
-    size_t tasksPerThread = INT_DIV_CEIL(numBatchedTasks, m_threads.size());
+    notifyWorkers(count);
+}
 
-    size_t popIndex = 0;
-    while (popIndex < numBatchedTasks) {
+BaseTask* ThreadPool::findTask(Thread* currentThread) {
+    PROFILE_SCOPE("ThreadPool::findTask")
 
-        {
-            std::unique_lock<std::mutex> threadLock(m_threads[threadIndex]->mutex, std::try_to_lock);
+    BaseTask* task = nullptr;
+
+    if (currentThread != nullptr) {
+        std::optional<BaseTask*> localTask = currentThread->taskQueue.pop();
+        if (localTask.has_value()) {
+            --m_taskCount;
+            return localTask.value();
+        }
+    }
+
+    task = popInjectedTask();
+    if (task != nullptr)
+        return task;
 
-            if (threadLock) {
-                for (size_t i = 0; i < tasksPerThread && popIndex < numBatchedTasks; ++i)
-                    m_threads[threadIndex]->taskQueue.emplace_back(m_batchedTasks[popIndex++]);
+    return stealTask(currentThread);
+}
+
+BaseTask* ThreadPool::popInjectedTask() {
+    if (m_injectedTaskCount == 0)
+        return nullptr;
+
+    std::unique_lock<std::mutex> lock(m_injectedTasksMutex, std::try_to_lock);
+    if (!lock || m_injectedTasks.empty())
+        return nullptr;
+
+    BaseTask* task = m_injectedTasks.front();
+    m_injectedTasks.pop_front();
+    --m_injectedTaskCount;
+    --m_taskCount;
+    return task;
+}
+
+BaseTask* ThreadPool::stealTask(Thread* currentThread) {
+    PROFILE_SCOPE("ThreadPool::stealTask")
+
+    constexpr size_t maxAttempts = 128;
+
+    const size_t threadCount = m_threads.size();
+
+    std::uniform_int_distribution<size_t> rand(0, threadCount - 1);
+
+    for (size_t attempts = 0; attempts < maxAttempts && m_taskCount > 0; ++attempts) {
+        size_t offset = rand(random());
+
+        for (size_t i = 0; i < threadCount; ++i) {
+            Thread* victim = m_threads[(offset + i) % threadCount];
+
+            if (victim == currentThread || victim->taskQueue.empty())
+                continue;
+
+            // steal() may fail spuriously if another thread won the race for the same task, in which case we move on
+            // to the next victim rather than retrying this one.
+            std::optional<BaseTask*> task = victim->taskQueue.steal();
+            if (task.has_value()) {
+                --m_taskCount;
+                return task.value();
             }
         }
 
-        threadIndex = (threadIndex + 1) % m_threads.size();
+        BaseTask* task = popInjectedTask();
+        if (task != nullptr)
+            return task;
     }
 
-    m_batchedTasks.clear();
+    return nullptr;
+}
 
-    {
-        PROFILE_REGION("ThreadPool::syncBatchedTasks - Lock and incr tasks")
+void ThreadPool::notifyWorkers(size_t taskCount) {
+    if (m_sleepingThreadCount == 0)
+        return; // All workers are awake and will find the new tasks without being notified.
 
-        std::unique_lock<std::mutex> taskCountLock(m_tasksAvailableMutex);
-        m_taskCount += numBatchedTasks;
+    PROFILE_SCOPE("ThreadPool::notifyWorkers")
 
-        PROFILE_REGION("ThreadPool::syncBatchedTasks - Notify workers")
+    std::unique_lock<std::mutex> lock(m_tasksAvailableMutex);
+    if (taskCount == 1) {
+        m_tasksAvailableCondition.notify_one();
+    } else {
         m_tasksAvailableCondition.notify_all();
     }
-
 }
 
 void ThreadPool::flushFrame() {
-//    std::set<Thread*> lockedThreads;
-//
-//    while (lockedThreads.size() < m_threads.size()) {
-//        for (size_t i = 0; i < m_threads.size(); ++i) {
-//            if (!lockedThreads.contains(m_threads[i])) {
-//                if (m_threads[i]->mutex.try_lock())
-//                    lockedThreads.emplace(m_threads[i]);
-//            }
-//        }
-//    }
-//
-//    for (size_t i = 0; i < m_threads.size(); ++i) {
-//        auto& completeTasks = m_threads[i]->completeTasks;
-//    }
-//
-//    for (auto it = lockedThreads.rbegin(); it != lockedThreads.rend(); ++it) {
-//        Thread* thread = *it;
-//        thread->mutex.unlock();
-//    }
+    TaskArena::nextFrame();
 }
 
 bool ThreadPool::wakeThreadCondition(Thread* thread) const {
-    return
-//    thread->forceWake ||
-    m_taskCount > 0;
+    return m_taskCount > 0 || !thread->running;
 }
 
 void ThreadPool::wakeThreads() {
-//    PROFILE_SCOPE("ThreadPool::wakeThreads");
-//
-//    std::unique_lock<std::mutex> lock(m_tasksAvailableMutex);
-//    for (size_t i = 0; i < m_threads.size(); ++i)
-//        m_threads[i]->forceWake = true;
-//
-//    m_tasksAvailableCondition.notify_all();
+    PROFILE_SCOPE("ThreadPool::wakeThreads");
+
+    std::unique_lock<std::mutex> lock(m_tasksAvailableMutex);
+    m_tasksAvailableCondition.notify_all();
 }
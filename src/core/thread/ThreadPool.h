@@ -12,21 +12,21 @@
 
 
 class ThreadPool {
-public:
-    static std::unordered_map<std::thread::id, std::atomic_size_t> s_maxTaskSizes;
-
 private:
     template<typename Func, typename... Args>
     using future_t = typename Task<Func, Args...>::future_t;
 
     struct Thread {
+        ThreadPool* pool;
+        size_t index;
         std::thread thread;
-        std::mutex mutex;
-        //wsque<BaseTask*> taskQueue;
-        std::deque<BaseTask*> taskQueue;
-        std::vector<BaseTask*> completeTasks;
-        bool running;
-        bool forceWake;
+        wsque<BaseTask*> taskQueue; // Only the owning worker may push or pop, any other thread may steal.
+        std::atomic_bool running;
+    };
+
+    struct TaskBatch {
+        std::vector<BaseTask*> tasks;
+        bool active = false;
     };
 
 public:
@@ -36,24 +36,29 @@ public:
 
     static ThreadPool* instance();
 
+    // The pool owning the calling thread, or nullptr if the calling thread is not a pool worker.
+    static ThreadPool* current();
+
     size_t getThreadCount() const;
 
     size_t getTaskCount() const;
 
+    // Marks a frame boundary. Task arena blocks whose tasks have all completed are recycled by their owning thread.
     void flushFrame();
 
     template<typename Func, typename... Args>
     future_t<Func, Args...> pushTask(Task<Func, Args...>* task);
 
-//    template<typename Func, typename... Args>
-//    void pushTasks(size_t count, Task<Func, Args...>** tasks, future_t<Func, Args...>* futures);
-
     void beginBatch();
 
     void endBatch();
 
     BaseTask* nextTask(Thread* currentThread);
 
+    // Executes one pending task on the calling worker, preferring its own queue before stealing. Returns false if the
+    // calling thread is not a worker of this pool, or if no task could be found.
+    bool runPendingTask();
+
     void wakeThreads();
 
 private:
@@ -61,27 +66,38 @@ private:
 
     Thread* getCurrentThread();
 
-    void executor();
+    void executor(size_t threadIndex);
 
     std::default_random_engine& random();
 
-    void syncBatchedTasks();
+    void enqueueTasks(BaseTask* const* tasks, size_t count);
+
+    BaseTask* findTask(Thread* currentThread);
+
+    BaseTask* popInjectedTask();
+
+    BaseTask* stealTask(Thread* currentThread);
+
+    void notifyWorkers(size_t taskCount);
 
     bool wakeThreadCondition(Thread* thread) const;
 
 private:
     std::vector<Thread*> m_threads;
-    std::atomic_size_t m_pushThreadIndex;
+
+    // Tasks pushed from threads outside the pool can't be pushed to a worker's queue, since only the
+    // owning worker is allowed to push. They go through this queue instead.
+    std::deque<BaseTask*> m_injectedTasks;
+    std::mutex m_injectedTasksMutex;
+    std::atomic_size_t m_injectedTaskCount;
 
     std::atomic_size_t m_taskCount;
+    std::atomic_size_t m_sleepingThreadCount;
     std::mutex m_tasksAvailableMutex;
     std::condition_variable m_tasksAvailableCondition;
 
-    std::vector<BaseTask*> m_batchedTasks;
-    std::recursive_mutex m_batchedTasksMutex;
-    bool m_isBatchingTasks;
-
-
+    static thread_local Thread* s_currentThread;
+    static thread_local TaskBatch s_batchedTasks;
 };
 
 
@@ -95,29 +111,12 @@ typename ThreadPool::future_t<Func, Args...> ThreadPool::pushTask(Task<Func, Arg
 
     auto future = task->getFuture();
 
-
-    if (m_isBatchingTasks) {
-        m_batchedTasks.emplace_back(task);
+    if (s_batchedTasks.active) {
+        s_batchedTasks.tasks.emplace_back(task);
 
     } else {
-        size_t pushThreadIndex = m_pushThreadIndex++;
-
-        {
-            PROFILE_REGION("Lock and push")
-            pushThreadIndex = pushThreadIndex % m_threads.size();
-            std::unique_lock<std::mutex> lock(m_threads[pushThreadIndex]->mutex);
-            m_threads[pushThreadIndex]->taskQueue.push_back(task);
-        }
-
-        {
-            PROFILE_REGION("Lock and incr tasks")
-            std::unique_lock<std::mutex> lock(m_tasksAvailableMutex);
-            ++m_taskCount;
-
-            PROFILE_REGION("Notify task available")
-            m_tasksAvailableCondition.notify_one();
-        }
-
+        BaseTask* baseTask = task;
+        enqueueTasks(&baseTask, 1);
     }
 
     return future;
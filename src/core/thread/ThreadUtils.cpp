@@ -15,6 +15,10 @@ void ThreadUtils::wakeThreads() {
     ThreadPool::instance()->wakeThreads();
 }
 
+void ThreadUtils::flushFrame() {
+    ThreadPool::instance()->flushFrame();
+}
+
 size_t ThreadUtils::getThreadCount() {
     return ThreadPool::instance()->getThreadCount();
 }
@@ -10,6 +10,7 @@ namespace ThreadUtils {
     template<typename Func, typename... Args>
     using future_t = typename Task<Func, Args...>::future_t;
 
+    // Ownership of the task is transferred to the thread pool. It must have been allocated with new or Task::create
     template<typename Func, typename... Args>
     ThreadUtils::future_t<Func, Args...> run(Task<Func, Args...>* task);
 
@@ -19,20 +20,20 @@ namespace ThreadUtils {
     template<typename Func, typename... Args>
     auto parallel_range(size_t range, size_t alignment, size_t taskCount, Func&& func, Args&&... args);
 
-    template<typename Func, typename... Args>
+    template<typename Func, typename... Args> requires std::is_invocable_v<Func, size_t, size_t, Args...>
     auto parallel_range(size_t range, Func&& func, Args&&... args);
 
     template<typename T, typename... Ts>
-    void wait(const std::future<T>& future, const std::future<Ts>&... futures);
+    void wait(const TaskFuture<T>& future, const TaskFuture<Ts>&... futures);
 
     template<typename T>
-    void wait(const std::vector<std::future<T>>& futures);
+    void wait(const std::vector<TaskFuture<T>>& futures);
 
     template<typename T, typename... Ts>
-    auto getResults(const std::future<T>& future, const std::future<Ts>&... futures);
+    auto getResults(const TaskFuture<T>& future, const TaskFuture<Ts>&... futures);
 
     template<typename T>
-    std::vector<T> getResults(const std::vector<std::future<T>>& futures);
+    std::vector<T> getResults(const std::vector<TaskFuture<T>>& futures);
 
     void beginBatch();
 
@@ -40,6 +41,8 @@ namespace ThreadUtils {
 
     void wakeThreads();
 
+    void flushFrame();
+
     size_t getThreadCount();
 
     uint64_t getThreadHashedId(const std::thread::id& id);
@@ -56,7 +59,7 @@ typename ThreadUtils::future_t<Func, Args...> ThreadUtils::run(Task<Func, Args..
 template<typename Func, typename... Args>
 typename ThreadUtils::future_t<Func, Args...> ThreadUtils::run(Func&& func, Args&&... args) {
     PROFILE_SCOPE("ThreadUtils::run")
-    auto* task = new Task<Func, Args...>(std::forward<Func>(func), std::forward<Args>(args)...);
+    auto* task = Task<Func, Args...>::create(std::forward<Func>(func), std::forward<Args>(args)...);
     return ThreadPool::instance()->pushTask(task);
 }
 
@@ -100,14 +103,14 @@ auto ThreadUtils::parallel_range(size_t range, size_t alignment, size_t taskCoun
     return std::move(results);
 }
 
-template<typename Func, typename... Args>
+template<typename Func, typename... Args> requires std::is_invocable_v<Func, size_t, size_t, Args...>
 auto ThreadUtils::parallel_range(size_t range, Func&& func, Args&&... args) {
     return ThreadUtils::parallel_range<Func, Args...>(range, 1, ThreadUtils::getThreadCount(), std::forward<Func>(func), std::forward<Args>(args)...);
 }
 
 
 template<typename T, typename... Ts>
-void ThreadUtils::wait(const std::future<T>& future, const std::future<Ts>&... futures) {
+void ThreadUtils::wait(const TaskFuture<T>& future, const TaskFuture<Ts>&... futures) {
     PROFILE_SCOPE("ThreadUtils::wait")
     future.wait();
     if constexpr (sizeof...(futures) != 0)
@@ -115,30 +118,30 @@ void ThreadUtils::wait(const std::future<T>& future, const std::future<Ts>&... f
 }
 
 template<typename T>
-void ThreadUtils::wait(const std::vector<std::future<T>>& futures) {
+void ThreadUtils::wait(const std::vector<TaskFuture<T>>& futures) {
     PROFILE_SCOPE("ThreadUtils::wait")
     for (auto& future : futures)
         future.wait();
 }
 
 template<typename T, typename... Ts>
-auto ThreadUtils::getResults(const std::future<T>& future, const std::future<Ts>&... futures) {
+auto ThreadUtils::getResults(const TaskFuture<T>& future, const TaskFuture<Ts>&... futures) {
     PROFILE_SCOPE("ThreadUtils::getResults")
     if constexpr (sizeof...(futures) == 0) {
-        return const_cast<std::future<T>&>(future).get();
+        return const_cast<TaskFuture<T>&>(future).get();
     } else {
-        return std::make_tuple(const_cast<std::future<T>&>(future).get(), getResults(futures)...);
+        return std::make_tuple(const_cast<TaskFuture<T>&>(future).get(), getResults(futures)...);
     }
 }
 
 template<typename T>
-std::vector<T> ThreadUtils::getResults(const std::vector<std::future<T>>& futures) {
+std::vector<T> ThreadUtils::getResults(const std::vector<TaskFuture<T>>& futures) {
     PROFILE_SCOPE("ThreadUtils::getResults")
 
     std::vector<T> results;
     results.reserve(futures.size());
 
-    auto& nonConstFutures = const_cast<std::vector<std::future<T>>&>(futures);
+    auto& nonConstFutures = const_cast<std::vector<TaskFuture<T>>&>(futures);
     for (auto&& future : nonConstFutures)
         results.emplace_back(future.get());
 
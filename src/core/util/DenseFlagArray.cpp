@@ -129,3 +129,21 @@ void DenseFlagArray::push_back(bool flag) {
     expand(index);
     set(index, flag);
 }
+
+size_t DenseFlagArray::find(size_t index, bool flag) const {
+    const pack_t skipBits = flag ? FALSE_BITS : TRUE_BITS;
+
+    while (index < m_size) {
+        if (index % pack_bits == 0 && m_data[index / pack_bits] == skipBits) {
+            index += pack_bits; // None of the flags in this pack match, skip the whole pack.
+            continue;
+        }
+
+        if (GET_BIT(m_data[index / pack_bits], index % pack_bits) == (flag ? 1 : 0))
+            return index;
+
+        ++index;
+    }
+
+    return m_size;
+}
@@ -40,6 +40,9 @@ public:
 
     void push_back(bool flag);
 
+    // Returns the index of the first flag at or after index which is equal to flag, or size() if there is none.
+    size_t find(size_t index, bool flag) const;
+
     bool operator[](size_t index) const;
 private:
     std::vector<pack_t> m_data;
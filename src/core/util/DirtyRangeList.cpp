@@ -0,0 +1,123 @@
+#include "core/util/DirtyRangeList.h"
+#include "core/util/Profiler.h"
+
+
+DirtyRangeList::DirtyRangeList():
+        m_allDirty(false),
+        m_sorted(true) {
+}
+
+DirtyRangeList::~DirtyRangeList() = default;
+
+void DirtyRangeList::markDirty(size_t first, size_t count) {
+    if (count == 0 || m_allDirty)
+        return;
+
+    if (!m_ranges.empty()) {
+        Range& last = m_ranges.back();
+
+        // Sequential modifications are by far the most common, and are merged immediately.
+        if (first >= last.first && first <= last.first + last.count) {
+            last.count = glm::max(last.count, first + count - last.first);
+            return;
+        }
+
+        if (first < last.first)
+            m_sorted = false;
+    }
+
+    m_ranges.emplace_back(Range{first, count});
+}
+
+void DirtyRangeList::markAllDirty() {
+    m_allDirty = true;
+    m_ranges.clear();
+    m_sorted = true;
+}
+
+void DirtyRangeList::clear() {
+    m_allDirty = false;
+    m_ranges.clear();
+    m_sorted = true;
+}
+
+bool DirtyRangeList::empty() const {
+    return !m_allDirty && m_ranges.empty();
+}
+
+bool DirtyRangeList::isAllDirty() const {
+    return m_allDirty;
+}
+
+const std::vector<DirtyRangeList::Range>& DirtyRangeList::coalesce(size_t mergeDistance) {
+    PROFILE_SCOPE("DirtyRangeList::coalesce")
+
+    if (m_ranges.size() < 2)
+        return m_ranges;
+
+    if (!m_sorted) {
+        std::sort(m_ranges.begin(), m_ranges.end(), [](const Range& lhs, const Range& rhs) {
+            return lhs.first < rhs.first;
+        });
+        m_sorted = true;
+    }
+
+    size_t mergedCount = 0;
+
+    for (size_t i = 1; i < m_ranges.size(); ++i) {
+        Range& merged = m_ranges[mergedCount];
+        const Range& range = m_ranges[i];
+
+        if (range.first <= merged.first + merged.count + mergeDistance) {
+            merged.count = glm::max(merged.count, range.first + range.count - merged.first);
+        } else {
+            m_ranges[++mergedCount] = range;
+        }
+    }
+
+    m_ranges.resize(mergedCount + 1);
+    return m_ranges;
+}
+
+size_t DirtyRangeList::upload(void* dst, const void* src, size_t elementCount, size_t elementSize, float fullCopyThreshold) {
+    PROFILE_SCOPE("DirtyRangeList::upload")
+
+    if (elementCount == 0) {
+        clear();
+        return 0;
+    }
+
+    bool copyAll = m_allDirty;
+
+    if (!copyAll) {
+        coalesce();
+
+        size_t dirtyCount = 0;
+        for (const Range& range : m_ranges)
+            if (range.first < elementCount)
+                dirtyCount += glm::min(range.count, elementCount - range.first);
+
+        copyAll = (float)dirtyCount >= (float)elementCount * fullCopyThreshold;
+    }
+
+    size_t bytesCopied = 0;
+
+    if (copyAll) {
+        bytesCopied = elementCount * elementSize;
+        memcpy(dst, src, bytesCopied);
+
+    } else {
+        for (const Range& range : m_ranges) {
+            if (range.first >= elementCount)
+                continue;
+
+            size_t offset = range.first * elementSize;
+            size_t size = glm::min(range.count, elementCount - range.first) * elementSize;
+            memcpy(static_cast<uint8_t*>(dst) + offset, static_cast<const uint8_t*>(src) + offset, size);
+            bytesCopied += size;
+        }
+    }
+
+    clear();
+    return bytesCopied;
+}
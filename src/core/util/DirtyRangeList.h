@@ -0,0 +1,46 @@
+
+#ifndef WORLDENGINE_DIRTYRANGELIST_H
+#define WORLDENGINE_DIRTYRANGELIST_H
+
+#include "core/core.h"
+
+// Tracks which elements of a CPU side array were modified since they were last copied to a GPU buffer. Adjacent and
+// overlapping modifications are coalesced, and only the modified spans are copied, unless so much of the array changed
+// that a single contiguous copy is cheaper.
+class DirtyRangeList {
+public:
+    struct Range {
+        size_t first;
+        size_t count;
+    };
+
+public:
+    DirtyRangeList();
+
+    ~DirtyRangeList();
+
+    void markDirty(size_t first, size_t count);
+
+    void markAllDirty();
+
+    void clear();
+
+    bool empty() const;
+
+    bool isAllDirty() const;
+
+    // Sorts the dirty ranges and merges any which overlap or are separated by at most mergeDistance clean elements.
+    const std::vector<Range>& coalesce(size_t mergeDistance = 0);
+
+    // Copies the dirty elements within [0, elementCount) from src to dst, then clears the list. Everything is copied
+    // if the dirty fraction of the array is at least fullCopyThreshold. Returns the number of bytes copied.
+    size_t upload(void* dst, const void* src, size_t elementCount, size_t elementSize, float fullCopyThreshold = 0.5F);
+
+private:
+    std::vector<Range> m_ranges;
+    bool m_allDirty;
+    bool m_sorted;
+};
+
+
+#endif //WORLDENGINE_DIRTYRANGELIST_H
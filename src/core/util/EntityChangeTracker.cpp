@@ -34,4 +34,12 @@ void EntityChangeTracker::setChanged(const EntityChangeTracker::entity_index& en
 
     m_changedFlags.expand(entityIndex + count, true);
     m_changedFlags.set(entityIndex, count, changed);
+}
+
+EntityChangeTracker::entity_index EntityChangeTracker::find(const entity_index& entityIndex, bool changed) const {
+    return (entity_index)m_changedFlags.find(entityIndex, changed);
+}
+
+EntityChangeTracker::entity_index EntityChangeTracker::size() const {
+    return (entity_index)m_changedFlags.size();
 }
\ No newline at end of file
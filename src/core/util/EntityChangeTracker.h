@@ -24,6 +24,11 @@ public:
 
     void setChanged(const entity_index& entityIndex, size_t count, bool changed);
 
+    // Returns the first entity at or after entityIndex which has the given changed state, or size() if there is none.
+    entity_index find(const entity_index& entityIndex, bool changed) const;
+
+    entity_index size() const;
+
 private:
     DenseFlagArray m_changedFlags;
 };
@@ -1,5 +1,70 @@
 #include "Float16.h"
 
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#include <immintrin.h>
+#define FLOAT16_F16C 1
+#else
+#define FLOAT16_F16C 0
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FLOAT16_SSE 1
+#else
+#define FLOAT16_SSE 0
+#endif
+
+#if FLOAT16_SSE && !FLOAT16_F16C
+// Without F16C the conversions are done with integer and float bit manipulation, four values at a time. Both round to
+// nearest even and handle subnormals, infinities and NaNs, the same as F16C. Based on Fabian Giesen's public domain
+// conversions: https://gist.github.com/rygorous/2156668
+
+// Each 32 bit lane of the result holds a half in its low 16 bits, sign extended so that _mm_packs_epi32 keeps it intact.
+static __m128i floatToFloat16SSE(__m128 value) {
+    const __m128i vHalfMax = _mm_set1_epi32((127 + 16) << 23); // Floats at or above this become infinity
+    const __m128i vMinNormal = _mm_set1_epi32((127 - 14) << 23); // Floats below this become subnormal halfs
+    const __m128i vSubnormalMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+    const __m128i vNormalBias = _mm_set1_epi32(0xFFF - ((127 - 15) << 23)); // Rebias the exponent, and round the mantissa
+    const __m128i vNanBit = _mm_set1_epi32(0x200);
+    const __m128i vInfinity = _mm_set1_epi32(0x7C00);
+
+    __m128 sign = _mm_and_ps(value, _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000)));
+    __m128 absValue = _mm_xor_ps(value, sign);
+    __m128i absBits = _mm_castps_si128(absValue);
+
+    __m128i isRegular = _mm_cmpgt_epi32(vHalfMax, absBits);
+    __m128i isSubnormal = _mm_cmpgt_epi32(vMinNormal, absBits);
+    __m128i special = _mm_or_si128(_mm_and_si128(_mm_castps_si128(_mm_cmpunord_ps(absValue, absValue)), vNanBit), vInfinity);
+
+    // Adding the magic value lets the FPU round the mantissa into place.
+    __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absValue, _mm_castsi128_ps(vSubnormalMagic))), vSubnormalMagic);
+
+    // Ties round up only when the half's mantissa would be odd.
+    __m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(absBits, 31 - 13), 31);
+    __m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(absBits, vNormalBias), mantissaOdd), 13);
+
+    __m128i result = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+    result = _mm_or_si128(_mm_and_si128(isRegular, result), _mm_andnot_si128(isRegular, special));
+    return _mm_or_si128(result, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+}
+
+// Each 32 bit lane of the input holds a zero extended half.
+static __m128 float16ToFloatSSE(__m128i value) {
+    const __m128 vExponentScale = _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23));
+    const __m128i vMaxFinite = _mm_set1_epi32(0x7BFF);
+    const __m128 vInfinityExponent = _mm_castsi128_ps(_mm_set1_epi32(255 << 23));
+
+    __m128i absBits = _mm_and_si128(value, _mm_set1_epi32(0x7FFF));
+    __m128i sign = _mm_slli_epi32(_mm_xor_si128(value, absBits), 16);
+
+    // Scaling rebiases the exponent, and normalizes subnormal halfs.
+    __m128 result = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(absBits, 13)), vExponentScale);
+
+    __m128 infNanExponent = _mm_and_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(absBits, vMaxFinite)), vInfinityExponent);
+    return _mm_or_ps(result, _mm_or_ps(_mm_castsi128_ps(sign), infNanExponent));
+}
+#endif
+
 short floatToFloat16(float value) {
     return glm::detail::toFloat16(value);
 //    uint16_t u16;
@@ -18,3 +83,95 @@ float float16ToFloat(short value) {
 //    memcpy(&fRet, &u32, sizeof(float));
 //    return fRet;
 }
+
+void floatToFloat16(const float* src, short* dst, size_t count) {
+    size_t i = 0;
+
+#if FLOAT16_F16C
+    for (; i + 8 <= count; i += 8) {
+        __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(&src[i]), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[i]), half);
+    }
+#elif FLOAT16_SSE
+    for (; i + 8 <= count; i += 8) {
+        __m128i half0 = floatToFloat16SSE(_mm_loadu_ps(&src[i + 0]));
+        __m128i half1 = floatToFloat16SSE(_mm_loadu_ps(&src[i + 4]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[i]), _mm_packs_epi32(half0, half1));
+    }
+#endif
+
+    for (; i < count; ++i)
+        dst[i] = floatToFloat16(src[i]);
+}
+
+void float16ToFloat(const short* src, float* dst, size_t count) {
+    size_t i = 0;
+
+#if FLOAT16_F16C
+    for (; i + 8 <= count; i += 8) {
+        __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
+        _mm256_storeu_ps(&dst[i], _mm256_cvtph_ps(half));
+    }
+#elif FLOAT16_SSE
+    const __m128i vZero = _mm_setzero_si128();
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
+        _mm_storeu_ps(&dst[i + 0], float16ToFloatSSE(_mm_unpacklo_epi16(half, vZero)));
+        _mm_storeu_ps(&dst[i + 4], float16ToFloatSSE(_mm_unpackhi_epi16(half, vZero)));
+    }
+#endif
+
+    for (; i < count; ++i)
+        dst[i] = float16ToFloat(src[i]);
+}
+
+void floatToUnorm16(const float* src, uint16_t* dst, size_t count, float scale, float offset) {
+    float invScale = scale != 0.0F ? 65535.0F / scale : 0.0F;
+    size_t i = 0;
+
+#if FLOAT16_SSE
+    const __m128 vOffset = _mm_set1_ps(offset);
+    const __m128 vInvScale = _mm_set1_ps(invScale);
+    const __m128 vMax = _mm_set1_ps(65535.0F);
+    const __m128i vBias = _mm_set1_epi32(32768);
+    const __m128i vFlip = _mm_set1_epi16((short)0x8000);
+
+    for (; i + 8 <= count; i += 8) {
+        __m128 v0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&src[i + 0]), vOffset), vInvScale);
+        __m128 v1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&src[i + 4]), vOffset), vInvScale);
+        v0 = _mm_min_ps(_mm_max_ps(v0, _mm_setzero_ps()), vMax);
+        v1 = _mm_min_ps(_mm_max_ps(v1, _mm_setzero_ps()), vMax);
+
+        // SSE2 can only pack with signed saturation, so shift into the signed range and flip the sign bit back after.
+        __m128i i0 = _mm_sub_epi32(_mm_cvtps_epi32(v0), vBias);
+        __m128i i1 = _mm_sub_epi32(_mm_cvtps_epi32(v1), vBias);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[i]), _mm_xor_si128(_mm_packs_epi32(i0, i1), vFlip));
+    }
+#endif
+
+    for (; i < count; ++i)
+        dst[i] = (uint16_t)glm::round(glm::clamp((src[i] - offset) * invScale, 0.0F, 65535.0F));
+}
+
+void unorm16ToFloat(const uint16_t* src, float* dst, size_t count, float scale, float offset) {
+    float unitScale = scale / 65535.0F;
+    size_t i = 0;
+
+#if FLOAT16_SSE
+    const __m128 vOffset = _mm_set1_ps(offset);
+    const __m128 vScale = _mm_set1_ps(unitScale);
+    const __m128i vZero = _mm_setzero_si128();
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
+        __m128 v0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(values, vZero));
+        __m128 v1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(values, vZero));
+        _mm_storeu_ps(&dst[i + 0], _mm_add_ps(_mm_mul_ps(v0, vScale), vOffset));
+        _mm_storeu_ps(&dst[i + 4], _mm_add_ps(_mm_mul_ps(v1, vScale), vOffset));
+    }
+#endif
+
+    for (; i < count; ++i)
+        dst[i] = (float)src[i] * unitScale + offset;
+}
@@ -8,6 +8,18 @@ extern short floatToFloat16(float value);
 
 extern float float16ToFloat(short value);
 
+// Bulk conversions between float and half. F16C is used when it is enabled at compile time (ENABLE_AVX2), converting
+// eight values per instruction, otherwise SSE2 converts four values at a time with bit manipulation.
+extern void floatToFloat16(const float* src, short* dst, size_t count);
+
+extern void float16ToFloat(const short* src, float* dst, size_t count);
+
+// Bulk conversions between float and 16 bit unsigned normalized values, where 0 maps to offset and 65535 maps to
+// offset + scale. Values outside that range are clamped. SSE2 converts eight values at a time.
+extern void floatToUnorm16(const float* src, uint16_t* dst, size_t count, float scale, float offset);
+
+extern void unorm16ToFloat(const uint16_t* src, float* dst, size_t count, float scale, float offset);
+
 // Implementation mostly copied from:
 // https://stackoverflow.com/questions/22210684/16-bit-floats-and-gl-half-float
 class Float16 {
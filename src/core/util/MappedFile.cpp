@@ -0,0 +1,108 @@
+#include "core/util/MappedFile.h"
+#include "core/util/Logger.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::MappedFile():
+        m_data(nullptr),
+        m_size(0),
+#ifdef _WIN32
+        m_fileHandle(INVALID_HANDLE_VALUE),
+        m_mappingHandle(nullptr) {
+#else
+        m_fileDescriptor(-1) {
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+    if (m_data != nullptr)
+        UnmapViewOfFile(m_data);
+    if (m_mappingHandle != nullptr)
+        CloseHandle(m_mappingHandle);
+    if (m_fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(m_fileHandle);
+#else
+    if (m_data != nullptr)
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+    if (m_fileDescriptor >= 0)
+        close(m_fileDescriptor);
+#endif
+}
+
+MappedFile* MappedFile::open(const std::string& filePath) {
+    MappedFile* mappedFile = new MappedFile();
+    mappedFile->m_filePath = filePath;
+
+#ifdef _WIN32
+    mappedFile->m_fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (mappedFile->m_fileHandle == INVALID_HANDLE_VALUE) {
+        LOG_ERROR("Failed to open file \"%s\" for mapping", filePath.c_str());
+        delete mappedFile;
+        return nullptr;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(mappedFile->m_fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+        LOG_ERROR("Failed to map file \"%s\": The file is empty", filePath.c_str());
+        delete mappedFile;
+        return nullptr;
+    }
+    mappedFile->m_size = (size_t)fileSize.QuadPart;
+
+    mappedFile->m_mappingHandle = CreateFileMappingA(mappedFile->m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappedFile->m_mappingHandle == nullptr) {
+        LOG_ERROR("Failed to create file mapping for \"%s\"", filePath.c_str());
+        delete mappedFile;
+        return nullptr;
+    }
+
+    mappedFile->m_data = static_cast<const uint8_t*>(MapViewOfFile(mappedFile->m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+    mappedFile->m_fileDescriptor = ::open(filePath.c_str(), O_RDONLY);
+    if (mappedFile->m_fileDescriptor < 0) {
+        LOG_ERROR("Failed to open file \"%s\" for mapping", filePath.c_str());
+        delete mappedFile;
+        return nullptr;
+    }
+
+    struct stat fileStat{};
+    if (fstat(mappedFile->m_fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0) {
+        LOG_ERROR("Failed to map file \"%s\": The file is empty", filePath.c_str());
+        delete mappedFile;
+        return nullptr;
+    }
+    mappedFile->m_size = (size_t)fileStat.st_size;
+
+    void* data = mmap(nullptr, mappedFile->m_size, PROT_READ, MAP_SHARED, mappedFile->m_fileDescriptor, 0);
+    mappedFile->m_data = data != MAP_FAILED ? static_cast<const uint8_t*>(data) : nullptr;
+#endif
+
+    if (mappedFile->m_data == nullptr) {
+        LOG_ERROR("Failed to map view of file \"%s\"", filePath.c_str());
+        delete mappedFile;
+        return nullptr;
+    }
+
+    return mappedFile;
+}
+
+const uint8_t* MappedFile::data() const {
+    return m_data;
+}
+
+size_t MappedFile::size() const {
+    return m_size;
+}
+
+const std::string& MappedFile::getFilePath() const {
+    return m_filePath;
+}
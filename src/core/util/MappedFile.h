@@ -0,0 +1,40 @@
+
+#ifndef WORLDENGINE_MAPPEDFILE_H
+#define WORLDENGINE_MAPPEDFILE_H
+
+#include "core/core.h"
+
+// A read-only memory mapping of a whole file. Pages are only read from disk when they are first touched, and may be
+// evicted again by the operating system under memory pressure, so very large files can be accessed without being
+// resident. The mapping may be read from any thread.
+class MappedFile {
+    NO_COPY(MappedFile);
+    NO_MOVE(MappedFile);
+private:
+    MappedFile();
+
+public:
+    ~MappedFile();
+
+    static MappedFile* open(const std::string& filePath);
+
+    const uint8_t* data() const;
+
+    size_t size() const;
+
+    const std::string& getFilePath() const;
+
+private:
+    std::string m_filePath;
+    const uint8_t* m_data;
+    size_t m_size;
+#ifdef _WIN32
+    void* m_fileHandle;
+    void* m_mappingHandle;
+#else
+    int m_fileDescriptor;
+#endif
+};
+
+
+#endif //WORLDENGINE_MAPPEDFILE_H
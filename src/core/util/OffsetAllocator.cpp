@@ -0,0 +1,314 @@
+#include "core/util/OffsetAllocator.h"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+
+static uint64_t getAlignedOffset(uint64_t offset, uint64_t alignment) {
+    if (alignment <= 1)
+        return offset;
+    return offset + (alignment - (offset % alignment)) % alignment;
+}
+
+static uint32_t findMSB(uint64_t value) {
+    return 63 - (uint32_t)std::countl_zero(value);
+}
+
+
+bool OffsetAllocator::Allocation::valid() const {
+    return index != INVALID_INDEX;
+}
+
+double OffsetAllocator::Stats::getFragmentation() const {
+    if (freeBytes == 0)
+        return 0.0;
+    return 1.0 - (double)largestFreeRegion / (double)freeBytes;
+}
+
+
+OffsetAllocator::OffsetAllocator(uint64_t size) {
+    reset(size);
+}
+
+void OffsetAllocator::reset(uint64_t size) {
+    m_size = size;
+    m_allocatedBytes = 0;
+    m_allocationCount = 0;
+    m_freeRegionCount = 0;
+
+    m_nodes.clear();
+    m_unusedNodes.clear();
+
+    m_firstLevelBitmap = 0;
+    std::fill(std::begin(m_secondLevelBitmaps), std::end(m_secondLevelBitmaps), 0);
+    std::fill(std::begin(m_binHeads), std::end(m_binHeads), INVALID_INDEX);
+
+    if (size > 0)
+        insertFreeNode(createNode(0, size));
+}
+
+OffsetAllocator::Allocation OffsetAllocator::allocate(uint64_t size, uint64_t alignment) {
+    if (size == 0)
+        return Allocation{};
+
+    alignment = std::max(alignment, (uint64_t)1);
+
+    uint32_t nodeIndex = findFreeNode(size, alignment);
+    if (nodeIndex == INVALID_INDEX)
+        return Allocation{};
+
+    removeFreeNode(nodeIndex);
+
+    uint64_t padding = getAlignedOffset(m_nodes[nodeIndex].offset, alignment) - m_nodes[nodeIndex].offset;
+    if (padding > 0) {
+        // The padding stays free as its own region, and is merged back once either neighbour is freed.
+        uint32_t alignedNodeIndex = splitNode(nodeIndex, padding);
+        insertFreeNode(nodeIndex);
+        nodeIndex = alignedNodeIndex;
+    }
+
+    if (m_nodes[nodeIndex].size > size)
+        insertFreeNode(splitNode(nodeIndex, size));
+
+    assert(m_nodes[nodeIndex].size == size);
+    assert(m_nodes[nodeIndex].offset % alignment == 0);
+
+    m_allocatedBytes += size;
+    ++m_allocationCount;
+
+    Allocation allocation{};
+    allocation.offset = m_nodes[nodeIndex].offset;
+    allocation.size = size;
+    allocation.index = nodeIndex;
+    return allocation;
+}
+
+void OffsetAllocator::free(uint32_t allocationIndex) {
+    assert(allocationIndex < m_nodes.size() && !m_nodes[allocationIndex].free);
+
+    m_allocatedBytes -= m_nodes[allocationIndex].size;
+    --m_allocationCount;
+
+    uint32_t prevIndex = m_nodes[allocationIndex].regionPrev;
+    if (prevIndex != INVALID_INDEX && m_nodes[prevIndex].free) {
+        removeFreeNode(prevIndex);
+        m_nodes[allocationIndex].offset = m_nodes[prevIndex].offset;
+        m_nodes[allocationIndex].size += m_nodes[prevIndex].size;
+        m_nodes[allocationIndex].regionPrev = m_nodes[prevIndex].regionPrev;
+        if (m_nodes[allocationIndex].regionPrev != INVALID_INDEX)
+            m_nodes[m_nodes[allocationIndex].regionPrev].regionNext = allocationIndex;
+        destroyNode(prevIndex);
+    }
+
+    uint32_t nextIndex = m_nodes[allocationIndex].regionNext;
+    if (nextIndex != INVALID_INDEX && m_nodes[nextIndex].free) {
+        removeFreeNode(nextIndex);
+        m_nodes[allocationIndex].size += m_nodes[nextIndex].size;
+        m_nodes[allocationIndex].regionNext = m_nodes[nextIndex].regionNext;
+        if (m_nodes[allocationIndex].regionNext != INVALID_INDEX)
+            m_nodes[m_nodes[allocationIndex].regionNext].regionPrev = allocationIndex;
+        destroyNode(nextIndex);
+    }
+
+    insertFreeNode(allocationIndex);
+}
+
+bool OffsetAllocator::canAllocate(uint64_t size, uint64_t alignment) const {
+    return size > 0 && findFreeNode(size, std::max(alignment, (uint64_t)1)) != INVALID_INDEX;
+}
+
+uint64_t OffsetAllocator::getMaxAllocatableSize(uint64_t alignment) const {
+    uint64_t size = 0;
+    findLargestFreeNode(std::max(alignment, (uint64_t)1), size);
+    return size;
+}
+
+OffsetAllocator::Stats OffsetAllocator::getStats() const {
+    Stats stats{};
+    stats.size = m_size;
+    stats.allocatedBytes = m_allocatedBytes;
+    stats.freeBytes = m_size - m_allocatedBytes;
+    stats.allocationCount = m_allocationCount;
+    stats.freeRegionCount = m_freeRegionCount;
+    findLargestFreeNode(1, stats.largestFreeRegion);
+    return stats;
+}
+
+uint64_t OffsetAllocator::getSize() const {
+    return m_size;
+}
+
+uint64_t OffsetAllocator::getAllocatedBytes() const {
+    return m_allocatedBytes;
+}
+
+uint32_t OffsetAllocator::getAllocationCount() const {
+    return m_allocationCount;
+}
+
+uint32_t OffsetAllocator::getBinIndex(uint64_t size) {
+    // Sizes below SECOND_LEVEL_COUNT each get their own bin in the first level.
+    if (size < SECOND_LEVEL_COUNT)
+        return (uint32_t)size;
+
+    uint32_t msb = findMSB(size);
+    uint32_t firstLevel = msb - SECOND_LEVEL_BITS + 1;
+    uint32_t secondLevel = (uint32_t)(size >> (msb - SECOND_LEVEL_BITS)) & (SECOND_LEVEL_COUNT - 1);
+    return firstLevel * SECOND_LEVEL_COUNT + secondLevel;
+}
+
+uint32_t OffsetAllocator::findFreeBin(uint64_t size) const {
+    if (size >= SECOND_LEVEL_COUNT) {
+        // Round up to the next size class, so that any region in the bin is large enough.
+        uint64_t round = ((uint64_t)1 << (findMSB(size) - SECOND_LEVEL_BITS)) - 1;
+        if (size > UINT64_MAX - round)
+            return INVALID_INDEX;
+        size += round;
+    }
+
+    uint32_t binIndex = getBinIndex(size);
+    uint32_t firstLevel = binIndex / SECOND_LEVEL_COUNT;
+    uint32_t secondLevel = binIndex % SECOND_LEVEL_COUNT;
+
+    uint32_t secondLevelBitmap = m_secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+    if (secondLevelBitmap == 0) {
+        uint64_t firstLevelBitmap = firstLevel + 1 < FIRST_LEVEL_COUNT ? m_firstLevelBitmap & (~(uint64_t)0 << (firstLevel + 1)) : 0;
+        if (firstLevelBitmap == 0)
+            return INVALID_INDEX;
+
+        firstLevel = (uint32_t)std::countr_zero(firstLevelBitmap);
+        secondLevelBitmap = m_secondLevelBitmaps[firstLevel];
+    }
+
+    return firstLevel * SECOND_LEVEL_COUNT + (uint32_t)std::countr_zero(secondLevelBitmap);
+}
+
+uint32_t OffsetAllocator::findFreeNode(uint64_t size, uint64_t alignment) const {
+    // Try the tightest fit first. Its first region usually has room for the alignment padding too.
+    uint32_t binIndex = findFreeBin(size);
+    if (binIndex == INVALID_INDEX)
+        return INVALID_INDEX;
+
+    uint32_t nodeIndex = m_binHeads[binIndex];
+    const Node& node = m_nodes[nodeIndex];
+    if (getAlignedOffset(node.offset, alignment) - node.offset + size <= node.size)
+        return nodeIndex;
+
+    // Otherwise any region large enough for the worst case padding will do.
+    if (alignment <= 1 || size > UINT64_MAX - (alignment - 1))
+        return INVALID_INDEX;
+
+    binIndex = findFreeBin(size + (alignment - 1));
+    if (binIndex == INVALID_INDEX)
+        return INVALID_INDEX;
+
+    return m_binHeads[binIndex];
+}
+
+uint32_t OffsetAllocator::findLargestFreeNode(uint64_t alignment, uint64_t& outSize) const {
+    outSize = 0;
+    if (m_firstLevelBitmap == 0)
+        return INVALID_INDEX;
+
+    uint32_t firstLevel = findMSB(m_firstLevelBitmap);
+    uint32_t secondLevel = findMSB(m_secondLevelBitmaps[firstLevel]);
+
+    uint32_t largestNodeIndex = INVALID_INDEX;
+    for (uint32_t nodeIndex = m_binHeads[firstLevel * SECOND_LEVEL_COUNT + secondLevel]; nodeIndex != INVALID_INDEX; nodeIndex = m_nodes[nodeIndex].binNext) {
+        const Node& node = m_nodes[nodeIndex];
+        uint64_t padding = getAlignedOffset(node.offset, alignment) - node.offset;
+        uint64_t size = node.size > padding ? node.size - padding : 0;
+        if (size > outSize) {
+            outSize = size;
+            largestNodeIndex = nodeIndex;
+        }
+    }
+
+    return largestNodeIndex;
+}
+
+uint32_t OffsetAllocator::createNode(uint64_t offset, uint64_t size) {
+    uint32_t nodeIndex;
+    if (!m_unusedNodes.empty()) {
+        nodeIndex = m_unusedNodes.back();
+        m_unusedNodes.pop_back();
+    } else {
+        nodeIndex = (uint32_t)m_nodes.size();
+        m_nodes.emplace_back();
+    }
+
+    Node& node = m_nodes[nodeIndex];
+    node.offset = offset;
+    node.size = size;
+    node.binPrev = INVALID_INDEX;
+    node.binNext = INVALID_INDEX;
+    node.regionPrev = INVALID_INDEX;
+    node.regionNext = INVALID_INDEX;
+    node.free = false;
+    return nodeIndex;
+}
+
+void OffsetAllocator::destroyNode(uint32_t nodeIndex) {
+    m_unusedNodes.emplace_back(nodeIndex);
+}
+
+void OffsetAllocator::insertFreeNode(uint32_t nodeIndex) {
+    uint32_t binIndex = getBinIndex(m_nodes[nodeIndex].size);
+    uint32_t firstLevel = binIndex / SECOND_LEVEL_COUNT;
+    uint32_t secondLevel = binIndex % SECOND_LEVEL_COUNT;
+
+    Node& node = m_nodes[nodeIndex];
+    assert(!node.free);
+    node.free = true;
+    node.binPrev = INVALID_INDEX;
+    node.binNext = m_binHeads[binIndex];
+    if (node.binNext != INVALID_INDEX)
+        m_nodes[node.binNext].binPrev = nodeIndex;
+    m_binHeads[binIndex] = nodeIndex;
+
+    m_secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+    m_firstLevelBitmap |= (uint64_t)1 << firstLevel;
+    ++m_freeRegionCount;
+}
+
+void OffsetAllocator::removeFreeNode(uint32_t nodeIndex) {
+    uint32_t binIndex = getBinIndex(m_nodes[nodeIndex].size);
+    uint32_t firstLevel = binIndex / SECOND_LEVEL_COUNT;
+    uint32_t secondLevel = binIndex % SECOND_LEVEL_COUNT;
+
+    Node& node = m_nodes[nodeIndex];
+    assert(node.free);
+    node.free = false;
+
+    if (node.binPrev != INVALID_INDEX)
+        m_nodes[node.binPrev].binNext = node.binNext;
+    else
+        m_binHeads[binIndex] = node.binNext;
+
+    if (node.binNext != INVALID_INDEX)
+        m_nodes[node.binNext].binPrev = node.binPrev;
+
+    if (m_binHeads[binIndex] == INVALID_INDEX) {
+        m_secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+        if (m_secondLevelBitmaps[firstLevel] == 0)
+            m_firstLevelBitmap &= ~((uint64_t)1 << firstLevel);
+    }
+    --m_freeRegionCount;
+}
+
+uint32_t OffsetAllocator::splitNode(uint32_t nodeIndex, uint64_t size) {
+    assert(!m_nodes[nodeIndex].free && size < m_nodes[nodeIndex].size);
+
+    uint32_t tailIndex = createNode(m_nodes[nodeIndex].offset + size, m_nodes[nodeIndex].size - size); // May reallocate m_nodes
+
+    Node& node = m_nodes[nodeIndex];
+    Node& tail = m_nodes[tailIndex];
+    tail.regionPrev = nodeIndex;
+    tail.regionNext = node.regionNext;
+    if (tail.regionNext != INVALID_INDEX)
+        m_nodes[tail.regionNext].regionPrev = tailIndex;
+
+    node.size = size;
+    node.regionNext = tailIndex;
+    return tailIndex;
+}
@@ -0,0 +1,114 @@
+
+#ifndef WORLDENGINE_OFFSETALLOCATOR_H
+#define WORLDENGINE_OFFSETALLOCATOR_H
+
+#include <cstdint>
+#include <vector>
+
+// Two-level segregated fit (TLSF) allocator over a range of offsets. It owns no memory, so it can manage any linear
+// resource, such as a device memory heap, and can be exercised without one. Free regions are binned by size class. The
+// first level is the power of two of the size, which the second level divides linearly into SECOND_LEVEL_COUNT classes.
+// Bitmaps of the non-empty bins find a fitting region with two bit scans, so allocating and freeing are O(1) no matter
+// how many regions there are. Freed regions are merged with free neighbours immediately.
+class OffsetAllocator {
+public:
+    static constexpr uint32_t INVALID_INDEX = UINT32_MAX;
+
+    struct Allocation {
+        uint64_t offset = 0; // Aligned as requested
+        uint64_t size = 0;
+        uint32_t index = INVALID_INDEX; // Passed to free
+
+        bool valid() const;
+    };
+
+    struct Stats {
+        uint64_t size = 0;
+        uint64_t allocatedBytes = 0;
+        uint64_t freeBytes = 0;
+        uint64_t largestFreeRegion = 0;
+        uint32_t allocationCount = 0;
+        uint32_t freeRegionCount = 0;
+
+        // 0 when the free space is a single region, approaching 1 as it is split into many small ones.
+        double getFragmentation() const;
+    };
+
+private:
+    static constexpr uint32_t SECOND_LEVEL_BITS = 4;
+    static constexpr uint32_t SECOND_LEVEL_COUNT = 1 << SECOND_LEVEL_BITS;
+    static constexpr uint32_t FIRST_LEVEL_COUNT = 64 - SECOND_LEVEL_BITS + 1;
+    static constexpr uint32_t BIN_COUNT = FIRST_LEVEL_COUNT * SECOND_LEVEL_COUNT;
+
+    struct Node {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t binPrev; // Neighbours in the free list of the node's bin, while the node is free
+        uint32_t binNext;
+        uint32_t regionPrev; // Adjacent regions, whether free or allocated
+        uint32_t regionNext;
+        bool free;
+    };
+
+public:
+    explicit OffsetAllocator(uint64_t size = 0);
+
+    // Frees every allocation, and manages the range [0, size) instead.
+    void reset(uint64_t size);
+
+    // Returns an invalid allocation if no free region can fit the size at the alignment.
+    Allocation allocate(uint64_t size, uint64_t alignment = 1);
+
+    void free(uint32_t allocationIndex);
+
+    bool canAllocate(uint64_t size, uint64_t alignment = 1) const;
+
+    // The largest size which can currently be allocated at the alignment. Scans the regions of the largest size class.
+    uint64_t getMaxAllocatableSize(uint64_t alignment = 1) const;
+
+    // Scans the regions of the largest size class to find the largest free region.
+    Stats getStats() const;
+
+    uint64_t getSize() const;
+
+    uint64_t getAllocatedBytes() const;
+
+    uint32_t getAllocationCount() const;
+
+private:
+    static uint32_t getBinIndex(uint64_t size);
+
+    // The first bin whose regions are all at least the size, which may be beyond the bin the size falls in.
+    uint32_t findFreeBin(uint64_t size) const;
+
+    uint32_t findFreeNode(uint64_t size, uint64_t alignment) const;
+
+    uint32_t findLargestFreeNode(uint64_t alignment, uint64_t& outSize) const;
+
+    uint32_t createNode(uint64_t offset, uint64_t size);
+
+    void destroyNode(uint32_t nodeIndex);
+
+    void insertFreeNode(uint32_t nodeIndex);
+
+    void removeFreeNode(uint32_t nodeIndex);
+
+    // Splits the region after the first size bytes of an unbinned node into a new node, which is not yet binned.
+    uint32_t splitNode(uint32_t nodeIndex, uint64_t size);
+
+private:
+    uint64_t m_size;
+    uint64_t m_allocatedBytes;
+    uint32_t m_allocationCount;
+    uint32_t m_freeRegionCount;
+
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_unusedNodes;
+
+    uint64_t m_firstLevelBitmap;
+    uint32_t m_secondLevelBitmaps[FIRST_LEVEL_COUNT];
+    uint32_t m_binHeads[BIN_COUNT];
+};
+
+
+#endif //WORLDENGINE_OFFSETALLOCATOR_H
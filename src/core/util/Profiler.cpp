@@ -21,6 +21,8 @@ std::string stringListIds(const std::vector<uint32_t>& ids) {
 #if PROFILING_ENABLED && INTERNAL_PROFILING_ENABLED
 std::unordered_map<uint64_t, Profiler::ThreadContext*> Profiler::s_threadContexts;
 std::mutex Profiler::s_threadContextsMtx;
+std::map<std::string, double> Profiler::s_counters;
+std::mutex Profiler::s_countersMtx;
 #endif
 
 
@@ -555,6 +557,29 @@ float Profiler::getGpuProfilingResolutionNanoseconds() {
     return Engine::graphics()->getPhysicalDeviceLimits().timestampPeriod;
 }
 
+void Profiler::setCounter(const std::string& name, double value) {
+#if PROFILING_ENABLED && INTERNAL_PROFILING_ENABLED
+    std::scoped_lock<std::mutex> lock(s_countersMtx);
+    s_counters[name] = value;
+#endif
+}
+
+void Profiler::setCounters(const std::string* names, const double* values, size_t count) {
+#if PROFILING_ENABLED && INTERNAL_PROFILING_ENABLED
+    std::scoped_lock<std::mutex> lock(s_countersMtx);
+    for (size_t i = 0; i < count; ++i)
+        s_counters[names[i]] = values[i];
+#endif
+}
+
+void Profiler::getCounters(std::vector<std::pair<std::string, double>>& outCounters) {
+    outCounters.clear();
+#if PROFILING_ENABLED && INTERNAL_PROFILING_ENABLED
+    std::scoped_lock<std::mutex> lock(s_countersMtx);
+    outCounters.insert(outCounters.end(), s_counters.begin(), s_counters.end());
+#endif
+}
+
 bool Profiler::writeTimestamp(const vk::CommandBuffer& commandBuffer, const vk::PipelineStageFlagBits& pipelineStage, GPUQuery* outQuery) {
     assert(outQuery != nullptr);
 
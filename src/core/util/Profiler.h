@@ -164,6 +164,15 @@ public:
 
     static float getGpuProfilingResolutionNanoseconds();
 
+    // Named statistics shown next to the frame profiles, such as cache hit counts. A counter keeps its value until it
+    // is set again.
+    static void setCounter(const std::string& name, double value);
+
+    // Sets several counters while holding the lock once, for code which publishes a group of counters every frame.
+    static void setCounters(const std::string* names, const double* values, size_t count);
+
+    static void getCounters(std::vector<std::pair<std::string, double>>& outCounters);
+
 private:
     static bool writeTimestamp(const vk::CommandBuffer& commandBuffer, const vk::PipelineStageFlagBits& pipelineStage, GPUQuery* outQuery);
 
@@ -187,6 +196,8 @@ private:
 #if PROFILING_ENABLED && INTERNAL_PROFILING_ENABLED
     static std::unordered_map<uint64_t, ThreadContext*> s_threadContexts;
     static std::mutex s_threadContextsMtx;
+    static std::map<std::string, double> s_counters;
+    static std::mutex s_countersMtx;
 #endif
 };
 
@@ -236,6 +247,10 @@ private:
     Profiler::endGPU(name, commandBuffer); \
 }
 
+#define PROFILE_COUNTER(name, value) Profiler::setCounter(name, (double)(value));
+
+#define PROFILE_COUNTERS(names, values, count) Profiler::setCounters(names, values, count);
+
 #else
 
 #define PROFILE_SCOPE(name)
@@ -243,6 +258,8 @@ private:
 #define PROFILE_END_REGION()
 #define PROFILE_BEGIN_GPU_CMD(name, commandBuffer)
 #define PROFILE_END_GPU_CMD(name, commandBuffer)
+#define PROFILE_COUNTER(name, value)
+#define PROFILE_COUNTERS(names, values, count)
 
 #endif
 
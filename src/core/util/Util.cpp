@@ -3,6 +3,10 @@
 #include <cstdio>
 #include <xmmintrin.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/wait.h>
+#endif
+
 uint64_t Util::nextPowerOf2(uint64_t v) {
     v--;
     v |= v >> 1;
@@ -117,12 +121,35 @@ int Util::executeCommand(const std::string& command, std::string& outCommandOutp
 
     auto returnCode = _pclose(pipe);
     return (int)returnCode;
+#elif defined(__unix__) || defined(__APPLE__)
+    auto pipe = popen(command.c_str(), "r");
+
+    if (!pipe)
+        throw std::runtime_error("popen() failed");
+
+    outCommandOutput.clear();
+    while (!feof(pipe)) {
+        if (fgets(buffer, buffSize, pipe) != nullptr)
+            outCommandOutput += buffer;
+    }
+
+    int status = pclose(pipe);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE;
 #else
     LOG_FATAL("Unable to execute commands on unsupported platform");
     assert(false);
 #endif
 }
 
+uint64_t Util::hashBytes(const void* data, size_t size, uint64_t hash) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= (uint64_t)bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
 
 
 
@@ -178,6 +178,9 @@ namespace Util {
     inline void memcpy_sse(void* dst, void const* src, size_t size);
 
     int executeCommand(const std::string& command, std::string& outCommandOutput);
+
+    // 64-bit FNV-1a. Unlike std::hash, the result is the same on every platform and build, so it can key files on disk.
+    uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull);
 }
 
 #endif //WORLDENGINE_UTIL_H
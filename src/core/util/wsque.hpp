@@ -7,7 +7,6 @@
 
 // WORK STEALING QUEUE IMPLEMENTATION FROM: https://github.com/taskflow/work-stealing-queue
 // Modifications:
-// - When resizing, old array is deleted rather than being kept.
 // - Constructor is not explicit
 
 /**
@@ -69,7 +68,7 @@ class wsque {
   std::atomic<int64_t> _top;
   std::atomic<int64_t> _bottom;
   std::atomic<Array*> _array;
-  //std::vector<Array*> _garbage;
+  std::vector<Array*> _garbage; // Retired arrays may still be read by concurrent thieves, so they are only freed on destruction
 
   public:
     
@@ -138,15 +137,15 @@ wsque<T>::wsque(int64_t c) {
   _top.store(0, std::memory_order_relaxed);
   _bottom.store(0, std::memory_order_relaxed);
   _array.store(new Array{c}, std::memory_order_relaxed);
-  //_garbage.reserve(32);
+  _garbage.reserve(32);
 }
 
 // Destructor
 template <typename T>
 wsque<T>::~wsque() {
-  //for(auto a : _garbage) {
-  //  delete a;
-  //}
+  for(auto a : _garbage) {
+    delete a;
+  }
   delete _array.load();
 }
   
@@ -177,10 +176,9 @@ void wsque<T>::push(O&& o) {
   // queue is full
   if(a->capacity() - 1 < (b - t)) {
     Array* tmp = a->resize(b, t);
-    //_garbage.push_back(a);
+    _garbage.push_back(a);
     std::swap(a, tmp);
-    _array.store(a, std::memory_order_relaxed);
-    delete tmp;
+    _array.store(a, std::memory_order_release);
   }
 
   a->push(b, std::forward<O>(o));
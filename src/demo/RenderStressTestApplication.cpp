@@ -11,6 +11,7 @@
 #include "core/engine/scene/Transform.h"
 #include "core/engine/scene/bound/Frustum.h"
 #include "core/application/InputHandler.h"
+#include "benchmark/FrustumCullingBenchmark.h"
 #include <random>
 
 RenderStressTestApplication::RenderStressTestApplication():
@@ -99,6 +100,12 @@ void RenderStressTestApplication::render(double dt) {
         sphereEntity.addComponent<RenderComponent>().setMesh(m_sphereMesh).setMaterial(m_sphereMaterial);
     }
 
+    if (input()->keyPressed(SDL_SCANCODE_B)) {
+        const Frustum* frustum = Engine::instance()->getViewFrustum();
+        if (frustum != nullptr)
+            FrustumCullingBenchmark::run(*frustum);
+    }
+
     if (input()->keyPressed(SDL_SCANCODE_F)) {
         Engine::instance()->setViewFrustumPaused(!Engine::instance()->isViewFrustumPaused());
         LOG_INFO("View frustum paused: %s", Engine::instance()->isViewFrustumPaused() ? "TRUE" : "FALSE");
@@ -175,4 +182,4 @@ void RenderStressTestApplication::handleUserInput(double dt) {
             cameraTransform.translate(movementDir * (double)m_playerMovementSpeed * dt);
         }
     }
-}
\ No newline at end of file
+}
@@ -13,6 +13,8 @@
 #include "core/engine/scene/terrain/TerrainTileQuadtree.h"
 #include "core/engine/scene/terrain/tileSupplier/TestTerrainTileSupplier.h"
 #include "core/engine/scene/terrain/tileSupplier/HeightmapTerrainTileSupplier.h"
+#include "core/engine/scene/terrain/tileSupplier/CachedTerrainTileSupplier.h"
+#include "core/engine/scene/terrain/TerrainTileCache.h"
 #include "core/graphics/GraphicsManager.h"
 #include "core/graphics/Mesh.h"
 #include "core/application/InputHandler.h"
@@ -64,10 +66,14 @@ void TerrainTestApplication::init() {
 //    std::string heightmapFilePath = "terrain/UK.tif";
     std::string heightmapFilePath = "terrain/botw.png";
 //    std::string heightmapFilePath = "environment_maps/rustig_koppie_puresky_8k.hdr";
-    ImageData* heightmapImageData = ImageData::load(heightmapFilePath, ImagePixelLayout::RGBA, ImagePixelFormat::Float32);
+//    ImageData* heightmapImageData = ImageData::load(heightmapFilePath, ImagePixelLayout::RGBA, ImagePixelFormat::Float32);
 //    std::shared_ptr<TerrainTileSupplier> tileSupplier = std::make_shared<HeightmapTerrainTileSupplier>(heightmapImageData);
-    std::shared_ptr<TerrainTileSupplier> tileSupplier = std::make_shared<TestTerrainTileSupplier>(heightmapImageData);
-    std::shared_ptr<TerrainTileSupplier> tileSupplier2 = std::make_shared<TestTerrainTileSupplier>(heightmapImageData);
+//    std::shared_ptr<TerrainTileSupplier> tileSupplier = std::make_shared<TestTerrainTileSupplier>(heightmapImageData);
+//    std::shared_ptr<TerrainTileSupplier> tileSupplier2 = std::make_shared<TestTerrainTileSupplier>(heightmapImageData);
+    TerrainTileCache::BuildOptions tileCacheOptions{};
+    std::shared_ptr<TerrainTileCache> tileCache = std::shared_ptr<TerrainTileCache>(TerrainTileCache::load(heightmapFilePath, tileCacheOptions));
+    std::shared_ptr<TerrainTileSupplier> tileSupplier = std::make_shared<CachedTerrainTileSupplier>(tileCache);
+    std::shared_ptr<TerrainTileSupplier> tileSupplier2 = std::make_shared<CachedTerrainTileSupplier>(tileCache);
 
     Entity terrainEntity0 = EntityHierarchy::create(Engine::scene(), "terrainEntity0");
     terrainEntity0.addComponent<Transform>().translate(2000.0, 0.0, 0.0).rotate(0, 1, 0, glm::radians(22.5F));
@@ -2,12 +2,19 @@
 #include "demo/BloomTestApplication.h"
 #include "demo/RenderStressTestApplication.h"
 #include "demo/TerrainTestApplication.h"
+#include "benchmark/FrustumCullingBenchmark.h"
 #include <iostream>
+#include <cstring>
 
 int main(int argc, char* argv[]) {
     char* buffer = new char[1024 * 1024];
     setvbuf(stdout, buffer, _IOFBF, sizeof(buffer));
 
+    // CPU benchmarks run without creating an application, so they need no window or GPU.
+    for (int i = 1; i < argc; ++i)
+        if (strcmp(argv[i], "--benchmark-frustum") == 0)
+            return FrustumCullingBenchmark::main(argc, argv);
+
 //    return Application::create<RenderStressTestApplication>(argc, argv);
     return Application::create<BloomTestApplication>(argc, argv);
 //    return Application::create<TerrainTestApplication>(argc, argv);